@@ -0,0 +1,108 @@
+//  GDS3D, a program for viewing GDSII files in 3D.
+//  Created by Jasper Velner and Michiel Soer, http://icd.el.utwente.nl
+//  Copyright (C) 2013 IC-Design Group, University of Twente.
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+// Checks every gds_decode_xy() kernel against gds_int32() and times them on
+// the XY record of a 4096 point boundary. Then times filling a polygon with
+// it, the old way with two gds_int32() and an AddPoint() per point and with
+// AddPoints(). Exits with 1 on a mismatch.
+
+#include "gdsobject.h"
+#include "gdsreader.h"
+
+static const char *kernel_names[3] = {"scalar", "SSE2", "AVX2"};
+
+// All lengths up to a few vectors, so the tails are covered as well
+static bool check(gds_decode_xy_func decode)
+{
+	byte src[4*64];
+	int32_t dst[64];
+
+	for(unsigned int i=0; i<sizeof(src); i++)
+		src[i] = (byte)rand();
+
+	for(unsigned int count=0; count<=64; count++){
+		memset(dst, 0, sizeof(dst));
+		decode(src, count, dst);
+		for(unsigned int i=0; i<count; i++){
+			if(dst[i] != gds_int32(src + 4*i))
+				return false;
+		}
+	}
+	return true;
+}
+
+int main()
+{
+	const unsigned int count = 2*4096, rounds = 20000;
+	vector<byte> src(4*count);
+	vector<int32_t> dst(count);
+	int result = 0;
+
+	srand(1);
+	for(unsigned int i=0; i<src.size(); i++)
+		src[i] = (byte)rand();
+
+	for(unsigned int level=0; level<3; level++){
+		gds_decode_xy_func decode = gds_decode_xy_kernel(level);
+		if(!decode){
+			printf("%-10s not available\n", kernel_names[level]);
+			continue;
+		}
+		if(!check(decode)){
+			printf("%-10s WRONG\n", kernel_names[level]);
+			result = 1;
+			continue;
+		}
+
+		double start = gds_time();
+		for(unsigned int r=0; r<rounds; r++)
+			decode(&src[0], count, &dst[0]);
+		double seconds = gds_time() - start;
+		printf("%-10s %.2f ns/point\n", kernel_names[level], seconds*1e9/rounds/(count/2));
+	}
+
+	GDSGeometry geometry;
+	vector<int32_t> X(count/2), Y(count/2);
+
+	double start = gds_time();
+	for(unsigned int r=0; r<rounds; r++){
+		geometry.Clear();
+		GDSPolygon polygon = geometry.AddPolygon(0.0f, 1.0f, NULL, count/2);
+		for(unsigned int i=0; i<count/2; i++)
+			polygon.AddPoint(gds_int32(&src[8*i]), gds_int32(&src[8*i+4]));
+	}
+	double seconds = gds_time() - start;
+	printf("%-10s %.2f ns/point\n", "AddPoint", seconds*1e9/rounds/(count/2));
+	memcpy(&X[0], geometry.GetPolygon(0).GetX(), X.size()*sizeof(int32_t));
+	memcpy(&Y[0], geometry.GetPolygon(0).GetY(), Y.size()*sizeof(int32_t));
+
+	start = gds_time();
+	for(unsigned int r=0; r<rounds; r++){
+		geometry.Clear();
+		GDSPolygon polygon = geometry.AddPolygon(0.0f, 1.0f, NULL, count/2);
+		polygon.AddPoints(&src[0], count/2);
+	}
+	seconds = gds_time() - start;
+	if(memcmp(&X[0], geometry.GetPolygon(0).GetX(), X.size()*sizeof(int32_t)) || memcmp(&Y[0], geometry.GetPolygon(0).GetY(), Y.size()*sizeof(int32_t))){
+		printf("%-10s WRONG\n", "AddPoints");
+		result = 1;
+	}
+	else
+		printf("%-10s %.2f ns/point\n", "AddPoints", seconds*1e9/rounds/(count/2));
+	return result;
+}
@@ -0,0 +1,111 @@
+//  GDS3D, a program for viewing GDSII files in 3D.
+//  Created by Jasper Velner and Michiel Soer, http://icd.el.utwente.nl
+//  Copyright (C) 2013 IC-Design Group, University of Twente.
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+// Times GDSPath::Expand() on long routing paths, about 4M outline points
+// per row, and checks that every outline point stays within the miter
+// limit of the path. Exits with 1 if one does not. The expansion before
+// GDSPath had a 127 point limit, so it has no row here.
+
+#include "gdsobject.h"
+
+// Half width of the paths, in database units
+#define PATH_WIDTH	50
+
+static struct ProcessLayer layer; // Only paths with a layer are drawn
+
+// Manhattan routing with a 45 degree jog now and then
+static GDSPath *make_path(int Type, unsigned int Points)
+{
+	GDSPath *path = new GDSPath(Type, 0.0f, 1.0f, Points, PATH_WIDTH, 30.0f, 70.0f, &layer);
+	int32_t x = 0, y = 0;
+
+	for(unsigned int i=0; i<Points; i++){
+		path->AddPoint(i, x, y);
+		int step = 200 + rand()%2000;
+		switch(rand()%9){
+			case 0: case 1: case 2: x += step; break;
+			case 3: case 4: y += step; break;
+			case 5: case 6: y -= step; break;
+			case 7: x += step; y += step; break;
+			default: x += step; y -= step; break;
+		}
+	}
+	return path;
+}
+
+// Outline points are at most the miter limit of four half widths from a
+// path point, plus the extensions
+static bool check(GDSPath *Path, GDSGeometry& Geometry)
+{
+	GDSBox box;
+	int32_t margin = 4*PATH_WIDTH + 70 + 1;
+
+	for(unsigned int i=0; i<Path->GetPoints(); i++)
+		box.addPoint(Path->GetXCoords(i), Path->GetYCoords(i));
+	box.MinX -= margin;
+	box.MinY -= margin;
+	box.MaxX += margin;
+	box.MaxY += margin;
+	if(!Geometry.GetNumPolygons())
+		return false;
+	for(unsigned int i=0; i<Geometry.GetNumPolygons(); i++){
+		GDSPolygon polygon = Geometry.GetPolygon(i);
+		for(unsigned int j=0; j<polygon.GetPoints(); j++){
+			if(!box.isPointInside(polygon.GetXCoords(j), polygon.GetYCoords(j)))
+				return false;
+		}
+	}
+	return true;
+}
+
+int main()
+{
+	static const unsigned int rows[][2] = {{0, 1000}, {0, 2000}, {0, 8000}, {0, 20000}, {1, 2000}, {2, 2000}, {4, 2000}};
+	GDSGeometry geometry;
+	int result = 0;
+
+	srand(1);
+	for(unsigned int r=0; r<sizeof(rows)/sizeof(rows[0]); r++){
+		int type = rows[r][0];
+		unsigned int points = rows[r][1], count = 2000000/points;
+		vector<GDSPath*> paths;
+		unsigned int polygons = 0;
+
+		for(unsigned int i=0; i<count; i++)
+			paths.push_back(make_path(type, points));
+
+		geometry.Clear();
+		paths[0]->Expand(&geometry);
+		if(!check(paths[0], geometry)){
+			printf("type %d %5u pts WRONG\n", type, points);
+			result = 1;
+		}
+
+		double start = gds_time();
+		for(unsigned int i=0; i<count; i++){
+			geometry.Clear();
+			polygons += paths[i]->Expand(&geometry);
+		}
+		double seconds = gds_time() - start;
+		printf("type %d %5u pts x %4u  %.3f s  %.1f ns/point  %u polygons\n", type, points, count, seconds, seconds*1e9/count/points, polygons);
+
+		for(unsigned int i=0; i<count; i++)
+			delete paths[i];
+	}
+	return result;
+}
@@ -0,0 +1,129 @@
+//  GDS3D, a program for viewing GDSII files in 3D.
+//  Created by Jasper Velner and Michiel Soer, http://icd.el.utwente.nl
+//  Copyright (C) 2013 IC-Design Group, University of Twente.
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+// Counts the vertices and triangles the viewer uploads for a GDS file,
+// without X11 or OpenGL. Every object is uploaded once, whatever the number
+// of its instances. "faces" is the renderer as it is, with rectilinear
+// polygons filled with rectangles, "before" triangulates those as well.
+
+#include "gdsparse.h"
+
+// A vertex holds a position and a normal, a triangle three short indices
+#define VERTEX_BYTES	(6*sizeof(float))
+#define TRIANGLE_BYTES	(3*sizeof(uint16_t))
+
+class GDSParse_count : public GDSParse
+{
+public:
+	GDSParse_count(GDSProcess *process) : GDSParse(process, false) {};
+	GDSObject *NewObject(char *Name) {return new GDSObject(Name);};
+};
+
+// Vertices and triangles of a polygon drawn from triangles, see
+// GDSObject_ogl::OutputOGLVertices2()
+static void count_triangles(const uint16_t *Indices, unsigned int NumIndices, unsigned int n, unsigned long long& Vertices, unsigned long long& Triangles)
+{
+	int e, o;
+
+	Vertices += 2*n;
+	if(NumIndices && gds_wall_vertices(Indices, NumIndices, e, o))
+		Vertices += 2*n;
+	Triangles += 2*(NumIndices/3) + 2*n;
+}
+
+static void print_count(const char *Name, unsigned long long Vertices, unsigned long long Triangles)
+{
+	printf("%-10s %12llu vertices %12llu triangles %9.1f MB\n", Name, Vertices, Triangles,
+		(Vertices*VERTEX_BYTES + Triangles*TRIANGLE_BYTES)/1048576.0);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long vertices = 0, triangles = 0, vertices0 = 0, triangles0 = 0;
+	unsigned long long polygons = 0, filled = 0;
+	GDSIndexArray indices;
+
+	if(argc < 3)
+	{
+		printf("Usage: %s process.txt file.gds\n", argv[0]);
+		return 1;
+	}
+
+	GDSProcess *process = new GDSProcess();
+	process->Parse(argv[1]);
+	if(!process->IsValid())
+		return 1;
+
+	FILE *iptr = fopen(argv[2], "rb");
+	if(!iptr)
+	{
+		printf("Unable to open %s\n", argv[2]);
+		return 1;
+	}
+	GDSParse_count *parse = new GDSParse_count(process);
+	if(parse->Parse(iptr, NULL)) // True on errors
+		return 1;
+	fclose(iptr);
+
+	GDSObjectList *objects = parse->_Objects;
+	for(unsigned int i=0; i<objects->getNumObjects(); i++)
+	{
+		GDSGeometry *geometry = objects->getObject(i)->GetGeometry();
+
+		vertices += geometry->GetNumVertices();
+		triangles += geometry->GetNumTriangles();
+		vertices0 += 8ULL*geometry->GetNumRects();
+		triangles0 += 12ULL*geometry->GetNumRects();
+		for(unsigned int j=0; j<geometry->GetNumPolygons(); j++)
+		{
+			GDSPolygon polygon = geometry->GetPolygon(j);
+			unsigned int n = polygon.GetPoints();
+
+			polygons++;
+			if(!polygon.hasFaces())
+			{
+				count_triangles(polygon.GetIndices(), polygon.GetNumIndices(), n, vertices0, triangles0);
+				continue;
+			}
+
+			// Fan or ears, like GDSPolygon::Tesselate() without the faces
+			filled++;
+			indices.clear();
+			if(polygon.isSimple())
+			{
+				for(unsigned int k=0; k<n-2; k++)
+				{
+					indices.push_back(0);
+					indices.push_back(k+1);
+					indices.push_back(k+2);
+				}
+			}
+			else
+			{
+				GDSEarClipper clipper(polygon.GetX(), polygon.GetY(), n);
+				clipper.Clip(indices);
+			}
+			count_triangles(indices.empty() ? NULL : &indices[0], indices.size(), n, vertices0, triangles0);
+		}
+	}
+
+	printf("%u objects, %llu polygons of which %llu filled with rectangles\n", objects->getNumObjects(), polygons, filled);
+	print_count("before", vertices0, triangles0);
+	print_count("faces", vertices, triangles);
+	return 0;
+}
@@ -0,0 +1,217 @@
+//  GDS3D, a program for viewing GDSII files in 3D.
+//  Created by Jasper Velner and Michiel Soer, http://icd.el.utwente.nl
+//  Copyright (C) 2013 IC-Design Group, University of Twente.
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+// Times GDSEarClipper against the ear clipper it replaced, kept below as
+// it was, on combs, stars and keyhole chains. The triangles of both have
+// to cover exactly the area of the outline, exits with 1 if they do not.
+// The old one is only run on the smaller outlines, it is cubic.
+
+#include "gdsobject.h"
+
+typedef vector<GDSPoint> Outline;
+
+static int64_t area(const GDSPoint& A, const GDSPoint& B, const GDSPoint& C)
+{
+	return ((int64_t)(B.X - A.X) * (C.Y - A.Y)) - ((int64_t)(B.Y - A.Y) * (C.X - A.X));
+}
+
+static bool on_line(const GDSPoint& A, const GDSPoint& B, const GDSPoint& P)
+{
+	if(P.X < A.X && P.X < B.X)
+		return false;
+	if(P.X > A.X && P.X > B.X)
+		return false;
+	if(P.Y < A.Y && P.Y < B.Y)
+		return false;
+	if(P.Y > A.Y && P.Y > B.Y)
+		return false;
+	return area(A, B, P) == 0;
+}
+
+static bool inside_triangle(const GDSPoint& A, const GDSPoint& B, const GDSPoint& C, const GDSPoint& P)
+{
+	if((A.X == P.X && A.Y == P.Y) || (B.X == P.X && B.Y == P.Y) || (C.X == P.X && C.Y == P.Y))
+		return false;
+	return area(B, C, P) >= 0 && area(C, A, P) >= 0 && area(A, B, P) >= 0;
+}
+
+// The clipper before GDSEarClipper: rescans every vertex for every ear and
+// erases from a vector
+static void old_clip(const Outline& C, GDSIndexArray& Indices)
+{
+	unsigned int n = C.size();
+	vector<int> V(n);
+	int a, b, c;
+
+	for(unsigned int i=0; i<n; i++)
+		V[i] = i;
+	for(unsigned int i=0; i<n-2; i++){
+		for(unsigned int j=0; j<V.size(); j++){
+			a = j; b = (j+1)%V.size(); c = (j+2)%V.size();
+			bool flagged = false;
+
+			if(area(C[V[a]], C[V[b]], C[V[c]]) <= 0)
+				continue;
+			for(unsigned int k=0; k<V.size(); k++){
+				if((int)k==a || (int)k==b || (int)k==c)
+					continue;
+				if((abs(V[a]-V[b])==1 || abs(V[a]-V[b])==(int)n-1) && on_line(C[V[a]], C[V[b]], C[V[k]]))
+					continue;
+				if((abs(V[b]-V[c])==1 || abs(V[b]-V[c])==(int)n-1) && on_line(C[V[b]], C[V[c]], C[V[k]]))
+					continue;
+				if((abs(V[c]-V[a])==1 || abs(V[c]-V[a])==(int)n-1) && on_line(C[V[c]], C[V[a]], C[V[k]]))
+					continue;
+				if(inside_triangle(C[V[a]], C[V[b]], C[V[c]], C[V[k]])){
+					flagged = true;
+					break;
+				}
+			}
+			if(!flagged){
+				Indices.push_back(V[a]);
+				Indices.push_back(V[b]);
+				Indices.push_back(V[c]);
+				V.erase(V.begin()+b);
+				break;
+			}
+		}
+	}
+}
+
+static void new_clip(const Outline& C, GDSIndexArray& Indices)
+{
+	vector<int32_t> X(C.size()), Y(C.size());
+
+	for(unsigned int i=0; i<C.size(); i++){
+		X[i] = C[i].X;
+		Y[i] = C[i].Y;
+	}
+	GDSEarClipper clipper(&X[0], &Y[0], C.size());
+	clipper.Clip(Indices);
+}
+
+// Teeth up from a base, counter-clockwise
+static Outline comb(unsigned int Teeth)
+{
+	Outline C;
+	GDSPoint p;
+
+	p.X = 0; p.Y = 0; C.push_back(p);
+	p.X = Teeth*200 - 100; C.push_back(p);
+	for(unsigned int i=Teeth; i-- > 0; ){
+		p.X = i*200 + 100; p.Y = 5000; C.push_back(p);
+		p.X = i*200; C.push_back(p);
+		if(i){
+			p.Y = 100; C.push_back(p);
+			p.X = i*200 - 100; C.push_back(p);
+		}
+	}
+	return C;
+}
+
+static Outline star(unsigned int Points)
+{
+	Outline C;
+	GDSPoint p;
+
+	for(unsigned int i=0; i<Points; i++){
+		double r = i%2 ? 100000.0 : 60000.0, a = 2*M_PI*i/Points;
+		p.X = (int32_t)(r*cos(a));
+		p.Y = (int32_t)(r*sin(a));
+		C.push_back(p);
+	}
+	return C;
+}
+
+// Square holes in a row, each cut in from the bottom edge along a doubled
+// edge
+static Outline keyholes(unsigned int Holes)
+{
+	Outline C;
+	GDSPoint p;
+
+	p.X = 0; p.Y = 0; C.push_back(p);
+	for(unsigned int i=0; i<Holes; i++){
+		int32_t x = 100 + i*300;
+		static const int32_t hole[7][2] = {{0, 0}, {0, 100}, {0, 300}, {200, 300}, {200, 100}, {0, 100}, {0, 0}};
+		for(unsigned int k=0; k<7; k++){
+			p.X = x + hole[k][0];
+			p.Y = hole[k][1];
+			C.push_back(p);
+		}
+	}
+	p.X = Holes*300 + 100; p.Y = 0; C.push_back(p);
+	p.Y = 400; C.push_back(p);
+	p.X = 0; C.push_back(p);
+	return C;
+}
+
+// Twice the area of the outline against the sum of the triangles
+static bool check(const Outline& C, const GDSIndexArray& Indices)
+{
+	int64_t outline = 0, triangles = 0;
+
+	for(unsigned int i=0; i<C.size(); i++)
+		outline += (int64_t)C[i].X*C[(i+1)%C.size()].Y - (int64_t)C[(i+1)%C.size()].X*C[i].Y;
+	for(unsigned int i=0; i+2<Indices.size(); i+=3)
+		triangles += area(C[Indices[i]], C[Indices[i+1]], C[Indices[i+2]]);
+	return outline == triangles;
+}
+
+static double run(void (*Clip)(const Outline&, GDSIndexArray&), const Outline& C, unsigned int Rounds, bool& Valid)
+{
+	GDSIndexArray indices;
+	double start = gds_time();
+
+	for(unsigned int r=0; r<Rounds; r++){
+		indices.clear();
+		Clip(C, indices);
+	}
+	double seconds = (gds_time() - start)/Rounds;
+	Valid = check(C, indices);
+	return seconds;
+}
+
+int main()
+{
+	struct {const char *name; Outline outline; bool old;} shapes[] = {
+		{"comb", comb(1000), true},
+		{"star", star(4000), true},
+		{"comb", comb(5000), false},
+		{"keyholes", keyholes(1143), false},
+	};
+	int result = 0;
+
+	for(unsigned int i=0; i<sizeof(shapes)/sizeof(shapes[0]); i++){
+		const Outline& C = shapes[i].outline;
+		bool valid, old_valid = true;
+
+		printf("%-8s %5u pts", shapes[i].name, (unsigned int)C.size());
+		if(shapes[i].old){
+			printf("  old %.4f s", run(old_clip, C, 3, old_valid));
+			fflush(stdout);
+		}
+		else
+			printf("  %12s", "");
+		printf("  new %.4f s\n", run(new_clip, C, 100, valid));
+		if(!valid || !old_valid){
+			printf("%-8s %5u pts WRONG\n", shapes[i].name, (unsigned int)C.size());
+			result = 1;
+		}
+	}
+	return result;
+}
@@ -77,6 +77,43 @@ void init_render()
 // GDSObject Class
 
 GDSObject_ogl::GDSObject_ogl(char *Name) : GDSObject(Name){
+	uploaded = false;
+	hasTreeBox = false;
+}
+
+static MATRIX4X4 gds_matrix(const GDSMat& mat)
+{
+	return MATRIX4X4(mat[0], mat[1], 0.0f, 0.0f, mat[2], mat[3], 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, mat[4], mat[5], 0.0f, 1.0f);
+}
+
+// Layers move apart in the exploded view
+static void gds_explode(AA_BOUNDING_BOX& bounds)
+{
+	bounds.maxes.z *= 1.0f+exploded_fraction;
+	bounds.mins.z *= 1.0f+exploded_fraction;
+	for(unsigned long i=0;i<8;i++)
+		bounds.vertices[i].z *= 1.0f+exploded_fraction;
+}
+
+// Box of the elements [C0, C1) x [R0, R1) of ref, each placing box. The
+// elements are on a lattice, so the corners bound the others.
+static AA_BOUNDING_BOX gds_lattice_box(const GDSRef *ref, const AA_BOUNDING_BOX& box, unsigned int C0, unsigned int C1, unsigned int R0, unsigned int R1)
+{
+	AA_BOUNDING_BOX result, t;
+	unsigned int c[2] = {C0, C1-1};
+	unsigned int r[2] = {R0, R1-1};
+
+	result = box;
+	result.Mult(gds_matrix(ref->Element(C0, R0)));
+	for(unsigned int i=1;i<4;i++)
+	{
+		if((i&1 && c[1] == c[0]) || (i&2 && r[1] == r[0]))
+			continue;
+		t = box;
+		t.Mult(gds_matrix(ref->Element(c[i&1], r[i>>1])));
+		result.AddBounds(t);
+	}
+	return result;
 }
 
 GDSObject_ogl::~GDSObject_ogl()
@@ -84,36 +121,126 @@ GDSObject_ogl::~GDSObject_ogl()
 	DeleteBuffers();
 }
 
+// Polygon filled with rectangles. The walls follow the outline like those
+// of triangulated polygons below, the top and bottom are two triangles per
+// face, see GDSPolygon::GetFaceMesh().
+void GDSObject_ogl::OutputOGLFaces(GDSPolygon& polygon, float& largest_dimension)
+{
+	float units = Geometry.GetUnits();
+	float z1 = polygon.GetHeight();
+	float z2 = polygon.GetHeight() + polygon.GetThickness();
+	unsigned int n = polygon.GetPoints();
+	const int32_t *X = polygon.GetX();
+	const int32_t *Y = polygon.GetY();
+	int tp, bp;
+	int v[3];
+
+	polygon.GetFaceMesh(mesh);
+
+	// Outline, then the added corners, on top and bottom
+	tp = renderer.getCurIndex();
+	for(unsigned int j=0; j<n; j++)
+		renderer.addVertex(units*(GLfloat)X[j], units*(GLfloat)Y[j], z2);
+	for(unsigned int j=0; j<mesh.Extra.size(); j++)
+		renderer.addVertex(units*(GLfloat)mesh.Extra[j].X, units*(GLfloat)mesh.Extra[j].Y, z2);
+	bp = renderer.getCurIndex();
+	for(unsigned int j=0; j<n; j++)
+		renderer.addVertex(units*(GLfloat)X[j], units*(GLfloat)Y[j], z1);
+	for(unsigned int j=0; j<mesh.Extra.size(); j++)
+		renderer.addVertex(units*(GLfloat)mesh.Extra[j].X, units*(GLfloat)mesh.Extra[j].Y, z1);
+
+	// Walls
+	for(unsigned int j=0; j<n; j++)
+	{
+		v[0] = j;
+		v[1] = (j+1)%n;
+		if(v[1]%2 == 0)
+		{
+			renderer.addTriangle(bp+v[0], bp+v[1], tp+v[1]);
+			renderer.addTriangle(tp+v[0], bp+v[0], tp+v[1]);
+		}
+		else
+		{
+			renderer.addTriangle(bp+v[1], tp+v[1], bp+v[0]);
+			renderer.addTriangle(tp+v[1], tp+v[0], bp+v[0]);
+		}
+	}
+	numtris += 2*n;
+
+	// Top and bottom
+	for(unsigned int i=0; i<polygon.GetNumFaces(); i++)
+	{
+		const GDSBox& face = polygon.GetFace(i);
+		float dx = units*(float)(face.MaxX - face.MinX);
+		float dy = units*(float)(face.MaxY - face.MinY);
+
+		if(fmax(dx,dy)/fmin(dx,dy) > 2.0f)
+			largest_dimension = fmax(fmin(dx, dy)/0.5f, largest_dimension);
+		else
+			largest_dimension = fmax(fmin(dx, dy)/3.0f, largest_dimension);
+	}
+	for(unsigned int j=0; j<mesh.Triangles.size(); j+=3)
+	{
+		const unsigned int *t = &mesh.Triangles[j];
+
+		renderer.addTriangle(tp+t[0], tp+t[1], tp+t[2]);
+		renderer.addTriangle(bp+t[1], bp+t[0], bp+t[2]);
+	}
+	numtris += 2*(mesh.Triangles.size()/3);
+}
+
 // New, vertex list based rendering
 void GDSObject_ogl::OutputOGLVertices2(struct ProcessLayer *do_layer, render_layer_t *data)
 {
-	struct ProcessLayer *layer;
 	float largest_dimension = 0.0; // Largest dimension of an object
 	float xmin, ymin, zmin, xmax, ymax, zmax;
-	class GDSPolygon *polygon;
+	GDSPolygon polygon;
     float dx, dy;
-    vector<int> *indices; // Pointer to index array of the triangles
+    const uint16_t *indices; // Index array of the triangles
+	unsigned int numindices;
+	const int32_t *X, *Y; // Coordinates of the polygon, in database units
+	float units = Geometry.GetUnits();
+	unsigned int first = 0, last = Geometry.GetNumPolygons();
     int tp=0, bp=0, tp2=0, bp2=0; // Top and bottom pointer into the vertex array
     int v[3]; // Indices of a triangle
     
 	zmin = xmin = ymin = 100000; zmax = xmax = ymax = -10000;
 
-    for(unsigned long i=0; i<PolygonItems.size(); i++)
-    {
-        polygon = PolygonItems[i];
-        layer = polygon->GetLayer();
-        if(do_layer && layer!= do_layer)
-            continue;
+	// Polygons of one layer are consecutive
+	if(do_layer)
+	{
+		const GDSLayerArray& layers = Geometry.GetLayers();
+		last = 0;
+		for(unsigned int i=0; i<layers.size(); i++)
+		{
+			if(layers[i].Layer == do_layer)
+			{
+				first = layers[i].FirstPolygon;
+				last = first + layers[i].NumPolygons;
+				break;
+			}
+		}
+	}
 
+    for(unsigned long i=first; i<last; i++)
+    {
+        polygon = Geometry.GetPolygon(i);
 
-        float z1 = polygon->GetHeight();
-        float z2 = polygon->GetHeight() + polygon->GetThickness();
+        float z1 = polygon.GetHeight();
+        float z2 = polygon.GetHeight() + polygon.GetThickness();
         float x0, y0;
+		unsigned int n = polygon.GetPoints();
+
+		// Tesselate before taking pointers, it may grow the index array
+		indices = polygon.GetIndices();
+		numindices = polygon.GetNumIndices();
+		X = polygon.GetX();
+		Y = polygon.GetY();
         
         //Bbox
-        for(unsigned int j=0; j<polygon->GetPoints(); j++){
-            x0 = polygon->GetXCoords(j);
-            y0 = polygon->GetYCoords(j);
+        for(unsigned int j=0; j<n; j++){
+            x0 = units*(float)X[j];
+            y0 = units*(float)Y[j];
             
             xmin = fmin(xmin, x0);
             ymin = fmin(ymin, y0);
@@ -122,25 +249,27 @@ void GDSObject_ogl::OutputOGLVertices2(struct ProcessLayer *do_layer, render_lay
         }
         zmin = z1;
         zmax = z2;
+
+		if(polygon.hasFaces())
+		{
+			OutputOGLFaces(polygon, largest_dimension);
+			renderer.allowFlush();
+			continue;
+		}
         
         // Send vertices to vertex buffer
         tp = tp2 = renderer.getCurIndex(); // Top pointer
-        for(unsigned int j=0; j<polygon->GetPoints(); j++)
-            renderer.addVertex((GLfloat) polygon->GetXCoords(j), (GLfloat) polygon->GetYCoords(j),z2);
+        for(unsigned int j=0; j<n; j++)
+            renderer.addVertex(units*(GLfloat)X[j], units*(GLfloat)Y[j], z2);
         bp = bp2 = renderer.getCurIndex(); // Bottom pointer
-        for(unsigned int j=0; j<polygon->GetPoints(); j++)
-            renderer.addVertex((GLfloat) polygon->GetXCoords(j), (GLfloat) polygon->GetYCoords(j),z1);
-        
-        // Assemble triangles
-		indices = polygon->GetIndices();
-		if(!indices)
-			continue;
+        for(unsigned int j=0; j<n; j++)
+            renderer.addVertex(units*(GLfloat)X[j], units*(GLfloat)Y[j], z1);
         
         // Largest dimension
-        for(unsigned int j=0;j<indices->size()/3;j++)
+        for(unsigned int j=0;j<numindices/3;j++)
         {
-            dx = fmax(fmax(fabs(polygon->GetXCoords((*indices)[j*3+0]) - polygon->GetXCoords((*indices)[j*3+1])), fabs(polygon->GetXCoords((*indices)[j*3+0]) - polygon->GetXCoords((*indices)[j*3+2]))), fabs(polygon->GetXCoords((*indices)[j*3+1]) - polygon->GetXCoords((*indices)[j*3+2])));
-            dy = fmax(fmax(fabs(polygon->GetYCoords((*indices)[j*3+0]) - polygon->GetYCoords((*indices)[j*3+1])), fabs(polygon->GetYCoords((*indices)[j*3+0]) - polygon->GetYCoords((*indices)[j*3+2]))), fabs(polygon->GetYCoords((*indices)[j*3+1]) - polygon->GetYCoords((*indices)[j*3+2])));
+            dx = units*fmax(fmax(fabs((float)X[indices[j*3+0]] - X[indices[j*3+1]]), fabs((float)X[indices[j*3+0]] - X[indices[j*3+2]])), fabs((float)X[indices[j*3+1]] - X[indices[j*3+2]]));
+            dy = units*fmax(fmax(fabs((float)Y[indices[j*3+0]] - Y[indices[j*3+1]]), fabs((float)Y[indices[j*3+0]] - Y[indices[j*3+2]])), fabs((float)Y[indices[j*3+1]] - Y[indices[j*3+2]]));
             if(fmax(dx,dy)/fmin(dx,dy) > 2.0f)
                 largest_dimension = fmax(fmin(dx, dy)/0.5f, largest_dimension);
             else
@@ -149,44 +278,24 @@ void GDSObject_ogl::OutputOGLVertices2(struct ProcessLayer *do_layer, render_lay
         }        
 		
         // Even-odd ordering?
-        int e=1;
-        int o=1;
-        for(unsigned int j=0;j<indices->size()/3;j++)
-        {
-            v[0] = (*indices)[j*3+0];
-            v[1] = (*indices)[j*3+1];
-            v[2] = (*indices)[j*3+2];
-            
-            if((v[0]%2)==0 && (v[1]%2)==0 && (v[2]%2)==0)
-                o=0;
-            if((v[0]%2)==1 && (v[1]%2)==1 && (v[2]%2)==1)
-                e=0;
-        }
-        if( (e==0 && o==0) || (e==1 && o==0 && (indices->size()/3)%2==1)) // Oh oh, we need to duplicate vertices for the boundary
+        int e, o;
+        if(gds_wall_vertices(indices, numindices, e, o)) // Oh oh, we need to duplicate vertices for the boundary
         {
             // Duplicate vertices
             tp2 = renderer.getCurIndex(); // Top pointer
-            for(unsigned int j=0; j<polygon->GetPoints(); j++)
-                renderer.addVertex((GLfloat) polygon->GetXCoords(j), (GLfloat) polygon->GetYCoords(j),z2);
+            for(unsigned int j=0; j<n; j++)
+                renderer.addVertex(units*(GLfloat)X[j], units*(GLfloat)Y[j], z2);
             bp2 = renderer.getCurIndex(); // Bottom pointer
-            for(unsigned int j=0; j<polygon->GetPoints(); j++)
-                renderer.addVertex((GLfloat) polygon->GetXCoords(j), (GLfloat) polygon->GetYCoords(j),z1);	
-
-			e = 0;
-			o = 1;
+            for(unsigned int j=0; j<n; j++)
+                renderer.addVertex(units*(GLfloat)X[j], units*(GLfloat)Y[j], z1);	
         }
-		if(e==1 && o==1)
-		{
-			e = 0;
-			o = 1;
-		}
         
         // Stream top
-        for(unsigned int j=0;j<indices->size()/3;j++)
+        for(unsigned int j=0;j<numindices/3;j++)
         {
-            v[0] = (*indices)[j*3+0];
-            v[1] = (*indices)[j*3+1];
-            v[2] = (*indices)[j*3+2];
+            v[0] = indices[j*3+0];
+            v[1] = indices[j*3+1];
+            v[2] = indices[j*3+2];
             
 			if( (e && v[1]%2==0) || (o && v[1]%2==1) )
                 renderer.addTriangle(tp+v[2], tp+v[0], tp+v[1]);
@@ -198,11 +307,11 @@ void GDSObject_ogl::OutputOGLVertices2(struct ProcessLayer *do_layer, render_lay
         }
         
         // Stream bottom
-        for(unsigned int j=0;j<indices->size()/3;j++)
+        for(unsigned int j=0;j<numindices/3;j++)
         {
-            v[0] = (*indices)[j*3+0];
-            v[1] = (*indices)[j*3+1];
-            v[2] = (*indices)[j*3+2];
+            v[0] = indices[j*3+0];
+            v[1] = indices[j*3+1];
+            v[2] = indices[j*3+2];
             
 			if( (e && v[1]%2==0) || (o && v[1]%2==1) )
 				renderer.addTriangle(bp+v[0], bp+v[2], bp+v[1]);                
@@ -214,10 +323,10 @@ void GDSObject_ogl::OutputOGLVertices2(struct ProcessLayer *do_layer, render_lay
         }
         
         // Stream boundary
-        for(unsigned int j=0;j<polygon->GetPoints();j++)
+        for(unsigned int j=0;j<n;j++)
         {
             v[0] = j+0;
-            v[1] = (j+1)%(polygon->GetPoints());
+            v[1] = (j+1)%n;
             
             if(v[1]%2!=o)
             {
@@ -235,6 +344,69 @@ void GDSObject_ogl::OutputOGLVertices2(struct ProcessLayer *do_layer, render_lay
         // Give renderer the chance to flush its buffers
         renderer.allowFlush(); 
     }	
+
+	// Rectangles, with the triangles the code above makes for a fan of four
+	// counter-clockwise points
+	const GDSRectRangeArray& ranges = Geometry.GetRectRanges();
+	for(unsigned int r=0; r<ranges.size(); r++)
+	{
+		if(do_layer && ranges[r].Layer != do_layer)
+			continue;
+
+		float z1 = ranges[r].Height;
+		float z2 = ranges[r].Height + ranges[r].Thickness;
+
+		for(unsigned int i=ranges[r].FirstRect; i<ranges[r].FirstRect+ranges[r].NumRects; i++)
+		{
+			const GDSBox& box = Geometry.GetRectBox(i);
+			GLfloat x[4] = {units*(GLfloat)box.MinX, units*(GLfloat)box.MaxX, units*(GLfloat)box.MaxX, units*(GLfloat)box.MinX};
+			GLfloat y[4] = {units*(GLfloat)box.MinY, units*(GLfloat)box.MinY, units*(GLfloat)box.MaxY, units*(GLfloat)box.MaxY};
+
+			xmin = fmin(xmin, x[0]);
+			ymin = fmin(ymin, y[0]);
+			xmax = fmax(xmax, x[2]);
+			ymax = fmax(ymax, y[2]);
+			zmin = z1;
+			zmax = z2;
+
+			tp = renderer.getCurIndex();
+			for(unsigned int j=0; j<4; j++)
+				renderer.addVertex(x[j], y[j], z2);
+			bp = renderer.getCurIndex();
+			for(unsigned int j=0; j<4; j++)
+				renderer.addVertex(x[j], y[j], z1);
+
+			dx = x[2] - x[0];
+			dy = y[2] - y[0];
+			if(fmax(dx,dy)/fmin(dx,dy) > 2.0f)
+				largest_dimension = fmax(fmin(dx, dy)/0.5f, largest_dimension);
+			else
+				largest_dimension = fmax(fmin(dx, dy)/3.0f, largest_dimension);
+
+			renderer.addTriangle(tp+2, tp+0, tp+1);
+			renderer.addTriangle(tp+0, tp+2, tp+3);
+			renderer.addTriangle(bp+0, bp+2, bp+1);
+			renderer.addTriangle(bp+2, bp+0, bp+3);
+			for(unsigned int j=0; j<4; j++)
+			{
+				v[0] = j;
+				v[1] = (j+1)%4;
+				if(v[1]%2 == 0)
+				{
+					renderer.addTriangle(bp+v[0], bp+v[1], tp+v[1]);
+					renderer.addTriangle(tp+v[0], bp+v[0], tp+v[1]);
+				}
+				else
+				{
+					renderer.addTriangle(bp+v[1], tp+v[1], bp+v[0]);
+					renderer.addTriangle(tp+v[1], tp+v[0], bp+v[0]);
+				}
+			}
+			numtris += 12;
+
+			renderer.allowFlush();
+		}
+	}
 	
 	// Visibility data
 	data->bbox.SetFromMinsMaxes(VECTOR3D(xmin, ymin, zmin), VECTOR3D(xmax, ymax, zmax) );
@@ -248,7 +420,7 @@ GDSObject_ogl::BuildLists()
 	struct ProcessLayer *layer;
 	bool found;
 
-	if(PolygonItems.empty() && PathItems.empty())
+	if(!Geometry.GetNumPolygons() && !Geometry.GetNumRects() && PathItems.empty())
 		return;
 
 	//
@@ -285,12 +457,44 @@ GDSObject_ogl::BuildLists()
 			}
 		}
 	}
-	if(!PolygonItems.empty())
+	if(Geometry.GetNumPolygons())
+	{
+		const GDSLayerArray& layers = Geometry.GetLayers();
+		for(unsigned long i=0; i<layers.size(); i++)
+		{
+			// Get layer
+			layer = layers[i].Layer;
+			if(!layer)
+				continue;
+
+			// Try to find layer
+			found = false;
+			for(unsigned long j=0;j<layer_list.size();j++)
+			{
+				if(layer_list[j].layer == layer)
+				{
+					found = true;
+					break;
+				}
+			}
+
+			// New layer?
+			if(!found)
+			{
+				render_layer.layer = layer;
+				render_layer.display_list = 0;
+				layer_list.push_back(render_layer);
+			}
+		}
+	}
+
+	if(Geometry.GetNumRects())
 	{
-		for(unsigned long i=0; i<PolygonItems.size(); i++)
+		const GDSRectRangeArray& ranges = Geometry.GetRectRanges();
+		for(unsigned long i=0; i<ranges.size(); i++)
 		{
 			// Get layer
-			layer = PolygonItems[i]->GetLayer();
+			layer = ranges[i].Layer;
 			if(!layer)
 				continue;
 
@@ -363,12 +567,32 @@ void GDSObject_ogl::EndRender()
 
 void GDSObject_ogl::UploadToVRAM()
 {    
+	// Objects placed many times are visited once
+	if(uploaded)
+		return;
+	uploaded = true;
+
     // Do we need to build the geometry?
-	if(!layer_list.size() && (!PolygonItems.empty() || !PathItems.empty()) )
+	if(!layer_list.size() && (Geometry.GetNumPolygons() || Geometry.GetNumRects() || !PathItems.empty()) )
 		BuildLists();
     
+	hasTreeBox = !layer_list.empty();
+	treebox = bbox;
 	for(unsigned int i=0;i<refs.size();i++)
-		((GDSObject_ogl*)refs[i]->object)->UploadToVRAM();	
+	{
+		GDSObject_ogl *child = (GDSObject_ogl*)refs[i]->object;
+
+		child->UploadToVRAM();
+		if(!child->hasTreeBox)
+			continue;
+
+		AA_BOUNDING_BOX box = gds_lattice_box(refs[i], child->treebox, 0, refs[i]->Columns, 0, refs[i]->Rows);
+		if(hasTreeBox)
+			treebox.AddBounds(box);
+		else
+			treebox = box;
+		hasTreeBox = true;
+	}
 }
 
 #define  Pr  .299
@@ -380,7 +604,7 @@ void GDSObject_ogl::RenderList(MATRIX4X4 object_view, bool HQ)
 	struct ProcessLayer *layer;
     
     // Do we need to build the geometry?
-	if(!layer_list.size() && (!PolygonItems.empty() || !PathItems.empty()) )
+	if(!uploaded)
     {
         // Recursively step through geometry, this is only called here from the topcell
         UploadToVRAM();
@@ -392,10 +616,9 @@ void GDSObject_ogl::RenderList(MATRIX4X4 object_view, bool HQ)
         renderer.forceFlush();
     }
     
-    // Go to sub cells
-	MATRIX4X4 M;
+    // Go to sub cells, arrays only as far as they are in view
 	for(unsigned int i=0;i<refs.size();i++)
-		((GDSObject_ogl*)refs[i]->object)->RenderList(object_view * MATRIX4X4(refs[i]->mat[0], refs[i]->mat[1], 0.0f, 0.0f, refs[i]->mat[2], refs[i]->mat[3], 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, refs[i]->mat[4], refs[i]->mat[5], 0.0f, 1.0f), HQ);
+		RenderLattice(refs[i], object_view, 0, refs[i]->Columns, 0, refs[i]->Rows, HQ);
 
 	// Frustum
 	AA_BOUNDING_BOX bounds;
@@ -406,10 +629,7 @@ void GDSObject_ogl::RenderList(MATRIX4X4 object_view, bool HQ)
 
 	// Prepare bounding box
 	bounds = bbox;
-	bounds.maxes.z *= 1.0f+exploded_fraction;
-	bounds.mins.z *= 1.0f+exploded_fraction;
-	for(unsigned long i=0;i<8;i++)
-		bounds.vertices[i].z *= 1.0f+exploded_fraction;
+	gds_explode(bounds);
 	bounds.Mult(object_view);
 	
 	// Frustum culling of bounding boxes
@@ -483,6 +703,35 @@ void GDSObject_ogl::RenderList(MATRIX4X4 object_view, bool HQ)
    
 }
 
+// Elements of an array in halves, a half out of view is left out as a
+// whole, so only the rows and columns in view are walked
+void GDSObject_ogl::RenderLattice(const GDSRef *ref, const MATRIX4X4& object_view, unsigned int C0, unsigned int C1, unsigned int R0, unsigned int R1, bool HQ)
+{
+	GDSObject_ogl *child = (GDSObject_ogl*)ref->object;
+
+	if(!child->hasTreeBox)
+		return; // Nothing to draw below it
+
+	AA_BOUNDING_BOX bounds = gds_lattice_box(ref, child->treebox, C0, C1, R0, R1);
+	gds_explode(bounds);
+	bounds.Mult(object_view);
+	if(!frustum.IsAABoundingBoxInside(bounds))
+		return;
+
+	if(C1-C0 == 1 && R1-R0 == 1)
+		child->RenderList(object_view * gds_matrix(ref->Element(C0, R0)), HQ);
+	else if(C1-C0 >= R1-R0)
+	{
+		RenderLattice(ref, object_view, C0, C0+(C1-C0)/2, R0, R1, HQ);
+		RenderLattice(ref, object_view, C0+(C1-C0)/2, C1, R0, R1, HQ);
+	}
+	else
+	{
+		RenderLattice(ref, object_view, C0, C1, R0, R0+(R1-R0)/2, HQ);
+		RenderLattice(ref, object_view, C0, C1, R0+(R1-R0)/2, R1, HQ);
+	}
+}
+
 void GDSObject_ogl::RenderOGLSRefs(MATRIX4X4 object_view, bool HQ)
 {
 	GDSObject_ogl *obj;
@@ -500,7 +749,7 @@ void GDSObject_ogl::RenderOGLSRefs(MATRIX4X4 object_view, bool HQ)
 					mod.SetScale(VECTOR3D(sref->Mag, sref->Mag, 1));
 					res = res * mod;
 				}
-				mod.SetTranslation(VECTOR3D(sref->X, sref->Y, 0.0f));
+				mod.SetTranslation(VECTOR3D(GetUnits()*(float)sref->X, GetUnits()*(float)sref->Y, 0.0f));
 				res = res * mod;
 				if(sref->Rotate.Y){
 					mod.SetRotationAxis(-sref->Rotate.Y, VECTOR3D(0.0f, 0.0f, 1.0f));
@@ -533,10 +782,10 @@ void GDSObject_ogl::RenderOGLARefs(MATRIX4X4 object_view, bool HQ)
         
             obj = (GDSObject_ogl*)aref->object;
             
-            dx1 = (float)(aref->X2 - aref->X1) / (float)aref->Columns;
-            dy1 = (float)(aref->Y2 - aref->Y1) / (float)aref->Columns;
-            dx2 = (float)(aref->X3 - aref->X1) / (float)aref->Rows;
-            dy2 = (float)(aref->Y3 - aref->Y1) / (float)aref->Rows;
+            dx1 = GetUnits()*(float)(aref->X2 - aref->X1) / (float)aref->Columns;
+            dy1 = GetUnits()*(float)(aref->Y2 - aref->Y1) / (float)aref->Columns;
+            dx2 = GetUnits()*(float)(aref->X3 - aref->X1) / (float)aref->Rows;
+            dy2 = GetUnits()*(float)(aref->Y3 - aref->Y1) / (float)aref->Rows;
             
             if(obj && !aref->collapsed){
                 for(i=0; i<aref->Rows; i++){
@@ -546,7 +795,7 @@ void GDSObject_ogl::RenderOGLARefs(MATRIX4X4 object_view, bool HQ)
                             mod.SetScale(VECTOR3D(aref->Mag, aref->Mag, 1));
                             res = res * mod;
                         }
-                        mod.SetTranslation(VECTOR3D(aref->X1+dx1*(float)j+dx2*(float)i, aref->Y1+dy2*(float)i+dy1*(float)j, 0.0f));
+                        mod.SetTranslation(VECTOR3D(GetUnits()*(float)aref->X1+dx1*(float)j+dx2*(float)i, GetUnits()*(float)aref->Y1+dy2*(float)i+dy1*(float)j, 0.0f));
                         res = res * mod;
                         if(aref->Rotate.Y){
                             mod.SetRotationAxis(-aref->Rotate.Y, VECTOR3D(0.0f, 0.0f, 1.0f));
@@ -576,6 +825,8 @@ GDSObject_ogl::DeleteBuffers()
         layer_list[i].renderRecipe = NULL;
 	}
 	layer_list.clear();
+	uploaded = false;
+	hasTreeBox = false;
 	
 	mem_tris = 0;
     mem_total = 0;
@@ -55,6 +55,13 @@ class GDSObject_ogl : public GDSObject
 private:
 	AA_BOUNDING_BOX bbox; // 3D Bounding box
 	unsigned long	numtris;
+
+	bool uploaded; // This object and everything below it, see UploadToVRAM()
+	bool hasTreeBox;
+	AA_BOUNDING_BOX treebox; // Of everything drawn for this object, children included
+	GDSFaceMesh mesh; // Reused by OutputOGLFaces()
+
+	void OutputOGLFaces(GDSPolygon& polygon, float& largest_dimension);
 	
 
 public:
@@ -69,6 +76,7 @@ public:
 	void PrepareRender(MATRIX4X4 projection_view, MATRIX4X4 object_view);
 	void EndRender();
 	void RenderList(MATRIX4X4 object_view, bool HQ);
+	void RenderLattice(const GDSRef *ref, const MATRIX4X4& object_view, unsigned int C0, unsigned int C1, unsigned int R0, unsigned int R1, bool HQ);
 	void RenderOGLSRefs(MATRIX4X4 object_view, bool HQ);
 	void RenderOGLARefs(MATRIX4X4 object_view, bool HQ);
 
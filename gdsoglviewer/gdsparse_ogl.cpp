@@ -88,11 +88,13 @@ class GDSObject *GDSParse_ogl::NewObject(char *Name)
 	return new class GDSObject_ogl(Name);
 }
 
-int GDSParse_ogl::SetTopcell(const char *topcell)
+int GDSParse_ogl::SetTopcell(const char *topcell, bool keepbuffers)
 {
 	// Cleanup? -> this can be moved somewhere else..
-	for(unsigned int i=0;i<_Objects->getNumObjects();i++)
-		((GDSObject_ogl*)_Objects->getObject(i))->DeleteBuffers();
+	// After a reload only the unchanged objects are left with buffers
+	if(!keepbuffers)
+		for(unsigned int i=0;i<_Objects->getNumObjects();i++)
+			((GDSObject_ogl*)_Objects->getObject(i))->DeleteBuffers();
 	if(substrate)
 	{
 		renderer.deleteRecipe(substrate); // Throw away substrate
@@ -102,7 +104,9 @@ int GDSParse_ogl::SetTopcell(const char *topcell)
 		(*l)->Reset();
 	firstrun = true; // Loading screen??
 
-	// Find new topcell
+	// Find new topcell, parse it first if it was left out so far
+	if(topcell)
+		LoadStructure(topcell);
 	if(topcell)
 		_topcell = (GDSObject_ogl*) _Objects->SearchObject(topcell);
     if(!_topcell)
@@ -123,11 +127,12 @@ int GDSParse_ogl::SetTopcell(const char *topcell)
 
 void GDSParse_ogl::initWorld()
 {
+	_Objects->PrintStatistics(_topcell);
+
     v_printf(1, "Building hierarchy.. ");
     
     // Absorb small objects into larger objects
-    _topcell->countTotalPoints();
-    _topcell->collapseHierachy();
+    _Objects->CollapseHierarchy(_topcell);
 
 	 v_printf(1, "done\n\n");
 
@@ -467,7 +472,7 @@ void GDSParse_ogl::gl_draw()
 				strcpy(tmp, _topcell->GetName());
 				v_printf(1, "GDS has been updated, reloading..\n");
 				Reload();
-				SetTopcell(tmp); // This is not elegant..
+				SetTopcell(tmp, true); // This is not elegant..
 				initWorld();
 			}
 		}
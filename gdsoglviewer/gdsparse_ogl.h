@@ -82,7 +82,7 @@ public:
 
 	class GDSObject *NewObject(char *Name);
 
-	int SetTopcell(const char *topcell);
+	int SetTopcell(const char *topcell, bool keepbuffers = false);
     void initWorld();
 	void buildSubstrate();
 	int gl_init();
@@ -323,10 +323,9 @@ UIHighlight::Event(int event, int data, int xpos, int ypos , bool shift, bool co
 			instances.clear();
 
 			// Trace and highlight
-			GDSMat identity; // For the world root 
-			cur_poly = NULL;
+			cur_poly = GDSPolygon();
 			cur_layer = NULL;
-			cur_mat = identity;
+			cur_placement = ObjectPlacement(); // The world root
 
 			// Step through all layers, calculate an intersect point and try to find intersections
 			// We have to replace this with a true 3D ray tracing algorithm...
@@ -350,18 +349,18 @@ UIHighlight::Event(int event, int data, int xpos, int ypos , bool shift, bool co
 				ray_z = wm->getWorld()->_z-layerz;
 
 				if(ray_z > 0.0f)
-					tracePoint(ray_x, ray_y,  wm->getWorld()->_topcell, identity, layer);
+					tracePoint(ray_x, ray_y, layer);
 				layer = layer->Next;
 			}
 
-			if(cur_poly)
+			if(cur_poly.isValid())
 			{
 				drawTracing(true);
 
 				// Add the root polygon to the list
 				ObjectInstance new_instance;
-				instances[cur_mat] = new_instance;
-				cur_instance = &instances[cur_mat];
+				instances[cur_placement] = new_instance;
+				cur_instance = &instances[cur_placement];
 				cur_instance->unchecked_poly.insert(cur_poly);
 
 				// Trace path
@@ -379,58 +378,65 @@ UIHighlight::Event(int event, int data, int xpos, int ypos , bool shift, bool co
 // This is where the trace magic happens..
 
 void 
-UIHighlight::tracePoint(float x, float y, GDSObject *obj, GDSMat object_mat, ProcessLayer *layer)
+UIHighlight::tracePoint(float x, float y, ProcessLayer *layer)
 {
-	GDSPolygon poly;	
-
-	// Is it within the boundary of this object?
-	GDSBB boundary = obj->GetTotalBoundary();
-	boundary.transform(object_mat);
-	if(!boundary.isPointInside(Point2D(x, y)))
+	if(!layer->Show)
 		return;
 
-	// Check object polygons
-	for(unsigned int i=0;i<obj->PolygonItems.size();i++)
+	// Polygons of this layer around the point, from the region index
+	GDSObject *top = wm->getWorld()->_topcell;
+	set<ProcessLayer*> layers;
+	vector<GDSHit> hits;
+	GDSBB window;
+	layers.insert(layer);
+	window.addPoint(Point2D(x, y));
+	wm->getWorld()->_Objects->QueryRegion(top, window, layers, hits);
+
+	// The point is taken into object space so the polygons can be tested
+	// where they are, exactly where the placement allows
+	for(unsigned int i=0;i<hits.size();i++)
 	{
-		poly = *obj->PolygonItems[i];
-
-		//
-		if(!poly.GetLayer()->Show || poly.GetLayer() != layer)
-			continue;
-
-		// Transform polygon
-		poly.transformPoints(object_mat);
+		ObjectPlacement placement(hits[i]);
+		float units = hits[i].Object->GetUnits();
+		GDSPoint P = {(int32_t)lround(x / units), (int32_t)lround(y / units)};
+		GDSTransform inverse;
 
-		// Raytraced point in polygon?
-		// Goes wrong when flipped transformation matrix!!!
-		poly.Orientate();
-		if(!poly.isPointInside(Point2D(x, y)))
-			continue;
-
-		// Same as current layer?
-		if((poly.GetLayer() != cur_layer) && cur_layer)
+		if(placement.Exact && placement.Transform.Inverse(inverse))
+			P = inverse * P;
+		else
 		{
-			if(poly.GetLayer()->Height+poly.GetLayer()->Thickness < cur_layer->Height + cur_layer->Thickness)
-				continue;
+			Point2D F = placement.Mat.Inverse() * Point2D(x, y);
+			P.X = (int32_t)lround(F.X / units);
+			P.Y = (int32_t)lround(F.Y / units);
 		}
+		tracePolygon(hits[i].Polygon, P.X, P.Y, hits[i].Object, placement);
+	}
+}
 
-		// Start tracing the path
-		cur_layer = poly.GetLayer();
-		cur_poly = obj->PolygonItems[i];
-		cur_mat = object_mat;	
-		cur_object = obj;
-	}	
+void 
+UIHighlight::tracePolygon(GDSPolygon poly, int32_t px, int32_t py, GDSObject *obj, const ObjectPlacement& placement)
+{
+	// Raytraced point in polygon?
+	if(!poly.GetBox().isPointInside(px, py) || !poly.isPointInside(px, py))
+		return;
 
-	// Propagate through hierarchy
-	for(unsigned int i=0;i<obj->refs.size();i++)
-		tracePoint(x, y, obj->refs[i]->object, object_mat * obj->refs[i]->mat, layer);
+	// Same as current layer?
+	if((poly.GetLayer() != cur_layer) && cur_layer)
+	{
+		if(poly.GetLayer()->Height+poly.GetLayer()->Thickness < cur_layer->Height + cur_layer->Thickness)
+			return;
+	}
+
+	// Start tracing the path
+	cur_layer = poly.GetLayer();
+	cur_poly = poly;
+	cur_placement = placement;
+	cur_object = obj;
 }
 
 void 
 UIHighlight::processList()
 {
-	GDSMat identity; // For the world root
-
 	// Reset timer
 	wm->timer(time, 1);
 
@@ -440,14 +446,14 @@ UIHighlight::processList()
 		// Work though current instance
 		while(cur_instance->unchecked_poly.size()>0)
 		{
-			GDSPolygon *poly = *cur_instance->unchecked_poly.begin();
+			GDSPolygon poly = *cur_instance->unchecked_poly.begin();
 
 			// Move to checked list
 			cur_instance->unchecked_poly.erase(poly);
 			cur_instance->checked_poly.insert(poly);			
 
 			// Trace against world
-			intersectTraverse(poly, cur_mat, wm->getWorld()->_topcell, identity);
+			intersectTraverse(poly, cur_placement);
 
 			// Check timer?
 			if(wm->timer(time, 0) > 1.0f)
@@ -460,12 +466,12 @@ UIHighlight::processList()
 
 		// Find a new instance with work to do
 		cur_instance = NULL;
-		for(map<GDSMat, ObjectInstance>::iterator it=instances.begin(); it!=instances.end(); ++it)
+		for(unordered_map<ObjectPlacement, ObjectInstance, ObjectPlacementHash>::iterator it=instances.begin(); it!=instances.end(); ++it)
 		{
 			if(it->second.unchecked_poly.size()>0)
 			{
 				cur_instance = &it->second;
-				cur_mat = it->first;
+				cur_placement = it->first;
 				break;
 			}
 		}
@@ -473,86 +479,103 @@ UIHighlight::processList()
 }
 
 void 
-UIHighlight::intersectTraverse(GDSPolygon *poly, GDSMat poly_mat, GDSObject *object, GDSMat object_mat)
+UIHighlight::intersectTraverse(GDSPolygon poly, const ObjectPlacement& poly_placement)
 {
-	// Is it within the boundary of this object?
-	GDSBB boundary = object->GetTotalBoundary();
-	GDSBB bb = *poly->GetBBox();
-	boundary.transform(object_mat);
-	bb.transform(poly_mat);
-	if(!GDSBB::intersect(bb, boundary))
-		return;
-
-	// Intersect with this object
-	intersectPolyOnObject(poly, poly_mat, object, object_mat);
-
-	// Go to sub cells
-	for(unsigned int i=0;i<object->refs.size();i++)
-		intersectTraverse(poly, poly_mat, object->refs[i]->object, object_mat * object->refs[i]->mat);
+	// Polygons of any layer that overlap it, from the region index
+	set<ProcessLayer*> layers;
+	vector<GDSHit> hits;
+	GDSBB bb = poly.GetBBox();
+	bb.transform(poly_placement.Mat);
+	wm->getWorld()->_Objects->QueryRegion(wm->getWorld()->_topcell, bb, layers, hits);
+
+	// The hits of one instance come together, transform the polygon into
+	// its space once
+	GDSPolygon transformed_poly;
+	GDSObject *last = NULL;
+	ObjectPlacement last_placement;
+	for(unsigned int i=0;i<hits.size();i++)
+	{
+		ObjectPlacement placement(hits[i]);
+		if(hits[i].Object != last || placement != last_placement)
+		{
+			transformed_poly = transformPolygon(poly, poly_placement, placement);
+			last = hits[i].Object;
+			last_placement = placement;
+		}
+		intersectPolyOnPoly(poly, transformed_poly, hits[i].Polygon, placement);
+	}
 }
 
-void 
-UIHighlight::intersectPolyOnObject(GDSPolygon *poly, GDSMat poly_mat, GDSObject *object, GDSMat object_mat)
+GDSPolygon 
+UIHighlight::transformPolygon(GDSPolygon poly, const ObjectPlacement& poly_placement, const ObjectPlacement& placement)
 {
-	GDSPolygon *target_poly;
+	scratch.Clear();
+	scratch.SetUnits(poly.GetUnits());
+	GDSPolygon transformed_poly = scratch.AddPolygon(poly);
+	GDSTransform inverse;
+
+	// Straight from one instance to the other when both are exact, the way
+	// back needs a unit magnification
+	if(poly_placement.Exact && placement.Exact && placement.Transform.Inverse(inverse))
+	{
+		transformed_poly.transformPoints(inverse * poly_placement.Transform);
+		return transformed_poly;
+	}
 
 	// Transform poly into worldspace -> do this on root level
-	GDSPolygon transformed_poly = *poly;
-	transformed_poly.transformPoints(poly_mat);	
+	transformed_poly.transformPoints(poly_placement.Mat);	
 
 	// Transform poly into object space
-	GDSMat invMat = object_mat.Inverse();
+	GDSMat invMat = placement.Mat.Inverse();
 	transformed_poly.transformPoints(invMat);
+	return transformed_poly;
+}
 
-	// Cache instances who already have polygons in the check list
-
-	for(unsigned int i=0;i<object->PolygonItems.size();i++)
+void 
+UIHighlight::intersectPolyOnPoly(GDSPolygon poly, GDSPolygon transformed_poly, GDSPolygon target_poly, const ObjectPlacement& placement)
+{
+	// Possible reject on layers
+	if(!target_poly.GetLayer()->Show)
+		return;
+	if(target_poly.GetLayer() != poly.GetLayer())
+	{			
+		if(target_poly.GetLayer()->Height > poly.GetLayer()->Height+poly.GetLayer()->Thickness + 1.0f)
+			return; // Too high
+		if(target_poly.GetLayer()->Height + target_poly.GetLayer()->Thickness + 1.0f < poly.GetLayer()->Height)
+			return; // Too low
+		if(target_poly.GetLayer()->Metal == poly.GetLayer()->Metal)
+			return; // Only jump between VIA -> METAL or METAL -> VIA
+	}
+	else
 	{
-		target_poly = object->PolygonItems[i];
-
-		// Possible reject on layers
-		if(!target_poly->GetLayer()->Show)
-			continue;
-		if(target_poly->GetLayer() != poly->GetLayer())
-		{			
-			if(target_poly->GetLayer()->Height > poly->GetLayer()->Height+poly->GetLayer()->Thickness + 1.0f)
-				continue; // Too high
-			if(target_poly->GetLayer()->Height + target_poly->GetLayer()->Thickness + 1.0f < poly->GetLayer()->Height)
-				continue; // Too low
-			if(target_poly->GetLayer()->Metal == poly->GetLayer()->Metal)
-				continue; // Only jump between VIA -> METAL or METAL -> VIA
-		}
-		else
-		{
-			if(!target_poly->GetLayer()->Metal)
-				continue; // Do not intersect within VIA layers
-		}
+		if(!target_poly.GetLayer()->Metal)
+			return; // Do not intersect within VIA layers
+	}
 
-		// Do bounds overlap?
-		if(!GDSBB::intersect(*transformed_poly.GetBBox(), *target_poly->GetBBox()))
-			continue;		
+	// Do bounds overlap?
+	if(!GDSBox::intersect(transformed_poly.GetBox(), target_poly.GetBox()))
+		return;		
 
-		// Do we already have this polygon?
-		map<GDSMat, ObjectInstance>::iterator cur_instance = instances.find(object_mat);
-		if(cur_instance != instances.end())
-		{
-			if( cur_instance->second.checked_poly.find(target_poly) != cur_instance->second.checked_poly.end())
-				continue; // Found it
-		}					
+	// Do we already have this polygon?
+	unordered_map<ObjectPlacement, ObjectInstance, ObjectPlacementHash>::iterator cur_instance = instances.find(placement);
+	if(cur_instance != instances.end())
+	{
+		if( cur_instance->second.checked_poly.find(target_poly) != cur_instance->second.checked_poly.end())
+			return; // Found it
+	}					
 
-		// Intersects with polygon?
-		if(!GDSPolygon::intersect(&transformed_poly, target_poly))
-			continue;
+	// Intersects with polygon?
+	if(!GDSPolygon::intersect(transformed_poly, target_poly))
+		return;
 
-		// Add to unchecked list
-		if(cur_instance == instances.end())
-		{
-			ObjectInstance new_instance;
-			instances[object_mat] = new_instance;
-			cur_instance = instances.find(object_mat);
-		}
-		cur_instance->second.unchecked_poly.insert(object->PolygonItems[i]);
-	}		
+	// Add to unchecked list
+	if(cur_instance == instances.end())
+	{
+		ObjectInstance new_instance;
+		instances[placement] = new_instance;
+		cur_instance = instances.find(placement);
+	}
+	cur_instance->second.unchecked_poly.insert(target_poly);
 }
 
 void 
@@ -566,17 +589,18 @@ UIHighlight::buildRenderObject()
 	render_object = new GDSObject_ogl((char*)"_ui_highlight");
 
 	// Iterate over all object instances
-	for(map<GDSMat, ObjectInstance>::iterator inst=instances.begin(); inst != instances.end(); ++inst)
+	for(unordered_map<ObjectPlacement, ObjectInstance, ObjectPlacementHash>::iterator inst=instances.begin(); inst != instances.end(); ++inst)
 	{
 		// Iterate over all polygons (unchecked should be empty by now)
-		for(set<GDSPolygon*>::iterator it=inst->second.checked_poly.begin(); it!=inst->second.checked_poly.end(); ++it)
+		for(set<GDSPolygon>::iterator it=inst->second.checked_poly.begin(); it!=inst->second.checked_poly.end(); ++it)
 		{
-			poly = **it;
-			poly.transformPoints(inst->first);
+			render_object->SetUnits(it->GetUnits());
+			poly = render_object->AddPolygon(*it); // Perform a copy
+			if(inst->first.Exact)
+				poly.transformPoints(inst->first.Transform);
+			else
+				poly.transformPoints(inst->first.Mat);
 			poly.Orientate();
-
-			render_object->AddPolygon(poly.GetHeight(), poly.GetThickness(), poly.GetPoints(), poly.GetLayer());
-			*render_object->GetCurrentPolygon() = poly; // Perform a copy
 		}
 	}
 
@@ -27,31 +27,64 @@
 class ObjectInstance // Also sort on object*!!
 {
 public:
-	set<GDSPolygon*> checked_poly;
-	set<GDSPolygon*> unchecked_poly; 
+	set<GDSPolygon> checked_poly;
+	set<GDSPolygon> unchecked_poly; 
 
-	set<GDSPolygon*> poly_pool; // Not yet implemented
-};// Use matrix as a sort key
+	set<GDSPolygon> poly_pool; // Not yet implemented
+};// Use placement as a key
+
+// Where an instance is, exactly if every reference above it allows that.
+// The same instance reached another way then gets the same key.
+class ObjectPlacement
+{
+public:
+	bool			Exact;
+	GDSTransform	Transform; // Database units, if Exact
+	GDSMat			Mat; // User units
+
+	ObjectPlacement() {Exact = true;};
+	ObjectPlacement(const GDSHit& Hit) {Exact = Hit.Exact; Transform = Hit.Transform; Mat = Hit.Mat;};
+
+	bool operator==(const ObjectPlacement& P) const {return Exact == P.Exact && (Exact ? Transform == P.Transform : !(Mat < P.Mat) && !(P.Mat < Mat));};
+	bool operator!=(const ObjectPlacement& P) const {return !(*this == P);};
+};
+
+struct ObjectPlacementHash
+{
+	size_t operator()(const ObjectPlacement& P) const
+	{
+		if(P.Exact)
+			return (size_t)P.Transform.Hash();
+
+		float e[6]; // Without -0, it compares equal to 0
+		for(unsigned int i=0;i<6;i++)
+			e[i] = P.Mat[i] + 0.0f;
+		return (size_t)gds_hash(e, sizeof(e));
+	};
+};
 
 class UIHighlight : public UIElement
 {
 private:    
     int state;
 	ProcessLayer *cur_layer;
-	GDSPolygon *cur_poly;
-	GDSMat		cur_mat;
+	GDSPolygon cur_poly;
+	ObjectPlacement cur_placement;
 	GDSObject *cur_object;
 	ObjectInstance *cur_instance;
 	htime *time;
 
-	map<GDSMat, ObjectInstance> instances;
+	unordered_map<ObjectPlacement, ObjectInstance, ObjectPlacementHash> instances;
 	vector<VECTOR3D> triangles;
 	GDSObject_ogl *render_object;
+	GDSGeometry scratch; // Transformed copy of the polygon being traced
 
-	void tracePoint(float x, float y, GDSObject *object, GDSMat object_mat, ProcessLayer *layer);
+	void tracePoint(float x, float y, ProcessLayer *layer);
+	void tracePolygon(GDSPolygon poly, int32_t px, int32_t py, GDSObject *object, const ObjectPlacement& placement);
 	void processList();
-	void intersectTraverse(GDSPolygon *poly, GDSMat poly_mat, GDSObject *object, GDSMat object_mat);
-	void intersectPolyOnObject(GDSPolygon *poly, GDSMat poly_mat, GDSObject *object, GDSMat object_mat);
+	void intersectTraverse(GDSPolygon poly, const ObjectPlacement& poly_placement);
+	GDSPolygon transformPolygon(GDSPolygon poly, const ObjectPlacement& poly_placement, const ObjectPlacement& placement); // Into the space of placement, in scratch
+	void intersectPolyOnPoly(GDSPolygon poly, GDSPolygon transformed_poly, GDSPolygon target_poly, const ObjectPlacement& placement);
 	
 	void buildRenderObject();
 	void drawTracing(bool finish);
@@ -22,7 +22,7 @@
 #include "windowmanager.h"
 #include "win_topmap.h"
 
-void WinTopmap::build_topcell_list(class GDSObject *object, struct ListItem *parent) {
+void WinTopmap::build_topcell_list(class GDSObject *object, const char *name, struct ListItem *parent) {
 	unsigned int i;
 	struct ListItem *item;
 	struct ListItem *newitem;
@@ -32,7 +32,7 @@ void WinTopmap::build_topcell_list(class GDSObject *object, struct ListItem *par
 		return;
 	
 	newitem = new struct ListItem();
-	newitem->Text = object->GetName();
+	newitem->Text = name; // Merged structures keep the name they were referenced by
 
 	// Select item if it corresponds to the topcell (listview will prevent double selections automatically, only first occurence will be selected)
 	if (strcmp(newitem->Text.c_str(), wm->getWorld()->_topcell->GetName()) == 0)
@@ -57,7 +57,7 @@ void WinTopmap::build_topcell_list(class GDSObject *object, struct ListItem *par
 		child = object->GetSRef(i)->object;
 		
 		if(child && (child != object) && !child->isPCell())
-			build_topcell_list(child, item);
+			build_topcell_list(child, gds_name(object->GetSRef(i)->Name), item);
 	}
 	
 	// Add ARef children
@@ -65,7 +65,7 @@ void WinTopmap::build_topcell_list(class GDSObject *object, struct ListItem *par
 		child = object->GetARef(i)->object;
 			
 		if(child && (child != object) && !child->isPCell())
-			build_topcell_list(child, item);
+			build_topcell_list(child, gds_name(object->GetARef(i)->Name), item);
 	}
 		
 	delete newitem;
@@ -82,7 +82,10 @@ WinTopmap::WinTopmap()
 	SetSingleSelect(true);
 	SetSorted(true);
 
-	build_topcell_list(wm->getWorld()->_Objects->GetTopObject(), NULL);
+	// PCells are left out of the list, also those not collapsed yet
+	wm->getWorld()->_Objects->UpdateStatistics();
+	GDSObject *top = wm->getWorld()->_Objects->GetTopObject();
+	build_topcell_list(top, top ? top->GetName() : NULL, NULL);
 
 	// Always expand first item in the list
 	if (GetFirst() && GetFirst()->Children.size() > 0)
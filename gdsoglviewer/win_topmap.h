@@ -27,7 +27,7 @@
 class WinTopmap : public ListView
 {
 private:
-	void build_topcell_list(class GDSObject *object, struct ListItem *parent);
+	void build_topcell_list(class GDSObject *object, const char *name, struct ListItem *parent);
 
 public:
 	WinTopmap();
@@ -54,15 +54,20 @@ void WindowManager::printUsage()
 {
 	v_printf(1, "\n");
 	v_printf(1, "GDS3D is a program for viewing a GDSII file in 3D.\n");
-	v_printf(1, "Usage: GDS3D -p process.txt -i input.gds [-t topcell] [-f] [-u] [-h] [-v]\n\n");
+	v_printf(1, "Usage: GDS3D -p process.txt -i input.gds [-t topcell] [-j threads] [-m megabytes] [-f] [-u] [-h] [-v]\n");
+	v_printf(1, "             [--no-cache] [--rebuild-cache]\n\n");
 	v_printf(1, "Options\n");
 	v_printf(1, " -p\t\tSpecify process file\n");
-	v_printf(1, " -i\t\tInput GDSII file\n");
+	v_printf(1, " -i\t\tInput GDSII or OASIS file\n");
 	v_printf(1, " -t\t\tSpecify top cell name\n");
+	v_printf(1, " -j\t\tNumber of worker threads, default is one per core\n");
+	v_printf(1, " -m\t\tMemory budget for flattening the hierarchy in MB, default is 512\n");
 	v_printf(1, " -f\t\tFullscreen mode\n");
 	v_printf(1, " -u\t\tDon't check GDS for update\n");
 	v_printf(1, " -h\t\tDisplay this help\n");
-	v_printf(1, " -v\t\tVerbose output\n\n");
+	v_printf(1, " -v\t\tVerbose output\n");
+	v_printf(1, " --no-cache\tDon't read or write the input.gds.gds3d cache\n");
+	v_printf(1, " --rebuild-cache\tIgnore the cache and write a fresh one\n\n");
 }
 
 bool WindowManager::commandLineParameters(int argc, char *argv[])
@@ -86,10 +91,16 @@ bool WindowManager::commandLineParameters(int argc, char *argv[])
 	char *gdsfile=NULL;
 	char *processfile=NULL;
 	char *topcell=NULL;
+	bool cache=true;
+	bool rebuildcache=false;
 
 	for(int i=1; i<argc; i++){
 		if(argv[i][0] == '-'){
-			if(strncmp(argv[i], "-i", strlen("-i"))==0){
+			if(strcmp(argv[i], "--no-cache")==0){
+				cache = false;
+			}else if(strcmp(argv[i], "--rebuild-cache")==0){
+				rebuildcache = true;
+			}else if(strncmp(argv[i], "-i", strlen("-i"))==0){
 				if(i==argc-1){
 					v_printf(-1, "Error: -i switch given but no input file specified.\n\n");
 					printUsage();
@@ -117,6 +128,22 @@ bool WindowManager::commandLineParameters(int argc, char *argv[])
 				}else{
 					topcell = argv[i+1];
 				}
+			}else if(strncmp(argv[i], "-j", strlen("-j"))==0){
+				if(i==argc-1){
+					v_printf(-1, "Error: -j switch given but no thread count specified.\n\n");
+					printUsage();
+					return false;
+				}else{
+					worker_threads = atoi(argv[i+1]);
+				}
+			}else if(strncmp(argv[i], "-m", strlen("-m"))==0){
+				if(i==argc-1){
+					v_printf(-1, "Error: -m switch given but no memory budget specified.\n\n");
+					printUsage();
+					return false;
+				}else{
+					flatten_budget = atoi(argv[i+1]);
+				}
 			}else if(strncmp(argv[i], "-v", strlen("-v"))==0){
 				verbose_output++;
 			}else if(strncmp(argv[i], "-u", strlen("-u"))==0){
@@ -161,11 +188,13 @@ bool WindowManager::commandLineParameters(int argc, char *argv[])
         v_printf(1, "Opening GDS file \"%s\"..\n\n", gdsfile);
         
 		world = new GDSParse_ogl(process, false);
+		if(cache)
+			world->SetCache(gdsfile, rebuildcache);
 		filename = gdsfile;
 		techname = processfile;
 		if(!world->Parse(iptr, topcell))
 		{
-			if(!update)
+			if(!update && !world->HasUnloadedStructures()) // Keep it for loading on demand
 				fclose(iptr);
 			if(!world->SetTopcell(topcell))
 			{
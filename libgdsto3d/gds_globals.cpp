@@ -29,15 +29,46 @@
 
 
 
+// 64 bit off_t for fstat() and fseeko() on 32 bit systems
+#define _FILE_OFFSET_BITS 64
+
 #include "gds_globals.h"
+#include <chrono>
+#include <sys/stat.h>
 
 // For the console output
 #ifdef WIN32
 	#include <Windows.h>
 	#include <WinBase.h>
+	#include <io.h>
 #endif
 
 int verbose_output=1; // Is this also initialized elsewhere?
+int worker_threads=0;
+int flatten_budget=512;
+
+int64_t gds_file_size(FILE *iptr)
+{
+#ifdef WIN32
+	struct _stat64 st;
+	if(!iptr || _fstat64(_fileno(iptr), &st) != 0)
+		return -1;
+#else
+	struct stat st;
+	if(!iptr || fstat(fileno(iptr), &st) != 0)
+		return -1;
+#endif
+	return (int64_t)st.st_size;
+}
+
+bool gds_file_seek(FILE *iptr, int64_t offset)
+{
+#ifdef WIN32
+	return _fseeki64(iptr, offset, SEEK_SET) == 0;
+#else
+	return fseeko(iptr, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
 
 void v_printf(const int level, const char *fmt, ...)
 {
@@ -72,3 +103,76 @@ void v_printf(const int level, const char *fmt, ...)
 	}
 }
 
+double gds_time()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+unsigned int gds_thread_count()
+{
+	unsigned int count = worker_threads;
+
+	if(worker_threads <= 0){
+		count = thread::hardware_concurrency();
+	}
+	return count ? count : 1;
+}
+
+void gds_parallel_for(unsigned int count, const function<void(unsigned int, unsigned int)>& func)
+{
+	unsigned int threads = gds_thread_count();
+	atomic<unsigned int> next(0);
+	vector<thread> pool;
+
+	if(threads > count)
+		threads = count;
+	if(threads <= 1){
+		for(unsigned int i=0; i<count; i++)
+			func(i, 0);
+		return;
+	}
+
+	for(unsigned int t=0; t<threads; t++){
+		pool.push_back(thread([&, t](){
+			unsigned int i;
+			while((i = next++) < count)
+				func(i, t);
+		}));
+	}
+	for(unsigned int t=0; t<threads; t++)
+		pool[t].join();
+}
+
+unsigned long long gds_hash(const void *data, size_t length, unsigned long long seed)
+{
+	const unsigned long long m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
+	const unsigned char *p = (const unsigned char *)data;
+	unsigned long long h = seed ^ (length * m);
+	unsigned long long k;
+
+	for(; length >= 8; length -= 8, p += 8){
+		memcpy(&k, p, 8);
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+		h ^= k;
+		h *= m;
+	}
+
+	switch(length){
+		case 7: h ^= (unsigned long long)p[6] << 48; /* fallthrough */
+		case 6: h ^= (unsigned long long)p[5] << 40; /* fallthrough */
+		case 5: h ^= (unsigned long long)p[4] << 32; /* fallthrough */
+		case 4: h ^= (unsigned long long)p[3] << 24; /* fallthrough */
+		case 3: h ^= (unsigned long long)p[2] << 16; /* fallthrough */
+		case 2: h ^= (unsigned long long)p[1] << 8; /* fallthrough */
+		case 1: h ^= (unsigned long long)p[0];
+			h *= m;
+	}
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+	return h;
+}
@@ -38,16 +38,38 @@
 #include <string.h>
 #include <assert.h>
 #include <sys/types.h>
+#include <stdint.h>
 // STL
 #include <vector>
 #include <list>
 #include <set>
 #include <map>
+#include <string>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
 using namespace std;
 
 extern int verbose_output;
+extern int worker_threads; // Number of worker threads, 0 for one per core
+extern int flatten_budget; // Megabytes the geometry may grow by flattening the hierarchy
 
 void v_printf(const int level, const char *fmt, ...); // Message feedback
+double gds_time(); // Wall clock in seconds, for timing feedback
+
+// Runs func(index, thread) for every index in [0, count) on a pool of worker
+// threads. Indices are handed out dynamically, thread is in [0, gds_thread_count()).
+unsigned int gds_thread_count();
+void gds_parallel_for(unsigned int count, const function<void(unsigned int, unsigned int)>& func);
+
+// Size of an open file in bytes, -1 if unknown, and seeking to an offset.
+// 64 bit on every platform, long is 32 bits on Win32.
+int64_t gds_file_size(FILE *iptr);
+bool gds_file_seek(FILE *iptr, int64_t offset);
+
+// 64 bit MurmurHash2 of a block of memory, chain blocks by passing the previous hash as seed
+unsigned long long gds_hash(const void *data, size_t length, unsigned long long seed = 0);
 
 /*
  * We need byte swapping functions.
@@ -102,10 +124,10 @@ typedef enum gds_element_type{
 typedef unsigned char byte;
 
 typedef struct gds_header{
-	short RecordLength;
+	unsigned short RecordLength; /* Length of Data, without the 4 byte header */
 	byte RecordType;
 	byte DataType;
-	byte *Data;
+	const byte *Data;
 }gds_header;
 
 /* A word consists of 16 bits, numbered from 0 to 15, left to right. */
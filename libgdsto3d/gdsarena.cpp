@@ -0,0 +1,150 @@
+//  GDS3D, a program for viewing GDSII files in 3D.
+//  Created by Jasper Velner and Michiel Soer, http://icd.el.utwente.nl
+//  Copyright (C) 2013 IC-Design Group, University of Twente.
+//
+//  Based on gds2pov by Roger Light, http://atchoo.org/gds2pov/ / https://github.com/ralight/gds2pov
+//  Copyright (C) 2004-2008 by Roger Light
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include "gdsarena.h"
+
+#define GDS_SLAB_SIZE	(256*1024)
+#define GDS_ARENA_MIN	256		// First chunk, most cells in a large library are small
+#define GDS_ARENA_MAX	(16*1024)
+#define GDS_ARENA_LARGE	(GDS_SLAB_SIZE/8)	// Larger requests get a slab of their own
+
+struct GDSArenaSlab
+{
+	atomic<int>	refs;
+	char		*pos;	// Not yet carved
+	char		*end;
+};
+
+static GDSArenaSlab *gds_slab_new(size_t size)
+{
+	size_t header = (sizeof(GDSArenaSlab) + 15) & ~(size_t)15;
+	char *mem = (char *)malloc(header + size);
+	assert(mem);
+
+	GDSArenaSlab *slab = new (mem) GDSArenaSlab;
+	slab->refs = 1;
+	slab->pos = mem + header;
+	slab->end = mem + header + size;
+	return slab;
+}
+
+static void gds_slab_release(GDSArenaSlab *slab)
+{
+	if(--slab->refs == 0)
+	{
+		slab->~GDSArenaSlab();
+		free(slab);
+	}
+}
+
+// Slab the arenas of this thread carve from, it keeps a reference of its own
+// until it is full or the thread ends
+struct GDSSlabHolder
+{
+	GDSArenaSlab *slab;
+
+	GDSSlabHolder() {slab = NULL;};
+	~GDSSlabHolder() {if(slab) gds_slab_release(slab);};
+};
+
+static thread_local GDSSlabHolder gds_current_slab;
+
+GDSArena::GDSArena()
+{
+	_chunkslab = NULL;
+	_pos = _end = NULL;
+	_nextsize = GDS_ARENA_MIN;
+	_allocated = 0;
+}
+
+GDSArena::~GDSArena()
+{
+	Release();
+}
+
+void *GDSArena::AllocateSlow(size_t size, size_t align)
+{
+	size_t need = size + align - 1;
+
+	if(need > GDS_ARENA_LARGE)
+	{
+		GDSArenaSlab *slab = gds_slab_new(need);
+		_slabs.push_back(slab);
+		_allocated += need;
+		return (void *)(((size_t)slab->pos + align - 1) & ~(align - 1));
+	}
+
+	GDSArenaSlab *slab = gds_current_slab.slab;
+	if(!slab || (size_t)(slab->end - slab->pos) < need)
+	{
+		if(slab)
+			gds_slab_release(slab);
+		slab = gds_current_slab.slab = gds_slab_new(GDS_SLAB_SIZE);
+	}
+
+	if(_chunkslab != slab || _end != slab->pos)
+	{
+		// Someone else carved in between, start a new chunk
+		if(_chunkslab != slab)
+		{
+			slab->refs++;
+			_slabs.push_back(slab);
+			_chunkslab = slab;
+		}
+		_pos = _end = slab->pos;
+	}
+
+	// Grow the chunk in place
+	size_t chunk = _nextsize > need ? _nextsize : need;
+	if(chunk > (size_t)(slab->end - slab->pos))
+		chunk = slab->end - slab->pos;
+	_end += chunk;
+	slab->pos = _end;
+	_allocated += chunk;
+	if(_nextsize < GDS_ARENA_MAX)
+		_nextsize *= 2;
+
+	char *p = (char *)(((size_t)_pos + align - 1) & ~(align - 1));
+	_pos = p + size;
+	return p;
+}
+
+void GDSArena::Trim()
+{
+	GDSArenaSlab *slab = gds_current_slab.slab;
+	if(slab && _chunkslab == slab && _end == slab->pos)
+	{
+		_allocated -= _end - _pos;
+		slab->pos = _end = _pos;
+	}
+}
+
+void GDSArena::Release()
+{
+	for(unsigned int i=0;i<_slabs.size();i++)
+		gds_slab_release(_slabs[i]);
+	_slabs.clear();
+	_chunkslab = NULL;
+	_pos = _end = NULL;
+	_nextsize = GDS_ARENA_MIN;
+	_allocated = 0;
+}
@@ -0,0 +1,146 @@
+//  GDS3D, a program for viewing GDSII files in 3D.
+//  Created by Jasper Velner and Michiel Soer, http://icd.el.utwente.nl
+//  Copyright (C) 2013 IC-Design Group, University of Twente.
+//
+//  Based on gds2pov by Roger Light, http://atchoo.org/gds2pov/ / https://github.com/ralight/gds2pov
+//  Copyright (C) 2004-2008 by Roger Light
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#ifndef __GDSARENA_H__
+#define __GDSARENA_H__
+
+#include "gds_globals.h"
+#include <new>
+#include <type_traits>
+
+// Bump allocator for the elements of one structure. Polygons, paths, texts,
+// references and their coordinate and index lists are placed in memory owned
+// by the GDSObject, so a structure with thousands of shapes costs a handful
+// of mallocs instead of several per shape, and tearing it down releases the
+// lot at once. Memory is only returned as a whole, by Release() or the
+// destructor.
+//
+// Arenas carve their chunks from large slabs that are shared by all arenas
+// filled on the same thread. While one structure is parsed its chunks are
+// consecutive and grow in place, and Trim() hands back the unused end, so
+// a library of many small cells packs as densely as one big arena. A slab
+// is freed once every arena that used it is gone. One arena is only filled
+// by one thread at a time.
+struct GDSArenaSlab;
+
+class GDSArena
+{
+private:
+	vector<GDSArenaSlab*>	_slabs;	// One reference on each slab holding a chunk
+	GDSArenaSlab	*_chunkslab;	// Slab of the current chunk
+	char	*_pos;		// Free part of the current chunk
+	char	*_end;
+	size_t	_nextsize;	// Size of the next chunk, grows while the arena fills
+	size_t	_allocated;	// Bytes in chunks, for statistics
+
+	void *AllocateSlow(size_t size, size_t align);
+
+	GDSArena(const GDSArena&);		// Not copyable
+	GDSArena& operator=(const GDSArena&);
+
+public:
+	GDSArena();
+	~GDSArena();
+
+	void *Allocate(size_t size, size_t align = 8);
+	void Trim(); // Done filling for now, give the end of the chunk back
+	void Release(); // Drop everything, all allocations become invalid
+	size_t GetAllocated() {return _allocated;};
+};
+
+inline void *GDSArena::Allocate(size_t size, size_t align)
+{
+	char *p = (char *)(((size_t)_pos + align - 1) & ~(align - 1));
+	if(_pos && p + size <= _end)
+	{
+		_pos = p + size;
+		return p;
+	}
+	return AllocateSlow(size, align);
+}
+
+// Elements are created with new (arena) T(...) and destroyed by calling the
+// destructor, their memory goes when the arena goes
+inline void *operator new(size_t size, GDSArena& arena)
+{
+	return arena.Allocate(size);
+}
+
+inline void operator delete(void *, GDSArena&) // Only used if a constructor throws
+{
+}
+
+// Container allocator on top of an arena, or on the heap without one.
+// Growing a vector in the arena leaves the old buffer behind until the
+// arena is released, so reserve when the final size is known. Copies of a
+// container always go to the heap, a temporary copy must not outlive the
+// arena it came from.
+template <class T>
+class GDSArenaAllocator
+{
+public:
+	typedef T value_type;
+	typedef T *pointer;
+	typedef const T *const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	typedef std::true_type propagate_on_container_swap; // Swapping trades arenas too
+
+	template <class U> struct rebind {typedef GDSArenaAllocator<U> other;};
+
+	GDSArena *arena;
+
+	GDSArenaAllocator(GDSArena *a = NULL) : arena(a) {};
+	template <class U> GDSArenaAllocator(const GDSArenaAllocator<U>& o) : arena(o.arena) {};
+
+	T *allocate(size_t n)
+	{
+		if(arena)
+			return (T *)arena->Allocate(n*sizeof(T), __alignof(T));
+		return (T *)::operator new(n*sizeof(T));
+	}
+
+	void deallocate(T *p, size_t)
+	{
+		if(!arena)
+			::operator delete(p);
+	}
+
+	GDSArenaAllocator select_on_container_copy_construction() const {return GDSArenaAllocator();};
+};
+
+template <class T, class U>
+inline bool operator==(const GDSArenaAllocator<T>& a, const GDSArenaAllocator<U>& b)
+{
+	return a.arena == b.arena;
+}
+
+template <class T, class U>
+inline bool operator!=(const GDSArenaAllocator<T>& a, const GDSArenaAllocator<U>& b)
+{
+	return a.arena != b.arena;
+}
+
+#endif // __GDSARENA_H__
@@ -0,0 +1,696 @@
+//  GDS3D, a program for viewing GDSII files in 3D.
+//  Created by Jasper Velner and Michiel Soer, http://icd.el.utwente.nl
+//  Copyright (C) 2013 IC-Design Group, University of Twente.
+//
+//  Based on gds2pov by Roger Light, http://atchoo.org/gds2pov/ / https://github.com/ralight/gds2pov
+//  Copyright (C) 2004-2008 by Roger Light
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "gdscache.h"
+#include "gdsparse.h"
+#include <sys/stat.h>
+
+#ifdef WIN32
+	#include <io.h>
+#endif
+
+// Coordinates and indices are stored as the arrays of GDSGeometry
+static_assert(sizeof(float) == 4, "float must be 32 bits");
+
+static const char gdscache_magic[8] = {'G','D','S','3','D','D','B','\0'};
+
+static const size_t gdscache_record[csCount] = {
+	sizeof(GDSCacheObject),
+	sizeof(GDSCachePolygon),
+	sizeof(int32_t),
+	sizeof(int32_t),
+	sizeof(uint16_t),
+	4*sizeof(int32_t),
+	sizeof(GDSCacheRectRange),
+	4*sizeof(int32_t),
+	sizeof(GDSCacheSRef),
+	sizeof(GDSCacheARef),
+	sizeof(GDSCacheRef),
+	1
+};
+
+GDSCache::GDSCache(const char *gdsfile)
+{
+	_filename = new char[strlen(gdsfile)+7];
+	strcpy(_filename, gdsfile);
+	strcat(_filename, ".gds3d");
+
+	memset(&_key, 0, sizeof(_key));
+}
+
+GDSCache::~GDSCache()
+{
+	delete [] _filename;
+}
+
+void GDSCache::LayerTable(class GDSProcess *process, vector<struct ProcessLayer*>& layers)
+{
+	layers.clear();
+	for(struct ProcessLayer *layer = process->GetLayer(); layer; layer = layer->Next)
+		layers.push_back(layer);
+}
+
+void GDSCache::MakeKey(FILE *iptr, GDSReader& reader, class GDSProcess *process)
+{
+	vector<struct ProcessLayer*> layers;
+	uint64_t hash;
+
+	memset(&_key, 0, sizeof(_key));
+
+#ifdef WIN32
+	struct _stat64 st;
+	if(_fstat64(_fileno(iptr), &st) == 0){
+#else
+	struct stat st;
+	if(fstat(fileno(iptr), &st) == 0){
+#endif
+		_key.Size = (uint64_t)st.st_size;
+		_key.MTime = (int64_t)st.st_mtime;
+	}
+
+	// Content hash, straight from the mapping or in chunks through stdio
+	if(reader.IsMapped()){
+		_key.Content = gds_hash(reader.GetData(), reader.GetSize());
+	}else{
+		byte *buffer = new byte[1<<20];
+		size_t length;
+
+		hash = 0;
+		fseek(iptr, 0, SEEK_SET);
+		while((length = fread(buffer, 1, 1<<20, iptr)) > 0)
+			hash = gds_hash(buffer, length, hash);
+		fseek(iptr, 0, SEEK_SET);
+		delete [] buffer;
+		_key.Content = hash;
+	}
+
+	// Only the parts of the techfile that end up in the geometry
+	hash = 0;
+	LayerTable(process, layers);
+	for(unsigned int i=0; i<layers.size(); i++){
+		int32_t id[2] = {layers[i]->Layer, layers[i]->Datatype};
+		float z[2] = {layers[i]->Height, layers[i]->Thickness};
+		hash = gds_hash(id, sizeof(id), hash);
+		hash = gds_hash(z, sizeof(z), hash);
+	}
+	_key.Process = hash;
+}
+
+bool GDSCache::Load(class GDSParse *parser, class GDSObjectList *objects, class GDSProcess *process, long *elements, double *units)
+{
+	FILE *iptr;
+	GDSFileMap file;
+	GDSCacheHeader header;
+	vector<struct ProcessLayer*> layers;
+	vector<GDSObject*> loaded;
+	const byte *data;
+	uint64_t size;
+
+	iptr = fopen(_filename, "rb");
+	if(!iptr){
+		v_printf(2, "No cache file %s.\n", _filename);
+		return false;
+	}
+	int64_t length = gds_file_size(iptr);
+	if(length < 0){
+		fclose(iptr);
+		return false;
+	}
+	size = (uint64_t)length;
+
+	if(size < sizeof(GDSCacheHeader) || !file.Open(iptr, length, false)){
+		fclose(iptr);
+		return false;
+	}
+	fclose(iptr);
+	data = file.GetData();
+	memcpy(&header, data, sizeof(header));
+
+	if(memcmp(header.Magic, gdscache_magic, 8) || header.Version != GDSCACHE_VERSION || header.ByteOrder != 0x01020304){
+		v_printf(1, "Ignoring cache file %s of another version.\n", _filename);
+		return false;
+	}
+	if(memcmp(&header.Key, &_key, sizeof(_key))){
+		v_printf(1, "Cache file %s is out of date.\n", _filename);
+		return false;
+	}
+
+	// Never trust a truncated or damaged file
+	for(int i=0; i<csCount; i++){
+		if(header.Offset[i] % 8 || header.Offset[i] > size || header.Count[i] > 0xffffffffULL
+			|| header.Count[i] > (size - header.Offset[i]) / gdscache_record[i]){
+			v_printf(1, "Cache file %s is damaged.\n", _filename);
+			return false;
+		}
+	}
+
+	const GDSCacheObject *cobjects = (const GDSCacheObject *)(data + header.Offset[csObjects]);
+	const GDSCachePolygon *cpolygons = (const GDSCachePolygon *)(data + header.Offset[csPolygons]);
+	const int32_t *cx = (const int32_t *)(data + header.Offset[csX]);
+	const int32_t *cy = (const int32_t *)(data + header.Offset[csY]);
+	const uint16_t *cindices = (const uint16_t *)(data + header.Offset[csIndices]);
+	const int32_t *cfaces = (const int32_t *)(data + header.Offset[csFaces]);
+	const GDSCacheRectRange *crectranges = (const GDSCacheRectRange *)(data + header.Offset[csRectRanges]);
+	const int32_t *crects = (const int32_t *)(data + header.Offset[csRects]);
+	const GDSCacheSRef *csrefs = (const GDSCacheSRef *)(data + header.Offset[csSRefs]);
+	const GDSCacheARef *carefs = (const GDSCacheARef *)(data + header.Offset[csARefs]);
+	const GDSCacheRef *crefs = (const GDSCacheRef *)(data + header.Offset[csRefs]);
+	const char *cnames = (const char *)(data + header.Offset[csNames]);
+	uint64_t numnames = header.Count[csNames];
+
+	if(numnames == 0 || cnames[numnames-1] != '\0'){
+		v_printf(1, "Cache file %s is damaged.\n", _filename);
+		return false;
+	}
+
+	// Each name is stored once, intern them up front
+	map<uint64_t, unsigned int> nameids;
+	for(uint64_t i=0; i<numnames; i+=strlen(cnames+i)+1)
+		nameids[i] = gds_intern(cnames+i);
+
+	LayerTable(process, layers);
+
+	// Validate every range before anything is allocated
+	for(uint64_t i=0; i<header.Count[csObjects]; i++){
+		const GDSCacheObject& o = cobjects[i];
+		bool valid = nameids.count(o.Name)
+			&& (uint64_t)o.FirstPolygon + o.NumPolygons <= header.Count[csPolygons]
+			&& (uint64_t)o.FirstPoint + o.NumPoints <= header.Count[csX]
+			&& (uint64_t)o.FirstIndex + o.NumIndices <= header.Count[csIndices]
+			&& (uint64_t)o.FirstFace + o.NumFaces <= header.Count[csFaces]
+			&& (uint64_t)o.FirstRectRange + o.NumRectRanges <= header.Count[csRectRanges]
+			&& (uint64_t)o.FirstRect + o.NumRects <= header.Count[csRects]
+			&& o.NumRectRanges <= GDS_MAX_POLYGON_POINTS
+			&& (uint64_t)o.FirstSRef + o.NumSRefs <= header.Count[csSRefs]
+			&& (uint64_t)o.FirstARef + o.NumARefs <= header.Count[csARefs]
+			&& (uint64_t)o.FirstRef + o.NumRefs <= header.Count[csRefs];
+		for(uint32_t j=o.FirstPolygon; valid && j<o.FirstPolygon+o.NumPolygons; j++){
+			const GDSCachePolygon& p = cpolygons[j];
+			bool faces = (p.Flags & GDS_POLYGON_FACES) != 0;
+			valid = (uint64_t)p.FirstPoint + p.NumPoints <= o.NumPoints
+				&& (uint64_t)p.FirstIndex + p.NumIndices <= (faces ? o.NumFaces : o.NumIndices)
+				&& p.NumPoints <= GDS_MAX_POLYGON_POINTS && (faces || p.NumIndices % 3 == 0)
+				&& (p.Flags & ~(GDS_POLYGON_FACES | GDS_POLYGON_SHARED)) == 0
+				&& p.Layer >= -1 && p.Layer < (int32_t)layers.size();
+			for(uint32_t k=0; valid && !faces && k<p.NumIndices; k++)
+				valid = cindices[o.FirstIndex + p.FirstIndex + k] < p.NumPoints;
+		}
+		uint64_t rects = 0; // Ranges follow each other without gaps
+		for(uint32_t j=o.FirstRectRange; valid && j<o.FirstRectRange+o.NumRectRanges; j++){
+			const GDSCacheRectRange& r = crectranges[j];
+			valid = r.FirstRect == rects && r.Layer >= -1 && r.Layer < (int32_t)layers.size();
+			rects += r.NumRects;
+		}
+		valid = valid && rects == o.NumRects;
+		for(uint32_t j=o.FirstSRef; valid && j<o.FirstSRef+o.NumSRefs; j++)
+			valid = nameids.count(csrefs[j].Name) && csrefs[j].Object >= 0 && (uint64_t)csrefs[j].Object < header.Count[csObjects];
+		for(uint32_t j=o.FirstARef; valid && j<o.FirstARef+o.NumARefs; j++)
+			valid = nameids.count(carefs[j].Name) && carefs[j].Object >= 0 && (uint64_t)carefs[j].Object < header.Count[csObjects];
+		for(uint32_t j=o.FirstRef; valid && j<o.FirstRef+o.NumRefs; j++)
+			valid = crefs[j].Object >= 0 && (uint64_t)crefs[j].Object < header.Count[csObjects] && crefs[j].Columns > 0 && crefs[j].Rows > 0
+				&& crefs[j].SRef >= -1 && crefs[j].SRef < (int64_t)o.NumSRefs && crefs[j].ARef >= -1 && crefs[j].ARef < (int64_t)o.NumARefs;
+		if(!valid){
+			v_printf(1, "Cache file %s is damaged.\n", _filename);
+			return false;
+		}
+	}
+
+	// Objects first, references point anywhere in the list
+	for(uint64_t i=0; i<header.Count[csObjects]; i++)
+		loaded.push_back(parser->NewObject((char *)cnames + cobjects[i].Name));
+
+	for(uint64_t i=0; i<header.Count[csObjects]; i++){
+		const GDSCacheObject& o = cobjects[i];
+		GDSObject *object = loaded[i];
+
+		object->PointCount = o.PointCount;
+		object->ContentHash = o.ContentHash;
+		object->SetUnits((float)header.Units);
+
+		GDSGeometry& geometry = object->Geometry;
+		geometry._X.assign(cx + o.FirstPoint, cx + o.FirstPoint + o.NumPoints);
+		geometry._Y.assign(cy + o.FirstPoint, cy + o.FirstPoint + o.NumPoints);
+		geometry._Indices.assign(cindices + o.FirstIndex, cindices + o.FirstIndex + o.NumIndices);
+		geometry._Faces.resize(o.NumFaces);
+		for(uint32_t j=0; j<o.NumFaces; j++){
+			const int32_t *c = cfaces + 4*((uint64_t)o.FirstFace + j);
+			GDSBox& b = geometry._Faces[j];
+
+			b.MinX = c[0];
+			b.MinY = c[1];
+			b.MaxX = c[2];
+			b.MaxY = c[3];
+		}
+		geometry._Polygons.resize(o.NumPolygons);
+		for(uint32_t j=0; j<o.NumPolygons; j++){
+			const GDSCachePolygon& p = cpolygons[o.FirstPolygon + j];
+			GDSPolygonRecord& r = geometry._Polygons[j];
+
+			r.FirstPoint = p.FirstPoint;
+			r.FirstIndex = p.FirstIndex;
+			r.NumIndices = p.NumIndices;
+			r.NumPoints = (uint16_t)p.NumPoints;
+			r.Flags = (uint16_t)p.Flags;
+			r.Height = p.Height;
+			r.Thickness = p.Thickness;
+			r.Layer = p.Layer >= 0 ? layers[p.Layer] : NULL;
+			r.BBox.MinX = p.BBox[0];
+			r.BBox.MinY = p.BBox[1];
+			r.BBox.MaxX = p.BBox[2];
+			r.BBox.MaxY = p.BBox[3];
+		}
+		geometry._Rects.resize(o.NumRects);
+		geometry._RectRange.resize(o.NumRects);
+		geometry._RectRanges.resize(o.NumRectRanges);
+		for(uint32_t j=0; j<o.NumRects; j++){
+			const int32_t *c = crects + 4*((uint64_t)o.FirstRect + j);
+			GDSBox& b = geometry._Rects[j];
+
+			b.MinX = c[0];
+			b.MinY = c[1];
+			b.MaxX = c[2];
+			b.MaxY = c[3];
+		}
+		for(uint32_t j=0; j<o.NumRectRanges; j++){
+			const GDSCacheRectRange& c = crectranges[o.FirstRectRange + j];
+			GDSRectRange& r = geometry._RectRanges[j];
+
+			r.Layer = c.Layer >= 0 ? layers[c.Layer] : NULL;
+			r.Height = c.Height;
+			r.Thickness = c.Thickness;
+			r.FirstRect = c.FirstRect;
+			r.NumRects = c.NumRects;
+			for(uint32_t k=c.FirstRect; k<c.FirstRect+c.NumRects; k++)
+				geometry._RectRange[k] = (uint16_t)j;
+		}
+		geometry._Bucketed = false;
+
+		for(uint32_t j=o.FirstSRef; j<o.FirstSRef+o.NumSRefs; j++){
+			const GDSCacheSRef& s = csrefs[j];
+			object->AddSRef(nameids[s.Name], s.X, s.Y, s.Flipped, s.Mag);
+			object->SetSRefRotation(s.Rotate[0], s.Rotate[1], s.Rotate[2]);
+			object->SRefItems.back()->object = loaded[s.Object];
+		}
+
+		for(uint32_t j=o.FirstARef; j<o.FirstARef+o.NumARefs; j++){
+			const GDSCacheARef& a = carefs[j];
+			object->AddARef(nameids[a.Name], a.X1, a.Y1, a.X2, a.Y2, a.X3, a.Y3, a.Columns, a.Rows, a.Flipped, a.Mag);
+			object->SetARefRotation(a.Rotate[0], a.Rotate[1], a.Rotate[2]);
+			object->ARefItems.back()->object = loaded[a.Object];
+		}
+
+		object->refs.reserve(o.NumRefs);
+		for(uint32_t j=o.FirstRef; j<o.FirstRef+o.NumRefs; j++){
+			const GDSCacheRef& r = crefs[j];
+			GDSRef *ref = new (object->Arena) GDSRef;
+			ref->object = loaded[r.Object];
+			ref->mat = GDSMat(r.Mat[0], r.Mat[1], r.Mat[2], r.Mat[3], r.Mat[4], r.Mat[5]);
+			ref->Columns = r.Columns;
+			ref->Rows = r.Rows;
+			ref->ColumnX = r.ColumnX;
+			ref->ColumnY = r.ColumnY;
+			ref->RowX = r.RowX;
+			ref->RowY = r.RowY;
+			ref->X = r.X;
+			ref->Y = r.Y;
+			ref->Mag = r.Mag;
+			ref->Units = r.Units;
+			ref->SRef = r.SRef >= 0 ? object->SRefItems[r.SRef] : NULL;
+			ref->ARef = r.ARef >= 0 ? object->ARefItems[r.ARef] : NULL;
+			ref->UpdateTransform();
+			object->refs.push_back(ref);
+		}
+
+		object->FinishElements();
+		objects->AddObject(object);
+	}
+
+	for(int i=0; i<6; i++)
+		elements[i] = (long)header.Elements[i];
+	*units = header.Units;
+
+	v_printf(1, "Loaded %u structures from cache file %s\n", (unsigned int)header.Count[csObjects], _filename);
+	return true;
+}
+
+// Pad the output to the next section boundary
+static bool gdscache_align(FILE *optr, uint64_t& pos)
+{
+	static const byte zero[8] = {0,0,0,0,0,0,0,0};
+	size_t pad = (size_t)((8 - pos % 8) % 8);
+
+	pos += pad;
+	return fwrite(zero, 1, pad, optr) == pad;
+}
+
+static bool gdscache_write(FILE *optr, uint64_t& pos, const void *data, size_t length)
+{
+	pos += length;
+	return fwrite(data, 1, length, optr) == length;
+}
+
+// Every distinct name is stored once, in the order it is first used
+static void gdscache_name(map<unsigned int, uint64_t>& names, vector<unsigned int>& order, uint64_t& size, unsigned int id)
+{
+	if(names.count(id))
+		return;
+	names[id] = size;
+	order.push_back(id);
+	size += strlen(gds_name(id)) + 1;
+}
+
+bool GDSCache::Write(FILE *optr, class GDSObjectList *objects, class GDSProcess *process, const long *elements, double units)
+{
+	GDSCacheHeader header;
+	vector<struct ProcessLayer*> layertable;
+	map<struct ProcessLayer*, int32_t> layers;
+	map<GDSObject*, int32_t> index;
+	map<unsigned int, uint64_t> names; // Interned name to its offset in the names section
+	vector<unsigned int> nameorder;
+	unsigned int numobjects = objects->getNumObjects();
+	uint64_t pos;
+	bool ok = true;
+
+	LayerTable(process, layertable);
+	for(unsigned int i=0; i<layertable.size(); i++)
+		layers[layertable[i]] = i;
+	for(unsigned int i=0; i<numobjects; i++)
+		index[objects->getObject(i)] = i;
+
+	// Size every section
+	memset(&header, 0, sizeof(header));
+	memcpy(header.Magic, gdscache_magic, 8);
+	header.Version = GDSCACHE_VERSION;
+	header.ByteOrder = 0x01020304;
+	header.Key = _key;
+	for(int i=0; i<6; i++)
+		header.Elements[i] = elements[i];
+	header.Units = units;
+
+	header.Count[csObjects] = numobjects;
+	for(unsigned int i=0; i<numobjects; i++){
+		GDSObject *object = objects->getObject(i);
+
+		header.Count[csPolygons] += object->Geometry.GetNumPolygons();
+		header.Count[csX] += object->Geometry.GetNumPoints();
+		header.Count[csY] += object->Geometry.GetNumPoints();
+		header.Count[csIndices] += object->Geometry.GetNumIndices();
+		header.Count[csFaces] += object->Geometry.GetNumFaces();
+		header.Count[csRectRanges] += object->Geometry.GetRectRanges().size();
+		header.Count[csRects] += object->Geometry.GetNumRects();
+		header.Count[csSRefs] += object->SRefItems.size();
+		header.Count[csARefs] += object->ARefItems.size();
+		header.Count[csRefs] += object->refs.size();
+
+		gdscache_name(names, nameorder, header.Count[csNames], object->GetNameID());
+		for(unsigned int j=0; j<object->SRefItems.size(); j++)
+			gdscache_name(names, nameorder, header.Count[csNames], object->SRefItems[j]->Name);
+		for(unsigned int j=0; j<object->ARefItems.size(); j++)
+			gdscache_name(names, nameorder, header.Count[csNames], object->ARefItems[j]->Name);
+	}
+	for(int i=0; i<csCount; i++){
+		if(header.Count[i] > 0xffffffffULL){
+			v_printf(1, "Database too large for the cache file.\n");
+			return false;
+		}
+	}
+
+	pos = sizeof(header);
+	for(int i=0; i<csCount; i++){
+		pos = (pos + 7) & ~(uint64_t)7;
+		header.Offset[i] = pos;
+		pos += header.Count[i] * gdscache_record[i];
+	}
+
+	pos = 0;
+	ok = gdscache_write(optr, pos, &header, sizeof(header));
+
+	// Objects
+	uint32_t polygon = 0, point = 0, indice = 0, face = 0, rectrange = 0, rect = 0, sref = 0, aref = 0, ref = 0;
+	ok = ok && gdscache_align(optr, pos);
+	for(unsigned int i=0; ok && i<numobjects; i++){
+		GDSObject *object = objects->getObject(i);
+		GDSCacheObject o;
+
+		memset(&o, 0, sizeof(o));
+		o.ContentHash = object->ContentHash;
+		o.Name = (uint32_t)names[object->GetNameID()];
+		o.PointCount = object->PointCount;
+		o.FirstPolygon = polygon;
+		o.NumPolygons = object->Geometry.GetNumPolygons();
+		o.FirstPoint = point;
+		o.NumPoints = object->Geometry.GetNumPoints();
+		o.FirstIndex = indice;
+		o.NumIndices = object->Geometry.GetNumIndices();
+		o.FirstFace = face;
+		o.NumFaces = object->Geometry.GetNumFaces();
+		o.FirstRectRange = rectrange;
+		o.NumRectRanges = object->Geometry.GetRectRanges().size();
+		o.FirstRect = rect;
+		o.NumRects = object->Geometry.GetNumRects();
+		o.FirstSRef = sref;
+		o.NumSRefs = object->SRefItems.size();
+		o.FirstARef = aref;
+		o.NumARefs = object->ARefItems.size();
+		o.FirstRef = ref;
+		o.NumRefs = object->refs.size();
+		ok = gdscache_write(optr, pos, &o, sizeof(o));
+
+		polygon += o.NumPolygons;
+		point += o.NumPoints;
+		indice += o.NumIndices;
+		face += o.NumFaces;
+		rectrange += o.NumRectRanges;
+		rect += o.NumRects;
+		sref += o.NumSRefs;
+		aref += o.NumARefs;
+		ref += o.NumRefs;
+	}
+
+	// Polygons
+	ok = ok && gdscache_align(optr, pos);
+	for(unsigned int i=0; ok && i<numobjects; i++){
+		GDSObject *object = objects->getObject(i);
+		for(unsigned int j=0; ok && j<object->Geometry.GetNumPolygons(); j++){
+			const GDSPolygonRecord& p = object->Geometry._Polygons[j];
+			GDSCachePolygon c;
+
+			c.FirstPoint = p.FirstPoint;
+			c.NumPoints = p.NumPoints;
+			c.FirstIndex = p.FirstIndex;
+			c.NumIndices = p.NumIndices;
+			c.Flags = p.Flags;
+			c.Layer = p.Layer ? layers[p.Layer] : -1;
+			c.Height = p.Height;
+			c.Thickness = p.Thickness;
+			c.BBox[0] = p.BBox.MinX;
+			c.BBox[1] = p.BBox.MinY;
+			c.BBox[2] = p.BBox.MaxX;
+			c.BBox[3] = p.BBox.MaxY;
+			ok = gdscache_write(optr, pos, &c, sizeof(c));
+		}
+	}
+
+	// Coordinates and indices, copied as is
+	ok = ok && gdscache_align(optr, pos);
+	for(unsigned int i=0; ok && i<numobjects; i++){
+		GDSCoordArray& X = objects->getObject(i)->Geometry._X;
+		if(!X.empty())
+			ok = gdscache_write(optr, pos, &X[0], X.size()*sizeof(int32_t));
+	}
+	ok = ok && gdscache_align(optr, pos);
+	for(unsigned int i=0; ok && i<numobjects; i++){
+		GDSCoordArray& Y = objects->getObject(i)->Geometry._Y;
+		if(!Y.empty())
+			ok = gdscache_write(optr, pos, &Y[0], Y.size()*sizeof(int32_t));
+	}
+	ok = ok && gdscache_align(optr, pos);
+	for(unsigned int i=0; ok && i<numobjects; i++){
+		GDSIndexArray& indices = objects->getObject(i)->Geometry._Indices;
+		if(!indices.empty())
+			ok = gdscache_write(optr, pos, &indices[0], indices.size()*sizeof(uint16_t));
+	}
+
+	ok = ok && gdscache_align(optr, pos);
+	for(unsigned int i=0; ok && i<numobjects; i++){
+		GDSRectArray& faces = objects->getObject(i)->Geometry._Faces;
+		for(unsigned int j=0; ok && j<faces.size(); j++){
+			int32_t c[4] = {faces[j].MinX, faces[j].MinY, faces[j].MaxX, faces[j].MaxY};
+			ok = gdscache_write(optr, pos, c, sizeof(c));
+		}
+	}
+
+	// Rectangles
+	ok = ok && gdscache_align(optr, pos);
+	for(unsigned int i=0; ok && i<numobjects; i++){
+		const GDSRectRangeArray& ranges = objects->getObject(i)->Geometry.GetRectRanges();
+		for(unsigned int j=0; ok && j<ranges.size(); j++){
+			const GDSRectRange& r = ranges[j];
+			GDSCacheRectRange c;
+
+			c.Layer = r.Layer ? layers[r.Layer] : -1;
+			c.Height = r.Height;
+			c.Thickness = r.Thickness;
+			c.FirstRect = r.FirstRect;
+			c.NumRects = r.NumRects;
+			ok = gdscache_write(optr, pos, &c, sizeof(c));
+		}
+	}
+	ok = ok && gdscache_align(optr, pos);
+	for(unsigned int i=0; ok && i<numobjects; i++){
+		GDSRectArray& rects = objects->getObject(i)->Geometry._Rects;
+		for(unsigned int j=0; ok && j<rects.size(); j++){
+			int32_t c[4] = {rects[j].MinX, rects[j].MinY, rects[j].MaxX, rects[j].MaxY};
+			ok = gdscache_write(optr, pos, c, sizeof(c));
+		}
+	}
+
+	// Structure references
+	ok = ok && gdscache_align(optr, pos);
+	for(unsigned int i=0; ok && i<numobjects; i++){
+		GDSObject *object = objects->getObject(i);
+
+		for(unsigned int j=0; ok && j<object->SRefItems.size(); j++){
+			SRefElement *s = object->SRefItems[j];
+			GDSCacheSRef c;
+
+			c.Name = (uint32_t)names[s->Name];
+			c.Object = index[s->object];
+			c.X = s->X;
+			c.Y = s->Y;
+			c.Mag = s->Mag;
+			c.Rotate[0] = s->Rotate.X;
+			c.Rotate[1] = s->Rotate.Y;
+			c.Rotate[2] = s->Rotate.Z;
+			c.Flipped = s->Flipped;
+			ok = gdscache_write(optr, pos, &c, sizeof(c));
+		}
+	}
+
+	ok = ok && gdscache_align(optr, pos);
+	for(unsigned int i=0; ok && i<numobjects; i++){
+		GDSObject *object = objects->getObject(i);
+
+		for(unsigned int j=0; ok && j<object->ARefItems.size(); j++){
+			ARefElement *a = object->ARefItems[j];
+			GDSCacheARef c;
+
+			c.Name = (uint32_t)names[a->Name];
+			c.Object = index[a->object];
+			c.X1 = a->X1;
+			c.Y1 = a->Y1;
+			c.X2 = a->X2;
+			c.Y2 = a->Y2;
+			c.X3 = a->X3;
+			c.Y3 = a->Y3;
+			c.Mag = a->Mag;
+			c.Rotate[0] = a->Rotate.X;
+			c.Rotate[1] = a->Rotate.Y;
+			c.Rotate[2] = a->Rotate.Z;
+			c.Columns = a->Columns;
+			c.Rows = a->Rows;
+			c.Flipped = a->Flipped;
+			ok = gdscache_write(optr, pos, &c, sizeof(c));
+		}
+	}
+
+	// Resolved references, arrays as one lattice
+	ok = ok && gdscache_align(optr, pos);
+	for(unsigned int i=0; ok && i<numobjects; i++){
+		GDSObject *object = objects->getObject(i);
+		map<SRefElement*, int32_t> srefs;
+		map<ARefElement*, int32_t> arefs;
+		for(unsigned int j=0; j<object->SRefItems.size(); j++)
+			srefs[object->SRefItems[j]] = j;
+		for(unsigned int j=0; j<object->ARefItems.size(); j++)
+			arefs[object->ARefItems[j]] = j;
+
+		for(unsigned int j=0; ok && j<object->refs.size(); j++){
+			const GDSRef *r = object->refs[j];
+			GDSCacheRef c;
+
+			memset(&c, 0, sizeof(c));
+			c.Object = index[r->object];
+			for(int k=0; k<6; k++)
+				c.Mat[k] = r->mat[k];
+			c.Columns = r->Columns;
+			c.Rows = r->Rows;
+			c.ColumnX = r->ColumnX;
+			c.ColumnY = r->ColumnY;
+			c.RowX = r->RowX;
+			c.RowY = r->RowY;
+			c.X = r->X;
+			c.Y = r->Y;
+			c.Mag = r->Mag;
+			c.Units = r->Units;
+			c.SRef = r->SRef ? srefs[r->SRef] : -1;
+			c.ARef = r->ARef ? arefs[r->ARef] : -1;
+			ok = gdscache_write(optr, pos, &c, sizeof(c));
+		}
+	}
+
+	// Names
+	ok = ok && gdscache_align(optr, pos);
+	for(unsigned int i=0; ok && i<nameorder.size(); i++)
+		ok = gdscache_write(optr, pos, gds_name(nameorder[i]), strlen(gds_name(nameorder[i])) + 1);
+
+	return ok && pos == header.Offset[csNames] + header.Count[csNames];
+}
+
+bool GDSCache::Save(class GDSObjectList *objects, class GDSProcess *process, const long *elements, double units)
+{
+	char *tempname;
+	FILE *optr;
+	bool ok;
+
+	// Write to a temporary file first, so a viewer starting at the same time
+	// never maps half a cache
+	tempname = new char[strlen(_filename)+5];
+	strcpy(tempname, _filename);
+	strcat(tempname, ".tmp");
+
+	optr = fopen(tempname, "wb");
+	if(!optr){
+		v_printf(2, "Unable to write cache file %s.\n", _filename);
+		delete [] tempname;
+		return false;
+	}
+
+	ok = Write(optr, objects, process, elements, units);
+	if(fclose(optr) != 0)
+		ok = false;
+
+	if(ok){
+#ifdef WIN32
+		remove(_filename);
+#endif
+		ok = rename(tempname, _filename) == 0;
+	}
+	if(!ok){
+		v_printf(1, "Unable to write cache file %s.\n", _filename);
+		remove(tempname);
+	}else{
+		v_printf(2, "Wrote cache file %s.\n", _filename);
+	}
+
+	delete [] tempname;
+	return ok;
+}
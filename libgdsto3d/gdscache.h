@@ -0,0 +1,160 @@
+//  GDS3D, a program for viewing GDSII files in 3D.
+//  Created by Jasper Velner and Michiel Soer, http://icd.el.utwente.nl
+//  Copyright (C) 2013 IC-Design Group, University of Twente.
+//
+//  Based on gds2pov by Roger Light, http://atchoo.org/gds2pov/ / https://github.com/ralight/gds2pov
+//  Copyright (C) 2004-2008 by Roger Light
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef __GDSCACHE_H__
+#define __GDSCACHE_H__
+
+#include "gds_globals.h"
+#include "gdsreader.h"
+#include "gdsobjectlist.h"
+#include "process_cfg.h"
+#include <stdint.h>
+
+// Bump whenever the layout below or the stored geometry changes
+#define GDSCACHE_VERSION	9
+
+enum GDSCacheSection{
+	csObjects,
+	csPolygons,
+	csX,		// Database unit coordinates of all objects, object by object
+	csY,
+	csIndices,	// 16 bit, relative to the first point of the polygon
+	csFaces,	// MinX, MinY, MaxX, MaxY in database units
+	csRectRanges,
+	csRects,	// MinX, MinY, MaxX, MaxY in database units, range after range
+	csSRefs,
+	csARefs,
+	csRefs,
+	csNames,	// Each distinct structure name once, zero terminated
+	csCount
+};
+
+// A GDS file and techfile are only served from the cache if all of these match
+typedef struct GDSCacheKey{
+	uint64_t	Size;
+	int64_t		MTime;
+	uint64_t	Content;	// Hash of the GDS bytes
+	uint64_t	Process;	// Hash of the layer table of the techfile
+}GDSCacheKey;
+
+// The cache file is a header followed by flat, 8 byte aligned sections of
+// fixed size records, so it can be mapped and copied straight into objects.
+typedef struct GDSCacheHeader{
+	char		Magic[8];
+	uint32_t	Version;
+	uint32_t	ByteOrder;
+	GDSCacheKey	Key;
+	int64_t		Elements[6];	// Element counters of the parser summary
+	double		Units;		// User units per database unit
+	uint64_t	Offset[csCount];
+	uint64_t	Count[csCount];
+}GDSCacheHeader;
+
+typedef struct GDSCacheObject{
+	uint64_t	ContentHash;	// For incremental reloads
+	uint32_t	Name;		// Offset into the names section
+	int32_t		PointCount;
+	uint32_t	FirstPolygon, NumPolygons;
+	uint32_t	FirstPoint, NumPoints;
+	uint32_t	FirstIndex, NumIndices;
+	uint32_t	FirstFace, NumFaces;
+	uint32_t	FirstRectRange, NumRectRanges;
+	uint32_t	FirstRect, NumRects;
+	uint32_t	FirstSRef, NumSRefs;
+	uint32_t	FirstARef, NumARefs;
+	uint32_t	FirstRef, NumRefs;
+}GDSCacheObject;
+
+// Same as GDSPolygonRecord, ranges are relative to the object
+typedef struct GDSCachePolygon{
+	uint32_t	FirstPoint, NumPoints;
+	uint32_t	FirstIndex, NumIndices;	// Or the faces
+	uint32_t	Flags;
+	int32_t		Layer;		// Position in the process layer list, -1 for none
+	float		Height;
+	float		Thickness;
+	int32_t		BBox[4];
+}GDSCachePolygon;
+
+// Same as GDSRectRange, FirstRect is relative to the object
+typedef struct GDSCacheRectRange{
+	int32_t		Layer;
+	float		Height;
+	float		Thickness;
+	uint32_t	FirstRect, NumRects;
+}GDSCacheRectRange;
+
+typedef struct GDSCacheSRef{
+	uint32_t	Name;
+	int32_t		Object;
+	int32_t		X, Y;
+	float		Mag;
+	float		Rotate[3];
+	int32_t		Flipped;
+}GDSCacheSRef;
+
+typedef struct GDSCacheARef{
+	uint32_t	Name;
+	int32_t		Object;
+	int32_t		X1, Y1, X2, Y2, X3, Y3;
+	float		Mag;
+	float		Rotate[3];
+	int32_t		Columns, Rows;
+	int32_t		Flipped;
+}GDSCacheARef;
+
+// A GDSRef, arrays as one lattice
+typedef struct GDSCacheRef{
+	double		ColumnX, ColumnY, RowX, RowY;
+	int32_t		Object;
+	float		Mat[6];
+	uint32_t	Columns, Rows;
+	int32_t		X, Y;
+	float		Mag;
+	float		Units;
+	int32_t		SRef, ARef; // Index of the element it was made from, or -1
+}GDSCacheRef;
+
+// Persistent copy of the parsed and tessellated database, stored next to the
+// GDS file as <file>.gds3d. A matching cache skips parsing, tessellation and
+// reference resolving entirely.
+class GDSCache
+{
+private:
+	char			*_filename;
+	GDSCacheKey		_key;
+
+	void LayerTable(class GDSProcess *process, vector<struct ProcessLayer*>& layers);
+	bool Write(FILE *optr, class GDSObjectList *objects, class GDSProcess *process, const long *elements, double units);
+
+public:
+	GDSCache(const char *gdsfile);
+	~GDSCache();
+
+	// Fingerprint the GDS file and techfile, must be called before Load/Save
+	void MakeKey(FILE *iptr, GDSReader& reader, class GDSProcess *process);
+
+	// Fill objects from the cache, returns false if it is missing or stale
+	bool Load(class GDSParse *parser, class GDSObjectList *objects, class GDSProcess *process, long *elements, double *units);
+	bool Save(class GDSObjectList *objects, class GDSProcess *process, const long *elements, double units);
+};
+
+#endif // __GDSCACHE_H__
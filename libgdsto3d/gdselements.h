@@ -49,10 +49,10 @@ typedef struct ElementColour{
 
 typedef struct SRefElement {
     bool collapsed;
-	float X;
-	float Y;
+	int32_t X; // Database units
+	int32_t Y;
 	float Mag;
-	char *Name;
+	unsigned int Name; // Interned, see gdsnames.h
 	Transform Rotate;
 	int Flipped;
 
@@ -61,16 +61,16 @@ typedef struct SRefElement {
 
 typedef struct ARefElement {
     bool collapsed;
-	float X1;
-	float Y1;
-	float X2;
-	float Y2;
-	float X3;
-	float Y3;
+	int32_t X1; // Database units
+	int32_t Y1;
+	int32_t X2;
+	int32_t Y2;
+	int32_t X3;
+	int32_t Y3;
 	float Mag;
 	int Columns;
 	int Rows;
-	char *Name;
+	unsigned int Name; // Interned, see gdsnames.h
 	Transform Rotate;
 	int Flipped;
 
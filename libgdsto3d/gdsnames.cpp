@@ -0,0 +1,118 @@
+//  GDS3D, a program for viewing GDSII files in 3D.
+//  Created by Jasper Velner and Michiel Soer, http://icd.el.utwente.nl
+//  Copyright (C) 2013 IC-Design Group, University of Twente.
+//
+//  Based on gds2pov by Roger Light, http://atchoo.org/gds2pov/ / https://github.com/ralight/gds2pov
+//  Copyright (C) 2004-2008 by Roger Light
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include "gdsnames.h"
+#include <unordered_map>
+
+#define NAME_PAGE_BITS	12
+#define NAME_PAGE_SIZE	(1 << NAME_PAGE_BITS)
+#define NAME_PAGES	4096
+#define NAME_BLOCK_SIZE	65536
+
+struct GDSNameHash
+{
+	size_t operator()(const char *name) const
+	{
+		return (size_t)gds_hash(name, strlen(name));
+	}
+};
+
+struct GDSNameEqual
+{
+	bool operator()(const char *a, const char *b) const
+	{
+		return strcmp(a, b) == 0;
+	}
+};
+
+// Strings are copied into large blocks and never move. The id to string
+// pages are only appended to, so gds_name() needs no lock: whoever holds an
+// id got it through gds_intern(), after the page entry was written.
+static mutex _namelock;
+static unordered_map<const char*, unsigned int, GDSNameHash, GDSNameEqual> _nameids;
+static const char **_namepages[NAME_PAGES];
+static unsigned int _namecount = 0;
+static char *_nameblock = NULL;
+static size_t _nameblockfree = 0;
+
+static const char *gds_store_name(const char *name)
+{
+	size_t length = strlen(name) + 1;
+
+	if(length > NAME_BLOCK_SIZE / 4) // Long names get their own block
+	{
+		char *str = new char[length];
+		memcpy(str, name, length);
+		return str;
+	}
+
+	if(length > _nameblockfree)
+	{
+		_nameblock = new char[NAME_BLOCK_SIZE];
+		_nameblockfree = NAME_BLOCK_SIZE;
+	}
+
+	char *str = _nameblock;
+	memcpy(str, name, length);
+	_nameblock += length;
+	_nameblockfree -= length;
+	return str;
+}
+
+unsigned int gds_intern(const char *name)
+{
+	lock_guard<mutex> lock(_namelock);
+
+	unordered_map<const char*, unsigned int, GDSNameHash, GDSNameEqual>::iterator it = _nameids.find(name);
+	if(it != _nameids.end())
+		return it->second;
+
+	assert(_namecount < (unsigned int)NAME_PAGES * NAME_PAGE_SIZE);
+
+	unsigned int id = _namecount;
+	unsigned int page = id >> NAME_PAGE_BITS;
+	if(!_namepages[page])
+		_namepages[page] = new const char*[NAME_PAGE_SIZE];
+
+	const char *str = gds_store_name(name);
+	_namepages[page][id & (NAME_PAGE_SIZE - 1)] = str;
+	_nameids[str] = id;
+	_namecount++;
+
+	return id;
+}
+
+unsigned int gds_find_name(const char *name)
+{
+	lock_guard<mutex> lock(_namelock);
+
+	unordered_map<const char*, unsigned int, GDSNameHash, GDSNameEqual>::iterator it = _nameids.find(name);
+	if(it == _nameids.end())
+		return GDS_NO_NAME;
+	return it->second;
+}
+
+const char *gds_name(unsigned int id)
+{
+	assert(id != GDS_NO_NAME);
+	return _namepages[id >> NAME_PAGE_BITS][id & (NAME_PAGE_SIZE - 1)];
+}
@@ -0,0 +1,38 @@
+//  GDS3D, a program for viewing GDSII files in 3D.
+//  Created by Jasper Velner and Michiel Soer, http://icd.el.utwente.nl
+//  Copyright (C) 2013 IC-Design Group, University of Twente.
+//
+//  Based on gds2pov by Roger Light, http://atchoo.org/gds2pov/ / https://github.com/ralight/gds2pov
+//  Copyright (C) 2004-2008 by Roger Light
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#ifndef __GDSNAMES_H__
+#define __GDSNAMES_H__
+
+#include "gds_globals.h"
+
+// Structure names are interned once in a process wide table, shared by the
+// parser, the cache and GDSObjectList. References store the id, so resolving
+// them is an array lookup instead of a string compare per object. Ids and
+// strings stay valid until the program exits, also across reloads.
+#define GDS_NO_NAME	0xffffffff
+
+unsigned int gds_intern(const char *name); // Id of name, added if new
+unsigned int gds_find_name(const char *name); // GDS_NO_NAME if never interned
+const char *gds_name(unsigned int id);
+
+#endif // __GDSNAMES_H__
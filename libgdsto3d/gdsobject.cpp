@@ -30,58 +30,38 @@
 #include "gdsobject.h"
 #include "gdsobjectlist.h"
 
-
-
-#define HIERARCHY_LIMIT  30000
-
 GDSObject::GDSObject(char *NewName)
 {
     PointCount = 0;
+	ExpandedPaths = 0;
+	Stats.Points = Stats.Polygons = Stats.Triangles = Stats.Instances = 0;
     noHierarchy = false;
 	collapsed = false;
 
 	hasBoundary = false;
+	ContentHash = 0;
+	stub = false;
     
-	Name = new char[strlen(NewName)+1];
-	strcpy(Name, NewName); 
+	NameID = gds_intern(NewName);
+	Name = gds_name(NameID);
 
     PCell = false;
 }
 
 GDSObject::~GDSObject()
 {
-	for(unsigned int i=0;i<PolygonItems.size();i++)
-		delete PolygonItems[i];
-
+	// Elements live in the arena, only run their destructors here. The
+	// references are plain data, the arena frees everything at once
 	for(unsigned int i=0;i<PathItems.size();i++)
-		delete PathItems[i];
+		PathItems[i]->~GDSPath();
 
 	for(unsigned int i=0;i<TextItems.size();i++)
-		delete TextItems[i];
-
-	for(unsigned int i=0;i<SRefItems.size();i++)
-	{
-		if(SRefItems[i]->Name)
-			delete [] SRefItems[i]->Name;
-		delete SRefItems[i];
-	}
-
-	for(unsigned int i=0;i<ARefItems.size();i++)
-	{
-		if(ARefItems[i]->Name)
-			delete [] ARefItems[i]->Name;
-		delete ARefItems[i];
-	}
-
-	for(unsigned int i=0;i<refs.size();i++)		
-		delete refs[i];	
-    
-	delete [] Name;
+		TextItems[i]->~GDSText();
 }
 
 void GDSObject::AddText(float newX, float newY, float newZ, bool newFlipped, float newMag, int newVJust, int newHJust, struct ProcessLayer *newlayer)
 {
-	TextItems.push_back(new class GDSText(newX, newY, newZ, newFlipped, newMag, newVJust, newHJust, newlayer));
+	TextItems.push_back(new (Arena) GDSText(newX, newY, newZ, newFlipped, newMag, newVJust, newHJust, newlayer));
 }
 
 class GDSText *GDSObject::GetCurrentText()
@@ -93,32 +73,170 @@ class GDSText *GDSObject::GetCurrentText()
 	}
 }
 
-char *GDSObject::GetName()
+const char *GDSObject::GetName()
 {
 	return Name;
 }
 
 void GDSObject::AddPolygon(float Height, float Thickness, int Points, struct ProcessLayer *layer)
 {
-	PolygonItems.push_back(new class GDSPolygon(Height, Thickness, layer));
+	Geometry.AddPolygon(Height, Thickness, layer, Points);
 
     PointCount += Points*2;
 }
 
-class GDSPolygon *GDSObject::GetCurrentPolygon()
+GDSPolygon GDSObject::AddPolygon(const GDSPolygon& polygon)
 {
-    if(PolygonItems.size()>0)
-        return PolygonItems[PolygonItems.size()-1];
+	GDSPolygon copy = Geometry.AddPolygon(polygon);
+
+	PointCount += copy.GetPoints()*2;
+	return copy;
+}
+
+void GDSObject::AddRect(float Height, float Thickness, const GDSBox& box, struct ProcessLayer *layer)
+{
+	Geometry.AddRect(Height, Thickness, layer, box);
+
+	PointCount += 8;
+}
+
+GDSPolygon GDSObject::GetCurrentPolygon()
+{
+    if(Geometry.GetNumPolygons()>0)
+        return Geometry.GetPolygon(Geometry.GetNumPolygons()-1);
     else
-        return NULL;
+        return GDSPolygon();
 }
 
-void GDSObject::AddSRef(char *Name, float X, float Y, int Flipped, float Mag)
+void GDSObject::FinishElements()
 {
-	SRefElement *NewSRef = new SRefElement;
+	Geometry.Finish(&Arena);
+	Arena.Trim();
+}
+
+// The geometry work of a parsed structure, kept out of the parser so it
+// can run on all threads. Boundaries only have their points by now, paths
+// only their centre line. Polygons that were built before, copied from
+// children or read from the cache, are left alone.
+void GDSObject::BuildElements()
+{
+	unsigned int first;
+
+	for(unsigned int i=0;i<Geometry.GetNumPolygons();i++)
+	{
+		GDSPolygon polygon = Geometry.GetPolygon(i);
+
+		if(polygon.GetNumIndices() || polygon.hasFaces())
+			continue;
+		polygon.Orientate(); // Check normal pointing
+		polygon.Tesselate();
+	}
+
+	// Path outlines are counter-clockwise already
+	first = Geometry.GetNumPolygons();
+	for(;ExpandedPaths<PathItems.size();ExpandedPaths++)
+		PathItems[ExpandedPaths]->Expand(&Geometry);
+	for(unsigned int i=first;i<Geometry.GetNumPolygons();i++)
+		Geometry.GetPolygon(i).Tesselate();
+
+	FinishElements();
+}
+
+// Chunks end where they reach GDS_BUILD_CHUNK_POINTS, so they only depend
+// on the object and the result not on the threads that build them. A path
+// makes about twice its points.
+void GDSObject::SplitElements(vector<GDSBuildChunk>& Chunks)
+{
+	GDSBuildChunk chunk;
+
+	Chunks.clear();
+	if(PointCount <= GDS_BUILD_CHUNK_POINTS)
+		return;
+
+	chunk.Paths = false;
+	chunk.First = 0;
+	chunk.Points = 0;
+	for(unsigned int i=0;i<=Geometry.GetNumPolygons();i++)
+	{
+		if(i == Geometry.GetNumPolygons() || chunk.Points >= GDS_BUILD_CHUNK_POINTS)
+		{
+			chunk.Last = i;
+			if(chunk.Last > chunk.First)
+				Chunks.push_back(chunk);
+			chunk.First = i;
+			chunk.Points = 0;
+		}
+		if(i < Geometry.GetNumPolygons())
+			chunk.Points += Geometry.GetPolygon(i).GetPoints();
+	}
+
+	chunk.Paths = true;
+	chunk.First = ExpandedPaths;
+	chunk.Points = 0;
+	for(unsigned int i=ExpandedPaths;i<=PathItems.size();i++)
+	{
+		if(i == PathItems.size() || chunk.Points >= GDS_BUILD_CHUNK_POINTS)
+		{
+			chunk.Last = i;
+			if(chunk.Last > chunk.First)
+				Chunks.push_back(chunk);
+			chunk.First = i;
+			chunk.Points = 0;
+		}
+		if(i < PathItems.size())
+			chunk.Points += 2*PathItems[i]->GetPoints();
+	}
+
+	if(Chunks.size() < 2)
+		Chunks.clear();
+}
+
+// BuildElements() of one chunk, polygons are copied in first. Objects are
+// only read, so the chunks of one object can be built together.
+void GDSObject::BuildChunk(GDSBuildChunk& Chunk)
+{
+	GDSGeometry& geometry = Chunk.Geometry;
+
+	geometry.SetUnits(Geometry.GetUnits());
+	if(Chunk.Paths)
+	{
+		for(unsigned int i=Chunk.First;i<Chunk.Last;i++)
+			PathItems[i]->Expand(&geometry);
+		for(unsigned int i=0;i<geometry.GetNumPolygons();i++)
+			geometry.GetPolygon(i).Tesselate();
+		return;
+	}
+
+	geometry.Reserve(Chunk.Last - Chunk.First, Chunk.Points, 0);
+	for(unsigned int i=Chunk.First;i<Chunk.Last;i++)
+	{
+		GDSPolygon polygon = geometry.AddPolygon(Geometry.GetPolygon(i));
+
+		if(polygon.GetNumIndices() || polygon.hasFaces())
+			continue;
+		polygon.Orientate();
+		polygon.Tesselate();
+	}
+}
+
+void GDSObject::AppendChunks(vector<GDSBuildChunk>& Chunks)
+{
+	Geometry.ClearPolygons();
+	for(unsigned int i=0;i<Chunks.size();i++)
+	{
+		Geometry.Append(Chunks[i].Geometry);
+		Chunks[i].Geometry.ClearPolygons();
+	}
+	ExpandedPaths = PathItems.size();
+
+	FinishElements();
+}
+
+void GDSObject::AddSRef(unsigned int Name, int32_t X, int32_t Y, int Flipped, float Mag)
+{
+	SRefElement *NewSRef = new (Arena) SRefElement;
       
-	NewSRef->Name = new char[strlen(Name)+1];
-	strcpy(NewSRef->Name, Name);
+	NewSRef->Name = Name;
 	NewSRef->X = X;
 	NewSRef->Y = Y;
 	NewSRef->Rotate.X = 0.0;
@@ -142,12 +260,11 @@ void GDSObject::SetSRefRotation(float X, float Y, float Z)
 	}
 }
 
-void GDSObject::AddARef(char *Name, float X1, float Y1, float X2, float Y2, float X3, float Y3, int Columns, int Rows, int Flipped, float Mag)
+void GDSObject::AddARef(unsigned int Name, int32_t X1, int32_t Y1, int32_t X2, int32_t Y2, int32_t X3, int32_t Y3, int Columns, int Rows, int Flipped, float Mag)
 {
-	ARefElement *NewARef = new ARefElement;
+	ARefElement *NewARef = new (Arena) ARefElement;
     
-	NewARef->Name = new char[strlen(Name)+1];
-	strcpy(NewARef->Name, Name);
+	NewARef->Name = Name;
 	NewARef->X1 = X1;
 	NewARef->Y1 = Y1;
 	NewARef->X2 = X2;
@@ -361,27 +478,37 @@ struct _Boundary *GDSObject::GetTotalBoundary(class MATRIX4X4 *modelview)
 GDSBB GDSObject::GetTotalBoundary()
 {
 	GDSBB BB, t;
-	GDSPolygon *polygon;
 
 	if(hasBoundary)
 		return boundary;
 
-	for(unsigned int i=0; i<PolygonItems.size(); i++)
+	const GDSLayerArray& layers = Geometry.GetLayers();
+	for(unsigned int i=0; i<layers.size(); i++)
 	{
-		polygon = PolygonItems[i];
-		if(!polygon->GetLayer()->Show)
+		if(!layers[i].Layer->Show)
 			continue;
 
-		BB.merge(*polygon->GetBBox());
+		for(unsigned int j=layers[i].FirstPolygon; j<layers[i].FirstPolygon+layers[i].NumPolygons; j++)
+			BB.merge(Geometry.GetPolygon(j).GetBBox());
 	}
 
-	for(unsigned int i=0;i<refs.size();i++)
+	const GDSRectRangeArray& ranges = Geometry.GetRectRanges();
+	for(unsigned int i=0; i<ranges.size(); i++)
 	{
-		t = refs[i]->object->GetTotalBoundary();
-		t.transform(refs[i]->mat);
-		BB.merge(t);
+		GDSBox box;
+
+		if(!ranges[i].Layer->Show)
+			continue;
+
+		for(unsigned int j=ranges[i].FirstRect; j<ranges[i].FirstRect+ranges[i].NumRects; j++)
+			box.merge(Geometry.GetRectBox(j));
+		if(!box.isEmpty())
+			BB.merge(box.toBB(Geometry.GetUnits()));
 	}
 
+	for(unsigned int i=0;i<refs.size();i++)
+		BB.merge(refs[i]->Bounds(refs[i]->object->GetTotalBoundary()));
+
 	boundary = BB;
 	hasBoundary = true;
 	return BB;
@@ -389,7 +516,7 @@ GDSBB GDSObject::GetTotalBoundary()
 
 void GDSObject::AddPath(int PathType, float Height, float Thickness, int Points, float Width, float BgnExtn, float EndExtn, struct ProcessLayer *layer)
 {
-	PathItems.push_back(new class GDSPath(PathType, Height, Thickness, Points, Width, BgnExtn, EndExtn, layer));
+	PathItems.push_back(new (Arena) GDSPath(PathType, Height, Thickness, Points, Width, BgnExtn, EndExtn, layer, &Arena));
 
     PointCount += Points*4;
 }
@@ -404,11 +531,28 @@ class GDSPath *GDSObject::GetCurrentPath()
 
 
 
+void GDSObject::MakeStub(const vector<GDSObject*>& children)
+{
+	stub = true;
+	for(unsigned int i=0;i<children.size();i++)
+	{
+		AddSRef(children[i]->GetNameID(), 0, 0, 0, 1.0f);
+		SRefItems.back()->object = children[i];
+	}
+}
+
+void GDSObject::ClearStub()
+{
+	SRefItems.clear(); // Left in the arena until the object goes
+	stub = false;
+}
+
 void GDSObject::ConnectReferences(class GDSObjectList *Objects)
 {
 	GDSMat M;
-	float dx1, dx2, dy1, dy2;
-	int i,j;
+	double units = GetUnits();
+
+	Objects->InvalidateGraph();
 
     //Find SRef objects
 	for(unsigned int k=0;k<SRefItems.size();k++)
@@ -425,8 +569,16 @@ void GDSObject::ConnectReferences(class GDSObjectList *Objects)
 		}
 
 		// Decode 2D transformation matrix
-		GDSRef *newRef = new GDSRef;
+		GDSRef *newRef = new (Arena) GDSRef;
 		newRef->object = sref->object;
+		newRef->Columns = newRef->Rows = 1;
+		newRef->ColumnX = newRef->ColumnY = newRef->RowX = newRef->RowY = 0.0;
+		newRef->X = sref->X;
+		newRef->Y = sref->Y;
+		newRef->Mag = sref->Mag;
+		newRef->Units = GetUnits();
+		newRef->SRef = sref;
+		newRef->ARef = NULL;
 
 		newRef->mat.loadIdentity();
 		if(sref->Mag!=1.0)
@@ -434,7 +586,7 @@ void GDSObject::ConnectReferences(class GDSObjectList *Objects)
 			M.setScaling(sref->Mag, sref->Mag);
 			newRef->mat = newRef->mat * M;
 		}
-		M.setTranslation(sref->X, sref->Y);
+		M.setTranslation((float)(units*sref->X), (float)(units*sref->Y));
 		newRef->mat = newRef->mat * M;
 		if(sref->Rotate.Y)
 		{
@@ -449,6 +601,7 @@ void GDSObject::ConnectReferences(class GDSObjectList *Objects)
 		
 		// Round matrix to avoid small errors
 		newRef->mat.Round();
+		newRef->UpdateTransform();
 
 		// Add
 		refs.push_back(newRef);
@@ -468,47 +621,72 @@ void GDSObject::ConnectReferences(class GDSObjectList *Objects)
 			continue;
 		}
 
-		dx1 = (float)(aref->X2 - aref->X1) / (float)aref->Columns;
-		dy1 = (float)(aref->Y2 - aref->Y1) / (float)aref->Columns;
-		dx2 = (float)(aref->X3 - aref->X1) / (float)aref->Rows;
-		dy2 = (float)(aref->Y3 - aref->Y1) / (float)aref->Rows;
+		if(aref->Columns <= 0 || aref->Rows <= 0)
+			continue;
+
+		// One lattice, the matrix is that of element (0, 0), see GDSRef::Element()
+		GDSRef *newRef = new (Arena) GDSRef;
+		newRef->object = aref->object;
+		newRef->Columns = aref->Columns;
+		newRef->Rows = aref->Rows;
+		newRef->ColumnX = (double)(aref->X2 - aref->X1) / aref->Columns;
+		newRef->ColumnY = (double)(aref->Y2 - aref->Y1) / aref->Columns;
+		newRef->RowX = (double)(aref->X3 - aref->X1) / aref->Rows;
+		newRef->RowY = (double)(aref->Y3 - aref->Y1) / aref->Rows;
+		newRef->X = aref->X1;
+		newRef->Y = aref->Y1;
+		newRef->Mag = aref->Mag;
+		newRef->Units = GetUnits();
+		newRef->SRef = NULL;
+		newRef->ARef = aref;
 
-		for(i=0; i<aref->Rows; i++)
+		// Build transformation matrix      
+		newRef->mat.loadIdentity();
+		if(aref->Mag!=1.0)
 		{
-			for(j=0; j<aref->Columns; j++)
-			{
-				// Decode 2D transformation matrix
-				GDSRef *newRef = new GDSRef;
-				newRef->object = aref->object;
+			M.setScaling(aref->Mag, aref->Mag);
+			newRef->mat = newRef->mat * M;
+		}
+		M.setTranslation((float)(units*aref->X1), (float)(units*aref->Y1));
+		newRef->mat = newRef->mat * M;
+		if(aref->Rotate.Y)
+		{
+			M.setRotation(-aref->Rotate.Y);
+			newRef->mat = newRef->mat * M;
+		}
+		if(aref->Flipped)
+		{
+			M.setScaling(1.0f, -1.0f);
+			newRef->mat = newRef->mat * M;
+		}
+		
+		// Round matrix to avoid small errors
+		newRef->mat.Round();
+		newRef->UpdateTransform();
 
-				// Build transformation matrix      
-				newRef->mat.loadIdentity();
-				if(aref->Mag!=1.0)
-				{
-					M.setScaling(aref->Mag, aref->Mag);
-					newRef->mat = newRef->mat * M;
-				}
-				M.setTranslation(aref->X1+dx1*(float)j+dx2*(float)i, aref->Y1+dy2*(float)i+dy1*(float)j);
-				newRef->mat = newRef->mat * M;
-				if(aref->Rotate.Y)
-				{
-					M.setRotation(-aref->Rotate.Y);
-					newRef->mat = newRef->mat * M;
-				}
-				if(aref->Flipped)
-				{
-					M.setScaling(1.0f, -1.0f);
-					newRef->mat = newRef->mat * M;
-				}
-				
-				// Round matrix to avoid small errors
-				newRef->mat.Round();
+		// Add
+		refs.push_back(newRef);
+	}
 
-				// Add
-				refs.push_back(newRef);
-			}
-		}
+	Arena.Trim();
+}
+
+// The translation of mat is Mag times the origin, see ConnectReferences().
+// Exact only where that and every step are whole database units.
+void GDSRef::UpdateTransform()
+{
+	double x = (double)Mag*X, y = (double)Mag*Y;
+
+	Exact = Transform.setOrientation(mat) && Transform.Mag == Mag
+		&& fabs(x) < INT32_MAX && fabs(y) < INT32_MAX
+		&& ColumnX == floor(ColumnX) && ColumnY == floor(ColumnY) && RowX == floor(RowX) && RowY == floor(RowY);
+	if(!Exact)
+	{
+		Transform = GDSTransform();
+		return;
 	}
+	Transform.X = (int32_t)x;
+	Transform.Y = (int32_t)y;
 }
 
 unsigned int GDSObject::GetNumSRefs()
@@ -542,7 +720,7 @@ void GDSObject::printHierarchy(int depth)
 {
     for(int i=0;i<depth;i++)
         v_printf(2, "  ");
-    v_printf(2, "%s, %d total points\n", Name, AccumPointCount);
+    v_printf(2, "%s, %lld total points\n", Name, Stats.Points);
     
     if(noHierarchy)
         return;
@@ -562,153 +740,311 @@ void GDSObject::printHierarchy(int depth)
     }    
 }
 
-int GDSObject::countTotalPoints()
+// PCell variants end in a number after two or three underscores, like
+// __1018272 or ___1018272. Only the last run of underscores counts, a longer
+// run is split from the left, so "_____12" is "__" "__" "_12".
+static bool gds_pcell_name(const char *Name)
 {
-    AccumPointCount = PointCount;
-    char * dummy2 = NULL;
-    char *dummy3 = NULL;
-    
-    // PCell detection, try to find something like __1018272
-    dummy2 = strstr(Name, "__");
-    if(dummy2)
-    {
-        dummy2+=2;
-        dummy3 = dummy2;
-        while(dummy2)
-        {   
-            dummy2 = strstr(dummy2, "__");
-            if(dummy2)
-            {
-                dummy2 += 2;
-                dummy3 = dummy2;
-            }
-        }
-    }
-    if(dummy3)
-    {
-        if(atoi(dummy3)) 
-            PCell = true;
-    }
-    // PCell detection, try to find something like ___1018272
-    dummy2 = strstr(Name, "___");
-    if(dummy2)
-    {
-        dummy2+=3;
-        dummy3 = dummy2;
-        while(dummy2)
-        {   
-            dummy2 = strstr(dummy2, "___");
-            if(dummy2)
-            {
-                dummy2 += 3;
-                dummy3 = dummy2;
-            }
-        }
-    }
-    if(dummy3)
-    {
-        if(atoi(dummy3)) 
-            PCell = true;
-    }
-    
-	/*
-    // Count SRefs
-   for(unsigned int i=0;i<SRefItems.size();i++)
+	const char *two = NULL, *three = NULL;
+	const char *c = Name;
+
+	while(*c)
 	{
-            GDSObject* obj = SRefItems[i]->object;
-            if(obj  && !SRefItems[i]->collapsed && !noHierarchy)
-                AccumPointCount += obj->countTotalPoints();            
-    }
-    
-    // Count ARefs
-   for(unsigned int i=0;i<ARefItems.size();i++)
+		if(*c != '_')
+		{
+			c++;
+			continue;
+		}
+
+		const char *run = c;
+		while(*c == '_')
+			c++;
+		size_t n = c - run;
+		if(n >= 2)
+			two = c - n%2;
+		if(n >= 3)
+			three = c - n%3;
+	}
+	return (two && atoi(two)) || (three && atoi(three));
+}
+
+static void gds_merge_layer(vector<GDSLayerBB>& Layers, unordered_map<struct ProcessLayer*, unsigned int>& Index, struct ProcessLayer *Layer, const GDSBB& BB)
+{
+	unordered_map<struct ProcessLayer*, unsigned int>::iterator i = Index.find(Layer);
+
+	if(i != Index.end())
 	{
-            GDSObject* obj = ARefItems[i]->object;
-            if(obj && !ARefItems[i]->collapsed && !noHierarchy)
-                AccumPointCount += obj->countTotalPoints();          
-    }*/
-	for(unsigned int i=0;i<refs.size();i++)
-		AccumPointCount += refs[i]->object->countTotalPoints();
-    
-    return AccumPointCount;
+		Layers[i->second].BB.merge(BB);
+		return;
+	}
+	Index[Layer] = Layers.size();
+	GDSLayerBB l;
+	l.Layer = Layer;
+	l.BB = BB;
+	Layers.push_back(l);
 }
 
-void GDSObject::collapseHierachy()
+void GDSObject::UpdateStatistics()
 {
-    // Traverse hierarchy
-	//v_printf(1, ".");
-    for(unsigned int i=0;i<SRefItems.size();i++)
+	unordered_map<struct ProcessLayer*, unsigned int> index;
+
+	Stats.Points = PointCount;
+	Stats.Polygons = Geometry.GetNumPolygons() + Geometry.GetNumRects();
+	Stats.Triangles = Geometry.GetNumTriangles();
+	Stats.Instances = 0;
+	Stats.Layers.clear();
+
+	const GDSLayerArray& layers = Geometry.GetLayers();
+	for(unsigned int i=0; i<layers.size(); i++)
 	{
-		if(!SRefItems[i]->object->collapsed)
-            SRefItems[i]->object->collapseHierachy();
+		GDSBB BB;
+		for(unsigned int j=layers[i].FirstPolygon; j<layers[i].FirstPolygon+layers[i].NumPolygons; j++)
+			BB.merge(Geometry.GetPolygon(j).GetBBox());
+		gds_merge_layer(Stats.Layers, index, layers[i].Layer, BB);
 	}
-	for(unsigned int i=0;i<ARefItems.size();i++)
+
+	const GDSRectRangeArray& ranges = Geometry.GetRectRanges();
+	for(unsigned int i=0; i<ranges.size(); i++)
 	{
-		if(!ARefItems[i]->object->collapsed)
-            ARefItems[i]->object->collapseHierachy();
+		GDSBox box;
+		for(unsigned int j=ranges[i].FirstRect; j<ranges[i].FirstRect+ranges[i].NumRects; j++)
+			box.merge(Geometry.GetRectBox(j));
+		if(!box.isEmpty())
+			gds_merge_layer(Stats.Layers, index, ranges[i].Layer, box.toBB(Geometry.GetUnits()));
 	}
-  
-    // Collapse total cell?
-    if(AccumPointCount < HIERARCHY_LIMIT)
-        noHierarchy = true;
-    
-	GDSObject *obj;
-	vector<int> remove;
+
+	// Children are done first, see GDSObjectList::UpdateStatistics()
 	for(unsigned int i=0;i<refs.size();i++)
 	{
-		obj = refs[i]->object;
-		if(noHierarchy || obj->AccumPointCount < HIERARCHY_LIMIT/10)
-		{
-			remove.push_back(i);
-			TransformAddObject(obj, refs[i]->mat);
-		}
+		const GDSStatistics& child = refs[i]->object->Stats;
+		long long count = refs[i]->Count();
+
+		Stats.Points += count*child.Points;
+		Stats.Polygons += count*child.Polygons;
+		Stats.Triangles += count*child.Triangles;
+		Stats.Instances += count*(1 + child.Instances);
+		for(unsigned int j=0;j<child.Layers.size();j++)
+			gds_merge_layer(Stats.Layers, index, child.Layers[j].Layer, refs[i]->Bounds(child.Layers[j].BB));
 	}
-	// This really hurts performance
-	if(remove.size() > 0)
+
+	PCell = gds_pcell_name(Name);
+}
+
+void GDSObject::collapseHierachy(const vector<bool>& Absorb)
+{
+    // Children are collapsed first, see GDSObjectList::CollapseHierarchy()
+	uint64_t polygons = 0, points = 0, indices = 0;
+	for(unsigned int i=0;i<refs.size();i++)
 	{
-		for(int i=remove.size()-1;i>=0;i--)
-        {
-            delete refs[remove[i]]; // Remember refs are new
-			refs.erase(refs.begin()+remove[i]);
-        }
+		if(!Absorb[i])
+			continue;
+		GDSGeometry *geometry = refs[i]->object->GetGeometry();
+		polygons += (uint64_t)refs[i]->Count()*geometry->GetNumPolygons();
+		points += (uint64_t)refs[i]->Count()*geometry->GetNumPoints();
+		indices += (uint64_t)refs[i]->Count()*geometry->GetNumIndices();
 	}
+	// Reserve() counts in 32 bits, past that TransformAddObject() grows it per child
+	if(polygons && polygons <= UINT32_MAX && points <= UINT32_MAX && indices <= UINT32_MAX)
+		Geometry.Reserve((unsigned int)polygons, (unsigned int)points, (unsigned int)indices);
 
+	// Kept references move down over the absorbed ones
+	unsigned int kept = 0;
+	for(unsigned int i=0;i<refs.size();i++)
+	{
+		if(!Absorb[i])
+		{
+			refs[kept++] = refs[i];
+			continue;
+		}
+		for(unsigned int r=0;r<refs[i]->Rows;r++)
+			for(unsigned int c=0;c<refs[i]->Columns;c++)
+				TransformAddObject(refs[i]->object, refs[i]->Element(c, r));
+
+		// Flattened into this object, printHierarchy() and rendering skip it
+		if(refs[i]->SRef)
+			refs[i]->SRef->collapsed = true;
+		if(refs[i]->ARef)
+			refs[i]->ARef->collapsed = true;
+	}
+	refs.resize(kept);
+	noHierarchy = refs.empty();
+
+	FinishElements();
 	collapsed = true;
 }
 
 void GDSObject::TransformAddObject(GDSObject *obj, GDSMat mat)
 {
-    GDSPolygon *polygon;
+    GDSPolygon polygon;
     
     // Polygons
-    if(!obj->PolygonItems.empty())
+    if(obj->Geometry.GetNumPolygons())
     {
-		for(unsigned long i=0; i<obj->PolygonItems.size(); i++)
+		Geometry.Reserve(obj->Geometry.GetNumPolygons(), obj->Geometry.GetNumPoints(), obj->Geometry.GetNumIndices());
+		for(unsigned long i=0; i<obj->Geometry.GetNumPolygons(); i++)
         {
 			// Copy the polygon into the object
-            AddPolygon(obj->PolygonItems[i]->GetHeight(), obj->PolygonItems[i]->GetThickness(),obj->PolygonItems[i]->GetPoints(), obj->PolygonItems[i]->GetLayer());
-			polygon = GetCurrentPolygon();
-			obj->PolygonItems[i]->CopyInto(polygon);
+			polygon = AddPolygon(obj->Geometry.GetPolygon(i));
             
 			// Transform polygon
-            polygon->transformPoints(mat);            
+            polygon.transformPoints(mat);            
             
             // Flipped by transformation?
             if(mat.NegativeTrace())
-                polygon->Flip();
+                polygon.Flip();
         }
     }
+
+	// Rectangles stay rectangles when turned by multiples of 90 degrees,
+	// any other angle makes them polygons
+	if(obj->Geometry.GetNumRects())
+	{
+		const GDSRectRangeArray& ranges = obj->Geometry.GetRectRanges();
+		GDSBox box;
+
+		if(!mat.isManhattan())
+			Geometry.Reserve(obj->Geometry.GetNumRects(), obj->Geometry.GetNumRects()*4, obj->Geometry.GetNumRects()*6);
+		for(unsigned int i=0; i<ranges.size(); i++)
+		{
+			for(unsigned int j=ranges[i].FirstRect; j<ranges[i].FirstRect+ranges[i].NumRects; j++)
+			{
+				if(mat.isManhattan())
+				{
+					box = obj->Geometry.GetRectBox(j);
+					box.transform(mat, Geometry.GetUnits());
+					AddRect(ranges[i].Height, ranges[i].Thickness, box, ranges[i].Layer);
+				}
+				else
+				{
+					polygon = AddPolygon(obj->Geometry.GetRect(j));
+					polygon.transformPoints(mat);
+					if(mat.NegativeTrace())
+						polygon.Flip();
+				}
+			}
+		}
+	}
+}
+
+template <class T>
+static void gds_form(vector<byte>& Form, const T& Value)
+{
+	const byte *b = (const byte *)&Value;
+	Form.insert(Form.end(), b, b + sizeof(T));
+}
+
+static void gds_form(vector<byte>& Form, const void *Data, size_t Length)
+{
+	const byte *b = (const byte *)Data;
+	Form.insert(Form.end(), b, b + Length);
+}
+
+// Field by field, records have padding. Stubs are not parsed yet and are
+// only the same as themselves.
+void GDSObject::GetCanonicalForm(vector<byte>& Form, const unordered_map<GDSObject*, unsigned int>& Ids)
+{
+	Form.clear();
+	gds_form(Form, stub ? this : NULL);
+	gds_form(Form, collapsed);
+	gds_form(Form, Geometry.GetUnits());
+
+	gds_form(Form, Geometry.GetNumPolygons());
+	for(unsigned int i=0;i<Geometry.GetNumPolygons();i++)
+	{
+		GDSPolygon polygon = Geometry.GetPolygon(i);
+		unsigned int n = polygon.GetPoints();
+
+		gds_form(Form, polygon.GetLayer());
+		gds_form(Form, polygon.GetHeight());
+		gds_form(Form, polygon.GetThickness());
+		gds_form(Form, n);
+		gds_form(Form, polygon.GetX(), n*sizeof(int32_t));
+		gds_form(Form, polygon.GetY(), n*sizeof(int32_t));
+	}
+
+	const GDSRectRangeArray& ranges = Geometry.GetRectRanges();
+	gds_form(Form, (unsigned int)ranges.size());
+	for(unsigned int i=0;i<ranges.size();i++)
+	{
+		gds_form(Form, ranges[i].Layer);
+		gds_form(Form, ranges[i].Height);
+		gds_form(Form, ranges[i].Thickness);
+		gds_form(Form, ranges[i].NumRects);
+		if(ranges[i].NumRects)
+			gds_form(Form, &Geometry.GetRectBox(ranges[i].FirstRect), ranges[i].NumRects*sizeof(GDSBox));
+	}
+
+	gds_form(Form, (unsigned int)PathItems.size());
+	for(unsigned int i=0;i<PathItems.size();i++)
+		gds_form(Form, PathItems[i]->GetLayer());
+
+	gds_form(Form, (unsigned int)TextItems.size());
+	for(unsigned int i=0;i<TextItems.size();i++)
+	{
+		GDSText *text = TextItems[i];
+
+		gds_form(Form, text->GetX());
+		gds_form(Form, text->GetY());
+		gds_form(Form, text->GetZ());
+		gds_form(Form, text->GetRY());
+		gds_form(Form, text->GetMag());
+		gds_form(Form, text->GetVJust());
+		gds_form(Form, text->GetHJust());
+		gds_form(Form, text->GetFlipped());
+		gds_form(Form, text->GetLayer());
+		if(text->GetString())
+			gds_form(Form, text->GetString(), strlen(text->GetString())+1);
+	}
+
+	gds_form(Form, (unsigned int)refs.size());
+	for(unsigned int i=0;i<refs.size();i++)
+	{
+		unordered_map<GDSObject*, unsigned int>::const_iterator id = Ids.find(refs[i]->object);
+
+		gds_form(Form, id != Ids.end() ? id->second : 0xffffffffu);
+		for(unsigned int j=0;j<6;j++)
+			gds_form(Form, refs[i]->mat[j]);
+		gds_form(Form, refs[i]->Columns);
+		gds_form(Form, refs[i]->Rows);
+		if(refs[i]->Count() > 1)
+		{
+			gds_form(Form, refs[i]->ColumnX);
+			gds_form(Form, refs[i]->ColumnY);
+			gds_form(Form, refs[i]->RowX);
+			gds_form(Form, refs[i]->RowY);
+			gds_form(Form, refs[i]->X);
+			gds_form(Form, refs[i]->Y);
+			gds_form(Form, refs[i]->Mag);
+			gds_form(Form, refs[i]->Units);
+		}
+	}
+}
+
+void GDSObject::ReplaceReferences(const unordered_map<GDSObject*, GDSObject*>& Merged)
+{
+	unordered_map<GDSObject*, GDSObject*>::const_iterator m;
+
+	for(unsigned int i=0;i<refs.size();i++)
+		if((m = Merged.find(refs[i]->object)) != Merged.end())
+			refs[i]->object = m->second;
+	for(unsigned int i=0;i<SRefItems.size();i++)
+		if((m = Merged.find(SRefItems[i]->object)) != Merged.end())
+			SRefItems[i]->object = m->second;
+	for(unsigned int i=0;i<ARefItems.size();i++)
+		if((m = Merged.find(ARefItems[i]->object)) != Merged.end())
+			ARefItems[i]->object = m->second;
+	hasBoundary = false;
 }
 
 bool 
-GDSObject::referencesToObject(char *name)
+GDSObject::referencesToObject(unsigned int name)
 {
     //SRefs
    for(unsigned int i=0;i<SRefItems.size();i++)
 	{
         SRefElement *sref = SRefItems[i];        
 		
-            if(!strcmp(sref->object->GetName(), name))
+            if(sref->object->GetNameID() == name)
                return true;           
 	}
     
@@ -718,7 +1054,7 @@ GDSObject::referencesToObject(char *name)
 		ARefElement *aref = ARefItems[i];
         
 	
-            if(!strcmp(aref->object->GetName(), name))
+            if(aref->object->GetNameID() == name)
                 return true;          
 	}
     
@@ -32,19 +32,123 @@
 #include "gds_globals.h"
 #include "process_cfg.h"
 #include "gdselements.h"
+#include "gdsnames.h"
+#include "gdsarena.h"
 #include "gdspath.h"
 #include "gdstext.h"
 #include "gdspolygon.h"
 
+// A placement of object, or an array of Columns x Rows of them. The
+// elements are not stored, Element() makes the matrix of one when needed.
 typedef struct GDSRef
 {
 	GDSObject	*object;
-	GDSMat		mat;
+	GDSMat		mat; // Of element (0, 0)
+	uint32_t	Columns;
+	uint32_t	Rows;
+	double		ColumnX, ColumnY; // Steps between columns and rows, in database units
+	double		RowX, RowY;
+	int32_t		X, Y; // Origin, in database units
+	float		Mag;
+	float		Units; // Of the placing object
+	SRefElement	*SRef; // The element it was made from, the other is NULL
+	ARefElement	*ARef;
+	bool		Exact; // Transform is mat in database units, and the steps are whole
+	GDSTransform Transform;
+
+	unsigned int Count() const {return Columns*Rows;};
+	void UpdateTransform(); // After mat and the lattice are set
+	GDSMat Element(unsigned int Column, unsigned int Row) const;
+	GDSTransform ElementTransform(unsigned int Column, unsigned int Row) const; // If Exact
+	GDSBB Bounds(const GDSBB& BB, unsigned int C0, unsigned int C1, unsigned int R0, unsigned int R1) const; // Of BB placed by the elements in [C0, C1) x [R0, R1)
+	GDSBB Bounds(const GDSBB& BB) const {return Bounds(BB, 0, Columns, 0, Rows);};
 }GDSRef;
 
+// Same arithmetic as element (0, 0) in GDSObject::ConnectReferences(), the
+// translation in float, scaled and rounded, so elements land where they did
+// when arrays were expanded
+inline GDSMat GDSRef::Element(unsigned int Column, unsigned int Row) const
+{
+	if(!Column && !Row)
+		return mat;
+
+	double units = Units;
+	float x = (float)(units*(X + ColumnX*Column + RowX*Row));
+	float y = (float)(units*(Y + RowY*Row + ColumnY*Column));
+	GDSMat M(mat[0], mat[1], mat[2], mat[3], Mag*x, Mag*y);
+	M.Round();
+	return M;
+}
+
+// Element() without the float translation
+inline GDSTransform GDSRef::ElementTransform(unsigned int Column, unsigned int Row) const
+{
+	GDSTransform T = Transform;
+	T.X += (int32_t)(T.Mag*(int64_t)(ColumnX*Column + RowX*Row));
+	T.Y += (int32_t)(T.Mag*(int64_t)(RowY*Row + ColumnY*Column));
+	return T;
+}
+
+// Elements are placed on a lattice, the corners bound the others
+inline GDSBB GDSRef::Bounds(const GDSBB& BB, unsigned int C0, unsigned int C1, unsigned int R0, unsigned int R1) const
+{
+	GDSBB result, t;
+	unsigned int c[2] = {C0, C1-1};
+	unsigned int r[2] = {R0, R1-1};
+
+	for(unsigned int i=0;i<4;i++)
+	{
+		if((i&1 && c[1] == c[0]) || (i&2 && r[1] == r[0]))
+			continue;
+		t = BB;
+		t.transform(Element(c[i&1], r[i>>1]));
+		result.merge(t);
+	}
+	return result;
+}
+
+// Bounding box of one layer, in user units
+typedef struct GDSLayerBB
+{
+	struct ProcessLayer	*Layer;
+	GDSBB				BB;
+}GDSLayerBB;
+
+// An object with everything it places, as if flattened
+typedef struct GDSStatistics
+{
+	long long	Points; // Can exceed 32 bits in deep arrays
+	long long	Polygons; // Rectangles included
+	long long	Triangles; // See GDSGeometry::GetNumTriangles()
+	long long	Instances; // Placed objects below, not flattened into their parents
+	vector<GDSLayerBB> Layers;
+}GDSStatistics;
+
+// Objects with more points than this are built in chunks of about as many
+#define GDS_BUILD_CHUNK_POINTS	(1<<16)
+
+// A range of the polygons or of the paths of one object, built on any
+// thread into a geometry of its own, see GDSObject::SplitElements()
+typedef struct GDSBuildChunk
+{
+	bool		Paths; // Range of PathItems, otherwise of polygons
+	unsigned int	First;
+	unsigned int	Last;
+	unsigned int	Points;
+	GDSGeometry	Geometry;
+}GDSBuildChunk;
+
 class GDSObject
 {
+	friend class GDSCache;
+
 protected:
+	// Owns every element below, they are destroyed by hand and their
+	// memory goes with the arena
+	GDSArena Arena;
+
+	GDSGeometry Geometry; // All polygons
+
 	// Temporary data for parsing	
 	vector<GDSPath*> PathItems;
 	vector<GDSText*> TextItems;
@@ -52,20 +156,23 @@ protected:
 	vector<ARefElement*> ARefItems;	
 	
     int PointCount;
-    int AccumPointCount;
+	unsigned int ExpandedPaths; // PathItems already in Geometry
+	GDSStatistics Stats;
     bool noHierarchy;
 
 	bool hasBoundary;
 	GDSBB boundary;
 
-	char *Name;
-	bool PCell; // After PCell detection
+	unsigned int NameID;
+	const char *Name; // Owned by the name table
+	bool PCell; // After UpdateStatistics()
 	bool collapsed;
 
+	unsigned long long ContentHash; // Hash of the structure records, 0 if unknown
+	bool stub; // Not parsed yet, SRefItems only name the referenced objects
+
 public:
-	// Please move to private...
-	vector<GDSPolygon*> PolygonItems; 	
-	vector<GDSRef*> refs; // Use these references for rendering
+	vector<GDSRef*> refs; // Use these references for rendering, arrays are one each
 
 	GDSObject(char *Name);
 	virtual ~GDSObject();
@@ -74,31 +181,63 @@ public:
 	void AddText(float newX, float newY, float newZ, bool newFlipped, float newMag, int newVJust, int newHJust, struct ProcessLayer *newlayer);
 	class GDSText *GetCurrentText();
 	void AddPolygon(float Height, float Thickness, int Points, struct ProcessLayer *layer);
-	class GDSPolygon *GetCurrentPolygon();
-	void AddSRef(char *Name, float X, float Y, int Flipped, float Mag);
+	GDSPolygon AddPolygon(const GDSPolygon& polygon); // Copy
+	GDSPolygon GetCurrentPolygon(); // Not valid if there are none
+	void AddRect(float Height, float Thickness, const GDSBox& box, struct ProcessLayer *layer);
+	void AddSRef(unsigned int Name, int32_t X, int32_t Y, int Flipped, float Mag);
 	void SetSRefRotation(float X, float Y, float Z);
-	void AddARef(char *Name, float X1, float Y1, float X2, float Y2, float X3, float Y3, int Columns, int Rows, int Flipped, float Mag);
+	void AddARef(unsigned int Name, int32_t X1, int32_t Y1, int32_t X2, int32_t Y2, int32_t X3, int32_t Y3, int Columns, int Rows, int Flipped, float Mag);
 	void SetARefRotation(float X, float Y, float Z);
 	void AddPath(int PathType, float Height, float Thickness, int Points, float Width, float BgnExtn, float EndExtn, struct ProcessLayer *layer);
 	class GDSPath *GetCurrentPath();
 
 	void ConnectReferences(class GDSObjectList *Objects);
+	void MakeStub(const vector<GDSObject*>& children);
+	void ClearStub();
+	bool isStub() {return stub;};
+	bool isCollapsed() {return collapsed;};
+	void FinishElements(); // Done adding elements for now
+	void BuildElements(); // Expand paths and tesselate, then FinishElements()
+	void SplitElements(vector<GDSBuildChunk>& Chunks); // Work of BuildElements() in chunks, none if small
+	void BuildChunk(GDSBuildChunk& Chunk);
+	void AppendChunks(vector<GDSBuildChunk>& Chunks); // In order, then FinishElements()
 	void TransformAddObject(GDSObject *obj, GDSMat mat);
 
+	// Everything that is drawn of the object as bytes, children by their
+	// index in Ids. Objects with the same form look the same.
+	void GetCanonicalForm(vector<byte>& Form, const unordered_map<GDSObject*, unsigned int>& Ids);
+	void ReplaceReferences(const unordered_map<GDSObject*, GDSObject*>& Merged); // Point references to merged objects at the one kept
+
 	// Get stuff
-	char *GetName();    
-	bool referencesToObject(char *name);
+	const char *GetName();
+	unsigned int GetNameID() {return NameID;};
+	unsigned long long GetContentHash() {return ContentHash;};
+	void SetContentHash(unsigned long long hash) {ContentHash = hash;};
+	bool referencesToObject(unsigned int name);
+	unsigned int GetNumPolygons() {return Geometry.GetNumPolygons();};
+	GDSPolygon GetPolygon(unsigned int index) {return Geometry.GetPolygon(index);};
+	unsigned int GetNumRects() {return Geometry.GetNumRects();};
+	GDSPolygon GetRect(unsigned int index) {return Geometry.GetRect(index);};
+	GDSGeometry *GetGeometry() {return &Geometry;};
+	void SetUnits(float Units) {Geometry.SetUnits(Units);}; // User units per database unit
+	float GetUnits() {return Geometry.GetUnits();};
 	GDSBB GetTotalBoundary();
 	bool isPCell();
+	int GetPointCount() {return PointCount;}; // Own points, an estimate of the work to build it
 	unsigned int GetNumSRefs();
 	SRefElement* GetSRef(unsigned int index);
 	unsigned int GetNumARefs();
 	ARefElement* GetARef(unsigned int index);
     
-    // Flatten lower part of hierarchy
+	// Statistics and PCell detection, valid after the statistics of the
+	// children, GDSObjectList::UpdateStatistics() does the whole tree
+	void UpdateStatistics();
+	const GDSStatistics& GetStatistics() {return Stats;};
+
+    // Flatten lower part of hierarchy, one object at a time after its
+    // children, GDSObjectList::CollapseHierarchy() does the whole tree
     void printHierarchy(int);
-    int countTotalPoints();
-    void collapseHierachy();   
+    void collapseHierachy(const vector<bool>& Absorb); // Flatten refs[i] where Absorb[i]
 };
 
 #endif // __GDSOBJECT_H__
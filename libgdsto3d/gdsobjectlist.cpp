@@ -22,25 +22,193 @@
 #include "gdsobjectlist.h"
 
 // ObjectTree Class
-ObjectTree::ObjectTree(GDSObject *object, const GDSMat& mat)
+ObjectTree::ObjectTree(GDSObject *object, GDSObjectList *Objects)
 {
+	Entry entry;
+
 	this->object = object;
-	this->mat = mat;
 
-	// Go through all ARefs and SRefs
+	entries.reserve(object->GetNumPolygons() + object->GetNumRects() + object->refs.size());
+	for(unsigned int i=0;i<object->GetNumPolygons();i++)
+	{
+		entry.bbox = object->GetPolygon(i).GetBBox();
+		entry.index = i;
+		entries.push_back(entry);
+	}
+	for(unsigned int i=0;i<object->GetNumRects();i++)
+	{
+		entry.bbox = object->GetRect(i).GetBBox();
+		entry.index = i | GDS_RECT_VIEW;
+		entries.push_back(entry);
+	}
+
+	// A whole array is one entry, bounded by its corner elements
+	for(unsigned int i=0;i<object->refs.size();i++)
+	{
+		ObjectTree *child = Objects->GetObjectTree(object->refs[i]->object);
+		if(!child)
+			continue;
+		GDSBB bb = child->GetBBox();
+		if(bb.isEmpty())
+			continue;
+		entry.bbox = object->refs[i]->Bounds(bb);
+		entry.index = i | GDS_TREE_REF;
+		entries.push_back(entry);
+	}
+
+	if(!entries.empty())
+	{
+		nodes.reserve(2*entries.size()/GDS_TREE_LEAF + 1);
+		build(0, (uint32_t)entries.size());
+	}
+}
+
+// Median split on the longer side of the bounding box
+uint32_t ObjectTree::build(uint32_t first, uint32_t count)
+{
+	Node node;
+	uint32_t index = (uint32_t)nodes.size();
+
+	for(uint32_t i=first;i<first+count;i++)
+		node.bbox.merge(entries[i].bbox);
+	node.first = first;
+	node.count = count;
+	nodes.push_back(node);
+	if(count <= GDS_TREE_LEAF)
+		return index;
+
+	bool X = node.bbox.max.X - node.bbox.min.X >= node.bbox.max.Y - node.bbox.min.Y;
+	uint32_t half = count/2;
+	nth_element(entries.begin()+first, entries.begin()+first+half, entries.begin()+first+count,
+		[X](const Entry& A, const Entry& B) {
+			return X ? A.bbox.min.X + A.bbox.max.X < B.bbox.min.X + B.bbox.max.X : A.bbox.min.Y + A.bbox.max.Y < B.bbox.min.Y + B.bbox.max.Y;
+		});
+
+	build(first, half); // At index+1
+	uint32_t second = build(first+half, count-half);
+	nodes[index].first = second;
+	nodes[index].count = 0;
+	return index;
+}
+
+GDSBB ObjectTree::GetBBox() const
+{
+	if(nodes.empty())
+		return GDSBB();
+	return nodes[0].bbox;
 }
 
-ObjectTree::~ObjectTree()
+// Window is in the coordinates Mat maps this object to, the tree is walked
+// with it taken into object space. The polygons go first, then the
+// references, so the hits of one instance stay together.
+void ObjectTree::Query(GDSObjectList *Objects, const GDSBB& Window, const GDSMat& Mat, const GDSTransform *Transform, const set<ProcessLayer*>& Layers, vector<GDSInstance>& Path, vector<GDSHit>& Hits)
 {
-	for(unsigned int i=0;i<leaves.size();i++)
-		delete leaves[i];
-	leaves.clear();
+	vector<uint32_t> stack, refs;
+	GDSBB Local = Window;
+
+	if(nodes.empty())
+		return;
+	Local.transform(Mat.Inverse());
+
+	stack.push_back(0);
+	while(!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		uint32_t n = stack.back();
+		stack.pop_back();
+		if(!GDSBB::intersect(node.bbox, Local))
+			continue;
+
+		if(!node.count)
+		{
+			stack.push_back(node.first);
+			stack.push_back(n+1);
+			continue;
+		}
+
+		for(uint32_t i=node.first;i<node.first+node.count;i++)
+		{
+			const Entry& entry = entries[i];
+			if(!GDSBB::intersect(entry.bbox, Local))
+				continue;
+			if(entry.index & GDS_TREE_REF)
+			{
+				refs.push_back(entry.index & ~GDS_TREE_REF);
+				continue;
+			}
+
+			GDSPolygon polygon(object->GetGeometry(), entry.index);
+			if(!Layers.empty() && !Layers.count(polygon.GetLayer()))
+				continue;
+
+			// The same test in the coordinates of the window
+			GDSBB bb = entry.bbox;
+			bb.transform(Mat);
+			if(!GDSBB::intersect(bb, Window))
+				continue;
+
+			Hits.push_back(GDSHit());
+			Hits.back().Path = Path;
+			Hits.back().Object = object;
+			Hits.back().Mat = Mat;
+			Hits.back().Exact = Transform != NULL;
+			if(Transform)
+				Hits.back().Transform = *Transform;
+			Hits.back().Polygon = polygon;
+		}
+	}
+
+	sort(refs.begin(), refs.end());
+	for(unsigned int i=0;i<refs.size();i++)
+	{
+		const GDSRef *ref = object->refs[refs[i]];
+		ObjectTree *child = Objects->GetObjectTree(ref->object);
+		queryRef(Objects, ref, child->GetBBox(), Local, 0, ref->Columns, 0, ref->Rows, Window, Mat, Transform, Layers, Path, Hits);
+	}
+}
+
+// Bisect the elements [C0, C1) x [R0, R1) of an array down to the ones
+// that overlap Local, BB bounds the placed object
+void ObjectTree::queryRef(GDSObjectList *Objects, const GDSRef *ref, const GDSBB& BB, const GDSBB& Local, uint32_t C0, uint32_t C1, uint32_t R0, uint32_t R1, const GDSBB& Window, const GDSMat& Mat, const GDSTransform *Transform, const set<ProcessLayer*>& Layers, vector<GDSInstance>& Path, vector<GDSHit>& Hits)
+{
+	if(!GDSBB::intersect(ref->Bounds(BB, C0, C1, R0, R1), Local))
+		return;
+
+	if(C1-C0 > 1 || R1-R0 > 1)
+	{
+		if(C1-C0 >= R1-R0)
+		{
+			uint32_t C = C0 + (C1-C0)/2;
+			queryRef(Objects, ref, BB, Local, C0, C, R0, R1, Window, Mat, Transform, Layers, Path, Hits);
+			queryRef(Objects, ref, BB, Local, C, C1, R0, R1, Window, Mat, Transform, Layers, Path, Hits);
+		}
+		else
+		{
+			uint32_t R = R0 + (R1-R0)/2;
+			queryRef(Objects, ref, BB, Local, C0, C1, R0, R, Window, Mat, Transform, Layers, Path, Hits);
+			queryRef(Objects, ref, BB, Local, C0, C1, R, R1, Window, Mat, Transform, Layers, Path, Hits);
+		}
+		return;
+	}
+
+	// The exact transform goes on while every step has one in the same units
+	GDSInstance instance = {ref, C0, R0};
+	GDSTransform T;
+	bool exact = Transform && ref->Exact && ref->Units == ref->object->GetUnits();
+	if(exact)
+		T = *Transform * ref->ElementTransform(C0, R0);
+
+	Path.push_back(instance);
+	Objects->GetObjectTree(ref->object)->Query(Objects, Window, Mat * ref->Element(C0, R0), exact ? &T : NULL, Layers, Path, Hits);
+	Path.pop_back();
 }
 
 // GDSObjectList Class
 GDSObjectList::GDSObjectList()
 {
-	tree = NULL;
+	graphvalid = false;
+	statsvalid = false;
+	cyclic = false;
 }
 
 GDSObjectList::~GDSObjectList()
@@ -48,56 +216,390 @@ GDSObjectList::~GDSObjectList()
 	for(unsigned int i=0;i<objects.size();i++)
 		delete objects[i];
 
-	if(tree)
-		delete tree;
+	ClearObjectTrees();
 }
 
 GDSObject *GDSObjectList::AddObject(class GDSObject *newobject)
 {
 	objects.push_back(newobject);
+	InvalidateGraph();
+
+	// Like a search through the list, the first object with a name wins
+	unsigned int id = newobject->GetNameID();
+	if(id >= byname.size())
+		byname.resize(id+1, NULL);
+	if(!byname[id])
+		byname[id] = newobject;
 
 	return newobject;
 }
 
+void GDSObjectList::ReleaseObjects()
+{
+	objects.clear();
+	byname.clear();
+	aliases.clear();
+	InvalidateGraph();
+}
+
+// Name finds object from now on, unless an object already has it
+void GDSObjectList::AddAlias(unsigned int Name, GDSObject *object, unsigned long long ContentHash)
+{
+	if(Name >= byname.size())
+		byname.resize(Name+1, NULL);
+	if(byname[Name])
+		return;
+	byname[Name] = object;
+	aliases[Name] = ContentHash;
+}
+
 GDSObject *GDSObjectList::SearchObject(const char *Name)
 {
-	for(unsigned int i=0;i<objects.size();i++)
-	{
-		if(strcmp(Name, objects[i]->GetName())==0)
-			return objects[i];
-	}
+	return SearchObject(gds_find_name(Name));
+}
 
-	return NULL;
+GDSObject *GDSObjectList::SearchObject(unsigned int Name)
+{
+	if(Name >= byname.size())
+		return NULL;
+
+	return byname[Name];
 }
 
 void GDSObjectList::ConnectReferences()
 {
 	for(unsigned int i=0;i<objects.size();i++)
 		objects[i]->ConnectReferences(this);
+
+	BuildGraph();
 }
 
+void GDSObjectList::BuildGraph()
+{
+	unsigned int n = objects.size();
+	vector<unsigned int> seen(n, n);
+
+	indexof.clear();
+	indexof.reserve(n);
+	for(unsigned int i=0;i<n;i++)
+		indexof[objects[i]] = i;
+
+	// One edge per referenced object, however often it is placed
+	children.assign(n, vector<unsigned int>());
+	parents.assign(n, vector<unsigned int>());
+	for(unsigned int i=0;i<n;i++)
+	{
+		GDSObject *obj = objects[i];
+		unsigned int numsrefs = obj->GetNumSRefs();
+		unsigned int numrefs = numsrefs + obj->GetNumARefs();
+
+		for(unsigned int j=0;j<numrefs;j++)
+		{
+			GDSObject *child = j < numsrefs ? obj->GetSRef(j)->object : obj->GetARef(j-numsrefs)->object;
+			unordered_map<GDSObject*, unsigned int>::iterator c = indexof.find(child);
+
+			if(c == indexof.end() || seen[c->second] == i)
+				continue;
+			seen[c->second] = i;
+			children[i].push_back(c->second);
+			parents[c->second].push_back(i);
+		}
+	}
+
+	tops.clear();
+	for(unsigned int i=0;i<n;i++)
+	{
+		if(parents[i].empty()) // Object is not referenced by any other objects
+			tops.push_back(objects[i]);
+	}
+
+	// Depth first from the top cells, an object is done after its children.
+	// Objects that are only reachable through a cycle are visited last.
+	vector<char> state(n, 0); // Not seen, on the stack, done
+	vector<pair<unsigned int, unsigned int> > stack;
+
+	order.clear();
+	cyclic = false;
+	for(unsigned int r=0;r<tops.size()+n;r++)
+	{
+		unsigned int root = r < tops.size() ? indexof[tops[r]] : r - tops.size();
+		if(state[root])
+			continue;
+
+		state[root] = 1;
+		stack.push_back(make_pair(root, 0u));
+		while(!stack.empty())
+		{
+			unsigned int node = stack.back().first;
+
+			if(stack.back().second < children[node].size())
+			{
+				unsigned int child = children[node][stack.back().second++];
+
+				if(state[child] == 0)
+				{
+					state[child] = 1;
+					stack.push_back(make_pair(child, 0u));
+				}
+				else if(state[child] == 1)
+				{
+					v_printf(1, "Structure \"%s\" references itself through \"%s\".\n", objects[child]->GetName(), objects[node]->GetName());
+					cyclic = true;
+				}
+				continue;
+			}
+
+			state[node] = 2;
+			order.push_back(objects[node]);
+			stack.pop_back();
+		}
+	}
+
+	graphvalid = true;
+}
 
 GDSObject *
 GDSObjectList::GetTopObject()
 {
-    // Loop through objects
-    for(unsigned int i=0;i<objects.size();i++)
+	if(GetTopObjects().empty())
+		return NULL;
+	return tops[0];
+}
+
+const vector<GDSObject*>& GDSObjectList::GetTopObjects()
+{
+	if(!graphvalid)
+		BuildGraph();
+	return tops;
+}
+
+const vector<GDSObject*>& GDSObjectList::GetTopologicalOrder()
+{
+	if(!graphvalid)
+		BuildGraph();
+	return order;
+}
+
+bool GDSObjectList::HasCycles()
+{
+	if(!graphvalid)
+		BuildGraph();
+	return cyclic;
+}
+
+void GDSObjectList::CollapseHierarchy(GDSObject *top)
+{
+	if(!graphvalid)
+		BuildGraph();
+	ClearObjectTrees(); // Polygons are added and references go
+
+	unordered_map<GDSObject*, unsigned int>::iterator t = indexof.find(top);
+	if(t == indexof.end())
+		return;
+
+	// Only the hierarchy below top
+	vector<char> below(objects.size(), 0);
+	vector<unsigned int> queue(1, t->second);
+	below[t->second] = 1;
+	while(!queue.empty())
 	{
-        bool found = false;
-        for(unsigned int j=0;j<objects.size();j++)
+		unsigned int node = queue.back();
+		queue.pop_back();
+		for(unsigned int i=0;i<children[node].size();i++)
 		{
-            GDSObject *obj = objects[j];
-            
-            if(obj->referencesToObject(objects[i]->GetName()))
-            {
-                found = true;
-                break;
-            }
-        }
-        if(!found) // Object is not referenced by any other objects
-            return objects[i];
-    }
-    return NULL;
+			if(!below[children[node][i]])
+			{
+				below[children[node][i]] = 1;
+				queue.push_back(children[node][i]);
+			}
+		}
+	}
+
+	// The statistics stay as they are, flattening does not change what is drawn
+	UpdateStatistics();
+
+	// How often every object is drawn below top, parents first
+	vector<double> placed(objects.size(), 0.0);
+	placed[t->second] = 1.0;
+	for(unsigned int i=order.size();i-->0;)
+	{
+		GDSObject *obj = order[i];
+		double p = placed[indexof[obj]];
+		if(p == 0.0)
+			continue;
+		for(unsigned int j=0;j<obj->refs.size();j++)
+			placed[indexof[obj->refs[j]->object]] += p*obj->refs[j]->Count();
+	}
+
+	// Keeping a reference costs a draw call per layer of the child every
+	// time the parent is drawn, flattening it copies the triangles of the
+	// child into the parent once. Children are flattened before the objects
+	// that place them, and only children without references left can be.
+	// Going up, draw calls get fewer, so the budget goes to the deepest
+	// references first.
+	double budget = flatten_budget*1048576.0, used = 0.0, saved = 0.0;
+	unsigned int absorbed = 0, total = 0;
+	vector<char> flat(objects.size(), 0);
+	vector<bool> absorb;
+	for(unsigned int i=0;i<order.size();i++)
+	{
+		GDSObject *obj = order[i];
+		unsigned int o = indexof[obj];
+		if(!below[o])
+			continue;
+		if(obj->isCollapsed())
+		{
+			flat[o] = obj->refs.empty();
+			continue;
+		}
+
+		// Arrays as a whole, their elements cost the same
+		unsigned int count = 0, elements = 0;
+		absorb.assign(obj->refs.size(), false);
+		for(unsigned int j=0;j<obj->refs.size();j++)
+		{
+			GDSObject *child = obj->refs[j]->object;
+			const GDSStatistics& stats = child->GetStatistics();
+			double calls = placed[o]*max(stats.Layers.size(), (size_t)1);
+			double bytes = (double)obj->refs[j]->Count()*stats.Triangles*GDS_TRIANGLE_BYTES;
+
+			elements += obj->refs[j]->Count();
+			if(flat[indexof[child]] && stats.Triangles <= calls*GDS_DRAW_CALL_TRIANGLES && used + bytes <= budget)
+			{
+				absorb[j] = true;
+				used += bytes;
+				saved += calls*obj->refs[j]->Count();
+				count += obj->refs[j]->Count();
+			}
+		}
+		if(!obj->refs.empty())
+			v_printf(2, "\t%-30s %6u of %6u references flattened, drawn %.0f times\n", obj->GetName(), count, elements, placed[o]);
+		absorbed += count;
+		total += elements;
+
+		obj->collapseHierachy(absorb);
+		flat[o] = obj->refs.empty();
+	}
+	v_printf(1, "Flattened %u of %u references: %.1f of %d MB budget, %.0f draw calls less\n",
+		absorbed, total, used/1048576.0, flatten_budget, saved);
+}
+
+// Children first, so every object only adds up its own references.
+// Linear in the number of objects and references.
+void GDSObjectList::UpdateStatistics()
+{
+	if(!graphvalid)
+		BuildGraph();
+	if(statsvalid)
+		return;
+
+	for(unsigned int i=0;i<order.size();i++)
+		order[i]->UpdateStatistics();
+	statsvalid = true;
+}
+
+void GDSObjectList::PrintStatistics(GDSObject *top)
+{
+	if(!top)
+		return;
+
+	UpdateStatistics();
+	const GDSStatistics& stats = top->GetStatistics();
+	v_printf(1, "\"%s\" flattened: %lld polygons, %lld points, %lld triangles, %lld instances\n",
+		top->GetName(), stats.Polygons, stats.Points, stats.Triangles, stats.Instances);
+	for(unsigned int i=0;i<stats.Layers.size();i++)
+		v_printf(2, "\t%-20s (%.3f, %.3f) - (%.3f, %.3f)\n", stats.Layers[i].Layer->Name,
+			stats.Layers[i].BB.min.X, stats.Layers[i].BB.min.Y, stats.Layers[i].BB.max.X, stats.Layers[i].BB.max.Y);
+}
+
+// Cells streamed out of other tools often come in many copies under other
+// names, PCell variants or re-streamed libraries. Going children first,
+// the form of an object refers to its children by the id of the object kept
+// for them, so copies higher up the tree are found as well.
+unsigned int GDSObjectList::MergeIdenticalObjects(unordered_map<GDSObject*, GDSObject*>& Merged)
+{
+	unordered_multimap<unsigned long long, unsigned int> forms; // Hash to index into objects
+	unordered_map<GDSObject*, unsigned int> ids;
+	vector<byte> form, other;
+	unsigned long long points = 0, polygons = 0, rects = 0, indices = 0, faces = 0, triangles = 0;
+	unsigned int before = objects.size();
+
+	Merged.clear();
+	if(HasCycles())
+		return 0;
+
+	for(unsigned int i=0;i<order.size();i++)
+	{
+		GDSObject *obj = order[i];
+		GDSObject *same = NULL;
+		unsigned long long hash;
+
+		obj->GetCanonicalForm(form, ids);
+		hash = gds_hash(&form[0], form.size());
+
+		pair<unordered_multimap<unsigned long long, unsigned int>::iterator, unordered_multimap<unsigned long long, unsigned int>::iterator> range = forms.equal_range(hash);
+		for(;!same && range.first!=range.second;range.first++)
+		{
+			objects[range.first->second]->GetCanonicalForm(other, ids);
+			if(other == form)
+				same = objects[range.first->second];
+		}
+
+		if(!same)
+		{
+			ids[obj] = indexof[obj];
+			forms.insert(make_pair(hash, indexof[obj]));
+			continue;
+		}
+
+		ids[obj] = indexof[same];
+		Merged[obj] = same;
+		points += obj->GetGeometry()->GetNumPoints();
+		polygons += obj->GetNumPolygons();
+		rects += obj->GetNumRects();
+		indices += obj->GetGeometry()->GetNumIndices();
+		faces += obj->GetGeometry()->GetNumFaces();
+		triangles += obj->GetGeometry()->GetNumTriangles();
+	}
+	if(Merged.empty())
+		return 0;
+
+	// Aliases find the object kept, the first object with a name still wins
+	vector<GDSObject*> kept;
+	for(unsigned int i=0;i<objects.size();i++)
+	{
+		unordered_map<GDSObject*, GDSObject*>::iterator m = Merged.find(objects[i]);
+
+		if(m == Merged.end())
+		{
+			objects[i]->ReplaceReferences(Merged);
+			kept.push_back(objects[i]);
+			continue;
+		}
+		if(byname[objects[i]->GetNameID()] == objects[i])
+		{
+			byname[objects[i]->GetNameID()] = m->second;
+			aliases[objects[i]->GetNameID()] = objects[i]->GetContentHash();
+		}
+		delete objects[i];
+	}
+	objects.swap(kept);
+
+	// Aliases of a merged object move on to where it went
+	for(unordered_map<unsigned int, unsigned long long>::iterator a = aliases.begin(); a != aliases.end(); a++)
+	{
+		unordered_map<GDSObject*, GDSObject*>::iterator m = Merged.find(byname[a->first]);
+		if(m != Merged.end())
+			byname[a->first] = m->second;
+	}
+	InvalidateGraph();
+
+	// Each object gets its own render buffers
+	v_printf(1, "Merged %u identical structures into others: %llu polygons and %llu rectangles less, about %.1f MB of geometry and %llu triangles to draw\n",
+		before - (unsigned int)objects.size(), polygons, rects,
+		(points*2*sizeof(int32_t) + indices*sizeof(uint16_t) + faces*sizeof(GDSBox) + polygons*sizeof(GDSPolygonRecord) + rects*(sizeof(GDSBox)+sizeof(uint16_t)))/1048576.0,
+		triangles);
+	return before - objects.size();
 }
 
 unsigned int	GDSObjectList::getNumObjects()
@@ -113,9 +615,39 @@ GDSObject* GDSObjectList::getObject(unsigned int index)
 
 void GDSObjectList::buildObjectTree()
 {
-	if(tree)
-		delete tree;
+	for(unsigned int i=0;i<objects.size();i++)
+		GetObjectTree(objects[i]);
+}
+
+// The trees of the children are built first, a NULL entry marks a tree
+// under construction so a cycle ends there
+ObjectTree *GDSObjectList::GetObjectTree(GDSObject *object)
+{
+	unordered_map<GDSObject*, ObjectTree*>::iterator t = trees.find(object);
+	if(t != trees.end())
+		return t->second;
 
-	// This will recursively build itself
-	tree = new ObjectTree(GetTopObject(), GDSMat());
-}
\ No newline at end of file
+	trees[object] = NULL;
+	ObjectTree *tree = new ObjectTree(object, this);
+	trees[object] = tree;
+	return tree;
+}
+
+void GDSObjectList::ClearObjectTrees()
+{
+	for(unordered_map<GDSObject*, ObjectTree*>::iterator t=trees.begin();t!=trees.end();++t)
+		delete t->second;
+	trees.clear();
+}
+
+void GDSObjectList::QueryRegion(GDSObject *top, const GDSBB& Window, const set<ProcessLayer*>& Layers, vector<GDSHit>& Hits)
+{
+	vector<GDSInstance> path;
+	GDSTransform identity;
+
+	if(!top)
+		return;
+	ObjectTree *tree = GetObjectTree(top);
+	if(tree)
+		tree->Query(this, Window, GDSMat(), &identity, Layers, path, Hits);
+}
@@ -23,21 +23,69 @@
 #define __GDSObjectList_H__
 
 #include "gdsobject.h"
+#include <unordered_map>
 
+// Cost model of CollapseHierarchy(): a draw call is worth this many
+// triangles, which take about this many bytes in RAM and VRAM together
+#define GDS_DRAW_CALL_TRIANGLES	1500
+#define GDS_TRIANGLE_BYTES		48
+
+// Leaves of an ObjectTree hold up to this many entries
+#define GDS_TREE_LEAF	4
+#define GDS_TREE_REF	0x40000000u
+
+// One step down the hierarchy, element (Column, Row) of Ref
+typedef struct GDSInstance
+{
+	const GDSRef	*Ref;
+	uint32_t		Column;
+	uint32_t		Row;
+}GDSInstance;
+
+// A polygon found by GDSObjectList::QueryRegion()
+typedef struct GDSHit
+{
+	vector<GDSInstance>	Path; // From the queried object down to Object
+	GDSObject			*Object; // Holding Polygon
+	GDSMat				Mat; // From Object to the queried object
+	bool				Exact; // Every step of Path is, in the same database units
+	GDSTransform		Transform; // Mat in database units, if Exact. Check Inverse() before mapping back
+	GDSPolygon			Polygon;
+}GDSHit;
+
+// Bounding volume hierarchy over the polygons, rectangles and references
+// of one object, in its own coordinates. An array is one entry, a query
+// bisects its lattice and goes on in the tree of the placed object, so
+// every object has one tree however often it is placed.
 class ObjectTree
 {
 private:
-	GDSBB						bbox;
-	GDSMat						mat;
-	GDSObject					*object;
+	typedef struct Entry
+	{
+		GDSBB		bbox;
+		uint32_t	index; // Polygon, rectangle with GDS_RECT_VIEW, or reference with GDS_TREE_REF
+	}Entry;
+
+	typedef struct Node
+	{
+		GDSBB		bbox;
+		uint32_t	first; // First entry, or the second child of an inner node, the first follows it
+		uint32_t	count; // Entries, 0 for an inner node
+	}Node;
+
+	GDSObject		*object;
+	vector<Entry>	entries;
+	vector<Node>	nodes;
 
-	list<int>					polygons;
-	vector<class ObjectTree*>	leaves;
+	uint32_t build(uint32_t first, uint32_t count);
+	void queryRef(class GDSObjectList *Objects, const GDSRef *ref, const GDSBB& BB, const GDSBB& Local, uint32_t C0, uint32_t C1, uint32_t R0, uint32_t R1, const GDSBB& Window, const GDSMat& Mat, const GDSTransform *Transform, const set<struct ProcessLayer*>& Layers, vector<GDSInstance>& Path, vector<GDSHit>& Hits);
 
 public:
-	ObjectTree(GDSObject *object, const GDSMat& mat);
-	~ObjectTree();
+	ObjectTree(GDSObject *object, class GDSObjectList *Objects); // Needs the trees of the children
+	~ObjectTree() {};
 
+	GDSBB GetBBox() const; // Everything below the object, empty if nothing
+	void Query(class GDSObjectList *Objects, const GDSBB& Window, const GDSMat& Mat, const GDSTransform *Transform, const set<struct ProcessLayer*>& Layers, vector<GDSInstance>& Path, vector<GDSHit>& Hits); // Transform NULL if not exact
 };
 
 class GDSObjectList
@@ -46,23 +94,71 @@ private:
 	// List of all the objects
 	vector<GDSObject*> objects;
 
-	// Tree of all object instances for net highlighting
-	ObjectTree	*tree;
+	// Objects by interned name id, NULL where no object has that name
+	vector<GDSObject*> byname;
+
+	// Names merged into another object, with the content hash of their own
+	// structure so a reload can tell whether they changed
+	unordered_map<unsigned int, unsigned long long> aliases;
+
+	// Reference graph over the SRefs and ARefs, as indices into objects.
+	// Rebuilt on first use after the objects or their references changed.
+	bool graphvalid;
+	bool statsvalid; // Statistics of the objects, with the graph
+	bool cyclic;
+	unordered_map<GDSObject*, unsigned int> indexof;
+	vector<vector<unsigned int> > children;
+	vector<vector<unsigned int> > parents;
+	vector<GDSObject*> tops; // Objects nobody references, in list order
+	vector<GDSObject*> order; // Children before their parents
+
+	// Trees for region queries, built on first use, NULL while building
+	unordered_map<GDSObject*, ObjectTree*> trees;
 
 public:
 	GDSObjectList();
 	~GDSObjectList();
 
 	GDSObject *AddObject(class GDSObject *newobject);
+	void ReleaseObjects(); // Forget all objects without deleting them
 	GDSObject *SearchObject(const char *Name);
+	GDSObject *SearchObject(unsigned int Name);
+	void AddAlias(unsigned int Name, GDSObject *object, unsigned long long ContentHash);
+	const unordered_map<unsigned int, unsigned long long>& GetAliases() {return aliases;};
 	GDSObject *GetTopObject();
+	const vector<GDSObject*>& GetTopObjects();
+	const vector<GDSObject*>& GetTopologicalOrder();
+	bool HasCycles();
 	unsigned int	getNumObjects();
 	GDSObject* getObject(unsigned int index);
 
 	void ConnectReferences();
+	void InvalidateGraph() {graphvalid = false; statsvalid = false; ClearObjectTrees();};
+	void BuildGraph();
+
+	// Keep one object of every set that looks the same, children first.
+	// The names of the others stay as aliases of it. Merged maps each
+	// deleted object to the one kept. Returns the number deleted.
+	unsigned int MergeIdenticalObjects(unordered_map<GDSObject*, GDSObject*>& Merged);
+
+	// Flatten the references below top where that saves more draw calls
+	// than it costs memory, within flatten_budget, children first
+	void CollapseHierarchy(GDSObject *top);
+
+	// Flattened statistics of every object, see GDSObject::GetStatistics()
+	void UpdateStatistics();
+	void PrintStatistics(GDSObject *top);
+
+	// Region queries, for net highlighting and other tools. The trees hold
+	// polygon indices, clear them when the geometry of an object changes.
+	void	buildObjectTree(); // Of every object, otherwise done when needed
+	ObjectTree *GetObjectTree(GDSObject *object); // NULL inside a cycle
+	void	ClearObjectTrees();
 
-	// For net highlighting
-	void	buildObjectTree();
+	// Every polygon below top on a layer in Layers, or any layer if empty,
+	// whose bounding box overlaps Window, in the coordinates of top. The
+	// hits of one instance come together, in O(log n) per hit.
+	void	QueryRegion(GDSObject *top, const GDSBB& Window, const set<struct ProcessLayer*>& Layers, vector<GDSHit>& Hits);
 };
 
 #endif // __GDSObjectList_H__
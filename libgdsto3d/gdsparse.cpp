@@ -34,19 +34,22 @@
 
 extern int verbose_output;
 
-#ifndef endian_swap_long
-    #define endian_swap_long(w) ( ((w&0xff)<<24) | ((w&0xff00)<<8) | ((w&0xff0000)>>8) | ((w&0xff000000)>>24) )
-#endif
-#ifndef endian_swap_short
-    #define endian_swap_short(w) ( ((w&0xff)<<8) | ((w&0xff00)>>8) )
-#endif
+// Disallow invalid characters in POV-Ray names.
+static void gds_clean_name(char *str)
+{
+	for(unsigned int i=0; str[i]; i++){
+		if((str[i] < 48 || str[i] > 57) && (str[i] < 65 || str[i] > 90) && (str[i] < 97 || str[i] > 122)){
+			str[i] = '_';
+		}
+	}
+}
 
 GDSParse::GDSParse (class GDSProcess *process, bool generate_process)
 {
 	_iptr = NULL;
 	_optr = NULL;
 	_libname = NULL;
-	_sname = NULL;
+	_sname = GDS_NO_NAME;
 	_textstring = NULL;
 	_Objects = NULL;
 
@@ -74,7 +77,13 @@ GDSParse::GDSParse (class GDSProcess *process, bool generate_process)
 	_angle = 0.0;
 	_units = 0.0;
 	_recordlen = 0;
+	_record = NULL;
 	_CurrentObject = NULL;
+	_cache = NULL;
+	_rebuildcache = false;
+	_structbegin = 0;
+	_indexsize = 0;
+	_loadobject = NULL;
 
 	_use_outfile = false;
 	_allow_multiple_output = false;
@@ -83,14 +92,10 @@ GDSParse::GDSParse (class GDSProcess *process, bool generate_process)
 
 	_process = process;
 
+	_shared = this;
 	for(int i=0; i<70; i++){
 		_unsupported[i] = false;
 	}
-	for(int i=0; i<257; i++){
-		for(int j=0; j<257; j++){
-			_layer_warning[i][j] = false;
-		}
-	}
 }
 
 GDSParse::~GDSParse ()
@@ -98,15 +103,27 @@ GDSParse::~GDSParse ()
 	if(_libname){
 		delete [] _libname;
 	}
-	if(_sname){
-		delete [] _sname;
-	}
 	if(_textstring){
 		delete [] _textstring;
 	}
 	if(_Objects){
 		delete _Objects;
 	}
+	if(_cache){
+		delete _cache;
+	}
+	if(_shared == this){
+		gds_clear_tesselations(); // Workers share the table of their parser
+	}
+}
+
+void GDSParse::SetCache(const char *gdsfile, bool rebuild)
+{
+	if(_cache){
+		delete _cache;
+	}
+	_cache = new GDSCache(gdsfile);
+	_rebuildcache = rebuild;
 }
 
 bool GDSParse::Parse(FILE *iptr, char *topcell)
@@ -114,6 +131,7 @@ bool GDSParse::Parse(FILE *iptr, char *topcell)
 	_iptr = iptr;
 	if(_iptr){
 		_Objects = new GDSObjectList;
+		gds_clear_tesselations(); // Shapes of another library
 
 		bool result = ParseFile(topcell);
 
@@ -130,39 +148,696 @@ void GDSParse::Reload()
 {
 	if(_Objects)
 	{
-		delete _Objects;
+		GDSObjectList *old = _Objects;
+
+		// Kept structures have their triangles already, the shape table
+		// starts over with the ones that changed
+		gds_clear_tesselations();
+
+		// Keep the structures that did not change, otherwise start over
 		_Objects = new GDSObjectList;
-		ParseFile(this->_topcellname);
+		if(!ReloadStructures(old))
+		{
+			delete old;
+			delete _Objects;
+			_Objects = new GDSObjectList;
+			ParseFile(this->_topcellname);
+		}
 	}
 }
 
+// Opens _iptr for reading. OASIS files are translated to a GDSII stream in
+// memory first, everything after this only sees GDSII.
+bool GDSParse::OpenFile()
+{
+	OASISReader oasis;
+	byte *data;
+	int64_t size;
+
+	if(!OASISReader::IsOASIS(_iptr)){
+		return _reader.Open(_iptr);
+	}
+
+	if(!oasis.Translate(_iptr)){
+		return false;
+	}
+	data = oasis.Release(&size);
+	return _reader.OpenBuffer(data, size);
+}
+
 bool GDSParse::ParseFile(char *topcell)
 {
-	byte recordtype, datatype;
-	char *tempstr;
-	struct ProcessLayer *layer = NULL;
-    
-    float BgnExtn;
-    float EndExtn;
-    float extn_x, extn_x2;
-    float extn_y, extn_y2;
-    float angleX[1024]; // HACK
-    float angleY[1024]; // HACK
-    Point2D points[8];
+	bool result;
+	double start;
 
 	this->_topcellname = topcell;
-    _currentelement = elNone;
 
 	if(!_iptr){
 		return true;
 	}
 
-	fseek(_iptr, 0, SEEK_SET);
-	while(!feof(_iptr)){
-		_recordlen = GetTwoByteSignedInt();
-		fread(&recordtype, 1, 1, _iptr);
-		fread(&datatype, 1, 1, _iptr);
-		_recordlen -= 4;
+	if(!OpenFile()){
+		return true;
+	}
+
+	// Serve the whole database from the cache when nothing changed
+	bool usecache = _cache && !_generate_process;
+	if(usecache){
+		long elements[6];
+		double units;
+
+		start = gds_time();
+		_cache->MakeKey(_iptr, _reader, _process);
+		if(!_rebuildcache && _cache->Load(this, _Objects, _process, elements, &units)){
+			_units = (float)units;
+			_PathElements = elements[0];
+			_BoundaryElements = elements[1];
+			_BoxElements = elements[2];
+			_TextElements = elements[3];
+			_SRefElements = elements[4];
+			_ARefElements = elements[5];
+			v_printf(1, "Loaded cache in %.2f s\n", gds_time() - start);
+			_reader.Close();
+			MergeIdenticalStructures();
+			return false;
+		}
+	}
+
+	// With a top cell only its part of the hierarchy is parsed now
+	start = gds_time();
+	_index.clear();
+	_indexnames.clear();
+	if(topcell && !_generate_process && _reader.IsMapped() && IndexStructures(_index)){
+		for(unsigned int i=0; i<_index.size(); i++){
+			if(!_indexnames.count(_index[i].name))
+				_indexnames[_index[i].name] = i;
+		}
+		if(!_indexnames.count(topcell)){
+			v_printf(1, "Topcell \"%s\" is not in the gds, loading everything.\n", topcell);
+			_index.clear();
+			_indexnames.clear();
+		}
+	}else{
+		_index.clear();
+	}
+	_reader.SetRange(0, _reader.GetSize());
+
+	if(!_index.empty()){
+		result = ParseLazy(topcell);
+		usecache = false; // Only part of the library
+	}else if(_reader.IsMapped() && gds_thread_count() > 1){
+		result = ParseStructures(topcell);
+	}else{
+		result = ParseRecords(topcell);
+	}
+	start = gds_time() - start;
+
+	if(start > 0.0){
+		v_printf(1, "Parsed %.1f MB in %.2f s (%.1f MB/s, %s)\n", _reader.GetSize()/1048576.0, start, _reader.GetSize()/1048576.0/start, _reader.IsMapped() ? "mapped" : "buffered");
+	}
+
+	// Lazy loading builds the structures as they are loaded
+	if(_index.empty()){
+		vector<GDSObject*> objects;
+		for(unsigned int i=0; i<_Objects->getNumObjects(); i++)
+			objects.push_back(_Objects->getObject(i));
+		BuildGeometry(objects);
+	}
+
+	if(usecache && !result){
+		long elements[6] = {_PathElements, _BoundaryElements, _BoxElements, _TextElements, _SRefElements, _ARefElements};
+		_cache->Save(_Objects, _process, elements, _units);
+	}
+
+	_reader.Close();
+	if(_index.empty()){
+		MergeIdenticalStructures(); // The cache keeps all names as structures
+	}
+	return result;
+}
+
+// Parses structures on a worker thread. Each worker has its own element state
+// and borrows the mapping, units, process and warnings of the main parser.
+class GDSParseWorker : public GDSParse
+{
+private:
+	GDSParse *_parent;
+
+public:
+	GDSParseWorker(GDSParse *parent, class GDSProcess *process, bool generate_process) : GDSParse(process, generate_process) {_parent = parent;};
+
+	class GDSObject *NewObject(char *Name) {return _parent->NewObject(Name);};
+};
+
+bool GDSParse::ParseStructures(char *topcell)
+{
+	vector<int64_t> begin, end;
+	vector<GDSObject*> structures;
+	vector<GDSParse*> workers;
+	unsigned int threads;
+	bool done = false;
+
+	// Pre-scan for the byte range of every structure
+	while(!done && _reader.NextRecord()){
+		const gds_header& record = _reader.GetRecord();
+		switch(record.RecordType){
+			case rnBgnStr:
+				begin.push_back(_reader.GetOffset());
+				break;
+			case rnEndStr:
+				if(end.size() < begin.size())
+					end.push_back(_reader.GetOffset() + 4 + record.RecordLength);
+				break;
+			case rnEndLib:
+				done = true;
+				break;
+			default:
+				break;
+		}
+	}
+
+	if(begin.size() < 2 || begin.size() != end.size()){
+		// Nothing to gain, or a broken file that is better read in order
+		_reader.SetRange(0, _reader.GetSize());
+		return ParseRecords(topcell);
+	}
+
+	// Header, library name and units
+	_reader.SetRange(0, begin[0]);
+	if(ParseRecords(topcell)){
+		return true;
+	}
+
+	threads = gds_thread_count();
+	if(threads > begin.size())
+		threads = begin.size();
+	v_printf(2, "Parsing %d structures on %d threads\n", (int)begin.size(), threads);
+
+	for(unsigned int i=0; i<threads; i++){
+		GDSParse *worker = new GDSParseWorker(this, _process, _generate_process);
+		worker->_Objects = new GDSObjectList;
+		worker->_reader.OpenView(_reader);
+		worker->_units = _units;
+		worker->_shared = this;
+		workers.push_back(worker);
+	}
+
+	structures.resize(begin.size(), NULL);
+	gds_parallel_for(begin.size(), [&](unsigned int i, unsigned int t){
+		GDSParse *worker = workers[t];
+		worker->_CurrentObject = NULL;
+		worker->_reader.SetRange(begin[i], end[i]);
+		worker->ParseRecords(topcell);
+		structures[i] = worker->_CurrentObject;
+	});
+
+	// Merge in file order, so the result does not depend on the scheduling
+	for(unsigned int i=0; i<structures.size(); i++){
+		if(structures[i]){
+			_CurrentObject = _Objects->AddObject(structures[i]);
+		}
+	}
+	for(unsigned int i=0; i<workers.size(); i++){
+		_PathElements += workers[i]->_PathElements;
+		_BoundaryElements += workers[i]->_BoundaryElements;
+		_BoxElements += workers[i]->_BoxElements;
+		_TextElements += workers[i]->_TextElements;
+		_SRefElements += workers[i]->_SRefElements;
+		_ARefElements += workers[i]->_ARefElements;
+		workers[i]->_Objects->ReleaseObjects();
+		delete workers[i];
+	}
+
+	// Records after the last structure, ENDLIB connects the references
+	_reader.SetRange(end.back(), _reader.GetSize());
+	return ParseRecords(topcell);
+}
+
+// Expands the paths and tesselates the polygons of freshly parsed objects
+// on all threads. Small objects are built by one thread, large ones in
+// chunks of their polygons and paths, put together in order by the thread
+// that finishes the last one. The largest objects are handed out first so
+// the threads finish together. Neither the objects nor the chunks depend
+// on the others or on the number of threads, so the result does not either.
+void GDSParse::BuildGeometry(const vector<GDSObject*>& objects)
+{
+	vector<vector<GDSBuildChunk> > chunks(objects.size());
+	vector<pair<int, unsigned int> > sorted; // Points and position, largest first
+	vector<pair<unsigned int, unsigned int> > order; // Object and chunk+1, or 0 for all of it
+	vector<atomic<unsigned int> > left(objects.size()); // Chunks still to build
+	unsigned int split = 0;
+	unsigned long long lookups, hits, shapes, bytes, lookups2, hits2;
+	double start = gds_time();
+
+	gds_tesselation_stats(lookups, hits, shapes, bytes);
+
+	for(unsigned int i=0; i<objects.size(); i++)
+		sorted.push_back(make_pair(-objects[i]->GetPointCount(), i));
+	std::sort(sorted.begin(), sorted.end());
+
+	// Chunks of an object follow each other, so few are held at a time.
+	// One thread builds the same without copying them.
+	for(unsigned int i=0; i<sorted.size(); i++){
+		unsigned int object = sorted[i].second;
+
+		if(gds_thread_count() > 1)
+			objects[object]->SplitElements(chunks[object]);
+		left[object] = chunks[object].size();
+		if(chunks[object].empty())
+			order.push_back(make_pair(object, 0u));
+		else
+			split++;
+		for(unsigned int j=0; j<chunks[object].size(); j++)
+			order.push_back(make_pair(object, j+1));
+	}
+
+	gds_parallel_for(order.size(), [&](unsigned int i, unsigned int){
+		unsigned int object = order[i].first;
+
+		if(!order[i].second){
+			objects[object]->BuildElements();
+			return;
+		}
+		objects[object]->BuildChunk(chunks[object][order[i].second-1]);
+		if(--left[object] == 0){
+			objects[object]->AppendChunks(chunks[object]);
+			vector<GDSBuildChunk>().swap(chunks[object]);
+		}
+	});
+
+	if(!objects.empty()){
+		v_printf(1, "Built geometry of %u structures in %.2f s (%u threads, %u structures in chunks)\n", (unsigned int)objects.size(), gds_time() - start, std::min(gds_thread_count(), (unsigned int)order.size()), split);
+	}
+
+	gds_tesselation_stats(lookups2, hits2, shapes, bytes);
+	if(lookups2 > lookups){
+		v_printf(2, "Tesselation cache: %llu of %llu polygons congruent to one before (%.1f%%), %llu shapes in %.1f MB\n", hits2 - hits, lookups2 - lookups, 100.0*(hits2 - hits)/(lookups2 - lookups), shapes, bytes/1048576.0);
+	}
+}
+
+// Drops structures that look the same as another one, their names then
+// find the one kept. Index entries of merged stubs' parents follow.
+void GDSParse::MergeIdenticalStructures()
+{
+	unordered_map<GDSObject*, GDSObject*> merged;
+
+	if(!_Objects->MergeIdenticalObjects(merged)){
+		return;
+	}
+	for(unsigned int i=0; i<_index.size(); i++){
+		unordered_map<GDSObject*, GDSObject*>::iterator m = merged.find(_index[i].object);
+		if(m != merged.end())
+			_index[i].object = m->second;
+	}
+}
+
+// Creates a stub object for every structure in the index, then parses the
+// top cell and everything it references.
+bool GDSParse::ParseLazy(char *topcell)
+{
+	unsigned int loaded = 0;
+
+	// Header, library name and units
+	_reader.SetRange(0, _index[0].begin);
+	if(ParseRecords(topcell)){
+		return true;
+	}
+
+	_indexsize = _reader.GetSize();
+	for(unsigned int i=0; i<_index.size(); i++){
+		char *name = new char[_index[i].name.size()+1];
+		strcpy(name, _index[i].name.c_str());
+		_index[i].object = _Objects->AddObject(NewObject(name));
+		_index[i].object->SetUnits(_units);
+		delete [] name;
+	}
+
+	// Stubs only know what they reference, enough for top cell detection and the top cell list
+	for(unsigned int i=0; i<_index.size(); i++){
+		vector<GDSObject*> children;
+		set<GDSObject*> unique;
+
+		for(unsigned int j=0; j<_index[i].children.size(); j++){
+			map<string, unsigned int>::iterator c = _indexnames.find(_index[i].children[j]);
+			if(c != _indexnames.end() && unique.insert(_index[c->second].object).second)
+				children.push_back(_index[c->second].object);
+		}
+		_index[i].object->MakeStub(children);
+	}
+
+	LoadStructures(_indexnames[topcell]);
+
+	for(unsigned int i=0; i<_index.size(); i++){
+		if(!_index[i].object->isStub())
+			loaded++;
+	}
+	v_printf(1, "Loaded %u of %u structures below \"%s\"\n", loaded, (unsigned int)_index.size(), topcell);
+	return false;
+}
+
+// Parses the stub at index and all stubs below it, the reader must be open
+void GDSParse::LoadStructures(unsigned int index)
+{
+	vector<unsigned int> queue, loaded;
+
+	queue.push_back(index);
+	while(!queue.empty()){
+		GDSStructureRange& structure = _index[queue.back()];
+		queue.pop_back();
+
+		if(!structure.object->isStub())
+			continue;
+		structure.object->ClearStub();
+
+		_loadobject = structure.object;
+		_CurrentObject = NULL;
+		_reader.SetRange(structure.begin, structure.end);
+		ParseRecords(_topcellname);
+		_loadobject = NULL;
+		loaded.push_back(&structure - &_index[0]);
+
+		for(unsigned int j=0; j<structure.children.size(); j++){
+			map<string, unsigned int>::iterator c = _indexnames.find(structure.children[j]);
+			if(c != _indexnames.end() && _index[c->second].object->isStub())
+				queue.push_back(c->second);
+		}
+	}
+
+	vector<GDSObject*> objects;
+	for(unsigned int i=0; i<loaded.size(); i++)
+		objects.push_back(_index[loaded[i]].object);
+	BuildGeometry(objects);
+
+	for(unsigned int i=0; i<loaded.size(); i++)
+		_index[loaded[i]].object->ConnectReferences(_Objects);
+	MergeIdenticalStructures();
+}
+
+bool GDSParse::LoadStructure(const char *name)
+{
+	map<string, unsigned int>::iterator i = _indexnames.find(name);
+	double start;
+
+	if(i == _indexnames.end() || !_index[i->second].object->isStub()){
+		return true;
+	}
+
+	// The file must still be the one that was indexed, otherwise all of it
+	// is loaded again
+	if(!_iptr || !OpenFile()){
+		v_printf(1, "Unable to load \"%s\", the GDS file can not be read.\n", name);
+		return false;
+	}
+	if(!_reader.IsMapped() || _reader.GetSize() != _indexsize || !StubsUnchanged(i->second)){
+		_reader.Close();
+		v_printf(1, "The GDS file has changed, loading it again.\n");
+		Reload();
+
+		i = _indexnames.find(name);
+		if(i == _indexnames.end() || !_index[i->second].object->isStub()){
+			return true;
+		}
+		if(!OpenFile()){
+			return false;
+		}
+	}
+
+	start = gds_time();
+	LoadStructures(i->second);
+	_reader.Close();
+	v_printf(1, "Loaded \"%s\" in %.2f s\n", name, gds_time() - start);
+	return true;
+}
+
+// Compares the records of the stub at index and all stubs below it with
+// the hashes of the index, the reader must be open
+bool GDSParse::StubsUnchanged(unsigned int index)
+{
+	vector<unsigned int> queue;
+	set<unsigned int> seen;
+
+	queue.push_back(index);
+	while(!queue.empty()){
+		const GDSStructureRange& structure = _index[queue.back()];
+		queue.pop_back();
+
+		if(!seen.insert(&structure - &_index[0]).second || !structure.object->isStub())
+			continue;
+
+		// The hash starts after BGNSTR, which holds the dates
+		int64_t body = structure.begin + (uint16_t)gds_int16(_reader.GetData() + structure.begin);
+		if(structure.end > _reader.GetSize() || body > structure.end || gds_hash(_reader.GetData() + body, structure.end - body) != structure.hash)
+			return false;
+
+		for(unsigned int j=0; j<structure.children.size(); j++){
+			map<string, unsigned int>::iterator c = _indexnames.find(structure.children[j]);
+			if(c != _indexnames.end())
+				queue.push_back(c->second);
+		}
+	}
+	return true;
+}
+
+bool GDSParse::HasUnloadedStructures()
+{
+	for(unsigned int i=0; i<_index.size(); i++){
+		if(_index[i].object->isStub())
+			return true;
+	}
+	return false;
+}
+
+// Pre-scan the open file for the byte range, name, content hash and
+// referenced names of every structure. Returns false for a malformed file.
+bool GDSParse::IndexStructures(vector<GDSStructureRange>& structures)
+{
+	GDSStructureRange current;
+	bool inside = false, done = false;
+	char *str;
+
+	structures.clear();
+	current.object = NULL;
+	while(!done && _reader.NextRecord()){
+		const gds_header& record = _reader.GetRecord();
+		_record = record.Data;
+		_recordlen = record.RecordLength;
+		switch(record.RecordType){
+			case rnBgnStr:
+				current.begin = _reader.GetOffset();
+				current.end = _reader.GetOffset() + 4 + record.RecordLength;
+				current.name.clear();
+				current.children.clear();
+				inside = true;
+				break;
+			case rnStrName:
+			case rnSName:
+				str = GetAsciiString();
+				if(str && inside){
+					gds_clean_name(str);
+					if(record.RecordType == rnStrName)
+						current.name = str;
+					else
+						current.children.push_back(str);
+				}
+				if(str)
+					delete [] str;
+				break;
+			case rnEndStr:
+				if(inside){
+					int64_t body = current.end;
+					current.end = _reader.GetOffset() + 4 + record.RecordLength;
+					current.hash = gds_hash(_reader.GetData() + body, current.end - body);
+					structures.push_back(current);
+					inside = false;
+				}
+				break;
+			case rnEndLib:
+				done = true;
+				break;
+			default:
+				break;
+		}
+	}
+
+	return done && !inside && !structures.empty();
+}
+
+// Rebuilds _Objects from the open file, reusing every structure of the old
+// list whose records are unchanged and that only references unchanged
+// structures. These keep their flattened geometry and render buffers, so
+// the work scales with the edit. Returns false, with old untouched, if the
+// file has to be parsed from scratch.
+bool GDSParse::ReloadStructures(class GDSObjectList *old)
+{
+	vector<GDSStructureRange> structures;
+	map<string, pair<GDSObject*, unsigned long long> > previous; // Object and content hash by name
+	map<string, vector<unsigned int> > parents;
+	map<string, unsigned int> count, indexof;
+	set<GDSObject*> kept;
+	vector<bool> dirty;
+	vector<string> queue;
+	vector<GDSObject*> objects;
+	GDSObjectList *result;
+	float units = _units;
+	unsigned int changed = 0, rebuilt = 0;
+	double start = gds_time();
+
+	// A partly loaded library is simply loaded again
+	if(!_index.empty()){
+		return false;
+	}
+	if(!_iptr || !OpenFile()){
+		return false;
+	}
+	if(!_reader.IsMapped()){
+		_reader.Close();
+		return false;
+	}
+
+	if(!IndexStructures(structures)){
+		_reader.Close();
+		return false;
+	}
+
+	// Header, library name and units. Different units change every coordinate.
+	_reader.SetRange(0, structures[0].begin);
+	if(ParseRecords(_topcellname) || _units != units){
+		_units = units;
+		_reader.Close();
+		return false;
+	}
+
+	// Merged structures are still there by their own name and hash
+	for(unsigned int i=0; i<old->getNumObjects(); i++){
+		GDSObject *object = old->getObject(i);
+		if(!previous.count(object->GetName()))
+			previous[object->GetName()] = make_pair(object, object->GetContentHash());
+	}
+	const unordered_map<unsigned int, unsigned long long>& aliases = old->GetAliases();
+	for(unordered_map<unsigned int, unsigned long long>::const_iterator a = aliases.begin(); a != aliases.end(); a++){
+		if(!previous.count(gds_name(a->first)))
+			previous[gds_name(a->first)] = make_pair(old->SearchObject(a->first), a->second);
+	}
+
+	// A structure is dirty if its records changed, or it references a dirty
+	// structure, or a structure that appeared or disappeared
+	dirty.resize(structures.size(), false);
+	for(unsigned int i=0; i<structures.size(); i++){
+		count[structures[i].name]++;
+		indexof[structures[i].name] = i;
+		for(unsigned int j=0; j<structures[i].children.size(); j++)
+			parents[structures[i].children[j]].push_back(i);
+	}
+	for(unsigned int i=0; i<structures.size(); i++){
+		map<string, pair<GDSObject*, unsigned long long> >::iterator o = previous.find(structures[i].name);
+		if(o == previous.end() || !o->second.second || o->second.second != structures[i].hash || count[structures[i].name] > 1){
+			dirty[i] = true;
+			queue.push_back(structures[i].name);
+			changed++;
+		}
+	}
+	for(map<string, pair<GDSObject*, unsigned long long> >::iterator o = previous.begin(); o != previous.end(); o++){
+		if(!count.count(o->first))
+			queue.push_back(o->first);
+	}
+	while(!queue.empty()){
+		while(!queue.empty()){
+			string name = queue.back();
+			queue.pop_back();
+
+			map<string, vector<unsigned int> >::iterator p = parents.find(name);
+			if(p == parents.end())
+				continue;
+			for(unsigned int j=0; j<p->second.size(); j++){
+				unsigned int parent = p->second[j];
+				if(!dirty[parent]){
+					dirty[parent] = true;
+					queue.push_back(structures[parent].name);
+				}
+			}
+		}
+
+		// An alias can only be kept with the object it was merged into
+		for(unsigned int i=0; i<structures.size(); i++){
+			if(dirty[i])
+				continue;
+			GDSObject *object = previous[structures[i].name].first;
+			map<string, unsigned int>::iterator k = indexof.find(object->GetName());
+			if(k == indexof.end() || dirty[k->second]){
+				dirty[i] = true;
+				queue.push_back(structures[i].name);
+			}
+		}
+	}
+
+	// Parse the dirty structures into a scratch list
+	result = _Objects;
+	_Objects = new GDSObjectList;
+	objects.resize(structures.size(), NULL);
+	for(unsigned int i=0; i<structures.size(); i++){
+		if(dirty[i]){
+			_CurrentObject = NULL;
+			_reader.SetRange(structures[i].begin, structures[i].end);
+			ParseRecords(_topcellname);
+			objects[i] = _CurrentObject;
+			rebuilt++;
+		}else{
+			objects[i] = previous[structures[i].name].first;
+			kept.insert(objects[i]);
+		}
+	}
+	_Objects->ReleaseObjects();
+	delete _Objects;
+	_Objects = result;
+	_reader.Close();
+
+	vector<GDSObject*> built;
+	for(unsigned int i=0; i<objects.size(); i++){
+		if(objects[i] && dirty[i])
+			built.push_back(objects[i]);
+	}
+	BuildGeometry(built);
+
+	set<GDSObject*> added;
+	for(unsigned int i=0; i<objects.size(); i++){
+		if(objects[i] && (dirty[i] || structures[i].name == objects[i]->GetName()) && added.insert(objects[i]).second)
+			_Objects->AddObject(objects[i]);
+	}
+	for(unsigned int i=0; i<objects.size(); i++){
+		if(objects[i] && !dirty[i] && structures[i].name != objects[i]->GetName())
+			_Objects->AddAlias(gds_intern(structures[i].name.c_str()), objects[i], structures[i].hash);
+	}
+	for(unsigned int i=0; i<objects.size(); i++){
+		if(objects[i] && dirty[i])
+			objects[i]->ConnectReferences(_Objects);
+	}
+
+	// Everything that was not reused goes, together with its render data
+	for(unsigned int i=0; i<old->getNumObjects(); i++){
+		if(!kept.count(old->getObject(i)))
+			delete old->getObject(i);
+	}
+	old->ReleaseObjects();
+	delete old;
+
+	v_printf(1, "Reloaded %u of %u structures (%u changed) in %.2f s\n", rebuilt, (unsigned int)structures.size(), changed, gds_time() - start);
+	MergeIdenticalStructures();
+	return true;
+}
+
+bool GDSParse::ParseRecords(char *topcell)
+{
+	byte recordtype;
+	char *tempstr;
+	struct ProcessLayer *layer = NULL;
+    
+    _currentelement = elNone;
+
+	while(_reader.NextRecord()){
+		const gds_header& record = _reader.GetRecord();
+		recordtype = record.RecordType;
+		_record = record.Data;
+		_recordlen = record.RecordLength;
 		switch(recordtype){
 			case rnHeader:
 				v_printf(3, "HEADER\n");
@@ -170,9 +845,7 @@ bool GDSParse::ParseFile(char *topcell)
 				break;
 			case rnBgnLib:
 				v_printf(3, "BGNLIB\n");
-				while(_recordlen){
-					GetTwoByteSignedInt();
-				}
+				SkipRecord();
 				break;
 			case rnLibName:
 				v_printf(3, "LIBNAME ");
@@ -184,7 +857,6 @@ bool GDSParse::ParseFile(char *topcell)
 				break;
 			case rnEndLib:
 				v_printf(3, "ENDLIB\n");
-				fseek(_iptr, 0, SEEK_END);
         //Added for substrate
       	_BoundaryElements++;
         _currentlayer = 255;
@@ -197,214 +869,24 @@ bool GDSParse::ParseFile(char *topcell)
 			case rnEndStr:
 				v_printf(3, "ENDSTR\n");				
 
+				// Fingerprint for incremental reloads, BGNSTR itself only holds dates
+				if(_CurrentObject && _reader.IsMapped()){
+					int64_t end = _reader.GetOffset() + 4 + record.RecordLength;
+					_CurrentObject->SetContentHash(gds_hash(_reader.GetData() + _structbegin, end - _structbegin));
+				}
+
 				// Reset transformation matrix
 				_currentstrans = 0;
 				break;
 			case rnEndEl:
 				v_printf(3, "ENDEL\n\n");
                 
-                // End of path, text or boundary
-                switch(_currentelement){
-                    case elBoundary:
-                        if(_CurrentObject)
-                        {
-                            if(_CurrentObject->GetCurrentPolygon())
-							{
-                                _CurrentObject->GetCurrentPolygon()->Orientate(); // Check normal pointing
-								_CurrentObject->GetCurrentPolygon()->Tesselate();
-							}
-                        }
-                        break;
-					case elPath:
-                        
-                        if(_CurrentObject)
-                        {
-                            if(_CurrentObject->GetCurrentPath())
-                            {
-                                GDSPath *path;
-                                path = _CurrentObject->GetCurrentPath();
-                                _CurrentObject->AddPolygon(path->GetHeight(), path->GetThickness(), path->GetPoints()*2, path->GetLayer());
-                                GDSPolygon* poly = _CurrentObject->GetCurrentPolygon();
-                                
-                                ProcessLayer *layer = path->GetLayer();
-                                
-                                if(path->GetWidth() && layer){
-                                    switch(path->GetType()){
-                                        case 1:
-                                        case 2:
-                                            BgnExtn = path->GetWidth(); /* Width has already been scaled to half */
-                                            EndExtn = path->GetWidth();
-                                            break;
-                                        case 4:
-                                            BgnExtn = path->GetBgnExtn();
-                                            EndExtn = path->GetEndExtn();
-                                            break;
-                                        default:
-                                            BgnExtn = 0.0;
-                                            EndExtn = 0.0;
-                                            break;
-                                    }
-                                    
-                                    float dx, dy;
-                                    // Cache angles
-                                    for(unsigned long j=0; j<path->GetPoints()-1; j++){
-                                        dx = path->GetXCoords(j) - path->GetXCoords(j+1);
-                                        dy = path->GetYCoords(j+1) - path->GetYCoords(j);
-                                        
-                                        /* This is only run once each time the program is run, so we can more afford the expensive trig functions.
-                                         Sort the above out properly later. */
-                                        angleX[j] = cos(atan2(dx, dy));
-                                        angleY[j] = sin(atan2(dx, dy));
-                                    }
-                                    
-                                    // Make path
-                                    float angleX_1;
-                                    float angleY_1;
-                                    float angleX_2;
-                                    float angleY_2;
-                                    float l; // Normalization
-                                    Point2D P[256];
-                                    
-									extn_x = extn_y = extn_x2 = extn_y2 = 0.0;
-                                    for(unsigned long j=0; j<path->GetPoints()-1; j++){
-                                        if(j==0){
-                                            extn_x = BgnExtn * angleY[j];
-                                            extn_y = BgnExtn * angleX[j];
-											extn_x2 = EndExtn * angleY[j];
-                                            extn_y2 = EndExtn * angleX[j];
-                                            angleX_1 = angleX[j]; 
-                                            angleY_1 = angleY[j];
-                                            if(path->GetPoints()>2){
-                                                angleX_2 = (angleX[j]+angleX[j+1])/2;
-                                                angleY_2 = (angleY[j]+angleY[j+1])/2;
-                                            }
-                                            else{
-                                                angleX_2 = angleX[j]; 
-                                                angleY_2 = angleY[j];
-                                            }
-                                            
-                                        }
-                                        else if(j==path->GetPoints()-2){
-											extn_x = BgnExtn * angleY[j];
-                                            extn_y = BgnExtn * angleX[j];
-                                            extn_x2 = EndExtn * angleY[j];
-                                            extn_y2 = EndExtn * angleX[j];
-                                            angleX_1 = (angleX[j]+angleX[j-1])/2;
-                                            angleY_1 = (angleY[j]+angleY[j-1])/2;
-                                            angleX_2 = angleX[j]; 
-                                            angleY_2 = angleY[j];
-                                        }else{
-											extn_x = extn_y = extn_x2 = extn_y2 = 0.0;
-                                            //extn_x = 0.0;
-                                            //extn_y = 0.0;
-                                            angleX_1 = (angleX[j]+angleX[j-1])/2;
-                                            angleY_1 = (angleY[j]+angleY[j-1])/2;
-                                            angleX_2 = (angleX[j]+angleX[j+1])/2;
-                                            angleY_2 = (angleY[j]+angleY[j+1])/2;
-                                        }
-                                        
-                                        // Normalize
-                                        l = sqrt(angleX_1*angleX_1+angleY_1*angleY_1);
-                                        if(l>0.01){
-                                            angleX_1 /= l; angleY_1 /= l;
-                                        }
-                                        l = sqrt(angleX_2*angleX_2+angleY_2*angleY_2);
-                                        if(l>0.01){
-                                            angleX_2 /= l; angleY_2 /= l;
-                                        }
-                                        
-                                        // Readjust path width
-                                        l = (angleX_1*angleX[j]+angleY_1*angleY[j]);
-                                        if(l>0.01){
-                                            angleX_1 /= l; angleY_1 /= l;
-                                        }
-                                        l = (angleX_2*angleX[j]+angleY_2*angleY[j]);
-                                        if(l>0.01){
-                                            angleX_2 /= l; angleY_2 /= l;
-                                        }
-                                        
-                                        // 1
-                                        if(j==0){
-                                            points[0].X = path->GetXCoords(j) - path->GetWidth() * angleX_1 + extn_x;// + offx;
-                                            points[0].Y = path->GetYCoords(j) - path->GetWidth() * angleY_1 - extn_y;// + offy;
-                                        }
-                                        else{
-                                            points[0].X = path->GetXCoords(j) - path->GetWidth() * angleX_1;// + offx;
-                                            points[0].Y = path->GetYCoords(j) - path->GetWidth() * angleY_1;// + offy;
-                                        }
-                                        //points[0].Z = z2;
-                                        
-                                        // 2
-                                        if(j==0){
-                                            points[1].X = path->GetXCoords(j) + path->GetWidth() * angleX_1 + extn_x;// + offx;
-                                            points[1].Y = path->GetYCoords(j) + path->GetWidth() * angleY_1 - extn_y;// + offy;
-                                        }
-                                        else{
-                                            points[1].X = path->GetXCoords(j) + path->GetWidth() * angleX_1; 
-                                            points[1].Y = path->GetYCoords(j) + path->GetWidth() * angleY_1;
-                                        }
-                                        //points[1].Z = z2;
-                                        
-                                        // 3 
-                                        if(j==path->GetPoints()-2){
-                                            points[2].X = path->GetXCoords(j+1) + path->GetWidth() * angleX_2 - extn_x2;// + offx;
-                                            points[2].Y = path->GetYCoords(j+1) + path->GetWidth() * angleY_2 + extn_y2;// + offy;
-                                        }
-                                        else{
-                                            points[2].X = path->GetXCoords(j+1) + path->GetWidth() * angleX_2;// + offx;
-                                            points[2].Y = path->GetYCoords(j+1) + path->GetWidth() * angleY_2;// + offy;
-                                        }
-                                        //points[2].Z = z2;
-                                        
-                                        // 4
-                                        if(j==path->GetPoints()-2){
-                                            points[3].X = path->GetXCoords(j+1) - path->GetWidth() * angleX_2 - extn_x2;// + offx;
-                                            points[3].Y = path->GetYCoords(j+1) - path->GetWidth() * angleY_2 + extn_y2;// + offy;
-                                        }
-                                        else{
-                                            points[3].X = path->GetXCoords(j+1) - path->GetWidth() * angleX_2;// + offx;
-                                            points[3].Y = path->GetYCoords(j+1) - path->GetWidth() * angleY_2;// + offy;
-                                        }
-                                        //points[3].Z = z2;
-                                        
-                                        
-                                        if(j==0)
-                                        {
-                                            P[0].X = points[0].X; P[0].Y = points[0].Y;
-                                            P[1].X = points[1].X; P[1].Y = points[1].Y;
-                                            
-                                            //poly->AddPoint(points[0].X, points[0].Y);
-                                            //poly->AddPoint(points[1].X, points[1].Y);
-                                            //poly->AddPoint(poly->GetPoints()-1, points[0].X, points[0].Y); // Close contour
-                                        }
-                                        P[j+2].X = points[2].X; P[j+2].Y = points[2].Y;
-                                        P[path->GetPoints()*2-1-j].X = points[3].X; P[path->GetPoints()*2-1-j].Y = points[3].Y;
-                                        //poly->AddPoint(points[2].X, points[2].Y);
-                                        //verts[j+2] = points[2];
-                                        //poly->AddPoint(points[3].X, points[3].Y);
-                                        //verts[numVerts-1-j] = points[3];
-                                    }
-
-                                    poly->Clear();
-                                    for(unsigned j=0;j<path->GetPoints()*2;j++)
-                                        poly->AddPoint(P[j].X, P[j].Y);
-									poly->Tesselate();
-                                    
-                                }
-                            }
-                        }
-                        break;
-                        
-                    default:
-                        break;
-                }
 				_currentstrans = 0;
 				break;
 			case rnBgnStr:
 				v_printf(3, "BGNSTR\n");
-				while(_recordlen){
-					GetTwoByteSignedInt();
-				}
+				_structbegin = _reader.GetOffset() + 4 + record.RecordLength;
+				SkipRecord();
 				break;
 			case rnStrName:
 				v_printf(3, "STRNAME ");
@@ -431,19 +913,16 @@ bool GDSParse::ParseFile(char *topcell)
 				_currentelement = elText;
 				break;
 			case rnLayer:
-				_currentlayer = GetTwoByteSignedInt();
+				_currentlayer = (uint16_t)GetTwoByteSignedInt();
 				v_printf(3, "LAYER (%d)\n", _currentlayer);
 				break;
 			case rnDataType:
-				_currentdatatype = GetTwoByteSignedInt();
+				_currentdatatype = (uint16_t)GetTwoByteSignedInt();
 				v_printf(3, "DATATYPE (%d)\n", _currentdatatype);
 				break;
 			case rnWidth:
-				_currentwidth = (float)(GetFourByteSignedInt()/2);
-				if(_currentwidth > 0){
-					_currentwidth *= _units;
-				}
-				v_printf(3, "WIDTH (%.3f)\n", _currentwidth*2);
+				_currentwidth = (float)GetFourByteSignedInt()/2.0f; // Database units
+				v_printf(3, "WIDTH (%.0f)\n", _currentwidth*2);
 				// Scale to a half to make width correct when adding and
 				// subtracting
 				break;
@@ -476,13 +955,13 @@ bool GDSParse::ParseFile(char *topcell)
 				ParseSName();
 				break;
 			case rnPathType:
-				if(!_unsupported[rnPathType]){
-					v_printf(2, "Incomplete support for GDS2 record type: PATHTYPE\n");
-					_unsupported[rnPathType] = true;
-				}
-				//FIXME
 				_currentpathtype = GetTwoByteSignedInt();
 				v_printf(3, "PATHTYPE (%d)\n", _currentpathtype);
+				if(_currentpathtype != 0 && _currentpathtype != 1 && _currentpathtype != 2 && _currentpathtype != 4){
+					if(!_shared->_unsupported[rnPathType] && !_shared->_unsupported[rnPathType].exchange(true)){
+						v_printf(2, "Unsupported PATHTYPE %d, drawing flush ends\n", _currentpathtype);
+					}
+				}
 				break;
 			case rnTextType:
 				ReportUnsupported("TEXTTYPE", rnTextType);
@@ -621,27 +1100,22 @@ Not used in GDS2 spec	case rnUString:
 				break;
 			case rnPropAttr:
 				ReportUnsupported("PROPATTR", rnPropAttr);
-				v_printf(3, "PROPATTR (");
-				while(_recordlen){
-					v_printf(3, "%d ", GetTwoByteSignedInt());
-				}
-				v_printf(3, ")\n");
+				v_printf(3, "PROPATTR\n");
+				SkipRecord();
 				break;
 			case rnPropValue:
 				ReportUnsupported("PROPVALUE", rnPropValue);
-				tempstr = GetAsciiString();
-				v_printf(3, "PROPVALUE (\"%s\")\n", tempstr);
-				delete [] tempstr;
+				v_printf(3, "PROPVALUE\n");
+				SkipRecord();
 				break;
 			case rnBox:
-				ReportUnsupported("BOX", rnBox);
 				v_printf(3, "BOX\n");
 				/* Empty */
 				_currentelement = elBox;
 				break;
 			case rnBoxType:
-				ReportUnsupported("BOXTYPE", rnBoxType);
-				v_printf(3, "BOXTYPE (%d)\n", GetTwoByteSignedInt());
+				_currentdatatype = (uint16_t)GetTwoByteSignedInt(); // Maps like a datatype
+				v_printf(3, "BOXTYPE (%d)\n", _currentdatatype);
 				break;
 			case rnPlex:
 				ReportUnsupported("PLEX", rnPlex);
@@ -652,14 +1126,12 @@ Not used in GDS2 spec	case rnUString:
 				v_printf(3, ")\n");
 				break;
 			case rnBgnExtn:
-				ReportUnsupported("BGNEXTN", rnBgnExtn);
-				_currentbgnextn = _units * (float)GetFourByteSignedInt();
+				_currentbgnextn = (float)GetFourByteSignedInt();
 				v_printf(3, "BGNEXTN (%f)\n", _currentbgnextn);
 				break;
 			case rnEndExtn:
-				ReportUnsupported("ENDEXTN", rnEndExtn);
-				_currentendextn = _units * (float)GetFourByteSignedInt();
-				v_printf(3, "ENDEXTN (%ld)\n", _currentendextn);
+				_currentendextn = (float)GetFourByteSignedInt();
+				v_printf(3, "ENDEXTN (%f)\n", _currentendextn);
 				break;
 			case rnTapeNum:
 				ReportUnsupported("TAPENUM", rnTapeNum);
@@ -784,7 +1256,7 @@ Not used in GDS2 spec	case rnUString:
 				/* Empty */
 				break;
 			default:
-				v_printf(2, "Unknown record type (%d) at position %ld.\n", recordtype, ftell(_iptr));
+				v_printf(2, "Unknown record type (%d) at position %lld.\n", recordtype, (long long)_reader.GetOffset());
 				//return true;
 				break;
 		}
@@ -823,21 +1295,12 @@ void GDSParse::ParseSName()
 
 	char *str;
 	str = GetAsciiString();
-	if(_sname){
-		delete [] _sname;
-		_sname = NULL;
-	}
-	_sname = new char[strlen(str)+1];
-	if(_sname){
-		strcpy(_sname, str);
-		for(unsigned int i=0; i<strlen(_sname); i++){
-			if(_sname[i] && (_sname[i] < 48 || _sname[i] > 57) && (_sname[i] < 65 || _sname[i] > 90) && (_sname[i] < 97 || _sname[i] > 122)){
-				_sname[i] = '_';
-			}
-		}
-		v_printf(3, "(\"%s\")\n", _sname);
+	if(str){
+		gds_clean_name(str);
+		_sname = gds_intern(str);
+		v_printf(3, "(\"%s\")\n", str);
 	}else{
-		v_printf(1, "Unable to allocate memory for string (%d)\n", strlen(str)+1);
+		_sname = GDS_NO_NAME;
 	}
 	delete [] str;
 }
@@ -856,18 +1319,19 @@ void GDSParse::ParseStrName()
 	str = GetAsciiString();
 
 	if(str){
-		// Disallow invalid characters in POV-Ray _names.
-		for(unsigned int i=0; i<strlen(str); i++){
-			if(str[i] && (str[i] < 48 || str[i] > 57) && (str[i] < 65 || str[i] > 90) && (str[i] < 97 || str[i] > 122)){
-				str[i] = '_';
-			}
-		}
+		gds_clean_name(str);
 		v_printf(3, "(\"%s\")", str);
 
 		// This calls our own NewObject function which is pure virtual so the end 
 		// user must define it. This means we can always add a unknown object as
 		// long as it inherits from GDSObject.
-		_CurrentObject = _Objects->AddObject(NewObject(str));
+		if(_loadobject){
+			_CurrentObject = _loadobject;
+			_loadobject = NULL;
+		}else{
+			_CurrentObject = _Objects->AddObject(NewObject(str));
+		}
+		_CurrentObject->SetUnits(_units);
 		delete [] str;
 	}
 	v_printf(3, "\n");
@@ -875,33 +1339,15 @@ void GDSParse::ParseStrName()
 
 void GDSParse::ParseXYPath()
 {
-	float X, Y;
 	int points = _recordlen/8;
-	int i;
 	struct ProcessLayer *thislayer = NULL;
 
 	if(_process != NULL){
 		thislayer = _process->GetLayer(_currentlayer, _currentdatatype);
 
 		if(thislayer==NULL){
-			// _layer_warning only has fixed bounds at the moment.
-			// Not sure how to best make it dynamic.
-
-			if(!_generate_process){
-				if(!_layer_warning[_currentlayer+1][_currentdatatype+1]){
-					v_printf(2, "Notice: Layer %d, datatype %d is in the GDS, but not in the process.\n", _currentlayer, _currentdatatype);
-					//v_printf(1, "\tIgnoring this layer.\n");
-					_layer_warning[_currentlayer+1][_currentdatatype+1] = true;
-				}
-			}else{
-				if(!_layer_warning[_currentlayer+1][_currentdatatype+1]){
-					_process->AddLayer(_currentlayer, _currentdatatype);
-					_layer_warning[_currentlayer+1][_currentdatatype+1] = true;
-				}
-			}
-			while(_recordlen){
-				GetFourByteSignedInt();
-			}
+			ReportUnknownLayer();
+			SkipRecord();
 			_currentwidth = 0.0; // Always reset to default for paths in case width not specified
 			_currentpathtype = 0;
 			_currentangle = 0.0;
@@ -916,22 +1362,13 @@ void GDSParse::ParseXYPath()
 	if(_currentwidth){
 		/* FIXME - need to check for -ve value and then not scale */
 		if(thislayer && thislayer->Thickness && _CurrentObject){
+			// Expanded by BuildGeometry()
 			_CurrentObject->AddPath(_currentpathtype, _units*thislayer->Height, _units*thislayer->Thickness, points, _currentwidth, _currentbgnextn, _currentendextn, thislayer);
+			_CurrentObject->GetCurrentPath()->AddPoints(_record);
 		}
-		for(i=0; i<points; i++){
-			X = _units * (float)GetFourByteSignedInt();
-			Y = _units * (float)GetFourByteSignedInt();
-			v_printf(3, "(%.3f,%.3f) ", X, Y);
-			if(thislayer && thislayer->Thickness &&  _CurrentObject){
-				_CurrentObject->GetCurrentPath()->AddPoint(i, X, Y);
-			}
-		}
-	}else{
-		for(i=0; i<points; i++){
-			GetFourByteSignedInt();
-			GetFourByteSignedInt();
-		}
+		PrintXY(points);
 	}
+	SkipRecord();
 	v_printf(3, "\n");
 	_currentwidth = 0.0; // Always reset to default for paths in case width not specified
 	_currentpathtype = 0;
@@ -1036,31 +1473,15 @@ _currentstrans=0; //Oh yeah!*/
 
 void GDSParse::ParseXYBoundary()
 {
-	float X, Y;
-	//float firstX=0.0, firstY=0.0;
 	int points = _recordlen/8;
-	int i;
 	struct ProcessLayer *thislayer = NULL;
 
 	if(_process != NULL){
 		thislayer = _process->GetLayer(_currentlayer, _currentdatatype);
 
 		if(thislayer==NULL){
-			if(!_generate_process){
-				if(!_layer_warning[_currentlayer+1][_currentdatatype+1]){
-					v_printf(2, "Notice: Layer %d, datatype %d is in the GDS, but not in the process.\n", _currentlayer, _currentdatatype);
-					//v_printf(1, "\tIgnoring this layer.\n");
-					_layer_warning[_currentlayer+1][_currentdatatype+1] = true;
-				}
-			}else{
-				if(!_layer_warning[_currentlayer+1][_currentdatatype+1]){
-					_process->AddLayer(_currentlayer, _currentdatatype);
-					_layer_warning[_currentlayer+1][_currentdatatype+1] = true;
-				}
-			}
-			while(_recordlen){
-				GetFourByteSignedInt();
-			}
+			ReportUnknownLayer();
+			SkipRecord();
 			_currentwidth = 0.0; // Always reset to default for paths in case width not specified
 			_currentpathtype = 0;
 			_currentangle = 0.0;
@@ -1073,18 +1494,25 @@ void GDSParse::ParseXYBoundary()
 	}
 
 	if(thislayer && thislayer->Thickness && _CurrentObject){
-		_CurrentObject->AddPolygon(_units*thislayer->Height, _units*thislayer->Thickness, points-1, thislayer);
-	}
-
-	for(i=0; i<points; i++){
-		X = _units * (float)GetFourByteSignedInt();
-		Y = _units * (float)GetFourByteSignedInt();
-		v_printf(3, "(%.3f,%.3f) ", X, Y);
-
-		if(thislayer && thislayer->Thickness && _CurrentObject && i!=points-1){ // Don't close the contour!
-			_CurrentObject->GetCurrentPolygon()->AddPoint(X, Y);
+		GDSBox box;
+		int32_t xy[10];
+
+		// Most boundaries and every box are rectangles, keep those as such
+		if(points == 5)
+			gds_decode_xy(_record, 10, xy);
+		if(points == 5 && box.setRectangle(xy, 5)){
+			_CurrentObject->AddRect(_units*thislayer->Height, _units*thislayer->Thickness, box, thislayer);
+		}else{
+			_CurrentObject->AddPolygon(_units*thislayer->Height, _units*thislayer->Thickness, points-1, thislayer);
+			if(points > 1){
+				GDSPolygon polygon = _CurrentObject->GetCurrentPolygon();
+
+				polygon.AddPoints(_record, points-1); // Don't close the contour! Tesselated by BuildGeometry()
+			}
 		}
 	}
+	PrintXY(points);
+	SkipRecord();
 	v_printf(3, "\n");
 	
 	_currentwidth = 0.0; // Always reset to default for paths in case width not specified
@@ -1101,7 +1529,7 @@ _currentstrans=0; //Oh yeah!
 void GDSParse::ParseXY()
 {
 	float X, Y;
-	float firstX=0.0, firstY=0.0, secondX=0.0, secondY=0.0;
+	int32_t coords[6];
 	struct ProcessLayer *thislayer = NULL;
 	int Flipped;
 
@@ -1113,12 +1541,12 @@ void GDSParse::ParseXY()
 	switch(_currentelement){
 		case elSRef:
 			_SRefElements++;
-			X = _units * (float)GetFourByteSignedInt();
-			Y = _units * (float)GetFourByteSignedInt();
-			v_printf(3, "(%.3f,%.3f)\n", X, Y);
+			coords[0] = GetFourByteSignedInt();
+			coords[1] = GetFourByteSignedInt();
+			v_printf(3, "(%d,%d)\n", coords[0], coords[1]);
 
 			if(_CurrentObject){
-				_CurrentObject->AddSRef(_sname, X, Y, Flipped, _currentmag);
+				_CurrentObject->AddSRef(_sname, coords[0], coords[1], Flipped, _currentmag);
 				if(_currentangle){
 					_CurrentObject->SetSRefRotation(0, -_currentangle, 0);
 				}
@@ -1127,19 +1555,19 @@ void GDSParse::ParseXY()
 
 		case elARef:
 			_ARefElements++;
-			firstX = _units * (float)GetFourByteSignedInt();
-			firstY = _units * (float)GetFourByteSignedInt();
-			secondX = _units * (float)GetFourByteSignedInt();
-			secondY = _units * (float)GetFourByteSignedInt();
-			X = _units * (float)GetFourByteSignedInt();
-			Y = _units * (float)GetFourByteSignedInt();
-			v_printf(3, "(%.3f,%.3f) ", firstX, firstY);
-			v_printf(3, "(%.3f,%.3f) ", secondX, secondY);
-			v_printf(3, "(%.3f,%.3f)\n", X, Y);
+			if(_recordlen < 24){
+				SkipRecord();
+				break;
+			}
+			gds_decode_xy(_record, 6, coords);
+			SkipRecord();
+			v_printf(3, "(%d,%d) ", coords[0], coords[1]);
+			v_printf(3, "(%d,%d) ", coords[2], coords[3]);
+			v_printf(3, "(%d,%d)\n", coords[4], coords[5]);
 
 			if(_CurrentObject){
 				
-				_CurrentObject->AddARef(_sname, firstX, firstY, secondX, secondY, X, Y, _arraycols, _arrayrows, Flipped, _currentmag);
+				_CurrentObject->AddARef(_sname, coords[0], coords[1], coords[2], coords[3], coords[4], coords[5], _arraycols, _arrayrows, Flipped, _currentmag);
 				if(_currentangle){
 					_CurrentObject->SetARefRotation(0, -_currentangle, 0);
 				}
@@ -1150,22 +1578,8 @@ void GDSParse::ParseXY()
 			_TextElements++;
 
 			if(thislayer==NULL){
-				if(!_generate_process)
-				{
-					if(!_layer_warning[_currentlayer+1][_currentdatatype+1]){
-						v_printf(2, "Notice: Layer %d, datatype %d is in the GDS, but not in the process.\n", _currentlayer, _currentdatatype);
-						//v_printf(1, "\tIgnoring this string.\n");
-						_layer_warning[_currentlayer+1][_currentdatatype+1] = true;
-					}
-				}else{
-					if(!_layer_warning[_currentlayer+1][_currentdatatype+1]){
-						_process->AddLayer(_currentlayer, _currentdatatype);
-						_layer_warning[_currentlayer+1][_currentdatatype+1] = true;
-					}
-				}
-				while(_recordlen){
-					GetFourByteSignedInt();
-				}
+				ReportUnknownLayer();
+				SkipRecord();
 				_currentwidth = 0.0; // Always reset to default for paths in case width not specified
 				_currentpathtype = 0;
 				_currentangle = 0.0;
@@ -1193,9 +1607,7 @@ void GDSParse::ParseXY()
 			}
 			break;
 		default:
-			while(_recordlen){
-				GetFourByteSignedInt();
-			}
+			SkipRecord();
 			break;
 	}
 	_currentwidth = 0.0; // Always reset to default for paths in case width not specified
@@ -1209,89 +1621,76 @@ _currentstrans=0; //Oh yeah!
 
 }
 
-short GDSParse::GetBitArray()
+void GDSParse::PrintXY(int points)
 {
-	byte byte1;
+	if(verbose_output < 3)
+		return;
 
-	fread(&byte1, 1, 1, _iptr);
-	fread(&byte1, 1, 1, _iptr);
+	for(int i=0; i<points; i++){
+		v_printf(3, "(%.3f,%.3f) ", _units * (float)gds_int32(_record + 8*i), _units * (float)gds_int32(_record + 8*i + 4));
+	}
+}
+
+void GDSParse::SkipRecord()
+{
+	_record += _recordlen;
+	_recordlen = 0;
+}
 
+short GDSParse::GetBitArray()
+{
+	if(_recordlen < 2){
+		SkipRecord();
+		return 0;
+	}
+	_record += 2;
 	_recordlen-=2;
 	return 0;
 }
 
 double GDSParse::GetEightByteReal()
 {
-	byte value;
-	byte b8, b2, b3, b4, b5, b6, b7;
-	double sign=1.0;
-	double exponent;
-	double mant;
-
-	fread(&value, 1, 1, _iptr);
-	if(value & 128){
-		value -= 128;
-		sign = -1.0;
-	}
-	exponent = (double )value;
-	exponent -= 64.0;
-	mant=0.0;
-
-	fread(&b2, 1, 1, _iptr);
-	fread(&b3, 1, 1, _iptr);
-	fread(&b4, 1, 1, _iptr);
-	fread(&b5, 1, 1, _iptr);
-	fread(&b6, 1, 1, _iptr);
-	fread(&b7, 1, 1, _iptr);
-	fread(&b8, 1, 1, _iptr);
-
-	mant += b8;
-	mant /= 256.0;
-	mant += b7;
-	mant /= 256.0;
-	mant += b6;
-	mant /= 256.0;
-	mant += b5;
-	mant /= 256.0;
-	mant += b4;
-	mant /= 256.0;
-	mant += b3;
-	mant /= 256.0;
-	mant += b2;
-	mant /= 256.0;
+	double value;
 
+	if(_recordlen < 8){
+		SkipRecord();
+		return 0.0;
+	}
+	value = gds_real8(_record);
+	_record += 8;
 	_recordlen-=8;
 
-	return sign*(mant*pow(16.0,exponent));
+	return value;
 }
 
 int32_t GDSParse::GetFourByteSignedInt()
 {
 	int32_t value;
-	fread(&value, 4, 1, _iptr);
-	
+
+	if(_recordlen < 4){
+		SkipRecord();
+		return 0;
+	}
+	value = gds_int32(_record);
+	_record += 4;
 	_recordlen-=4;
 
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-	return endian_swap_long(value);
-#else
 	return value;
-#endif
 }
 
 int16_t GDSParse::GetTwoByteSignedInt()
 {
 	int16_t value;
 
-	fread(&value, 2, 1, _iptr);
-
+	if(_recordlen < 2){
+		SkipRecord();
+		return 0;
+	}
+	value = gds_int16(_record);
+	_record += 2;
 	_recordlen-=2;
 
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-	return endian_swap_short(value);
-#else
 	return value;
-#endif
 }
 
 char *GDSParse::GetAsciiString()
@@ -1299,26 +1698,38 @@ char *GDSParse::GetAsciiString()
 	char *str=NULL;
 	
 	if(_recordlen>0){
-		_recordlen += _recordlen%2; /* Make sure length is even, why would you do this? */
 		str = new char[_recordlen+1];
 		if(!str){
 			v_printf(1, "Unable to allocate memory for ascii string (%d)\n", _recordlen);
 			return NULL;
 		}
-		fread(str, 1, _recordlen, _iptr);
+		memcpy(str, _record, _recordlen);
 		str[_recordlen] = 0;
-		_recordlen = 0;
+		SkipRecord();
 	}
 	return str;
 }
 
 void GDSParse::ReportUnsupported(const char *Name, enum RecordNumbers rn)
 {
-	if(!_unsupported[rn]){
+	// Check before the exchange, these records come by the million
+	if(!_shared->_unsupported[rn] && !_shared->_unsupported[rn].exchange(true)){
 		v_printf(2, "Unsupported GDS2 record type: %s\n", Name);
-		_unsupported[rn] = true;
 	}
+}
 
+void GDSParse::ReportUnknownLayer()
+{
+	// Report each layer once, also when structures are parsed in parallel
+	if(!_process->WarnOnce(_currentlayer, _currentdatatype)){
+		return;
+	}
+
+	if(!_generate_process){
+		v_printf(2, "Notice: Layer %d, datatype %d is in the GDS, but not in the process.\n", _currentlayer, _currentdatatype);
+	}else{
+		_process->AddLayer(_currentlayer, _currentdatatype);
+	}
 }
 
 class GDSProcess *GDSParse::GetProcess() {
@@ -34,6 +34,18 @@
 #include "gds_globals.h"
 #include "gdsobject.h"
 #include "gdsobjectlist.h"
+#include "gdsreader.h"
+#include "gdscache.h"
+#include "oasisreader.h"
+
+// Where a structure lives in the file, found by GDSParse::IndexStructures()
+typedef struct GDSStructureRange{
+	int64_t begin, end;
+	unsigned long long hash;
+	string name;
+	vector<string> children;	// Referenced structure names
+	class GDSObject *object;
+}GDSStructureRange;
 
 class GDSParse
 {
@@ -41,7 +53,7 @@ protected:
 	char			*_libname;
 	char			*_topcellname;
 
-	int16_t			_currentlayer;
+	int32_t			_currentlayer;		// 0 to 65535, -1 if not set
 	float			_currentwidth;
 	int16_t			_currentpathtype;
 	gds_element_type	_currentelement;
@@ -50,12 +62,12 @@ protected:
 	char			*_textstring;
 	int16_t			_currentstrans;
 	float			_currentangle;
-	int16_t			_currentdatatype;
+	int32_t			_currentdatatype;
 	float			_currentmag;
 	float			_currentbgnextn;
 	float			_currentendextn;
 
-	char			*_sname;
+	unsigned int		_sname;		// Interned name of the next reference
 	int16_t			_arrayrows, _arraycols;
 	float			_units;
 	float			_angle;
@@ -63,7 +75,20 @@ protected:
 	FILE			*_optr;
 	class GDSProcess	*_process;
 	
-	int16_t			_recordlen;
+	GDSReader		_reader;
+	const byte		*_record;	// Cursor into the current record
+	int32_t			_recordlen;	// Bytes left in the current record
+
+	int64_t			_structbegin;	// Offset of the first record after BGNSTR
+
+	// Lazy loading, all structures are known but only some are parsed
+	vector<GDSStructureRange>	_index;
+	map<string, unsigned int>	_indexnames;
+	int64_t			_indexsize;
+	class GDSObject		*_loadobject;	// Parse the next STRNAME into this stub
+
+	class GDSCache		*_cache;	// NULL when caching is off
+	bool			_rebuildcache;	// Ignore the cache, but write it
 
 	/* Output options */
 	bool			_allow_multiple_output;
@@ -72,17 +97,16 @@ protected:
 	bool			_generate_process;
 
 	/*
-	** Both of these variables have fixed bounds because
-	** they are not dependant on the GDS2 spec, not on the
-	** file we are parsing.
+	** This variable has fixed bounds because it is not
+	** dependant on the GDS2 spec, not on the file we are parsing.
 	** There will never be more than 70 records.
-	** The maximum layer and datatype are both defined as
-	** 255, but but could be as high as 32,767 because of
-	** the way they are stored (2 byte int). It might be worth
-	** checking if they are greater than 255
+	** Missing layers are remembered by the process, see
+	** GDSProcess::WarnOnce(), layer and datatype go up to 65535.
+	**
+	** Worker threads report through the parser that started them.
 	*/
-	bool			_unsupported[70];
-	bool			_layer_warning[257][257];
+	atomic<bool>		_unsupported[70];
+	GDSParse		*_shared;
 
 	long			_PathElements;
 	long			_BoundaryElements;
@@ -103,6 +127,7 @@ protected:
 	void ParseXY();
 	void ParseXYPath();
 	void ParseXYBoundary();
+	void PrintXY(int points);
 	void ParseSTrans();
     void AddSubstrate(char *topcell);
 
@@ -111,6 +136,7 @@ protected:
 	void HandleBoundary();
 	void HandlePath();
 
+	void SkipRecord();
 	short GetBitArray();
 	double GetEightByteReal();
 	int32_t GetFourByteSignedInt();
@@ -118,8 +144,19 @@ protected:
 	char *GetAsciiString();
 
 	void ReportUnsupported(const char *Name, enum RecordNumbers rn);
+	void ReportUnknownLayer();
 	
+	bool OpenFile();
 	bool ParseFile(char *topcell);
+	bool ParseRecords(char *topcell);
+	bool ParseStructures(char *topcell);
+	bool ReloadStructures(class GDSObjectList *old);
+	bool IndexStructures(vector<GDSStructureRange>& structures);
+	bool ParseLazy(char *topcell);
+	void LoadStructures(unsigned int index);
+	bool StubsUnchanged(unsigned int index);
+	void BuildGeometry(const vector<GDSObject*>& objects);
+	void MergeIdenticalStructures();
 
 public:
 	class GDSObjectList	*_Objects; // Move to protected later on
@@ -128,6 +165,9 @@ public:
 	virtual ~GDSParse ();
 
 	bool Parse(FILE *iptr, char *topcell);
+	void SetCache(const char *gdsfile, bool rebuild); // Keep a <gdsfile>.gds3d cache
+	bool LoadStructure(const char *name); // Parse a stub and everything below it
+	bool HasUnloadedStructures();
 	virtual class GDSObject *NewObject(char *Name) = 0;
 	void Reload();
 
@@ -29,11 +29,13 @@
 
 #include "gdsobject.h"
 #include "gdspath.h"
+#include "gdsreader.h"
 
-GDSPath::GDSPath(int Type, float Height, float Thickness, unsigned int Points, float Width, float BgnExtn, float EndExtn, struct ProcessLayer *Layer)
+GDSPath::GDSPath(int Type, float Height, float Thickness, unsigned int Points, float Width, float BgnExtn, float EndExtn, struct ProcessLayer *Layer, GDSArena *arena)
+	: _Alloc(arena)
 {
 	_Type = Type;
-	_Coords = new Point2D[Points];
+	_Coords = _Alloc.allocate(Points);
 	_Height = Height;
 	_Thickness = Thickness;
 	_Points = Points;
@@ -45,10 +47,10 @@ GDSPath::GDSPath(int Type, float Height, float Thickness, unsigned int Points, f
 
 GDSPath::~GDSPath()
 {
-	if(_Coords) delete [] _Coords;
+	if(_Coords) _Alloc.deallocate(_Coords, _Points);
 }
 
-void GDSPath::AddPoint(unsigned int Index, float X, float Y)
+void GDSPath::AddPoint(unsigned int Index, int32_t X, int32_t Y)
 {
 	if(_Points >= Index){
 		_Coords[Index].X = X;
@@ -56,6 +58,169 @@ void GDSPath::AddPoint(unsigned int Index, float X, float Y)
 	}
 }
 
+void GDSPath::AddPoints(const byte *XY)
+{
+	gds_decode_xy(XY, _Points*2, &_Coords[0].X);
+}
+
+// Round ends are drawn with this many segments per half circle
+#define GDS_PATH_ROUND_STEPS	8
+
+// Joins with a longer miter than this, in half widths, are beveled
+#define GDS_PATH_MITER_LIMIT	4.0
+
+static const double gds_path_cos[GDS_PATH_ROUND_STEPS+1] = {
+	1.0, 0.92387953251128674, 0.70710678118654757, 0.38268343236508984, 0.0,
+	-0.38268343236508967, -0.70710678118654746, -0.92387953251128674, -1.0
+};
+static const double gds_path_sin[GDS_PATH_ROUND_STEPS+1] = {
+	0.0, 0.38268343236508978, 0.70710678118654746, 0.92387953251128674, 1.0,
+	0.92387953251128674, 0.70710678118654757, 0.38268343236508989, 0.0
+};
+
+// Rounds to the grid, points that round onto the previous one are dropped
+static void gds_path_point(GDSPolygon& Poly, double X, double Y)
+{
+	int32_t x = (int32_t)lround(X);
+	int32_t y = (int32_t)lround(Y);
+	unsigned int n = Poly.GetPoints();
+
+	if(n && Poly.GetXCoords(n-1) == x && Poly.GetYCoords(n-1) == y)
+		return;
+	Poly.AddPoint(x, y);
+}
+
+// Unit direction of the segment from point Index to Index+1
+void GDSPath::Direction(unsigned int Index, double& DX, double& DY) const
+{
+	double dx = (double)_Coords[Index+1].X - _Coords[Index].X;
+	double dy = (double)_Coords[Index+1].Y - _Coords[Index].Y;
+	double l = sqrt(dx*dx + dy*dy);
+
+	DX = dx/l;
+	DY = dy/l;
+}
+
+// Outline point of one side at point Index, Side is 1 for the right and -1
+// for the left. The offset is the sum of the normals of both segments,
+// scaled so it is a half width away from each of them.
+void GDSPath::AddCorner(GDSPolygon& Poly, unsigned int Index, unsigned int Count, double Side, double BgnExtn, double EndExtn) const
+{
+	double w = Side*fabs(_Width);
+	double px = _Coords[Index].X, py = _Coords[Index].Y;
+	double ax, ay, bx, by; // Directions before and after the point
+	double mx, my, c, l;
+
+	if(Index == 0){
+		Direction(0, bx, by);
+		ax = bx; ay = by;
+		px -= BgnExtn*bx;
+		py -= BgnExtn*by;
+	}else if(Index == Count-1){
+		Direction(Index-1, ax, ay);
+		bx = ax; by = ay;
+		px += EndExtn*ax;
+		py += EndExtn*ay;
+	}else{
+		Direction(Index-1, ax, ay);
+		Direction(Index, bx, by);
+	}
+
+	// Right hand normals are (Y, -X)
+	mx = ay + by;
+	my = -ax - bx;
+	c = 1.0 + ax*bx + ay*by;
+	if(c*GDS_PATH_MITER_LIMIT*GDS_PATH_MITER_LIMIT >= 2.0){
+		gds_path_point(Poly, px + w*mx/c, py + w*my/c);
+		return;
+	}
+
+	if((ax*by - ay*bx > 0.0) == (Side > 0.0)){
+		// Outer side of a sharp turn, cut the corner off. The right side
+		// is walked forwards and the left side backwards.
+		if(Side > 0.0){
+			gds_path_point(Poly, px + w*ay, py - w*ax);
+			gds_path_point(Poly, px + w*by, py - w*bx);
+		}else{
+			gds_path_point(Poly, px + w*by, py - w*bx);
+			gds_path_point(Poly, px + w*ay, py - w*ax);
+		}
+	}else{
+		// Inner side, keep the miter within the limit
+		l = sqrt(mx*mx + my*my);
+		if(l > 0.0)
+			gds_path_point(Poly, px + w*GDS_PATH_MITER_LIMIT*mx/l, py + w*GDS_PATH_MITER_LIMIT*my/l);
+		else
+			gds_path_point(Poly, px + w*ay, py - w*ax);
+	}
+}
+
+// Half circle around point Index, from the right side of direction DX,DY
+// over the front to the left side. Both end points are left out.
+void GDSPath::AddCap(GDSPolygon& Poly, unsigned int Index, double DX, double DY) const
+{
+	double w = fabs(_Width);
+	double px = _Coords[Index].X, py = _Coords[Index].Y;
+
+	for(unsigned int k=1; k<GDS_PATH_ROUND_STEPS; k++){
+		gds_path_point(Poly,
+			px + w*(DY*gds_path_cos[k] + DX*gds_path_sin[k]),
+			py + w*(-DX*gds_path_cos[k] + DY*gds_path_sin[k]));
+	}
+}
+
+unsigned int GDSPath::Expand(GDSGeometry *Geometry)
+{
+	double BgnExtn = 0.0, EndExtn = 0.0;
+	double dx, dy;
+	unsigned int n = 0, first, last, polygons = 0;
+
+	if(_Width == 0.0f || !_Layer || !_Coords)
+		return 0;
+
+	// Repeated points have no direction
+	for(unsigned int i=0; i<_Points; i++){
+		if(n && _Coords[i].X == _Coords[n-1].X && _Coords[i].Y == _Coords[n-1].Y)
+			continue;
+		_Coords[n++] = _Coords[i];
+	}
+	if(n < 2)
+		return 0;
+
+	switch(_Type){
+		case 2:
+			BgnExtn = EndExtn = fabs(_Width); // Width is a half width
+			break;
+		case 4:
+			BgnExtn = _BgnExtn;
+			EndExtn = _EndExtn;
+			break;
+		default: // 0 is flush, 1 gets round caps
+			break;
+	}
+
+	// Counter clockwise: right side forwards, left side backwards
+	for(first=0; first<n-1; first=last){
+		last = std::min(first + GDS_PATH_MAX_SEGMENTS, n-1);
+
+		GDSPolygon poly = Geometry->AddPolygon(_Height, _Thickness, _Layer, 2*(last-first+1));
+		if(first == 0 && _Type == 1){
+			Direction(0, dx, dy);
+			AddCap(poly, 0, -dx, -dy);
+		}
+		for(unsigned int j=first; j<=last; j++)
+			AddCorner(poly, j, n, 1.0, BgnExtn, EndExtn);
+		if(last == n-1 && _Type == 1){
+			Direction(n-2, dx, dy);
+			AddCap(poly, n-1, dx, dy);
+		}
+		for(unsigned int j=last+1; j-- > first; )
+			AddCorner(poly, j, n, -1.0, BgnExtn, EndExtn);
+		polygons++;
+	}
+
+	return polygons;
+}
 
 void GDSPath::SetRotation(float X, float Y, float Z)
 {
@@ -64,12 +229,12 @@ void GDSPath::SetRotation(float X, float Y, float Z)
 	_Rotate.Z = Z;
 }
 
-float GDSPath::GetXCoords(unsigned int Index)
+int32_t GDSPath::GetXCoords(unsigned int Index)
 {
 	return _Coords[Index].X;
 }
 
-float GDSPath::GetYCoords(unsigned int Index)
+int32_t GDSPath::GetYCoords(unsigned int Index)
 {
 	return _Coords[Index].Y;
 }
@@ -30,6 +30,12 @@
 #define __GDSPATH_H__
 
 #include "process_cfg.h"
+#include "gdsarena.h"
+#include "gdspolygon.h"
+
+// Longest run of segments in one outline polygon, longer paths are split
+// into several polygons that meet at a join
+#define GDS_PATH_MAX_SEGMENTS	8192
 
 class GDSPath
 {
@@ -41,19 +47,29 @@ private:
 	float			_Width;
 	float			_BgnExtn;
 	float			_EndExtn;
-	Point2D			*_Coords;
+	GDSPoint		*_Coords; // Database units, as are width and extensions
+	GDSArenaAllocator<GDSPoint>	_Alloc;
 	Transform		_Rotate;
 	struct ProcessLayer	*_Layer;
 
+	void Direction(unsigned int Index, double& DX, double& DY) const;
+	void AddCorner(GDSPolygon& Poly, unsigned int Index, unsigned int Count, double Side, double BgnExtn, double EndExtn) const;
+	void AddCap(GDSPolygon& Poly, unsigned int Index, double DX, double DY) const;
+
 public:
-	GDSPath(int PathType, float Height, float Thickness, unsigned int Points, float Width, float BgnExtn, float EndExtn, struct ProcessLayer *layer);
+	GDSPath(int PathType, float Height, float Thickness, unsigned int Points, float Width, float BgnExtn, float EndExtn, struct ProcessLayer *layer, GDSArena *arena = NULL);
 	~GDSPath();
 
-	void AddPoint(unsigned int Index, float X, float Y);
+	void AddPoint(unsigned int Index, int32_t X, int32_t Y);
+	void AddPoints(const byte *XY); // Decode all points of an XY record
 	void SetRotation(float X, float Y, float Z);
 
-	float GetXCoords(unsigned int Index);
-	float GetYCoords(unsigned int Index);
+	// Adds the outline of the path to Geometry as one or more polygons,
+	// returns how many
+	unsigned int Expand(class GDSGeometry *Geometry);
+
+	int32_t GetXCoords(unsigned int Index);
+	int32_t GetYCoords(unsigned int Index);
 	unsigned int GetPoints();
 
 	float GetHeight();
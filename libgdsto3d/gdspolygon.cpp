@@ -30,7 +30,10 @@
 
 #include "gdsobject.h"
 #include "gdspolygon.h"
+#include "gdsreader.h"
 #include "../math/Maths.h"
+#include <algorithm>
+#include <float.h>
 
 #ifndef M_PI
 	#define M_PI 3.14159265358979323846
@@ -120,8 +123,8 @@ GDSBB::GDSBB()
 
 void GDSBB::clear()
 {
-	min.X = min.Y = 10000.0f;
-	max.X = max.Y = -10000.0f;
+	min.X = min.Y = FLT_MAX;
+	max.X = max.Y = -FLT_MAX;
 }
 
 bool GDSBB::isEmpty()
@@ -155,6 +158,10 @@ void GDSBB::transform(const GDSMat& M)
 	Point2D P2(max.X, min.Y);
 	Point2D P3(max.X, max.Y);
 
+	// An empty box stays empty
+	if(min.X > max.X)
+		return;
+
 	clear();
 	addPoint(M * P0);
 	addPoint(M * P1);
@@ -162,261 +169,1578 @@ void GDSBB::transform(const GDSMat& M)
 	addPoint(M * P3);
 }
 
-bool GDSBB::isPointInside(const Point2D& P)
+bool GDSBB::isPointInside(const Point2D& P)
+{
+	if( (P.X - max.X) > 0.001f || (min.X-P.X) > 0.001f )
+			return false;
+	if( (P.Y - max.Y) > 0.001f || (min.Y-P.Y) > 0.001f )
+			return false;
+
+	return true;
+}
+
+bool GDSBB::intersect(const GDSBB& BB1, const GDSBB& BB2)
+{
+	// How much of a margin??
+	if( (BB1.min.X - BB2.max.X) > 0.001f || (BB2.min.X-BB1.max.X) > 0.001f )
+			return false;
+	if( (BB1.min.Y - BB2.max.Y) > 0.001f || (BB2.min.Y-BB1.max.Y) > 0.001f )
+			return false;
+
+	return true;
+}
+
+// GDSBox Class
+// Four corners, in either direction and starting anywhere, optionally
+// closed by repeating the first. Empty rectangles are left to the polygons.
+bool GDSBox::setRectangle(const int32_t *XY, unsigned int Count)
+{
+	if(Count == 5 && (XY[8] != XY[0] || XY[9] != XY[1]))
+		return false;
+	if(Count != 4 && Count != 5)
+		return false;
+
+	bool horizontal = XY[1] == XY[3] && XY[2] == XY[4] && XY[5] == XY[7] && XY[6] == XY[0];
+	bool vertical = XY[0] == XY[2] && XY[3] == XY[5] && XY[4] == XY[6] && XY[7] == XY[1];
+	if(!horizontal && !vertical)
+		return false;
+	if(XY[0] == XY[4] || XY[1] == XY[5])
+		return false;
+
+	MinX = std::min(XY[0], XY[4]);
+	MinY = std::min(XY[1], XY[5]);
+	MaxX = std::max(XY[0], XY[4]);
+	MaxY = std::max(XY[1], XY[5]);
+	return true;
+}
+
+// Rectangles only stay rectangles when turned by multiples of 90 degrees,
+// otherwise this is the box around the turned corners
+void GDSBox::transform(const GDSMat& M, float Units)
+{
+	double units = Units;
+	GDSBox B;
+
+	if(isEmpty())
+		return;
+
+	if(M.isManhattan())
+	{
+		int32_t e[4] = {(int32_t)lround(M[0]), (int32_t)lround(M[1]), (int32_t)lround(M[2]), (int32_t)lround(M[3])};
+		int32_t tx = (int32_t)lround(M[4]/units);
+		int32_t ty = (int32_t)lround(M[5]/units);
+
+		B.addPoint(e[0]*MinX + e[2]*MinY + tx, e[1]*MinX + e[3]*MinY + ty);
+		B.addPoint(e[0]*MaxX + e[2]*MaxY + tx, e[1]*MaxX + e[3]*MaxY + ty);
+	}
+	else
+	{
+		for(unsigned int i=0;i<4;i++)
+		{
+			double x = (i == 1 || i == 2) ? MaxX : MinX;
+			double y = i >= 2 ? MaxY : MinY;
+
+			B.addPoint((int32_t)lround(M[0]*x + M[2]*y + M[4]/units), (int32_t)lround(M[1]*x + M[3]*y + M[5]/units));
+		}
+	}
+	*this = B;
+}
+
+GDSBB GDSBox::toBB(float Units) const
+{
+	GDSBB BB;
+
+	if(!isEmpty())
+	{
+		BB.min = Point2D((float)(Units*(double)MinX), (float)(Units*(double)MinY));
+		BB.max = Point2D((float)(Units*(double)MaxX), (float)(Units*(double)MaxY));
+	}
+	return BB;
+}
+
+// GDSTransform Class
+const int32_t gds_orientation[8][4] =
+{
+	{1, 0, 0, 1}, {0, 1, -1, 0}, {-1, 0, 0, -1}, {0, -1, 1, 0},
+	{1, 0, 0, -1}, {0, 1, 1, 0}, {-1, 0, 0, 1}, {0, -1, -1, 0}
+};
+
+// M as left by GDSMat::Round(), whole entries with a single non-zero one
+// per row and column
+bool GDSTransform::setOrientation(const GDSMat& M)
+{
+	int32_t e[4];
+
+	for(unsigned int i=0;i<4;i++)
+	{
+		e[i] = (int32_t)lround(M[i]);
+		if(fabs(M[i] - e[i]) > 1e-6)
+			return false;
+	}
+
+	int32_t mag = abs(e[0]) + abs(e[1]);
+	if(mag < 1 || abs(e[2]) + abs(e[3]) != mag || (e[0] && e[1]) || (e[2] && e[3]))
+		return false;
+
+	for(uint32_t c=0;c<8;c++)
+	{
+		const int32_t *o = gds_orientation[c];
+		if(o[0]*mag == e[0] && o[1]*mag == e[1] && o[2]*mag == e[2] && o[3]*mag == e[3])
+		{
+			Code = c;
+			Mag = mag;
+			return true;
+		}
+	}
+	return false;
+}
+
+GDSMat GDSTransform::toMat(float Units) const
+{
+	const int32_t *e = gds_orientation[Code];
+	double units = Units;
+
+	return GDSMat((float)(Mag*e[0]), (float)(Mag*e[1]), (float)(Mag*e[2]), (float)(Mag*e[3]), (float)(units*X), (float)(units*Y));
+}
+
+// GDSTriangle Class
+void GDSTriangle::set(const GDSPoint& P1, const GDSPoint& P2, const GDSPoint& P3)
+{
+	coords[0] = P1;
+	coords[1] = P2;
+	coords[2] = P3;
+
+	bbox.clear();
+	bbox.addPoint(P1.X, P1.Y);
+	bbox.addPoint(P2.X, P2.Y);
+	bbox.addPoint(P3.X, P3.Y);
+}
+
+void GDSTriangle::project(int64_t AX, int64_t AY, int64_t& min, int64_t& max) const
+{
+	int64_t d;
+
+	min = AX*coords[0].X+AY*coords[0].Y;
+	max = min;
+
+	d = AX*coords[1].X+AY*coords[1].Y;
+	min = std::min(min, d);
+	max = std::max(max, d);
+
+	d = AX*coords[2].X+AY*coords[2].Y;
+	min = std::min(min, d);
+	max = std::max(max, d);
+}
+
+// Separating axis test on the edge normals, exact in integers. Triangles
+// that only touch do intersect, so abutting shapes connect.
+bool GDSTriangle::intersect(const GDSTriangle& T1, const GDSTriangle& T2)
+{
+	int64_t min1 = 0, max1 = 0, min2 = 0, max2 = 0;
+	const GDSTriangle *T[2] = {&T1, &T2};
+
+	// Bounding box Test
+	if(!GDSBox::intersect(T1.bbox, T2.bbox))
+		return false;
+
+	// Test the edges of both
+	for(unsigned int t=0;t<2;t++)
+	{
+		for(unsigned int i=0;i<3;i++)
+		{
+			const GDSPoint& P1 = T[t]->coords[i];
+			const GDSPoint& P2 = T[t]->coords[(i+1)%3];
+
+			T1.project((int64_t)P1.Y - P2.Y, (int64_t)P2.X - P1.X, min1, max1);
+			T2.project((int64_t)P1.Y - P2.Y, (int64_t)P2.X - P1.X, min2, max2);
+			if(min1 > max2 || min2 > max1)
+				return false;
+		}
+	}
+
+	// No seperating axis, so intersection must have taken place
+	return true;
+}
+
+// GDSGeometry Class
+GDSGeometry::GDSGeometry()
+{
+	_Bucketed = true;
+	_Stored = false;
+	_Units = 1.0f;
+	_LastRange = 0;
+}
+
+void GDSGeometry::Clear()
+{
+	_X.clear();
+	_Y.clear();
+	_Indices.clear();
+	_Faces.clear();
+	_Shared.clear();
+	_Polygons.clear();
+	_Layers.clear();
+	_Rects.clear();
+	_RectRange.clear();
+	_RectRanges.clear();
+	_Bucketed = true;
+}
+
+void GDSGeometry::ClearPolygons()
+{
+	Thaw();
+	GDSCoordArray().swap(_X);
+	GDSCoordArray().swap(_Y);
+	GDSIndexArray().swap(_Indices);
+	GDSRectArray().swap(_Faces);
+	GDSPolygonArray().swap(_Polygons);
+	_Shared.clear();
+	_Layers.clear();
+	_Bucketed = false;
+}
+
+// Reserve room for Count more elements. reserve() allocates exactly what is
+// asked, so growing by small steps would copy the array every time.
+template <class V>
+static void grow(V& v, size_t Count)
+{
+	if(v.size() + Count > v.capacity())
+		v.reserve(max(v.size() + Count, v.capacity()*2));
+}
+
+// Put the array in Arena at its exact size, or on the heap without one
+template <class V>
+static void store(V& v, GDSArena *Arena)
+{
+	if(v.get_allocator().arena == Arena && (Arena || v.capacity() <= v.size() + v.size()/4))
+		return;
+
+	V stored((typename V::allocator_type(Arena)));
+	stored.reserve(v.size());
+	stored.assign(v.begin(), v.end());
+	v.swap(stored);
+}
+
+// Arena memory cannot grow, move the arrays back to the heap first
+void GDSGeometry::Thaw()
+{
+	if(!_Stored)
+		return;
+
+	store(_X, NULL);
+	store(_Y, NULL);
+	store(_Indices, NULL);
+	store(_Faces, NULL);
+	store(_Polygons, NULL);
+	store(_Layers, NULL);
+	store(_Rects, NULL);
+	store(_RectRange, NULL);
+	store(_RectRanges, NULL);
+	_Stored = false;
+}
+
+void GDSGeometry::Reserve(unsigned int Polygons, unsigned int Points, unsigned int Indices)
+{
+	Thaw();
+	grow(_Polygons, Polygons);
+	grow(_X, Points);
+	grow(_Y, Points);
+	grow(_Indices, Indices);
+}
+
+GDSPolygon GDSGeometry::AddPolygon(float Height, float Thickness, struct ProcessLayer *Layer, unsigned int Points)
+{
+	GDSPolygonRecord R;
+
+	Thaw();
+	R.FirstPoint = _X.size();
+	R.FirstIndex = _Indices.size();
+	R.NumIndices = 0;
+	R.NumPoints = 0;
+	R.Flags = 0;
+	R.Height = Height;
+	R.Thickness = Thickness;
+	R.Layer = Layer;
+	_Polygons.push_back(R);
+	_Bucketed = false;
+
+	if(Points)
+	{
+		grow(_X, Points);
+		grow(_Y, Points);
+	}
+
+	return GDSPolygon(this, _Polygons.size()-1);
+}
+
+GDSPolygon GDSGeometry::AddPolygon(const GDSPolygon& P)
+{
+	if(P.isRect())
+	{
+		const GDSRectRange& range = P.Range();
+		GDSBox box = P.Rect();
+		GDSPolygon copy = AddPolygon(range.Height, range.Thickness, range.Layer, 4);
+
+		// The rectangle is its own face
+		copy.AddPoint(box.MinX, box.MinY);
+		copy.AddPoint(box.MaxX, box.MinY);
+		copy.AddPoint(box.MaxX, box.MaxY);
+		copy.AddPoint(box.MinX, box.MaxY);
+		copy.Record().Flags = GDS_POLYGON_FACES;
+		copy.Record().FirstIndex = _Faces.size();
+		copy.Record().NumIndices = 1;
+		grow(_Faces, 1);
+		_Faces.push_back(box);
+		return copy;
+	}
+
+	// Copy the record first, P may be a view of this geometry
+	GDSPolygonRecord R = P._Geometry->_Polygons[P._Index];
+	unsigned int firstpoint = R.FirstPoint, firstindex = R.FirstIndex;
+	GDSGeometry *source = P._Geometry;
+
+	Thaw();
+	R.FirstPoint = _X.size();
+	R.Flags &= ~GDS_POLYGON_SHARED;
+	_X.resize(R.FirstPoint + R.NumPoints);
+	_Y.resize(R.FirstPoint + R.NumPoints);
+
+	if(R.NumPoints)
+	{
+		memcpy(&_X[R.FirstPoint], &source->_X[firstpoint], R.NumPoints*sizeof(int32_t));
+		memcpy(&_Y[R.FirstPoint], &source->_Y[firstpoint], R.NumPoints*sizeof(int32_t));
+	}
+	if(R.Flags & GDS_POLYGON_FACES)
+	{
+		R.FirstIndex = _Faces.size();
+		_Faces.resize(R.FirstIndex + R.NumIndices);
+		if(R.NumIndices)
+			memcpy(&_Faces[R.FirstIndex], &source->_Faces[firstindex], R.NumIndices*sizeof(GDSBox));
+	}
+	else
+	{
+		R.FirstIndex = _Indices.size();
+		_Indices.resize(R.FirstIndex + R.NumIndices);
+		if(R.NumIndices)
+			memcpy(&_Indices[R.FirstIndex], &source->_Indices[firstindex], R.NumIndices*sizeof(uint16_t));
+	}
+
+	_Polygons.push_back(R);
+	_Bucketed = false;
+	return GDSPolygon(this, _Polygons.size()-1);
+}
+
+// Whether two outlines are the same, moved
+static bool gds_congruent(const int32_t *X1, const int32_t *Y1, const int32_t *X2, const int32_t *Y2, unsigned int Count)
+{
+	for(unsigned int i=1;i<Count;i++)
+	{
+		if((int64_t)X1[i] - X1[0] != (int64_t)X2[i] - X2[0] || (int64_t)Y1[i] - Y1[0] != (int64_t)Y2[i] - Y2[0])
+			return false;
+	}
+	return true;
+}
+
+void GDSGeometry::Append(GDSGeometry& Chunk)
+{
+	unordered_map<uint32_t, unsigned long long> hashes; // Of the first polygon of each shape in Chunk
+	unordered_map<uint32_t, uint32_t> moved; // Shared indices, first index in Chunk to here
+
+	Thaw();
+	for(unordered_multimap<unsigned long long, uint32_t>::iterator it=Chunk._Shared.begin();it!=Chunk._Shared.end();it++)
+		hashes[it->second] = it->first;
+
+	grow(_Polygons, Chunk._Polygons.size());
+	grow(_X, Chunk._X.size());
+	grow(_Y, Chunk._Y.size());
+	grow(_Faces, Chunk._Faces.size());
+	grow(_Indices, Chunk._Indices.size());
+	for(unsigned int i=0;i<Chunk._Polygons.size();i++)
+	{
+		GDSPolygonRecord R = Chunk._Polygons[i];
+		const int32_t *X = &Chunk._X[R.FirstPoint];
+		const int32_t *Y = &Chunk._Y[R.FirstPoint];
+		unsigned int first = R.FirstIndex;
+
+		R.FirstPoint = _X.size();
+		_X.insert(_X.end(), X, X + R.NumPoints);
+		_Y.insert(_Y.end(), Y, Y + R.NumPoints);
+		if(R.Flags & GDS_POLYGON_FACES)
+		{
+			R.FirstIndex = _Faces.size();
+			_Faces.insert(_Faces.end(), Chunk._Faces.begin() + first, Chunk._Faces.begin() + first + R.NumIndices);
+		}
+		else if(R.Flags & GDS_POLYGON_SHARED)
+		{
+			unordered_map<uint32_t, uint32_t>::iterator m = moved.find(first);
+
+			if(m == moved.end())
+			{
+				// First of its shape in Chunk, look for it here like Tesselate()
+				unsigned long long hash = hashes[i];
+				pair<unordered_multimap<unsigned long long, uint32_t>::iterator, unordered_multimap<unsigned long long, uint32_t>::iterator> range = _Shared.equal_range(hash);
+
+				uint32_t index = _Indices.size();
+				bool found = false;
+
+				for(;!found && range.first!=range.second;range.first++)
+				{
+					const GDSPolygonRecord& P = _Polygons[range.first->second];
+
+					found = P.NumPoints == R.NumPoints && !(P.Flags & GDS_POLYGON_FACES) && gds_congruent(&_X[P.FirstPoint], &_Y[P.FirstPoint], X, Y, R.NumPoints);
+					if(found)
+						index = P.FirstIndex;
+				}
+				if(!found)
+				{
+					_Shared.insert(make_pair(hash, (uint32_t)_Polygons.size()));
+					_Indices.insert(_Indices.end(), Chunk._Indices.begin() + first, Chunk._Indices.begin() + first + R.NumIndices);
+				}
+				m = moved.insert(make_pair(first, index)).first;
+			}
+			R.FirstIndex = m->second;
+		}
+		else
+		{
+			R.FirstIndex = _Indices.size();
+			_Indices.insert(_Indices.end(), Chunk._Indices.begin() + first, Chunk._Indices.begin() + first + R.NumIndices);
+		}
+		_Polygons.push_back(R);
+	}
+	_Bucketed = false;
+}
+
+void GDSGeometry::AddRect(float Height, float Thickness, struct ProcessLayer *Layer, const GDSBox& Box)
+{
+	unsigned int r = _LastRange;
+
+	Thaw();
+	if(r >= _RectRanges.size() || _RectRanges[r].Layer != Layer || _RectRanges[r].Height != Height || _RectRanges[r].Thickness != Thickness)
+	{
+		for(r=0;r<_RectRanges.size();r++)
+			if(_RectRanges[r].Layer == Layer && _RectRanges[r].Height == Height && _RectRanges[r].Thickness == Thickness)
+				break;
+		if(r == _RectRanges.size())
+		{
+			GDSRectRange R;
+			R.Layer = Layer;
+			R.Height = Height;
+			R.Thickness = Thickness;
+			R.FirstRect = 0;
+			R.NumRects = 0;
+			_RectRanges.push_back(R);
+		}
+		_LastRange = r;
+	}
+
+	grow(_Rects, 1);
+	grow(_RectRange, 1);
+	_Rects.push_back(Box);
+	_RectRange.push_back(r);
+	_RectRanges[r].NumRects++;
+	_Bucketed = false;
+}
+
+void GDSGeometry::Finish(GDSArena *Arena)
+{
+	vector<unsigned int> bucket(_Polygons.size());
+	bool ordered = true;
+	unsigned int last = 0;
+
+	if(_Bucketed)
+		return;
+	Thaw();
+
+	// Layers in the order they first appear, a cell only uses a few
+	_Layers.clear();
+	for(unsigned int i=0;i<_Polygons.size();i++)
+	{
+		struct ProcessLayer *layer = _Polygons[i].Layer;
+		unsigned int b = last;
+
+		if(_Layers.empty() || _Layers[b].Layer != layer)
+		{
+			for(b=0;b<_Layers.size();b++)
+				if(_Layers[b].Layer == layer)
+					break;
+			if(b == _Layers.size())
+			{
+				GDSLayerRange L;
+				L.Layer = layer;
+				L.FirstPolygon = 0;
+				L.NumPolygons = 0;
+				_Layers.push_back(L);
+			}
+		}
+		if(b < last)
+			ordered = false;
+		last = b;
+		bucket[i] = b;
+		_Layers[b].NumPolygons++;
+	}
+	for(unsigned int b=1;b<_Layers.size();b++)
+		_Layers[b].FirstPolygon = _Layers[b-1].FirstPolygon + _Layers[b-1].NumPolygons;
+
+	if(!ordered)
+	{
+		// Rebuild all arrays in layer order, so a layer is one range of
+		// records, points and indices
+		vector<unsigned int> next(_Layers.size());
+		GDSPolygonArray polygons(_Polygons.size());
+		GDSCoordArray X, Y;
+		GDSIndexArray indices;
+		GDSRectArray faces;
+		unordered_map<uint32_t, uint32_t> moved; // Shared indices, old to new first index
+
+		X.reserve(_X.size());
+		Y.reserve(_Y.size());
+		indices.reserve(_Indices.size());
+		faces.reserve(_Faces.size());
+		for(unsigned int b=0;b<_Layers.size();b++)
+			next[b] = _Layers[b].FirstPolygon;
+		for(unsigned int i=0;i<_Polygons.size();i++)
+			polygons[next[bucket[i]]++] = _Polygons[i];
+
+		for(unsigned int i=0;i<polygons.size();i++)
+		{
+			GDSPolygonRecord& R = polygons[i];
+
+			X.insert(X.end(), _X.begin() + R.FirstPoint, _X.begin() + R.FirstPoint + R.NumPoints);
+			Y.insert(Y.end(), _Y.begin() + R.FirstPoint, _Y.begin() + R.FirstPoint + R.NumPoints);
+			R.FirstPoint = X.size() - R.NumPoints;
+			if(R.Flags & GDS_POLYGON_FACES)
+			{
+				faces.insert(faces.end(), _Faces.begin() + R.FirstIndex, _Faces.begin() + R.FirstIndex + R.NumIndices);
+				R.FirstIndex = faces.size() - R.NumIndices;
+			}
+			else if(R.Flags & GDS_POLYGON_SHARED)
+			{
+				pair<unordered_map<uint32_t, uint32_t>::iterator, bool> m = moved.insert(make_pair(R.FirstIndex, (uint32_t)indices.size()));
+				if(m.second)
+					indices.insert(indices.end(), _Indices.begin() + R.FirstIndex, _Indices.begin() + R.FirstIndex + R.NumIndices);
+				R.FirstIndex = m.first->second;
+			}
+			else
+			{
+				indices.insert(indices.end(), _Indices.begin() + R.FirstIndex, _Indices.begin() + R.FirstIndex + R.NumIndices);
+				R.FirstIndex = indices.size() - R.NumIndices;
+			}
+		}
+
+		_Polygons.swap(polygons);
+		_X.swap(X);
+		_Y.swap(Y);
+		_Indices.swap(indices);
+		_Faces.swap(faces);
+	}
+
+	// Rectangles are counted per range as they are added
+	bool sorted = true;
+	for(unsigned int r=1;r<_RectRanges.size();r++)
+		_RectRanges[r].FirstRect = _RectRanges[r-1].FirstRect + _RectRanges[r-1].NumRects;
+	for(unsigned int i=1;i<_RectRange.size();i++)
+		if(_RectRange[i] < _RectRange[i-1])
+			sorted = false;
+	if(!sorted)
+	{
+		vector<unsigned int> next(_RectRanges.size());
+		GDSRectArray rects(_Rects.size());
+		GDSIndexArray range(_RectRange.size());
+
+		for(unsigned int r=0;r<_RectRanges.size();r++)
+			next[r] = _RectRanges[r].FirstRect;
+		for(unsigned int i=0;i<_Rects.size();i++)
+		{
+			unsigned int j = next[_RectRange[i]]++;
+			rects[j] = _Rects[i];
+			range[j] = _RectRange[i];
+		}
+		_Rects.swap(rects);
+		_RectRange.swap(range);
+	}
+
+	// Parsing grows the arrays, only keep what is used. New polygons no
+	// longer share the indices of the ones before.
+	_Shared.clear();
+	store(_X, Arena);
+	store(_Y, Arena);
+	store(_Indices, Arena);
+	store(_Faces, Arena);
+	store(_Polygons, Arena);
+	store(_Layers, Arena);
+	store(_Rects, Arena);
+	store(_RectRange, Arena);
+	store(_RectRanges, Arena);
+	_Stored = (Arena != NULL);
+	_Bucketed = true;
+}
+
+const GDSLayerArray& GDSGeometry::GetLayers()
+{
+	Finish();
+	return _Layers;
+}
+
+const GDSRectRangeArray& GDSGeometry::GetRectRanges()
+{
+	Finish();
+	return _RectRanges;
+}
+
+// Walls of two triangles per edge, top and bottom of the triangles or two
+// per face, twelve per rectangle. Shared triangles are drawn every time.
+unsigned long long GDSGeometry::GetNumTriangles()
+{
+	unsigned long long triangles = 12ULL*_Rects.size();
+
+	for(unsigned int i=0;i<_Polygons.size();i++)
+	{
+		triangles += 2*_Polygons[i].NumPoints;
+		if(_Polygons[i].Flags & GDS_POLYGON_FACES)
+			triangles += 4*_Polygons[i].NumIndices;
+		else
+			triangles += 2*(_Polygons[i].NumIndices/3);
+	}
+	return triangles;
+}
+
+// Outline twice, or four times if the walls need their own vertices, the
+// added corners of faces twice, eight per rectangle
+unsigned long long GDSGeometry::GetNumVertices()
+{
+	unsigned long long vertices = 8ULL*_Rects.size();
+	GDSFaceMesh mesh;
+	int e, o;
+
+	for(unsigned int i=0;i<_Polygons.size();i++)
+	{
+		GDSPolygon polygon = GetPolygon(i);
+
+		vertices += 2*_Polygons[i].NumPoints;
+		if(_Polygons[i].Flags & GDS_POLYGON_FACES)
+		{
+			polygon.GetFaceMesh(mesh);
+			vertices += 2*mesh.Extra.size();
+		}
+		else if(_Polygons[i].NumIndices && gds_wall_vertices(polygon.Indices(), _Polygons[i].NumIndices, e, o))
+			vertices += 2*_Polygons[i].NumPoints;
+	}
+	return vertices;
+}
+
+bool gds_wall_vertices(const uint16_t *Indices, unsigned int NumIndices, int& E, int& O)
+{
+	bool walls = false;
+
+	E = O = 1;
+	for(unsigned int j=0;j<NumIndices/3;j++)
+	{
+		const uint16_t *v = Indices + j*3;
+
+		if((v[0]%2)==0 && (v[1]%2)==0 && (v[2]%2)==0)
+			O = 0;
+		if((v[0]%2)==1 && (v[1]%2)==1 && (v[2]%2)==1)
+			E = 0;
+	}
+	if((E==0 && O==0) || (E==1 && O==0 && (NumIndices/3)%2==1))
+	{
+		walls = true;
+		E = 0;
+		O = 1;
+	}
+	if(E==1 && O==1)
+	{
+		E = 0;
+		O = 1;
+	}
+	return walls;
+}
+
+// Face corners are keyed by position, X in the high half
+static uint64_t gds_corner(int32_t X, int32_t Y)
+{
+	return ((uint64_t)(uint32_t)X << 32) | (uint32_t)Y;
+}
+
+// Outline vertices sort before the added ones, odd ones first
+static bool gds_corner_less(const pair<uint64_t, unsigned int>& A, const pair<uint64_t, unsigned int>& B)
+{
+	if(A.first != B.first)
+		return A.first < B.first;
+	return (A.second%2) > (B.second%2);
+}
+
+// Face corners share the outline vertices where they are one, the others
+// are added once
+void GDSPolygon::GetFaceMesh(GDSFaceMesh& Mesh)
+{
+	unsigned int n = GetPoints();
+	const int32_t *X = GetX();
+	const int32_t *Y = GetY();
+	vector<pair<uint64_t, unsigned int> > corners; // Position and vertex
+
+	Mesh.Extra.clear();
+	Mesh.Triangles.clear();
+	corners.reserve(n + 4*NumFaces());
+	for(unsigned int j=0; j<n; j++)
+		corners.push_back(make_pair(gds_corner(X[j], Y[j]), j));
+	std::sort(corners.begin(), corners.end(), gds_corner_less);
+
+	// Corners not on the outline
+	for(unsigned int i=0; i<NumFaces(); i++)
+	{
+		const GDSBox& face = Face(i);
+		GDSPoint p[4] = {{face.MinX, face.MinY}, {face.MaxX, face.MinY}, {face.MaxX, face.MaxY}, {face.MinX, face.MaxY}};
+
+		for(unsigned int k=0; k<4; k++)
+		{
+			uint64_t c = gds_corner(p[k].X, p[k].Y);
+			vector<pair<uint64_t, unsigned int> >::iterator it = std::lower_bound(corners.begin(), corners.end(), make_pair(c, 1u), gds_corner_less);
+			if(it != corners.end() && it->first == c)
+				continue;
+			corners.insert(it, make_pair(c, n + (unsigned int)Mesh.Extra.size()));
+			Mesh.Extra.push_back(p[k]);
+		}
+	}
+
+	// Two triangles per face
+	Mesh.Triangles.reserve(6*NumFaces());
+	for(unsigned int i=0; i<NumFaces(); i++)
+	{
+		const GDSBox& face = Face(i);
+		GDSPoint p[4] = {{face.MinX, face.MinY}, {face.MaxX, face.MinY}, {face.MaxX, face.MaxY}, {face.MinX, face.MaxY}};
+		unsigned int vertex[4];
+		bool spare[4];
+
+		for(unsigned int k=0; k<4; k++)
+		{
+			vertex[k] = std::lower_bound(corners.begin(), corners.end(), make_pair(gds_corner(p[k].X, p[k].Y), 1u), gds_corner_less)->second;
+			spare[k] = vertex[k] >= n || vertex[k]%2 == 1;
+		}
+
+		// Split along the diagonal that leaves a spare corner in both halves
+		static const int split[2][2][3] = {{{0, 1, 2}, {0, 2, 3}}, {{1, 2, 3}, {1, 3, 0}}};
+		int d = 0;
+		for(unsigned int h=0; h<2; h++)
+			if(!spare[split[0][h][0]] && !spare[split[0][h][1]] && !spare[split[0][h][2]])
+				d = 1;
+
+		for(unsigned int h=0; h<2; h++)
+		{
+			const int *t = split[d][h];
+			unsigned int last = 2;
+
+			while(last > 0 && !spare[t[last]])
+				last--;
+			if(!spare[t[last]])
+			{
+				// No corner to spare, add one of its own
+				last = 2;
+				vertex[t[last]] = n + Mesh.Extra.size();
+				Mesh.Extra.push_back(p[t[last]]);
+				spare[t[last]] = true;
+			}
+
+			// Rotate the counter-clockwise triangle to end on it
+			Mesh.Triangles.push_back(vertex[t[(last+1)%3]]);
+			Mesh.Triangles.push_back(vertex[t[(last+2)%3]]);
+			Mesh.Triangles.push_back(vertex[t[last]]);
+		}
+	}
+}
+
+// GDSEarClipper Class
+GDSEarClipper::GDSEarClipper(const int32_t *X, const int32_t *Y, unsigned int Count)
+{
+	_Nodes.resize(Count);
+	for(unsigned int i=0;i<Count;i++)
+	{
+		_Nodes[i].P.X = X[i];
+		_Nodes[i].P.Y = Y[i];
+		_Nodes[i].Prev = (i+Count-1)%Count;
+		_Nodes[i].Next = (i+1)%Count;
+		_Nodes[i].Removed = false;
+	}
+	_Left = Count;
+	_Start = 0;
+	_SideX = _SideY = 0;
+}
+
+bool GDSEarClipper::isReflex(unsigned int I) const
+{
+	const GDSEarNode& N = _Nodes[I];
+
+	// Straight angles count, a vertex in the middle of an edge can block an ear
+	return GDSPolygon::area(_Nodes[N.Prev].P, N.P, _Nodes[N.Next].P) <= 0;
+}
+
+void GDSEarClipper::Remove(unsigned int I)
+{
+	GDSEarNode& N = _Nodes[I];
+
+	_Nodes[N.Prev].Next = N.Next;
+	_Nodes[N.Next].Prev = N.Prev;
+	N.Removed = true;
+	if(_Start == I)
+		_Start = N.Next;
+	_Left--;
+}
+
+// Drop repeated points and vertices on a line with their neighbours, they
+// only give empty triangles. Returns true if any were dropped.
+bool GDSEarClipper::Filter()
+{
+	unsigned int p = _Start, stop = _Start;
+	bool again, removed = false;
+
+	do
+	{
+		const GDSEarNode& N = _Nodes[p];
+		const GDSPoint& A = _Nodes[N.Prev].P;
+		const GDSPoint& B = _Nodes[N.Next].P;
+
+		again = false;
+		if(_Left <= 2)
+			break;
+		if((N.P.X == B.X && N.P.Y == B.Y) || GDSPolygon::area(A, N.P, B) == 0)
+		{
+			p = stop = N.Prev;
+			Remove(_Nodes[p].Next);
+			again = removed = true;
+		}
+		else
+			p = N.Next;
+	}while(again || p != stop);
+
+	return removed;
+}
+
+// Sort the reflex vertices into a grid of about one per cell, with cells
+// of about the shape of the box so rows of vertices spread out as well
+void GDSEarClipper::BuildGrid()
+{
+	vector<unsigned int> reflex;
+	unsigned int p = _Start;
+
+	_Box.clear();
+	do
+	{
+		if(isReflex(p))
+		{
+			reflex.push_back(p);
+			_Box.addPoint(_Nodes[p].P.X, _Nodes[p].P.Y);
+		}
+		p = _Nodes[p].Next;
+	}while(p != _Start);
+
+	_Reflex.resize(reflex.size());
+	if(reflex.empty())
+	{
+		_Cells.assign(1, 0);
+		return;
+	}
+
+	_W = (int64_t)_Box.MaxX - _Box.MinX + 1;
+	_H = (int64_t)_Box.MaxY - _Box.MinY + 1;
+	double side = sqrt((double)reflex.size() * _W / _H);
+	_SideX = (unsigned int)min(max(side, 1.0), (double)reflex.size());
+	_SideY = (unsigned int)min(max((double)reflex.size() / _SideX, 1.0), (double)reflex.size());
+	_Cells.assign(_SideX*_SideY+1, 0);
+	for(unsigned int i=0;i<reflex.size();i++)
+	{
+		const GDSPoint& P = _Nodes[reflex[i]].P;
+		_Cells[CellY(P.Y)*_SideX + CellX(P.X) + 1]++;
+	}
+	for(unsigned int c=1;c<_Cells.size();c++)
+		_Cells[c] += _Cells[c-1];
+
+	vector<unsigned int> next(_Cells.begin(), _Cells.end()-1);
+	for(unsigned int i=0;i<reflex.size();i++)
+	{
+		const GDSPoint& P = _Nodes[reflex[i]].P;
+		_Reflex[next[CellY(P.Y)*_SideX + CellX(P.X)]++] = reflex[i];
+	}
+}
+
+// Widens [Min, Max] by the X range of segment A B between Y0 and Y1
+static void slab_extent(const GDSPoint& A, const GDSPoint& B, double Y0, double Y1, double& Min, double& Max)
+{
+	double t0 = 0.0, t1 = 1.0;
+
+	if(A.Y != B.Y)
+	{
+		t0 = (Y0 - A.Y) / ((double)B.Y - A.Y);
+		t1 = (Y1 - A.Y) / ((double)B.Y - A.Y);
+		if(t0 > t1)
+			swap(t0, t1);
+		t0 = max(t0, 0.0);
+		t1 = min(t1, 1.0);
+		if(t0 > t1)
+			return;
+	}
+	else if(A.Y < Y0 || A.Y > Y1)
+		return;
+
+	double x0 = A.X + t0*((double)B.X - A.X);
+	double x1 = A.X + t1*((double)B.X - A.X);
+	Min = min(Min, min(x0, x1));
+	Max = max(Max, max(x0, x1));
+}
+
+// A convex corner is an ear when no reflex vertex is inside its triangle.
+// Vertices on the two polygon edges of the triangle or on its corners are
+// not inside, that is where a keyhole cut meets itself.
+bool GDSEarClipper::isEar(unsigned int I) const
+{
+	unsigned int a = _Nodes[I].Prev, c = _Nodes[I].Next;
+	const GDSPoint& A = _Nodes[a].P;
+	const GDSPoint& B = _Nodes[I].P;
+	const GDSPoint& C = _Nodes[c].P;
+	GDSBox T;
+
+	if(GDSPolygon::area(A, B, C) <= 0)
+		return false;
+	if(_Reflex.empty())
+		return true;
+
+	T.addPoint(A.X, A.Y);
+	T.addPoint(B.X, B.Y);
+	T.addPoint(C.X, C.Y);
+	if(!GDSBox::intersect(T, _Box))
+		return true;
+
+	unsigned int y0 = CellY(max(T.MinY, _Box.MinY));
+	unsigned int y1 = CellY(min(T.MaxY, _Box.MaxY));
+
+	for(unsigned int y=y0;y<=y1;y++)
+	{
+		// Only the cells the triangle covers within this row, a long flat
+		// triangle has a wide box but is narrow in each row
+		double rowmin = (double)(_Box.MinY + (y*_H + _SideY-1)/_SideY);
+		double rowmax = (double)(_Box.MinY + ((y+1)*_H + _SideY-1)/_SideY - 1);
+		double xmin = DBL_MAX, xmax = -DBL_MAX;
+
+		slab_extent(A, B, rowmin, rowmax, xmin, xmax);
+		slab_extent(B, C, rowmin, rowmax, xmin, xmax);
+		slab_extent(C, A, rowmin, rowmax, xmin, xmax);
+		if(xmin > xmax || xmax < _Box.MinX || xmin > _Box.MaxX)
+			continue;
+
+		unsigned int x0 = CellX((int32_t)max(floor(xmin - 0.5), (double)_Box.MinX));
+		unsigned int x1 = CellX((int32_t)min(ceil(xmax + 0.5), (double)_Box.MaxX));
+
+		for(unsigned int k=_Cells[y*_SideX+x0];k<_Cells[y*_SideX+x1+1];k++)
+		{
+			unsigned int p = _Reflex[k];
+			const GDSPoint& P = _Nodes[p].P;
+
+			if(p == a || p == I || p == c || _Nodes[p].Removed)
+				continue;
+			if(!T.isPointInside(P.X, P.Y))
+				continue;
+			if(!isReflex(p)) // Clipping only ever makes corners convex
+				continue;
+			if(GDSPolygon::onLine(A, B, P) || GDSPolygon::onLine(B, C, P))
+				continue;
+			if(GDSPolygon::insideTriangle(A, B, C, P))
+				return false;
+		}
+	}
+	return true;
+}
+
+void GDSEarClipper::Clip(GDSIndexArray& Indices)
+{
+	Filter();
+	if(_Left < 3)
+		return;
+	BuildGrid();
+
+	unsigned int ear = _Start, stop = _Start;
+	while(_Left > 2)
+	{
+		unsigned int prev = _Nodes[ear].Prev, next = _Nodes[ear].Next;
+
+		if(isEar(ear))
+		{
+			Indices.push_back(prev);
+			Indices.push_back(ear);
+			Indices.push_back(next);
+			Remove(ear);
+
+			// Only the two neighbours changed, go back to test the
+			// previous one, a new ear is usually right there
+			ear = stop = prev;
+			continue;
+		}
+
+		ear = next;
+		if(ear != stop)
+			continue;
+
+		// A whole round without an ear, the outline touches or crosses
+		// itself. Clean it up and try again, or cut off any convex corner
+		// so there always is an end.
+		if(Filter())
+		{
+			if(_Left < 3)
+				break;
+			BuildGrid();
+			ear = stop = _Start;
+			continue;
+		}
+		do
+		{
+			if(!isReflex(ear))
+				break;
+			ear = _Nodes[ear].Next;
+		}while(ear != stop);
+		if(isReflex(ear))
+			break;
+
+		prev = _Nodes[ear].Prev;
+		next = _Nodes[ear].Next;
+		Indices.push_back(prev);
+		Indices.push_back(ear);
+		Indices.push_back(next);
+		Remove(ear);
+		ear = stop = next;
+	}
+}
+
+// GDSPolygon Class
+void
+GDSPolygon::Clear()
+{
+	GDSPolygonRecord& R = Record();
+
+	assert(_Index == _Geometry->_Polygons.size()-1);
+	_Geometry->_X.resize(R.FirstPoint);
+	_Geometry->_Y.resize(R.FirstPoint);
+	if(R.Flags & GDS_POLYGON_FACES)
+	{
+		if(R.FirstIndex + R.NumIndices == _Geometry->_Faces.size())
+			_Geometry->_Faces.resize(R.FirstIndex);
+	}
+	else if(!(R.Flags & GDS_POLYGON_SHARED) && R.FirstIndex + R.NumIndices == _Geometry->_Indices.size())
+		_Geometry->_Indices.resize(R.FirstIndex);
+	R.FirstIndex = _Geometry->_Indices.size();
+	R.NumPoints = 0;
+	R.NumIndices = 0;
+	R.Flags = 0;
+	R.BBox.clear();
+}
+
+void 
+GDSPolygon::AddPoint(int32_t X, int32_t Y)
 {
-	if( (P.X - max.X) > 0.001f || (min.X-P.X) > 0.001f )
-			return false;
-	if( (P.Y - max.Y) > 0.001f || (min.Y-P.Y) > 0.001f )
-			return false;
+	GDSPolygonRecord& R = Record();
 
-	return true;
+	assert(R.FirstPoint + R.NumPoints == _Geometry->_X.size());
+	if(R.NumPoints == GDS_MAX_POLYGON_POINTS)
+		return;
+
+	_Geometry->_X.push_back(X);
+	_Geometry->_Y.push_back(Y);
+	R.NumPoints++;
+	R.BBox.addPoint(X, Y);
 }
 
-bool GDSBB::intersect(const GDSBB& BB1, const GDSBB& BB2)
+void
+GDSPolygon::AddPoints(const byte *XY, unsigned int Count)
 {
-	// How much of a margin??
-	if( (BB1.min.X - BB2.max.X) > 0.001f || (BB2.min.X-BB1.max.X) > 0.001f )
-			return false;
-	if( (BB1.min.Y - BB2.max.Y) > 0.001f || (BB2.min.Y-BB1.max.Y) > 0.001f )
-			return false;
+	GDSPolygonRecord& R = Record();
+	GDSCoordArray& X = _Geometry->_X;
+	GDSCoordArray& Y = _Geometry->_Y;
+	size_t first = X.size();
+	int32_t P[2*64];
+
+	assert(R.FirstPoint + R.NumPoints == first);
+	if(R.NumPoints + Count > GDS_MAX_POLYGON_POINTS)
+	{
+		v_printf(1, "Polygon with more than %d points truncated.\n", GDS_MAX_POLYGON_POINTS);
+		Count = GDS_MAX_POLYGON_POINTS - R.NumPoints;
+	}
+	if(!Count)
+		return;
 
-	return true;
+	// Decode packed pairs in small batches and split them into X and Y
+	X.resize(first + Count);
+	Y.resize(first + Count);
+	for(unsigned int done=0; done<Count; )
+	{
+		unsigned int n = std::min(Count - done, 64u);
+
+		gds_decode_xy(XY + done*8, n*2, P);
+		for(unsigned int i=0;i<n;i++)
+		{
+			X[first+done+i] = P[i*2+0];
+			Y[first+done+i] = P[i*2+1];
+			R.BBox.addPoint(P[i*2+0], P[i*2+1]);
+		}
+		done += n;
+	}
+	R.NumPoints += Count;
 }
 
-// GDSTriangle Class
-void GDSTriangle::set(const Point2D& P1, const Point2D& P2, const Point2D& P3)
+// Convex, all turns go the same way, a fan from the first point covers it
+static bool gds_is_simple(const int32_t *X, const int32_t *Y, unsigned int n)
 {
-	coords[0] = P1;
-	coords[1] = P2;
-	coords[2] = P3;
+    int numPos, numNeg;
+    numPos = numNeg = 0;
+    
+    int64_t dx1, dy1, dx2, dy2, nz;
+	unsigned int j;
+
+	// Repeated points give empty edges without a direction, turns are
+	// taken between the edges around them
+	for(j=n; j>0; j--){
+		dx1 = (int64_t)X[j%n] - X[j-1];
+		dy1 = (int64_t)Y[j%n] - Y[j-1];
+		if(dx1 || dy1)
+			break;
+	}
+	if(j == 0)
+		return true;
+    
+    for(j=0; j<n; j++){ // Iterate over edges
+        dx2 = (int64_t)X[(j+1)%n] - X[j];
+        dy2 = (int64_t)Y[(j+1)%n] - Y[j];
+		if(!dx2 && !dy2)
+			continue;
+        
+        nz = dx1*dy2 - dy1*dx2;
+        
+        if(nz > 0)
+            numPos+=1;
+        if(nz < 0)
+            numNeg+=1;
+		if(nz == 0 && dx1*dx2 + dy1*dy2 < 0) // Doubles back
+			return false;
 
-	bbox.addPoint(P1);
-	bbox.addPoint(P2);
-	bbox.addPoint(P3);
+		dx1 = dx2;
+		dy1 = dy2;
+    }
+    
+    if(numPos>0 && numNeg>0)
+        return false;
+    
+    return true;
 }
 
-void GDSTriangle::project(const Point2D& axis, float& min, float& max) const
+// Rectangles covering a rectilinear outline by the even-odd rule, in
+// horizontal slabs between the rows of vertices. A slab is cut where the
+// vertical edges cross it, and a rectangle grows into the next slab as long
+// as it keeps the same sides there.
+static bool gds_slabs(const int32_t *X, const int32_t *Y, unsigned int Count, vector<GDSBox>& Rects)
 {
-	float d;
+	vector<int32_t> rows(Y, Y + Count);
+	vector<pair<int32_t, int32_t> > starts, ends; // Y and X of the vertical edges
+	vector<int32_t> active; // X of the edges crossing the slab, sorted
+	vector<GDSBox> open, next;
 
-	min = axis.X*coords[0].X+axis.Y*coords[0].Y;
-	max = min;
+	for(unsigned int i=0;i<Count;i++)
+	{
+		unsigned int j = (i+1)%Count;
 
-	d = axis.X*coords[1].X+axis.Y*coords[1].Y;
-	min = std::min(min, d);
-	max = std::max(max, d);
+		if(X[i] != X[j] && Y[i] != Y[j])
+			return false;
+		if(X[i] == X[j] && Y[i] != Y[j])
+		{
+			starts.push_back(make_pair(min(Y[i], Y[j]), X[i]));
+			ends.push_back(make_pair(max(Y[i], Y[j]), X[i]));
+		}
+	}
+	std::sort(rows.begin(), rows.end());
+	rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+	std::sort(starts.begin(), starts.end());
+	std::sort(ends.begin(), ends.end());
 
-	d = axis.X*coords[2].X+axis.Y*coords[2].Y;
-	min = std::min(min, d);
-	max = std::max(max, d);
-}
+	unsigned int s = 0, e = 0;
+	for(unsigned int r=0;r+1<rows.size();r++)
+	{
+		for(;e<ends.size() && ends[e].first == rows[r];e++)
+			active.erase(std::lower_bound(active.begin(), active.end(), ends[e].second));
+		for(;s<starts.size() && starts[s].first == rows[r];s++)
+			active.insert(std::upper_bound(active.begin(), active.end(), starts[s].second), starts[s].second);
+		if(active.size() % 2)
+			return false;
 
-void GDSTriangle::normal(const Point2D& P1, const Point2D& P2, Point2D& N)
-{
-	N.X = P1.Y - P2.Y;
-	N.Y = P2.X - P1.X;
+		// Both lists go left to right, continue the rectangles that match
+		unsigned int o = 0;
+		next.clear();
+		for(unsigned int a=0;a<active.size();a+=2)
+		{
+			int32_t x0 = active[a], x1 = active[a+1];
+
+			if(x0 == x1)
+				continue;
+			while(o < open.size() && (open[o].MinX < x0 || (open[o].MinX == x0 && open[o].MaxX < x1)))
+				Rects.push_back(open[o++]);
+			if(o < open.size() && open[o].MinX == x0 && open[o].MaxX == x1)
+			{
+				next.push_back(open[o++]);
+				next.back().MaxY = rows[r+1];
+			}
+			else
+			{
+				GDSBox B;
+				B.MinX = x0;
+				B.MinY = rows[r];
+				B.MaxX = x1;
+				B.MaxY = rows[r+1];
+				next.push_back(B);
+			}
+		}
+		Rects.insert(Rects.end(), open.begin() + o, open.end());
+		open.swap(next);
+	}
+	Rects.insert(Rects.end(), open.begin(), open.end());
+	return true;
 }
 
-bool GDSTriangle::intersect(const GDSTriangle& T1, const GDSTriangle& T2)
+// Fill a rectilinear polygon with rectangles, cutting it into horizontal or
+// vertical slabs, whichever takes fewer. That is close to the minimum for
+// layout shapes and never more triangles than the ear clipper would make.
+static bool gds_decompose(const int32_t *X, const int32_t *Y, unsigned int Count, vector<GDSBox>& Faces)
 {
-	Point2D axis;
-	float min1 = 0, max1 = 0, min2 = 0, max2 = 0;
+	vector<GDSBox> up;
 
-	// Bounding box Test
-	if(!GDSBB::intersect(T1.bbox, T2.bbox))
+	Faces.clear();
+	if(Count > GDS_MAX_FACE_POINTS || !gds_slabs(X, Y, Count, Faces) || !gds_slabs(Y, X, Count, up))
 		return false;
 
-	// Test T1 edges
-	for(unsigned int i=0;i<3;i++)
+	if(up.size() < Faces.size())
 	{
-		GDSTriangle::normal(T1.coords[i], T1.coords[(i+1)%3], axis);
-		T1.project(axis, min1, max1);
-		T2.project(axis, min2, max2);
-		if( (min1 - max2) > 0.001f || (min2-max1) > 0.001f )
-			return false;
+		Faces.resize(up.size());
+		for(unsigned int i=0;i<up.size();i++)
+		{
+			Faces[i].MinX = up[i].MinY;
+			Faces[i].MinY = up[i].MinX;
+			Faces[i].MaxX = up[i].MaxY;
+			Faces[i].MaxY = up[i].MaxX;
+		}
 	}
-
-	// Test T2 edges
-	for(unsigned int i=0;i<3;i++)
+	if(Faces.empty() || 2*Faces.size() > Count-2)
 	{
-		GDSTriangle::normal(T2.coords[i], T2.coords[(i+1)%3], axis);
-		T1.project(axis, min1, max1);
-		T2.project(axis, min2, max2);
-		if( (min1 - max2) > 0.001f || (min2-max1) > 0.001f )
-			return false;
+		Faces.clear();
+		return false;
 	}
-
-	// No seperating axis, so intersection must have taken place
 	return true;
 }
 
-// GDSPolygon Class
-GDSPolygon::GDSPolygon(float Height, float Thickness, struct ProcessLayer *Layer)
+// Faces if rectilinear, else a fan if convex, else ear clipped triangles
+static void gds_tesselate(const int32_t *X, const int32_t *Y, unsigned int Count, GDSIndexArray& Indices, vector<GDSBox>& Faces)
 {
-	_Height = Height;
-	_Thickness = Thickness;
-	_Layer = Layer;
+	if(gds_decompose(X, Y, Count, Faces))
+		return;
+
+	// Fast path for simple polygons
+	if(gds_is_simple(X, Y, Count))
+	{
+		Indices.resize((Count-2)*3);
+		for(unsigned int j=0;j<Count-2;j++)
+		{
+			Indices[j*3+0] = 0;
+			Indices[j*3+1] = j+1;
+			Indices[j*3+2] = j+2;
+		}
+		return;
+	}
 
-	epsilon = 0.001; // Default precision of 1nm
+	GDSEarClipper clipper(X, Y, Count);
+	clipper.Clip(Indices);
 }
 
-GDSPolygon::~GDSPolygon()
+// An outline relative to its first point with its tesselation. Shared ones
+// are tesselated at that origin, so every congruent polygon gets exactly
+// the same triangles, whichever thread got there first. They are not
+// changed until gds_clear_tesselations().
+typedef struct GDSTesselation
 {
-}
+	vector<int32_t>		X, Y;
+	GDSIndexArray		Indices;
+	vector<GDSBox>		Faces; // Relative to the first point as well
+}GDSTesselation;
 
-void
-GDSPolygon::Clear()
+// Shapes are spread over a few locks, parser threads tesselate together
+#define GDS_TESSELATION_SHARDS	64
+
+// Bits per shard marking shapes seen once, a collision only keeps a shape early
+#define GDS_TESSELATION_SEEN	(1<<17)
+
+typedef struct GDSTesselationShard
 {
-    _Coords.clear();
-    indices.clear();
-	bbox.clear();
+	mutex Lock;
+	unordered_multimap<unsigned long long, GDSTesselation*> Shapes;
+	vector<uint64_t> Seen;
+}GDSTesselationShard;
+
+static GDSTesselationShard gds_tesselations[GDS_TESSELATION_SHARDS];
+static atomic<unsigned long long> gds_tesselation_lookups(0), gds_tesselation_hits(0), gds_tesselation_shapes(0), gds_tesselation_bytes(0);
+
+void gds_clear_tesselations()
+{
+	for(unsigned int i=0;i<GDS_TESSELATION_SHARDS;i++)
+	{
+		GDSTesselationShard& shard = gds_tesselations[i];
+		lock_guard<mutex> lock(shard.Lock);
+
+		for(unordered_multimap<unsigned long long, GDSTesselation*>::iterator s = shard.Shapes.begin(); s != shard.Shapes.end(); s++)
+			delete s->second;
+		unordered_multimap<unsigned long long, GDSTesselation*>().swap(shard.Shapes);
+		vector<uint64_t>().swap(shard.Seen);
+	}
+	gds_tesselation_lookups = 0;
+	gds_tesselation_hits = 0;
+	gds_tesselation_shapes = 0;
+	gds_tesselation_bytes = 0;
 }
 
-void 
-GDSPolygon::CopyInto(GDSPolygon *p)
+void gds_tesselation_stats(unsigned long long& Lookups, unsigned long long& Hits, unsigned long long& Shapes, unsigned long long& Bytes)
 {
-	// Nothing special happens here
-	p->_Height = _Height;
-	p->_Thickness = _Thickness;
-	p->_Layer = _Layer;
-    p->indices = indices;
-    p->_Coords = _Coords;
-	p->bbox = bbox;
+	Lookups = gds_tesselation_lookups;
+	Hits = gds_tesselation_hits;
+	Shapes = gds_tesselation_shapes;
+	Bytes = gds_tesselation_bytes;
 }
 
-void 
-GDSPolygon::AddPoint(float X, float Y)
+static GDSTesselation *gds_find_tesselation(GDSTesselationShard& Shard, unsigned long long Hash, const GDSTesselation& T)
 {
-    _Coords.push_back(Point2D(X,Y));
-	bbox.addPoint(Point2D(X,Y));
+	size_t bytes = T.X.size()*sizeof(int32_t);
+	pair<unordered_multimap<unsigned long long, GDSTesselation*>::iterator, unordered_multimap<unsigned long long, GDSTesselation*>::iterator> range = Shard.Shapes.equal_range(Hash);
+
+	for(;range.first!=range.second;range.first++)
+	{
+		GDSTesselation *S = range.first->second;
+		if(S->X.size() == T.X.size() && !memcmp(&S->X[0], &T.X[0], bytes) && !memcmp(&S->Y[0], &T.Y[0], bytes))
+			return S;
+	}
+	return NULL;
 }
 
-void
-GDSPolygon::Tesselate()
+// Tesselation of the outline in T, relative to its first point. Returns the
+// shared one, or T itself, tesselated. A shape is kept the second time it
+// comes by, unique ones cost a bit, and the table stops growing at
+// GDS_SHARED_MAX_BYTES. Either way the triangles are the same.
+static const GDSTesselation *gds_share_tesselation(GDSTesselation& T, unsigned long long Hash)
 {
-	if(indices.size() > 0 || _Coords.size() < 3)
-		return;
+	unsigned int n = T.X.size();
+	GDSTesselationShard& shard = gds_tesselations[Hash % GDS_TESSELATION_SHARDS];
+	unsigned long long bit = (Hash / GDS_TESSELATION_SHARDS) % GDS_TESSELATION_SEEN;
+	GDSTesselation *S;
 
-	// Fast path for simple polygons
-	if(isSimple())
-	{
-		for(unsigned int j=0;j<_Coords.size()-2;j++)
-        {
-                indices.push_back(0);
-                indices.push_back(j+1);
-                indices.push_back(j+2);
-        }
-		return;
+	gds_tesselation_lookups++;
+	{
+		lock_guard<mutex> lock(shard.Lock);
+		S = gds_find_tesselation(shard, Hash, T);
+	}
+	if(S)
+	{
+		gds_tesselation_hits++;
+		return S;
 	}
-    
-    // Build double linked list, with N indices
-    vector<int> V;
-    for (unsigned int i = 0; i <_Coords.size(); i++)
-        V.push_back(i);
-    
-    // Prepare to build N-2 triangles
-    int a,b,c;
-    for (unsigned int i = 0; i < _Coords.size()-2; i++)
-    {
-        // Go through the double linked list
-        for(unsigned int j=0;j<V.size();j++)
-        {
-            a = j; b = (j+1)%V.size(); c = (j+2)%V.size();
-            bool flagged = false;     
-            
-            // Orientation or degenerate?
-            if(area(_Coords[V[a]], _Coords[V[b]], _Coords[V[c]]) < (epsilon))
-                continue;
-            
-            // Go through all of the points
-            for(unsigned int k=0;k<V.size();k++) 
-            {
-				// Same point as triangle
-                if(k==a || k==b || k==c) 
-                    continue;
-
-				// Check if on polygon edge				
-                if( abs(V[a]-V[b])==1 ||  abs(V[a]-V[b])==_Coords.size()-1)
-				{
-					if(onLine(_Coords[V[a]], _Coords[V[b]], _Coords[V[k]]))
-						continue;
-				}
-				if( abs(V[b]-V[c])==1 ||  abs(V[b]-V[c])==_Coords.size()-1)
-				{
-					if(onLine(_Coords[V[b]], _Coords[V[c]], _Coords[V[k]]))
-						continue;
-				}
-				if( abs(V[c]-V[a])==1 ||  abs(V[c]-V[a])==_Coords.size()-1)
-				{
-					if(onLine(_Coords[V[c]], _Coords[V[a]], _Coords[V[k]]))
-						continue;
-				}
 
-				// Check if in triangle
-                if(insideTriangle(_Coords[V[a]], _Coords[V[b]], _Coords[V[c]], _Coords[V[k]]))
-                {
-                    flagged = true;
-                    break;
-                }
-            }
-            
-            // We have an ear
-            if(!flagged)
-            {
-                indices.push_back(V[a]);
-                indices.push_back(V[b]);
-                indices.push_back(V[c]);
-                V.erase(V.begin()+b);
-                break;
-            }
-        }
-    }
-    
-    
-    //Clean up
-    V.clear();
+	// Outside the lock, another thread may be doing the same shape
+	gds_tesselate(&T.X[0], &T.Y[0], n, T.Indices, T.Faces);
+	if(gds_tesselation_bytes >= GDS_SHARED_MAX_BYTES)
+		return &T;
+
+	lock_guard<mutex> lock(shard.Lock);
+	S = gds_find_tesselation(shard, Hash, T);
+	if(S)
+	{
+		gds_tesselation_hits++;
+		return S;
+	}
+	if(shard.Seen.empty())
+		shard.Seen.resize(GDS_TESSELATION_SEEN/64, 0);
+	if(!(shard.Seen[bit/64] & (1ull << (bit%64))))
+	{
+		shard.Seen[bit/64] |= 1ull << (bit%64);
+		return &T;
+	}
+	S = new GDSTesselation;
+	S->X.swap(T.X);
+	S->Y.swap(T.Y);
+	S->Indices.swap(T.Indices);
+	S->Faces.swap(T.Faces);
+	shard.Shapes.insert(make_pair(Hash, S));
+	gds_tesselation_shapes++;
+	gds_tesselation_bytes += sizeof(GDSTesselation) + 4*sizeof(void*) + n*2*sizeof(int32_t) + S->Indices.size()*sizeof(uint16_t) + S->Faces.size()*sizeof(GDSBox);
+	return S;
 }
 
-float GDSPolygon::GetXCoords(unsigned int Index)
+// Outline of Count points relative to the first one, false if it is too
+// large to share or does not fit
+static bool gds_relative_outline(const int32_t *X, const int32_t *Y, unsigned int Count, GDSTesselation& T)
 {
-	return _Coords[Index].X;
+	if(Count > GDS_SHARED_MAX_POINTS)
+		return false;
+
+	T.X.resize(Count);
+	T.Y.resize(Count);
+	for(unsigned int i=0;i<Count;i++)
+	{
+		int64_t x = (int64_t)X[i] - X[0];
+		int64_t y = (int64_t)Y[i] - Y[0];
+
+		if(x != (int32_t)x || y != (int32_t)y)
+			return false;
+		T.X[i] = (int32_t)x;
+		T.Y[i] = (int32_t)y;
+	}
+	return true;
 }
 
-float GDSPolygon::GetYCoords(unsigned int Index)
+// Whether X and Y are the outline of T, moved
+static bool gds_same_outline(const int32_t *X, const int32_t *Y, const GDSTesselation& T)
 {
-	return _Coords[Index].Y;
+	for(unsigned int i=0;i<T.X.size();i++)
+	{
+		if((int64_t)X[i] - X[0] != T.X[i] || (int64_t)Y[i] - Y[0] != T.Y[i])
+			return false;
+	}
+	return true;
 }
 
-unsigned int GDSPolygon::GetPoints()
+void
+GDSPolygon::Tesselate()
 {
-	return _Coords.size();
+	if(isRect() || Record().NumIndices > 0 || Record().NumPoints < 3)
+		return;
+
+	_Geometry->Thaw();
+
+	GDSPolygonRecord& R = Record();
+	const int32_t *X = &_Geometry->_X[R.FirstPoint];
+	const int32_t *Y = &_Geometry->_Y[R.FirstPoint];
+	unsigned int n = R.NumPoints;
+	int32_t x0 = 0, y0 = 0; // Origin of the tesselation
+	unsigned long long hash = 0;
+	GDSTesselation own;
+	const GDSTesselation *T = &own;
+	bool relative = gds_relative_outline(X, Y, n, own);
+
+	if(relative)
+	{
+		x0 = X[0];
+		y0 = Y[0];
+		hash = gds_hash(&own.Y[0], n*sizeof(int32_t), gds_hash(&own.X[0], n*sizeof(int32_t)));
+		T = gds_share_tesselation(own, hash);
+	}
+	else
+		gds_tesselate(X, Y, n, own.Indices, own.Faces);
+
+	if(!T->Faces.empty())
+	{
+		GDSRectArray& faces = _Geometry->_Faces;
+
+		R.Flags |= GDS_POLYGON_FACES;
+		R.FirstIndex = faces.size();
+		R.NumIndices = T->Faces.size();
+		grow(faces, T->Faces.size());
+		for(unsigned int i=0;i<T->Faces.size();i++)
+		{
+			GDSBox F = T->Faces[i];
+
+			F.MinX += x0;
+			F.MinY += y0;
+			F.MaxX += x0;
+			F.MaxY += y0;
+			faces.push_back(F);
+		}
+		return;
+	}
+	if(T->Indices.empty())
+		return;
+
+	// Congruent polygons of this geometry use the same indices, found by
+	// their outline, so the layout does not depend on the shape table
+	GDSIndexArray& indices = _Geometry->_Indices;
+	if(relative)
+	{
+		pair<unordered_multimap<unsigned long long, uint32_t>::iterator, unordered_multimap<unsigned long long, uint32_t>::iterator> range = _Geometry->_Shared.equal_range(hash);
+
+		R.Flags |= GDS_POLYGON_SHARED;
+		for(;range.first!=range.second;range.first++)
+		{
+			const GDSPolygonRecord& P = _Geometry->_Polygons[range.first->second];
+
+			if(P.NumPoints == n && !(P.Flags & GDS_POLYGON_FACES) && gds_same_outline(&_Geometry->_X[P.FirstPoint], &_Geometry->_Y[P.FirstPoint], *T))
+			{
+				R.FirstIndex = P.FirstIndex;
+				R.NumIndices = P.NumIndices;
+				return;
+			}
+		}
+		_Geometry->_Shared.insert(make_pair(hash, (uint32_t)_Index));
+	}
+	R.FirstIndex = indices.size();
+	R.NumIndices = T->Indices.size();
+	grow(indices, T->Indices.size());
+	indices.insert(indices.end(), T->Indices.begin(), T->Indices.end());
 }
 
-vector<int>* GDSPolygon::GetIndices()
+const uint16_t* GDSPolygon::GetIndices()
 {
 	// Tesselate if not done before
-	if(indices.size() == 0)
+	if(!isRect() && Record().NumIndices == 0)
 		Tesselate();
 
-	return &indices;
+	return Indices();
+}
+
+const uint16_t* GDSPolygon::Indices() const
+{
+	if(hasFaces())
+		return NULL;
+
+	GDSIndexArray& indices = _Geometry->_Indices;
+	return indices.empty() ? NULL : &indices[0] + Record().FirstIndex;
 }
 
 void GDSPolygon::Flip()
 {
+	if(isRect())
+		return; // Always counter-clockwise
+
+	// Other polygons may use the same triangles, flip a copy
+	if(Record().Flags & GDS_POLYGON_SHARED)
+	{
+		_Geometry->Thaw();
+
+		GDSPolygonRecord& S = Record();
+		GDSIndexArray& indices = _Geometry->_Indices;
+
+		grow(indices, S.NumIndices);
+		for(unsigned int i=0;i<S.NumIndices;i++)
+			indices.push_back(indices[S.FirstIndex + i]);
+		S.FirstIndex = indices.size() - S.NumIndices;
+		S.Flags &= ~GDS_POLYGON_SHARED;
+	}
+
+	GDSPolygonRecord& R = Record();
+	unsigned int n = R.NumPoints;
+
 	// Flip points for boundary
-    vector<Point2D> TCoords = _Coords;
-    for(unsigned int i=0;i<TCoords.size();i++)
-        _Coords[i] = TCoords[TCoords.size()-1-i];
+	std::reverse(_Geometry->_X.begin() + R.FirstPoint, _Geometry->_X.begin() + R.FirstPoint + n);
+	std::reverse(_Geometry->_Y.begin() + R.FirstPoint, _Geometry->_Y.begin() + R.FirstPoint + n);
+
+	// Faces do not depend on the order of the points
+	if(R.Flags & GDS_POLYGON_FACES)
+		return;
 
 	// Adjust indices?
     int a,b,c;
+	uint16_t *indices = R.NumIndices ? &_Geometry->_Indices[R.FirstIndex] : NULL;
 
-    for(unsigned int i=0;i<indices.size()/3;i++)
+    for(unsigned int i=0;i<R.NumIndices/3;i++)
     {
         // New index numbers
-        a = _Coords.size()-1-indices[i*3+0];
-        b = _Coords.size()-1-indices[i*3+1];
-        c = _Coords.size()-1-indices[i*3+2];
+        a = n-1-indices[i*3+0];
+        b = n-1-indices[i*3+1];
+        c = n-1-indices[i*3+2];
 
         // Swap Order
         indices[i*3+0] = a;
@@ -427,73 +1751,68 @@ void GDSPolygon::Flip()
 
 void GDSPolygon::Orientate()
 {
-    float x0,y0,x1,y1,x2,y2,nz;
-    float dx1,dy1,dx2,dy2;
-    nz = 0.0f;
+    int64_t x0,y0,x1,y1,x2,y2;
+    int64_t dx1,dy1,dx2,dy2;
+	double nz;
+	unsigned int n = GetPoints();
+	const int32_t *X = GetX(), *Y = GetY();
+    nz = 0.0;
+
+	if(isRect())
+		return;
     
     // Do we have to flip?    
-    for(unsigned int j=1; j<_Coords.size(); j++){
+    for(unsigned int j=1; j<n; j++){
 		if(j==1)
 		{
-			x0 = _Coords[0].X;
-			y0 = _Coords[0].Y;
+			x0 = X[0];
+			y0 = Y[0];
 		}
-        x1 = _Coords[j].X;// + offx;
-        y1 = _Coords[j].Y;// + offy;
+        x1 = X[j];// + offx;
+        y1 = Y[j];// + offy;
         
-        x2 = _Coords[(j+1)%_Coords.size()].X;// + offx;
-        y2 = _Coords[(j+1)%_Coords.size()].Y;// + offy;
+        x2 = X[(j+1)%n];// + offx;
+        y2 = Y[(j+1)%n];// + offy;
         
         dx1 = x2 - x0;
         dy1 = y2 - y0;
         
         dx2 = x2 - x1;
         dy2 = y2 - y1;
-        nz += dx1*dy2 - dy1*dx2;
+        nz += (double)(dx1*dy2 - dy1*dx2);
     }
     
-    if(nz < 0.0f)
+    if(nz < 0.0)
         Flip();
 }
 
 bool
 GDSPolygon::isSimple()
 {
-    int numPos, numNeg;
-    numPos = numNeg = 0;
-    
-    float dx1, dy1, dx2, dy2, nz;
-    
-    for(unsigned int j=0; j<_Coords.size(); j++){ // Iterate over edges
-        dx1 = _Coords[(j+1)%_Coords.size()].X - _Coords[j].X;
-        dy1 = _Coords[(j+1)%_Coords.size()].Y - _Coords[j].Y;
-        
-        dx2 = _Coords[(j+2)%_Coords.size()].X - _Coords[(j+1)%_Coords.size()].X;
-        dy2 = _Coords[(j+2)%_Coords.size()].Y - _Coords[(j+1)%_Coords.size()].Y;
-        
-        nz = dx1*dy2 - dy1*dx2;
-        
-        if(nz > 0.0000001f)
-            numPos+=1;
-        if(nz < -0.0000001f)
-            numNeg+=1;
-    }
-    
-    if(numPos>0 && numNeg>0)
-        return false;
-    
-    return true;
+	if(isRect())
+		return true;
+
+	return gds_is_simple(GetX(), GetY(), GetPoints());
 }
 
 bool 
-GDSPolygon::isPointInside(const Point2D& P)
+GDSPolygon::isPointInside(int32_t X, int32_t Y)
 {
-	//GDSTriangle T;
+	if(hasFaces())
+	{
+		for(unsigned int i=0;i<NumFaces();i++)
+			if(Face(i).isPointInside(X, Y))
+				return true;
+		return false;
+	}
+
+	const uint16_t *indices = Indices();
+	GDSPoint P = {X, Y};
 
 	//We are doing this brute force
-	for(unsigned int i=0;i<indices.size()/3;i++)
+	for(unsigned int i=0;i<GetNumIndices()/3;i++)
 	{
-		if( insideTriangle(_Coords[indices[i*3+0]], _Coords[indices[i*3+1]], _Coords[indices[i*3+2]], P))
+		if( insideTriangle(Point(indices[i*3+0]), Point(indices[i*3+1]), Point(indices[i*3+2]), P))
 			return true;
 	}
 	return false;
@@ -501,18 +1820,17 @@ GDSPolygon::isPointInside(const Point2D& P)
 
 // Private functions
 
-double 
-GDSPolygon::area(const Point2D& A, const Point2D& B, const Point2D& C)
+int64_t
+GDSPolygon::area(const GDSPoint& A, const GDSPoint& B, const GDSPoint& C)
 {
-    return ((B.X - A.X) * (C.Y - A.Y)) - ((B.Y - A.Y) * (C.X - A.X));
+    return ((int64_t)(B.X - A.X) * (C.Y - A.Y)) - ((int64_t)(B.Y - A.Y) * (C.X - A.X));
 }
 
 bool 
-GDSPolygon::onLine(const Point2D& A, const Point2D& B,const Point2D& P)
+GDSPolygon::onLine(const GDSPoint& A, const GDSPoint& B, const GDSPoint& P)
 {
 	// Check if a point lies on a line segment
 
-
 	// Inside bounding box?
 	if(P.X < A.X && P.X < B.X)
 		return false;
@@ -524,31 +1842,14 @@ GDSPolygon::onLine(const Point2D& A, const Point2D& B,const Point2D& P)
 		return false;
 	
 	// On line?
-	double a,b;  
-	
-	if( B.X - A.X != 0.0f)
-	{
-		a = (B.Y - A.Y) / (B.X - A.X);
-		b = A.Y - a * A.X;
-		if ( fabs(P.Y - (a*P.X+b)) < epsilon)
-			return true;
-	}
-	else
-	{
-		a = (B.X - A.X) / (B.Y - A.Y);
-		b = A.X - a * A.Y;
-		if ( fabs(P.X - (a*P.Y+b)) < epsilon)
-			return true;
-	}
-
-	return false;
+	return area(A, B, P) == 0;
 }
 
 bool 
-GDSPolygon::insideTriangle(const Point2D& A, const Point2D& B, const Point2D& C,const Point2D& P)
+GDSPolygon::insideTriangle(const GDSPoint& A, const GDSPoint& B, const GDSPoint& C, const GDSPoint& P)
 {
-    double ax, ay, bx, by, cx, cy, apx, apy, bpx, bpy, cpx, cpy;
-    double cCROSSap, bCROSScp, aCROSSbp;
+    int64_t ax, ay, bx, by, cx, cy, apx, apy, bpx, bpy, cpx, cpy;
+    int64_t cCROSSap, bCROSScp, aCROSSbp;
 
 	// Exclude points on vertices
 	if(A.X == P.X && A.Y == P.Y)
@@ -558,49 +1859,172 @@ GDSPolygon::insideTriangle(const Point2D& A, const Point2D& B, const Point2D& C,
 	if(C.X == P.X && C.Y == P.Y)
 		return false;
     
-    ax = C.X - B.X;  ay = C.Y - B.Y;
-    bx = A.X - C.X;  by = A.Y - C.Y;
-    cx = B.X - A.X;  cy = B.Y - A.Y;
-    apx = P.X - A.X;  apy = P.Y - A.Y;
-    bpx = P.X - B.X;  bpy = P.Y - B.Y;
-    cpx = P.X - C.X;  cpy = P.Y - C.Y;
+    ax = (int64_t)C.X - B.X;  ay = (int64_t)C.Y - B.Y;
+    bx = (int64_t)A.X - C.X;  by = (int64_t)A.Y - C.Y;
+    cx = (int64_t)B.X - A.X;  cy = (int64_t)B.Y - A.Y;
+    apx = (int64_t)P.X - A.X;  apy = (int64_t)P.Y - A.Y;
+    bpx = (int64_t)P.X - B.X;  bpy = (int64_t)P.Y - B.Y;
+    cpx = (int64_t)P.X - C.X;  cpy = (int64_t)P.Y - C.Y;
     
     aCROSSbp = ax * bpy - ay * bpx;
     cCROSSap = cx * apy - cy * apx;
     bCROSScp = bx * cpy - by * cpx;
     
-    return ((aCROSSbp >= 0.0f) && (bCROSScp >= 0.0f) && (cCROSSap >= 0.0f));
-    
-    //return ((aCROSSbp >= epsilon) && (bCROSScp >= epsilon) && (cCROSSap >= epsilon));
+    return ((aCROSSbp >= 0) && (bCROSScp >= 0) && (cCROSSap >= 0));
 }
 
+// Transforms that only swap or mirror the axes, which is almost every
+// placement in a layout, stay exact. Anything else is rounded to the grid.
 void GDSPolygon::transformPoints(const GDSMat& M)
 {
+	if(isRect())
+	{
+		_Geometry->_Rects[_Index & ~GDS_RECT_VIEW].transform(M, _Geometry->_Units);
+		return;
+	}
+
+	GDSPolygonRecord& R = Record();
+	int32_t *X = R.NumPoints ? &_Geometry->_X[R.FirstPoint] : NULL;
+	int32_t *Y = R.NumPoints ? &_Geometry->_Y[R.FirstPoint] : NULL;
+	double units = _Geometry->_Units;
+	int32_t e[4];
+
 	// Clear bounding box
-	bbox.clear();
+	R.BBox.clear();
+
+	if(M.isManhattan())
+	{
+		for(unsigned int i=0;i<4;i++)
+			e[i] = (int32_t)lround(M[i]);
+
+		int32_t tx = (int32_t)lround(M[4]/units);
+		int32_t ty = (int32_t)lround(M[5]/units);
+
+		for(unsigned int i=0;i<R.NumPoints;i++)
+		{
+			int32_t x = X[i], y = Y[i];
 
-	for(unsigned int i=0;i<_Coords.size();i++)
+			X[i] = e[0]*x + e[2]*y + tx;
+			Y[i] = e[1]*x + e[3]*y + ty;
+			R.BBox.addPoint(X[i], Y[i]);
+		}
+		for(unsigned int i=0;i<NumFaces();i++)
+			_Geometry->_Faces[R.FirstIndex + i].transform(M, _Geometry->_Units);
+		return;
+	}
+
+	for(unsigned int i=0;i<R.NumPoints;i++)
+	{
+		double x = X[i], y = Y[i];
+
+		X[i] = (int32_t)lround(M[0]*x + M[2]*y + M[4]/units);
+		Y[i] = (int32_t)lround(M[1]*x + M[3]*y + M[5]/units);
+		R.BBox.addPoint(X[i], Y[i]);
+	}
+
+	// Faces do not survive other angles, triangulate the new outline. The
+	// ear clipper needs it counter-clockwise, mirrored ones are flipped
+	// back after.
+	if(R.Flags & GDS_POLYGON_FACES)
+	{
+		bool mirrored = M[0]*M[3] - M[1]*M[2] < 0;
+
+		R.Flags = 0;
+		R.NumIndices = 0;
+		if(mirrored)
+			Flip();
+		Tesselate();
+		if(mirrored)
+			Flip();
+	}
+}
+
+void GDSPolygon::transformPoints(const GDSTransform& T)
+{
+	if(isRect())
+	{
+		GDSBox& B = _Geometry->_Rects[_Index & ~GDS_RECT_VIEW];
+		B = T * B;
+		return;
+	}
+
+	GDSPolygonRecord& R = Record();
+	int32_t *X = R.NumPoints ? &_Geometry->_X[R.FirstPoint] : NULL;
+	int32_t *Y = R.NumPoints ? &_Geometry->_Y[R.FirstPoint] : NULL;
+
+	R.BBox.clear();
+	for(unsigned int i=0;i<R.NumPoints;i++)
 	{
-		_Coords[i] = M * _Coords[i];
-		bbox.addPoint(_Coords[i]);
+		GDSPoint P = {X[i], Y[i]};
+
+		P = T * P;
+		X[i] = P.X;
+		Y[i] = P.Y;
+		R.BBox.addPoint(P.X, P.Y);
 	}
+	for(unsigned int i=0;i<NumFaces();i++)
+		_Geometry->_Faces[R.FirstIndex + i] = T * _Geometry->_Faces[R.FirstIndex + i];
 }
 
-bool GDSPolygon::intersect(GDSPolygon *P1, GDSPolygon *P2)
+bool GDSPolygon::intersect(const GDSPolygon& P1, const GDSPolygon& P2)
 {
 	GDSTriangle		T1, T2;
 
-	// Bounding box intersection
-	if(!GDSBB::intersect(P1->bbox, P2->bbox))
+	// Bounding box intersection, for two rectangles that is all
+	if(!GDSBox::intersect(P1.Box(), P2.Box()))
+		return false;
+	if(P1.isRect() && P2.isRect())
+		return true;
+
+	// Faces against faces only take box tests, against triangles the two
+	// halves of each face that overlaps the other polygon
+	if(P2.hasFaces() && !P1.hasFaces())
+		return intersect(P2, P1);
+	if(P1.hasFaces())
+	{
+		for(unsigned int i=0;i<P1.NumFaces();i++)
+		{
+			const GDSBox& F = P1.Face(i);
+			GDSPoint C[4] = {{F.MinX, F.MinY}, {F.MaxX, F.MinY}, {F.MaxX, F.MaxY}, {F.MinX, F.MaxY}};
+
+			if(!GDSBox::intersect(F, P2.Box()))
+				continue;
+
+			if(P2.hasFaces())
+			{
+				for(unsigned int j=0;j<P2.NumFaces();j++)
+					if(GDSBox::intersect(F, P2.Face(j)))
+						return true;
+				continue;
+			}
+
+			const uint16_t *I2 = P2.Indices();
+			for(unsigned int k=0;k<2;k++)
+			{
+				T1.set(C[0], C[k+1], C[k+2]);
+				for(unsigned int j=0;j<P2.Record().NumIndices/3;j++)
+				{
+					T2.set(P2.Point(I2[j*3+0]), P2.Point(I2[j*3+1]), P2.Point(I2[j*3+2]));
+					if(GDSTriangle::intersect(T1, T2))
+						return true;
+				}
+			}
+		}
 		return false;
+	}
+
+	const uint16_t *I1 = P1.Indices();
+	const uint16_t *I2 = P2.Indices();
+	unsigned int N1 = P1.Record().NumIndices/3;
+	unsigned int N2 = P2.Record().NumIndices/3;
 
 	//We are doing this brute force
-	for(unsigned int i=0;i<P1->indices.size()/3;i++)
+	for(unsigned int i=0;i<N1;i++)
 	{
-		for(unsigned int j=0;j<P2->indices.size()/3;j++)
+		for(unsigned int j=0;j<N2;j++)
 		{
-			T1.set(P1->_Coords[P1->indices[i*3+0]], P1->_Coords[P1->indices[i*3+1]], P1->_Coords[P1->indices[i*3+2]]);
-			T2.set(P2->_Coords[P2->indices[j*3+0]], P2->_Coords[P2->indices[j*3+1]], P2->_Coords[P2->indices[j*3+2]]);
+			T1.set(P1.Point(I1[i*3+0]), P1.Point(I1[i*3+1]), P1.Point(I1[i*3+2]));
+			T2.set(P2.Point(I2[j*3+0]), P2.Point(I2[j*3+1]), P2.Point(I2[j*3+2]));
 
 			if(GDSTriangle::intersect(T1, T2))
 				return true;
@@ -609,4 +2033,3 @@ bool GDSPolygon::intersect(GDSPolygon *P1, GDSPolygon *P2)
 
 	return false;
 }
-
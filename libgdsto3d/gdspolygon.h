@@ -31,7 +31,11 @@
 
 #include "gds_globals.h"
 #include "process_cfg.h"
+#include "gdsarena.h"
+#include <stdint.h>
 #include <math.h>
+#include <algorithm>
+#include <unordered_map>
 
 // All these types are 2D
 class GDSMat
@@ -58,6 +62,7 @@ public:
 	void setRotation(const float& angle);
 
 	bool NegativeTrace() const;
+	bool isManhattan() const; // Only swaps or mirrors the axes
 	GDSMat Inverse() const;
 	void Round();
 };
@@ -68,6 +73,19 @@ bool GDSMat::NegativeTrace() const
 	return ((entries[0] < 0) != (entries[3] < 0));
 }
 
+// Rotations by multiples of 90 degrees leave cos/sin residues of 1e-8
+inline
+bool GDSMat::isManhattan() const
+{
+	for(unsigned int i=0;i<4;i++)
+	{
+		long e = lround(entries[i]);
+		if(e < -1 || e > 1 || fabs(entries[i] - e) > 1e-6)
+			return false;
+	}
+	return true;
+}
+
 // | 0 2 4 |   | X |
 // | 1 3 5 | X | Y | 
 inline Point2D GDSMat::operator*(const Point2D& P) const
@@ -133,83 +151,531 @@ public:
 	static bool intersect(const GDSBB& BB1, const GDSBB& BB2);
 };
 
+// Polygon geometry is kept in database units. The integer kernels below are
+// exact as long as coordinates stay within +-2^30, a metre at 1 nm.
+typedef struct GDSPoint
+{
+	int32_t		X;
+	int32_t		Y;
+}GDSPoint;
+
+// Bounding box in database units, touching boxes intersect
+class GDSBox
+{
+public:
+	int32_t MinX, MinY, MaxX, MaxY;
+
+	GDSBox() {clear();};
+
+	void clear() {MinX = MinY = INT32_MAX; MaxX = MaxY = INT32_MIN;};
+	bool isEmpty() const {return MinX > MaxX || MinY > MaxY;};
+	void addPoint(int32_t X, int32_t Y);
+	void merge(const GDSBox& B);
+	bool isPointInside(int32_t X, int32_t Y) const {return X >= MinX && X <= MaxX && Y >= MinY && Y <= MaxY;};
+	void transform(const GDSMat& M, float Units); // M in user units, exact if M.isManhattan()
+	bool setRectangle(const int32_t *XY, unsigned int Count); // From Count XY pairs, if they are an axis-aligned rectangle
+	GDSBB toBB(float Units) const; // In user units
+
+	static bool intersect(const GDSBox& B1, const GDSBox& B2);
+};
+
+inline void GDSBox::addPoint(int32_t X, int32_t Y)
+{
+	MinX = std::min(MinX, X);
+	MinY = std::min(MinY, Y);
+	MaxX = std::max(MaxX, X);
+	MaxY = std::max(MaxY, Y);
+}
+
+inline void GDSBox::merge(const GDSBox& B)
+{
+	MinX = std::min(MinX, B.MinX);
+	MinY = std::min(MinY, B.MinY);
+	MaxX = std::max(MaxX, B.MaxX);
+	MaxY = std::max(MaxY, B.MaxY);
+}
+
+inline bool GDSBox::intersect(const GDSBox& B1, const GDSBox& B2)
+{
+	return B1.MinX <= B2.MaxX && B2.MinX <= B1.MaxX && B1.MinY <= B2.MaxY && B2.MinY <= B1.MaxY;
+}
+
+// Exact placement in database units: orientation Code, then an integral
+// magnification, then the offset. Codes 0-3 rotate by that many quarter
+// turns counter-clockwise, 4-7 mirror in the X axis first. GDSMat remains
+// for what does not fit, other angles and fractional magnifications.
+class GDSTransform
+{
+public:
+	uint32_t	Code;
+	int32_t		Mag;
+	int32_t		X, Y;
+
+	GDSTransform() {Code = 0; Mag = 1; X = Y = 0;};
+
+	bool setOrientation(const GDSMat& M); // Code and Mag from the 2x2 part of M, false if it has none
+	GDSMat toMat(float Units) const; // In user units
+
+	GDSTransform operator*(const GDSTransform& T) const; // T first
+	GDSPoint operator*(const GDSPoint& P) const;
+	GDSBox operator*(const GDSBox& B) const;
+	bool Inverse(GDSTransform& Result) const; // False unless Mag is 1, the inverse is not whole then
+	bool operator==(const GDSTransform& T) const {return Code == T.Code && Mag == T.Mag && X == T.X && Y == T.Y;};
+	bool operator!=(const GDSTransform& T) const {return !(*this == T);};
+	unsigned long long Hash() const {return gds_hash(this, sizeof(GDSTransform));};
+};
+
+// For unordered containers keyed by GDSTransform
+struct GDSTransformHash
+{
+	size_t operator()(const GDSTransform& T) const {return (size_t)T.Hash();};
+};
+
+// 2x2 part of every code, in GDSMat order
+extern const int32_t gds_orientation[8][4];
+
+// The table does the orientation, so there are no branches on the code
+inline GDSPoint GDSTransform::operator*(const GDSPoint& P) const
+{
+	const int32_t *e = gds_orientation[Code];
+	GDSPoint R;
+
+	R.X = (int32_t)(Mag*((int64_t)e[0]*P.X + (int64_t)e[2]*P.Y) + X);
+	R.Y = (int32_t)(Mag*((int64_t)e[1]*P.X + (int64_t)e[3]*P.Y) + Y);
+	return R;
+}
+
+// Opposite corners stay opposite corners
+inline GDSBox GDSTransform::operator*(const GDSBox& B) const
+{
+	GDSPoint P0 = {B.MinX, B.MinY}, P1 = {B.MaxX, B.MaxY};
+	GDSBox R;
+
+	if(B.isEmpty())
+		return B;
+
+	P0 = *this * P0;
+	P1 = *this * P1;
+	R.MinX = std::min(P0.X, P1.X);
+	R.MinY = std::min(P0.Y, P1.Y);
+	R.MaxX = std::max(P0.X, P1.X);
+	R.MaxY = std::max(P0.Y, P1.Y);
+	return R;
+}
+
+// A mirror turns the rotations of T the other way: (R_a F)(R_b) = R_(a-b) F
+inline GDSTransform GDSTransform::operator*(const GDSTransform& T) const
+{
+	GDSPoint P = {T.X, T.Y};
+	uint32_t m = Code >> 2;
+	GDSTransform R;
+
+	P = *this * P;
+	R.Code = ((Code + (T.Code & 3)*(1 - 2*m)) & 3) | ((m ^ (T.Code >> 2)) << 2);
+	R.Mag = Mag*T.Mag;
+	R.X = P.X;
+	R.Y = P.Y;
+	return R;
+}
+
+// Rotations undo the other way round, mirrored ones are their own inverse
+inline bool GDSTransform::Inverse(GDSTransform& Result) const
+{
+	uint32_t m = Code >> 2;
+	GDSTransform R;
+	GDSPoint P = {-X, -Y};
+
+	if(Mag != 1)
+		return false;
+	R.Code = ((Code*(2*m - 1)) & 3) | (m << 2);
+	P = R * P;
+	R.X = P.X;
+	R.Y = P.Y;
+	Result = R;
+	return true;
+}
+
 class GDSTriangle
 {
 private:
-	Point2D	coords[3];
-	GDSBB	bbox;
+	GDSPoint	coords[3];
+	GDSBox		bbox;
 
-	void project(const Point2D& axis, float& min, float& max) const;
-	static void normal(const Point2D& P1, const Point2D& P2, Point2D& N);
+	void project(int64_t AX, int64_t AY, int64_t& min, int64_t& max) const;
 public:
 	GDSTriangle() {};
 
-	void set(const Point2D& P1, const Point2D& P2, const Point2D& P3);
+	void set(const GDSPoint& P1, const GDSPoint& P2, const GDSPoint& P3);
 	static bool intersect(const GDSTriangle& T1, const GDSTriangle& T2);	
 };
 
+class GDSPolygon;
+
+// One polygon in a GDSGeometry
+typedef struct GDSPolygonRecord
+{
+	uint32_t	FirstPoint;	// Into the X and Y arrays
+	uint32_t	FirstIndex;	// Into the index array, or the faces with GDS_POLYGON_FACES
+	uint32_t	NumIndices;	// Or the number of faces
+	uint16_t	NumPoints;
+	uint16_t	Flags;
+	float		Height;
+	float		Thickness;
+	struct ProcessLayer *Layer;
+	GDSBox		BBox;
+}GDSPolygonRecord;
+
+// Polygons of one layer, consecutive after GDSGeometry::Finish()
+typedef struct GDSLayerRange
+{
+	struct ProcessLayer *Layer;
+	uint32_t	FirstPolygon;
+	uint32_t	NumPolygons;
+}GDSLayerRange;
+
+// Rectangles of one layer, consecutive after GDSGeometry::Finish()
+typedef struct GDSRectRange
+{
+	struct ProcessLayer *Layer;
+	float		Height;
+	float		Thickness;
+	uint32_t	FirstRect;
+	uint32_t	NumRects;
+}GDSRectRange;
+
+// Triangle indices are 16 bit and relative to the first point of their polygon
+#define GDS_MAX_POLYGON_POINTS	65535
+
+// Rectilinear polygons are filled with rectangles instead of triangles
+#define GDS_POLYGON_FACES	0x0001
+
+// Decomposition takes up to the square of the points in the worst case
+#define GDS_MAX_FACE_POINTS	4096
+
+// Triangles come from the tesselation cache, other polygons of the geometry
+// may use the same indices
+#define GDS_POLYGON_SHARED	0x0002
+
+// Outlines up to this many points go through the tesselation cache, which
+// takes no new shapes once it holds this many bytes
+#define GDS_SHARED_MAX_POINTS	1024
+#define GDS_SHARED_MAX_BYTES	(64<<20)
+
+// Views with this bit set in their index are of a rectangle
+#define GDS_RECT_VIEW		0x80000000u
+
+typedef vector<int32_t, GDSArenaAllocator<int32_t> > GDSCoordArray;
+typedef vector<uint16_t, GDSArenaAllocator<uint16_t> > GDSIndexArray;
+typedef vector<GDSPolygonRecord, GDSArenaAllocator<GDSPolygonRecord> > GDSPolygonArray;
+typedef vector<GDSLayerRange, GDSArenaAllocator<GDSLayerRange> > GDSLayerArray;
+typedef vector<GDSBox, GDSArenaAllocator<GDSBox> > GDSRectArray;
+typedef vector<GDSRectRange, GDSArenaAllocator<GDSRectRange> > GDSRectRangeArray;
+
+// All polygons of one GDSObject. Coordinates live in two flat X and Y
+// arrays and triangles in one index array, each polygon is a record with
+// its ranges, so walking all geometry of a layer is a linear pass over a
+// few arrays instead of chasing a vector per polygon.
+//
+// Coordinates are the integer database units of the GDS file. Units gives
+// the size of one in user units (microns), floats are only made where the
+// geometry leaves the library, like vertex buffers and GetBBox().
+//
+// Axis-aligned rectangles, most shapes of a layout, are not polygons but
+// a box in a table of their own, four ints without points or triangles.
+// Each rectangle refers to a range holding its layer, Height and Thickness.
+// Other rectilinear polygons keep their outline, but are filled with
+// rectangles, their faces, instead of triangles.
+//
+// The arrays grow on the heap and Finish() can move them, at their final
+// size, into the arena of the owning object.
+class GDSGeometry
+{
+	friend class GDSPolygon;
+	friend class GDSCache;
+
+private:
+	GDSCoordArray		_X;
+	GDSCoordArray		_Y;
+	GDSIndexArray		_Indices;
+	GDSRectArray		_Faces; // Of rectilinear polygons
+	GDSPolygonArray		_Polygons;
+	GDSLayerArray		_Layers;
+	GDSRectArray		_Rects;
+	GDSIndexArray		_RectRange; // Range of each rectangle
+	GDSRectRangeArray	_RectRanges;
+	unordered_multimap<unsigned long long, uint32_t> _Shared; // Polygons with shared indices by the hash of their shape, until Finish()
+	unsigned int		_LastRange; // Most rectangles go to the range of the one before
+	bool			_Bucketed; // _Layers and _RectRanges are up to date
+	bool			_Stored; // Arrays are in an arena, copy them out before growing
+	float			_Units; // User units per database unit
+
+	void Thaw();
+
+public:
+	GDSGeometry();
+
+	void Clear();
+	void SetUnits(float Units) {_Units = Units;};
+	float GetUnits() {return _Units;};
+	void Reserve(unsigned int Polygons, unsigned int Points, unsigned int Indices);
+
+	// New polygons are filled through the returned view, points can only
+	// be added to the last polygon
+	GDSPolygon AddPolygon(float Height, float Thickness, struct ProcessLayer *Layer, unsigned int Points);
+	GDSPolygon AddPolygon(const GDSPolygon& P); // Copy, triangles included, in the same units, not shared
+	void AddRect(float Height, float Thickness, struct ProcessLayer *Layer, const GDSBox& Box);
+
+	// Large objects are built in chunks, each into a geometry of its own,
+	// and put together again in order. Congruent polygons of different
+	// chunks share their indices as if they were tesselated here.
+	void ClearPolygons(); // Rectangles stay
+	void Append(GDSGeometry& Chunk); // Its polygons, triangles and faces
+
+	// Order the polygons by layer and drop unused capacity, storing the
+	// arrays in Arena if given. Views taken before by index point to other
+	// polygons afterwards.
+	void Finish(GDSArena *Arena = NULL);
+	const GDSLayerArray& GetLayers(); // Finishes if needed
+	const GDSRectRangeArray& GetRectRanges(); // Finishes if needed
+
+	unsigned int GetNumPolygons() {return _Polygons.size();};
+	unsigned int GetNumPoints() {return _X.size();};
+	unsigned int GetNumIndices() {return _Indices.size();};
+	unsigned int GetNumFaces() {return _Faces.size();};
+	unsigned long long GetNumTriangles(); // Drawn when extruded
+	unsigned long long GetNumVertices(); // Made when extruded
+	GDSPolygon GetPolygon(unsigned int Index);
+
+	unsigned int GetNumRects() {return _Rects.size();};
+	const GDSBox& GetRectBox(unsigned int Index) {return _Rects[Index];};
+	GDSPolygon GetRect(unsigned int Index); // As a view, see GDSPolygon
+};
+
+// How a polygon filled with rectangles is extruded. The top vertices are
+// the outline, then Extra, the bottom repeats them. Triangles are three top
+// vertices each, two per face, ending on the vertex that gives their
+// normal: a face corner that is not on the outline or an odd one, as the
+// walls end on the even ones. A triangle without such a corner gets a
+// vertex of its own in Extra.
+typedef struct GDSFaceMesh
+{
+	vector<GDSPoint>	Extra;
+	vector<unsigned int>	Triangles;
+}GDSFaceMesh;
+
+// Triangles take their normal from their last vertex. The top and bottom
+// end on vertices of one parity, E or O, and the walls on the other. True
+// if the triangles need both, the walls then get vertices of their own.
+bool gds_wall_vertices(const uint16_t *Indices, unsigned int NumIndices, int& E, int& O);
+
+// Lightweight view of one polygon in a GDSGeometry. Views are cheap to copy
+// and stay valid while polygons are added, pointers returned by GetX(),
+// GetY() and GetIndices() only until the geometry grows.
+//
+// A view can also be of a rectangle, it then acts as a polygon of four
+// counter-clockwise points, but has no coordinate arrays:
+// GetX() and GetY() return NULL. Copy it with GDSGeometry::AddPolygon() to
+// get a real polygon.
+//
+// Polygons with faces, and rectangles, which are their own face, are filled
+// by GetNumFaces() rectangles. They have no triangles, GetIndices() returns
+// NULL for them.
 class GDSPolygon
 {
+	friend class GDSGeometry;
+	friend class GDSEarClipper;
+
 private:
-	float			_Height;
-	float			_Thickness;
-	vector<Point2D>	_Coords;
-	vector<int>		indices;
-	struct ProcessLayer	*_Layer;
-	GDSBB			bbox;
-
-	double epsilon;
-	double area(const Point2D& A, const Point2D& B, const Point2D& C);
-	bool onLine(const Point2D& A, const Point2D& B, const Point2D& P);
-    bool insideTriangle(const Point2D& A, const Point2D& B, const Point2D& C,const Point2D& P);
+	GDSGeometry	*_Geometry;
+	unsigned int	_Index;
+
+	GDSPolygonRecord& Record() const {return _Geometry->_Polygons[_Index];};
+	const GDSRectRange& Range() const {return _Geometry->_RectRanges[_Geometry->_RectRange[_Index & ~GDS_RECT_VIEW]];};
+	const GDSBox& Rect() const {return _Geometry->_Rects[_Index & ~GDS_RECT_VIEW];};
+	const GDSBox& Box() const {return isRect() ? Rect() : Record().BBox;};
+	const GDSBox& Face(unsigned int Index) const {return isRect() ? Rect() : _Geometry->_Faces[Record().FirstIndex + Index];};
+	unsigned int NumFaces() const {return isRect() ? 1 : (Record().Flags & GDS_POLYGON_FACES) ? Record().NumIndices : 0;};
+	GDSPoint Point(unsigned int Index) const;
+	const uint16_t *Indices() const;
+
+	static int64_t area(const GDSPoint& A, const GDSPoint& B, const GDSPoint& C);
+	static bool onLine(const GDSPoint& A, const GDSPoint& B, const GDSPoint& P);
+	static bool insideTriangle(const GDSPoint& A, const GDSPoint& B, const GDSPoint& C, const GDSPoint& P);
 
 public:
-	GDSPolygon() {_Layer = NULL;};
-	GDSPolygon(float Height, float Thickness, struct ProcessLayer *Layer);
-	~GDSPolygon();
+	GDSPolygon() {_Geometry = NULL; _Index = 0;};
+	GDSPolygon(GDSGeometry *Geometry, unsigned int Index) {_Geometry = Geometry; _Index = Index;};
 
-    void Clear();
-	void CopyInto(GDSPolygon *p); // Remove? nothing really different from default copy..
-	void AddPoint(float X, float Y);
-	void Tesselate(); // Build a triangle index list
+	bool isValid() const {return _Geometry != NULL;};
+	bool isRect() const {return (_Index & GDS_RECT_VIEW) != 0;};
+	bool hasFaces() const {return NumFaces() > 0;};
+	bool operator<(const GDSPolygon& P) const; // Ordering for sets of polygons
+	bool operator==(const GDSPolygon& P) const {return _Geometry == P._Geometry && _Index == P._Index;};
 
-	GDSBB* GetBBox();
+	void Clear(); // Only for the last polygon of the geometry
+	void AddPoint(int32_t X, int32_t Y); // Only for the last polygon of the geometry
+	void AddPoints(const byte *XY, unsigned int Count); // Decode Count points of an XY record
+	void Tesselate(); // Build a triangle index list, or the faces if rectilinear, shared with congruent polygons
+
+	const GDSBox& GetBox(); // Database units
+	GDSBB GetBBox(); // User units
+	float GetUnits() const {return _Geometry->_Units;};
 	float GetHeight();
 	float GetThickness();
 	unsigned int GetPoints();
-	vector<int>* GetIndices();
-	float GetXCoords(unsigned int Index);
-	float GetYCoords(unsigned int Index);
-	float GetAngleCoords(unsigned int Index);
-	void SetAngleCoords(unsigned int Index, float value);
-    void Flip(); // Flip the winding order
-    void Orientate(); // Make sure normal points upwards
+	const int32_t *GetX(); // The coordinates, GetPoints() in a row
+	const int32_t *GetY();
+	int32_t GetXCoords(unsigned int Index);
+	int32_t GetYCoords(unsigned int Index);
+	const uint16_t *GetIndices(); // Tesselates if not done before
+	unsigned int GetNumIndices();
+	unsigned int GetNumFaces() {return NumFaces();};
+	const GDSBox& GetFace(unsigned int Index) {return Face(Index);};
+	void GetFaceMesh(GDSFaceMesh& Mesh); // Of a polygon with faces
+	void Flip(); // Flip the winding order
+	void Orientate(); // Make sure normal points upwards
 	struct ProcessLayer *GetLayer();
-    bool isSimple();
-	bool isPointInside(const Point2D& P);
+	bool isSimple();
+	bool isPointInside(int32_t X, int32_t Y);
+
+	void transformPoints(const GDSMat& M); // M is in user units, the result is rounded to database units
+	void transformPoints(const GDSTransform& T); // Exact, T is in the database units of the geometry
+	static bool intersect(const GDSPolygon& P1, const GDSPolygon& P2);
+};
+
+// Standard cells and PCell variants repeat the same outlines thousands of
+// times at other positions. Tesselate() keys outlines by their points
+// relative to the first one and tesselates each shape once per library.
+// The table only saves time, the triangles and their layout come out the
+// same without it. GDSParse clears it for every library and reload.
+void gds_clear_tesselations();
+
+// Lookups, hits, distinct shapes and their bytes since the last clear
+void gds_tesselation_stats(unsigned long long& Lookups, unsigned long long& Hits, unsigned long long& Shapes, unsigned long long& Bytes);
 
-	void transformPoints(const GDSMat& M);
-	static bool intersect(GDSPolygon *P1, GDSPolygon *P2);
+// Triangulates one counter-clockwise outline by ear clipping. The vertices
+// are a circular double linked list, and only the reflex ones, which are
+// the only ones that can lie inside an ear, are kept in a grid, so clipping
+// n vertices takes about n ear tests of a few vertices each.
+typedef struct GDSEarNode
+{
+	GDSPoint	P;
+	unsigned int	Prev;
+	unsigned int	Next;
+	bool		Removed;
+}GDSEarNode;
+
+class GDSEarClipper
+{
+private:
+	vector<GDSEarNode>	_Nodes;
+	unsigned int		_Left; // Vertices still in the list
+	unsigned int		_Start;
+	GDSBox			_Box; // Of the reflex vertices
+	int64_t			_W, _H;
+	unsigned int		_SideX, _SideY; // Grid cells across and up
+	vector<unsigned int>	_Cells; // First entry of each cell in _Reflex
+	vector<unsigned int>	_Reflex;
+
+	bool isReflex(unsigned int I) const;
+	bool isEar(unsigned int I) const;
+	void Remove(unsigned int I);
+	bool Filter();
+	void BuildGrid();
+	unsigned int CellX(int32_t X) const {return (unsigned int)((((int64_t)X - _Box.MinX) * _SideX) / _W);};
+	unsigned int CellY(int32_t Y) const {return (unsigned int)((((int64_t)Y - _Box.MinY) * _SideY) / _H);};
+
+public:
+	GDSEarClipper(const int32_t *X, const int32_t *Y, unsigned int Count);
+
+	void Clip(GDSIndexArray& Indices); // Appends triangles, indices relative to X and Y
 };
 
-inline GDSBB* GDSPolygon::GetBBox()
+inline GDSPolygon GDSGeometry::GetPolygon(unsigned int Index)
 {
-	return &bbox;
+	return GDSPolygon(this, Index);
+}
+
+inline bool GDSPolygon::operator<(const GDSPolygon& P) const
+{
+	if(_Geometry != P._Geometry)
+		return _Geometry < P._Geometry;
+	return _Index < P._Index;
+}
+
+inline GDSPolygon GDSGeometry::GetRect(unsigned int Index)
+{
+	return GDSPolygon(this, Index | GDS_RECT_VIEW);
+}
+
+// Rectangles go counter-clockwise from the lower left corner
+inline GDSPoint GDSPolygon::Point(unsigned int Index) const
+{
+	if(isRect())
+	{
+		const GDSBox& B = Rect();
+		GDSPoint P = {(Index == 1 || Index == 2) ? B.MaxX : B.MinX, Index >= 2 ? B.MaxY : B.MinY};
+		return P;
+	}
+
+	unsigned int i = Record().FirstPoint + Index;
+	GDSPoint P = {_Geometry->_X[i], _Geometry->_Y[i]};
+	return P;
+}
+
+inline const GDSBox& GDSPolygon::GetBox()
+{
+	return Box();
+}
+
+inline GDSBB GDSPolygon::GetBBox()
+{
+	return GetBox().toBB(_Geometry->_Units);
 }
 
 inline struct ProcessLayer *GDSPolygon::GetLayer()
 {
-	return _Layer;
+	return isRect() ? Range().Layer : Record().Layer;
 }
 
 inline float GDSPolygon::GetHeight()
 {
-	return _Height;
+	return isRect() ? Range().Height : Record().Height;
 }
 
 inline float GDSPolygon::GetThickness()
 {
-	return _Thickness;
+	return isRect() ? Range().Thickness : Record().Thickness;
+}
+
+inline unsigned int GDSPolygon::GetPoints()
+{
+	return isRect() ? 4 : Record().NumPoints;
+}
+
+inline const int32_t *GDSPolygon::GetX()
+{
+	return _Geometry->_X.empty() || isRect() ? NULL : &_Geometry->_X[0] + Record().FirstPoint;
+}
+
+inline const int32_t *GDSPolygon::GetY()
+{
+	return _Geometry->_Y.empty() || isRect() ? NULL : &_Geometry->_Y[0] + Record().FirstPoint;
+}
+
+inline int32_t GDSPolygon::GetXCoords(unsigned int Index)
+{
+	return isRect() ? Point(Index).X : _Geometry->_X[Record().FirstPoint + Index];
+}
+
+inline int32_t GDSPolygon::GetYCoords(unsigned int Index)
+{
+	return isRect() ? Point(Index).Y : _Geometry->_Y[Record().FirstPoint + Index];
+}
+
+inline unsigned int GDSPolygon::GetNumIndices()
+{
+	return isRect() || (Record().Flags & GDS_POLYGON_FACES) ? 0 : Record().NumIndices;
 }
 
 #endif // __GDSPOLYGON_H__
@@ -0,0 +1,379 @@
+//  GDS3D, a program for viewing GDSII files in 3D.
+//  Created by Jasper Velner and Michiel Soer, http://icd.el.utwente.nl
+//  Copyright (C) 2013 IC-Design Group, University of Twente.
+//
+//  Based on gds2pov by Roger Light, http://atchoo.org/gds2pov/ / https://github.com/ralight/gds2pov
+//  Copyright (C) 2004-2008 by Roger Light
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "gdsreader.h"
+#include <math.h>
+
+#ifdef WIN32
+	#include <Windows.h>
+	#include <io.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define GDS_SSE2
+	#include <emmintrin.h>
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define GDS_TARGET_AVX2
+	#else
+		#define GDS_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+double gds_real8(const byte *p)
+{
+	double sign=1.0;
+	double exponent;
+	double mant;
+	byte value = p[0];
+
+	if(value & 128){
+		value -= 128;
+		sign = -1.0;
+	}
+	exponent = (double)value;
+	exponent -= 64.0;
+
+	mant = 0.0;
+	for(int i=7; i>0; i--){
+		mant += p[i];
+		mant /= 256.0;
+	}
+
+	return sign*(mant*pow(16.0,exponent));
+}
+
+static void decode_xy_scalar(const byte *src, unsigned int Count, int32_t *dst)
+{
+	for(unsigned int i=0; i<Count; i++)
+		dst[i] = gds_int32(src + 4*i);
+}
+
+#ifdef GDS_SSE2
+static void decode_xy_sse2(const byte *src, unsigned int Count, int32_t *dst)
+{
+	unsigned int i = 0;
+
+	for(; i+4 <= Count; i+=4){
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + 4*i));
+		// Swap the bytes of each 16 bit word, then the words of each 32 bit value
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2,3,0,1));
+		v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2,3,0,1));
+		_mm_storeu_si128((__m128i *)(dst + i), v);
+	}
+	decode_xy_scalar(src + 4*i, Count - i, dst + i);
+}
+
+GDS_TARGET_AVX2
+static void decode_xy_avx2(const byte *src, unsigned int Count, int32_t *dst)
+{
+	const __m256i swap = _mm256_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12,
+										  3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12);
+	unsigned int i = 0;
+
+	for(; i+8 <= Count; i+=8){
+		__m256i v = _mm256_loadu_si256((const __m256i *)(src + 4*i));
+		v = _mm256_shuffle_epi8(v, swap);
+		_mm256_storeu_si256((__m256i *)(dst + i), v);
+	}
+	decode_xy_sse2(src + 4*i, Count - i, dst + i);
+}
+
+static bool has_avx2()
+{
+#ifdef _MSC_VER
+	int info[4];
+
+	__cpuid(info, 0);
+	if(info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	if(!(info[2] & (1<<27))) // OSXSAVE
+		return false;
+	if((_xgetbv(0) & 6) != 6) // YMM state enabled by the OS
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1<<5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+static gds_decode_xy_func select_decode_xy()
+{
+#ifdef GDS_SSE2
+	if(has_avx2()){
+		v_printf(2, "Using AVX2 coordinate decoding.\n");
+		return decode_xy_avx2;
+	}
+	return decode_xy_sse2;
+#else
+	return decode_xy_scalar;
+#endif
+}
+
+void gds_decode_xy(const byte *src, unsigned int Count, int32_t *dst)
+{
+	static gds_decode_xy_func decode = select_decode_xy();
+
+	decode(src, Count, dst);
+}
+
+gds_decode_xy_func gds_decode_xy_kernel(unsigned int Level)
+{
+	switch(Level){
+		case 0:
+			return decode_xy_scalar;
+#ifdef GDS_SSE2
+		case 1:
+			return decode_xy_sse2;
+		case 2:
+			return has_avx2() ? decode_xy_avx2 : NULL;
+#endif
+		default:
+			return NULL;
+	}
+}
+
+GDSFileMap::GDSFileMap()
+{
+	_data = NULL;
+	_mapping = NULL;
+	_size = 0;
+}
+
+GDSFileMap::~GDSFileMap()
+{
+	Close();
+}
+
+bool GDSFileMap::Open(FILE *iptr, int64_t size, bool sequential)
+{
+	Close();
+
+	// A 32 bit address space cannot hold every file
+	if(!iptr || size <= 0 || (uint64_t)size > SIZE_MAX)
+		return false;
+
+#ifdef WIN32
+	HANDLE file = (HANDLE)_get_osfhandle(_fileno(iptr));
+	if(file == INVALID_HANDLE_VALUE)
+		return false;
+	HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(!mapping)
+		return false;
+	void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if(!view){
+		CloseHandle(mapping);
+		return false;
+	}
+	_mapping = mapping;
+#else
+	void *view = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, fileno(iptr), 0);
+	if(view == MAP_FAILED)
+		return false;
+	if(sequential)
+		madvise(view, (size_t)size, MADV_SEQUENTIAL);
+#endif
+	_data = (const byte *)view;
+	_size = size;
+	return true;
+}
+
+void GDSFileMap::Close()
+{
+	if(_data){
+#ifdef WIN32
+		UnmapViewOfFile((LPCVOID)_data);
+		CloseHandle((HANDLE)_mapping);
+		_mapping = NULL;
+#else
+		munmap((void *)_data, (size_t)_size);
+#endif
+		_data = NULL;
+	}
+	_size = 0;
+}
+
+GDSReader::GDSReader()
+{
+	_iptr = NULL;
+	_map = NULL;
+	_size = 0;
+	_end = 0;
+	_pos = 0;
+	_offset = 0;
+	_view = false;
+	_owned = NULL;
+	_buffer = NULL;
+
+	_record.RecordLength = 0;
+	_record.RecordType = 0;
+	_record.DataType = 0;
+	_record.Data = NULL;
+}
+
+GDSReader::~GDSReader()
+{
+	Close();
+}
+
+bool GDSReader::Open(FILE *iptr)
+{
+	Close();
+
+	if(!iptr)
+		return false;
+	_iptr = iptr;
+
+	_size = gds_file_size(_iptr);
+	if(_size < 0){
+		v_printf(1, "Unable to get the size of the GDS file.\n");
+		_iptr = NULL;
+		_size = 0;
+		return false;
+	}
+	gds_file_seek(_iptr, 0);
+	_end = _size;
+
+	if(_file.Open(_iptr, _size, true)){
+		_map = _file.GetData();
+	}else{
+		v_printf(2, "Unable to map GDS file, falling back to buffered reads.\n");
+		_buffer = new byte[65536];
+	}
+	return true;
+}
+
+bool GDSReader::OpenView(const GDSReader& source)
+{
+	Close();
+
+	// Only a mapped file can be read from several places at once
+	if(!source._map)
+		return false;
+
+	_map = source._map;
+	_size = _end = source._size;
+	_view = true;
+	return true;
+}
+
+bool GDSReader::OpenBuffer(byte *data, int64_t size)
+{
+	Close();
+
+	if(!data)
+		return false;
+
+	_owned = data;
+	_map = data;
+	_size = _end = size;
+	return true;
+}
+
+void GDSReader::Close()
+{
+	_file.Close();
+	_map = NULL;
+	_view = false;
+	if(_owned){
+		delete [] _owned;
+		_owned = NULL;
+	}
+	if(_buffer){
+		delete [] _buffer;
+		_buffer = NULL;
+	}
+	_iptr = NULL;
+	_size = 0;
+	_end = 0;
+	_pos = 0;
+	_offset = 0;
+	_record.RecordLength = 0;
+	_record.Data = NULL;
+}
+
+void GDSReader::Seek(int64_t offset)
+{
+	_pos = offset;
+	if(!_map && _iptr)
+		gds_file_seek(_iptr, offset);
+}
+
+void GDSReader::SetRange(int64_t begin, int64_t end)
+{
+	Seek(begin);
+	_end = (end < _size) ? end : _size;
+}
+
+bool GDSReader::NextRecord()
+{
+	byte header[4];
+	unsigned short length;
+
+	if(_pos + 4 > _end)
+		return false;
+
+	if(_map){
+		memcpy(header, _map + _pos, 4);
+	}else{
+		if(fread(header, 1, 4, _iptr) != 4)
+			return false;
+	}
+
+	// Zero padding after ENDLIB, or garbage
+	length = (unsigned short)gds_int16(header);
+	if(length < 4){
+		v_printf(2, "Invalid record length (%d) at position %lld.\n", length, (long long)_pos);
+		return false;
+	}
+	length -= 4;
+
+	if(_pos + 4 + length > _end){
+		v_printf(1, "Truncated record at position %lld.\n", (long long)_pos);
+		return false;
+	}
+
+	_offset = _pos;
+	_record.RecordLength = length;
+	_record.RecordType = header[2];
+	_record.DataType = header[3];
+
+	if(_map){
+		_record.Data = _map + _pos + 4;
+	}else{
+		if(length && fread(_buffer, 1, length, _iptr) != length)
+			return false;
+		_record.Data = _buffer;
+	}
+	_pos += 4 + length;
+
+	return true;
+}
@@ -0,0 +1,108 @@
+//  GDS3D, a program for viewing GDSII files in 3D.
+//  Created by Jasper Velner and Michiel Soer, http://icd.el.utwente.nl
+//  Copyright (C) 2013 IC-Design Group, University of Twente.
+//
+//  Based on gds2pov by Roger Light, http://atchoo.org/gds2pov/ / https://github.com/ralight/gds2pov
+//  Copyright (C) 2004-2008 by Roger Light
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef __GDSREADER_H__
+#define __GDSREADER_H__
+
+#include "gds_globals.h"
+
+// Big endian decoding straight from the record bytes
+inline int16_t gds_int16(const byte *p)
+{
+	return (int16_t)(((unsigned short)p[0] << 8) | (unsigned short)p[1]);
+}
+
+inline int32_t gds_int32(const byte *p)
+{
+	return (int32_t)(((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | (unsigned int)p[3]);
+}
+
+double gds_real8(const byte *p);
+
+// Decode Count big endian 32 bit integers, used for whole XY records. Picks
+// an SSE2/AVX2 kernel at runtime where available.
+void gds_decode_xy(const byte *src, unsigned int Count, int32_t *dst);
+
+// One kernel of gds_decode_xy(), for testing and benchmarks: 0 is scalar,
+// 1 SSE2 and 2 AVX2. NULL where the build or the CPU has no such kernel.
+typedef void (*gds_decode_xy_func)(const byte *src, unsigned int Count, int32_t *dst);
+gds_decode_xy_func gds_decode_xy_kernel(unsigned int Level);
+
+// Read-only memory mapping of a whole file
+class GDSFileMap
+{
+private:
+	const byte		*_data;
+	void			*_mapping;	// Win32 mapping handle
+	int64_t			_size;
+
+public:
+	GDSFileMap();
+	~GDSFileMap();
+
+	bool Open(FILE *iptr, int64_t size, bool sequential);
+	void Close();
+
+	const byte *GetData() const { return _data; }
+	int64_t GetSize() const { return _size; }
+};
+
+// Walks the records of a GDSII file. The file is memory mapped when the
+// platform allows it, so every record is a view into the mapping and no data
+// is copied. Otherwise each record is read with a single fread into a buffer.
+class GDSReader
+{
+private:
+	FILE			*_iptr;
+	GDSFileMap		_file;
+	const byte		*_map;		// Mapped file, NULL when using stdio
+	int64_t			_size;		// Size of the file in bytes
+	int64_t			_end;		// Records are read up to this offset
+	int64_t			_pos;		// Offset of the next record header
+	bool			_view;		// Borrows the mapping of another reader
+	byte			*_owned;	// Stream in memory, freed on Close()
+	int64_t			_offset;	// Offset of the current record header
+
+	byte			*_buffer;	// Record buffer for the stdio fallback
+	gds_header		_record;
+
+public:
+	GDSReader();
+	~GDSReader();
+
+	bool Open(FILE *iptr);
+	bool OpenView(const GDSReader& source); // Share the mapping of an open reader
+	bool OpenBuffer(byte *data, int64_t size); // Read a stream in memory, takes ownership
+	void Close();
+
+	// Fetch the next record, returns false at the end of the file or range
+	bool NextRecord();
+	void Seek(int64_t offset);
+	void SetRange(int64_t begin, int64_t end);
+
+	const gds_header& GetRecord() { return _record; }
+	int64_t GetOffset() { return _offset; }
+	int64_t GetSize() { return _size; }
+	const byte *GetData() { return _map; } // Whole file, NULL when using stdio
+	bool IsMapped() { return _map != NULL; }
+};
+
+#endif // __GDSREADER_H__
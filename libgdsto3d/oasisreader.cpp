@@ -0,0 +1,1664 @@
+//  GDS3D, a program for viewing GDSII files in 3D.
+//  Created by Jasper Velner and Michiel Soer, http://icd.el.utwente.nl
+//  Copyright (C) 2013 IC-Design Group, University of Twente.
+//
+//  Based on gds2pov by Roger Light, http://atchoo.org/gds2pov/ / https://github.com/ralight/gds2pov
+//  Copyright (C) 2004-2008 by Roger Light
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "oasisreader.h"
+#include "gdsreader.h"
+#include "../math/Maths.h"
+
+// OASIS record types
+enum OASISRecord{
+	orPad, orStart, orEnd,
+	orCellName, orCellNameRef, orTextString, orTextStringRef,
+	orPropName, orPropNameRef, orPropString, orPropStringRef,
+	orLayerName, orLayerNameText,
+	orCellRef, orCell,
+	orXYAbsolute, orXYRelative,
+	orPlacement, orPlacementMag,
+	orText, orRectangle, orPolygon, orPath,
+	orTrapezoid, orTrapezoidA, orTrapezoidB, orCTrapezoid, orCircle,
+	orProperty, orPropertyRepeat,
+	orXName, orXNameRef, orXElement, orXGeometry,
+	orCBlock
+};
+
+// Largest element a GDSII XY record can hold
+#define GDS_MAX_POINTS	8190
+
+// Segments used for CIRCLE records
+#define OASIS_CIRCLE_SEGMENTS	64
+
+// Lattices written out element by element may have this many per byte of
+// input left, more is taken for a corrupt count
+#define OASIS_LATTICE_PER_BYTE	65536
+
+// Vertices of the CTRAPEZOID types, x = a*w + b*h and y = c*w + d*h
+static const signed char ctrapezoids[26][4][4] = {
+	{{0,0,0,0}, {0,0,0,1}, {1,-1,0,1}, {1,0,0,0}},
+	{{0,0,0,0}, {0,0,0,1}, {1,0,0,1}, {1,-1,0,0}},
+	{{0,0,0,0}, {0,1,0,1}, {1,0,0,1}, {1,0,0,0}},
+	{{0,1,0,0}, {0,0,0,1}, {1,0,0,1}, {1,0,0,0}},
+	{{0,0,0,0}, {0,1,0,1}, {1,-1,0,1}, {1,0,0,0}},
+	{{0,1,0,0}, {0,0,0,1}, {1,0,0,1}, {1,-1,0,0}},
+	{{0,0,0,0}, {0,1,0,1}, {1,0,0,1}, {1,-1,0,0}},
+	{{0,1,0,0}, {0,0,0,1}, {1,-1,0,1}, {1,0,0,0}},
+	{{0,0,0,0}, {0,0,0,1}, {1,0,-1,1}, {1,0,0,0}},
+	{{0,0,0,0}, {0,0,-1,1}, {1,0,0,1}, {1,0,0,0}},
+	{{0,0,0,0}, {0,0,0,1}, {1,0,0,1}, {1,0,1,0}},
+	{{0,0,1,0}, {0,0,0,1}, {1,0,0,1}, {1,0,0,0}},
+	{{0,0,0,0}, {0,0,0,1}, {1,0,-1,1}, {1,0,1,0}},
+	{{0,0,1,0}, {0,0,-1,1}, {1,0,0,1}, {1,0,0,0}},
+	{{0,0,0,0}, {0,0,-1,1}, {1,0,0,1}, {1,0,1,0}},
+	{{0,0,1,0}, {0,0,0,1}, {1,0,-1,1}, {1,0,0,0}},
+	{{0,0,0,0}, {0,0,1,0}, {1,0,0,0}, {1,0,0,0}},
+	{{0,0,0,0}, {0,0,1,0}, {1,0,1,0}, {1,0,1,0}},
+	{{0,0,0,0}, {1,0,1,0}, {1,0,0,0}, {1,0,0,0}},
+	{{0,0,1,0}, {1,0,1,0}, {1,0,0,0}, {1,0,0,0}},
+	{{0,0,0,0}, {0,1,0,1}, {0,2,0,0}, {0,2,0,0}},
+	{{0,0,0,1}, {0,2,0,1}, {0,1,0,0}, {0,1,0,0}},
+	{{0,0,0,0}, {0,0,2,0}, {1,0,1,0}, {1,0,1,0}},
+	{{1,0,0,0}, {0,0,1,0}, {1,0,2,0}, {1,0,2,0}},
+	{{0,0,0,0}, {0,0,0,1}, {1,0,0,1}, {1,0,0,0}},
+	{{0,0,0,0}, {0,0,1,0}, {1,0,1,0}, {1,0,0,0}}
+};
+
+/*
+** Raw DEFLATE (RFC 1951) decoder for CBLOCK records, after Mark Adler's
+** puff.c. Speed matters little here, CBLOCKs are small and decompressed once.
+*/
+
+typedef struct InflateState{
+	const byte	*in;
+	size_t		inlen, inpos;
+	unsigned int	bitbuf, bitcnt;
+	byte		*out;
+	size_t		outlen, outpos;
+	bool		error;
+}InflateState;
+
+typedef struct InflateHuffman{
+	short		count[16];	// Number of codes of each length
+	short		symbol[288];	// Symbols ordered by code
+}InflateHuffman;
+
+static int inflate_bits(InflateState *s, int need)
+{
+	unsigned long val = s->bitbuf;
+
+	while(s->bitcnt < (unsigned int)need){
+		if(s->inpos == s->inlen){
+			s->error = true;
+			return 0;
+		}
+		val |= (unsigned long)s->in[s->inpos++] << s->bitcnt;
+		s->bitcnt += 8;
+	}
+	s->bitbuf = (unsigned int)(val >> need);
+	s->bitcnt -= need;
+	return (int)(val & ((1UL << need) - 1));
+}
+
+static int inflate_decode(InflateState *s, const InflateHuffman *h)
+{
+	int code = 0, first = 0, index = 0;
+
+	for(int len=1; len<16; len++){
+		code |= inflate_bits(s, 1);
+		int count = h->count[len];
+		if(code - count < first)
+			return h->symbol[index + (code - first)];
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+	return -1;
+}
+
+// Returns false for an over-subscribed code
+static bool inflate_construct(InflateHuffman *h, const short *length, int n)
+{
+	short offs[16];
+	int left = 1;
+
+	memset(h->count, 0, sizeof(h->count));
+	for(int i=0; i<n; i++)
+		h->count[length[i]]++;
+	if(h->count[0] == n)
+		return true;
+
+	for(int len=1; len<16; len++){
+		left <<= 1;
+		left -= h->count[len];
+		if(left < 0)
+			return false;
+	}
+
+	offs[1] = 0;
+	for(int len=1; len<15; len++)
+		offs[len+1] = offs[len] + h->count[len];
+	for(int i=0; i<n; i++){
+		if(length[i])
+			h->symbol[offs[length[i]]++] = (short)i;
+	}
+	return true;
+}
+
+static bool inflate_codes(InflateState *s, const InflateHuffman *lencode, const InflateHuffman *distcode)
+{
+	static const short lbase[29] = {3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258};
+	static const short lext[29] = {0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0};
+	static const short dbase[30] = {1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577};
+	static const short dext[30] = {0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+	int symbol;
+
+	do{
+		symbol = inflate_decode(s, lencode);
+		if(symbol < 0 || s->error)
+			return false;
+		if(symbol < 256){
+			if(s->outpos == s->outlen)
+				return false;
+			s->out[s->outpos++] = (byte)symbol;
+		}else if(symbol > 256){
+			symbol -= 257;
+			if(symbol >= 29)
+				return false;
+			size_t len = lbase[symbol] + inflate_bits(s, lext[symbol]);
+			symbol = inflate_decode(s, distcode);
+			if(symbol < 0 || symbol >= 30)
+				return false;
+			size_t dist = dbase[symbol] + inflate_bits(s, dext[symbol]);
+			if(s->error || dist > s->outpos || len > s->outlen - s->outpos)
+				return false;
+			for(; len; len--, s->outpos++)
+				s->out[s->outpos] = s->out[s->outpos - dist];
+		}
+	}while(symbol != 256);
+	return true;
+}
+
+static bool inflate_stored(InflateState *s)
+{
+	size_t len;
+
+	s->bitbuf = 0;
+	s->bitcnt = 0;
+	if(s->inpos + 4 > s->inlen)
+		return false;
+	len = s->in[s->inpos] | (s->in[s->inpos+1] << 8);
+	if(s->in[s->inpos+2] != (~len & 0xff) || s->in[s->inpos+3] != ((~len >> 8) & 0xff))
+		return false;
+	s->inpos += 4;
+	if(s->inpos + len > s->inlen || len > s->outlen - s->outpos)
+		return false;
+	memcpy(s->out + s->outpos, s->in + s->inpos, len);
+	s->inpos += len;
+	s->outpos += len;
+	return true;
+}
+
+static bool inflate_fixed(InflateState *s)
+{
+	InflateHuffman lencode, distcode;
+	short lengths[288];
+	int i;
+
+	for(i=0; i<144; i++)
+		lengths[i] = 8;
+	for(; i<256; i++)
+		lengths[i] = 9;
+	for(; i<280; i++)
+		lengths[i] = 7;
+	for(; i<288; i++)
+		lengths[i] = 8;
+	inflate_construct(&lencode, lengths, 288);
+	for(i=0; i<30; i++)
+		lengths[i] = 5;
+	inflate_construct(&distcode, lengths, 30);
+
+	return inflate_codes(s, &lencode, &distcode);
+}
+
+static bool inflate_dynamic(InflateState *s)
+{
+	static const short order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+	InflateHuffman lencode, distcode;
+	short lengths[320];
+	int nlen, ndist, ncode, index;
+
+	nlen = inflate_bits(s, 5) + 257;
+	ndist = inflate_bits(s, 5) + 1;
+	ncode = inflate_bits(s, 4) + 4;
+	if(s->error || nlen > 286 || ndist > 30)
+		return false;
+
+	for(index=0; index<ncode; index++)
+		lengths[order[index]] = (short)inflate_bits(s, 3);
+	for(; index<19; index++)
+		lengths[order[index]] = 0;
+	if(!inflate_construct(&lencode, lengths, 19))
+		return false;
+
+	index = 0;
+	while(index < nlen + ndist){
+		int symbol = inflate_decode(s, &lencode);
+		int len = 0, repeat;
+
+		if(symbol < 0 || s->error)
+			return false;
+		if(symbol < 16){
+			lengths[index++] = (short)symbol;
+			continue;
+		}
+		if(symbol == 16){
+			if(index == 0)
+				return false;
+			len = lengths[index-1];
+			repeat = 3 + inflate_bits(s, 2);
+		}else if(symbol == 17){
+			repeat = 3 + inflate_bits(s, 3);
+		}else{
+			repeat = 11 + inflate_bits(s, 7);
+		}
+		if(index + repeat > nlen + ndist)
+			return false;
+		while(repeat--)
+			lengths[index++] = (short)len;
+	}
+
+	// Without an end of block code the block never finishes
+	if(lengths[256] == 0)
+		return false;
+	if(!inflate_construct(&lencode, lengths, nlen) || !inflate_construct(&distcode, lengths + nlen, ndist))
+		return false;
+
+	return inflate_codes(s, &lencode, &distcode);
+}
+
+static bool gds_inflate(const byte *in, size_t inlen, byte *out, size_t outlen)
+{
+	InflateState s;
+	int last, type;
+	bool ok;
+
+	memset(&s, 0, sizeof(s));
+	s.in = in;
+	s.inlen = inlen;
+	s.out = out;
+	s.outlen = outlen;
+
+	do{
+		last = inflate_bits(&s, 1);
+		type = inflate_bits(&s, 2);
+		if(s.error)
+			return false;
+		switch(type){
+			case 0:
+				ok = inflate_stored(&s);
+				break;
+			case 1:
+				ok = inflate_fixed(&s);
+				break;
+			case 2:
+				ok = inflate_dynamic(&s);
+				break;
+			default:
+				ok = false;
+				break;
+		}
+		if(!ok || s.error)
+			return false;
+	}while(!last);
+
+	return s.outpos == outlen;
+}
+
+// Direction of 2-deltas, 3-deltas and g-deltas
+static void oasis_direction(unsigned int direction, int64_t magnitude, int64_t *dx, int64_t *dy)
+{
+	static const int dirx[8] = {1, 0, -1, 0, 1, -1, -1, 1};
+	static const int diry[8] = {0, 1, 0, -1, 1, 1, -1, -1};
+
+	*dx = dirx[direction & 7] * magnitude;
+	*dy = diry[direction & 7] * magnitude;
+}
+
+OASISReader::OASISReader()
+{
+	_pos = _end = NULL;
+	_error = false;
+	_done = false;
+	_emit = false;
+	_cellnameindex = 0;
+	_textstringindex = 0;
+	_offsetflag = 0;
+	_blockindex = 0;
+	_incell = false;
+	_unit = 1000.0;
+
+	_out = NULL;
+	_outsize = 0;
+	_outcapacity = 0;
+	_polygonwarning = false;
+
+	ResetModal();
+}
+
+OASISReader::~OASISReader()
+{
+	for(unsigned int i=0; i<_blocks.size(); i++)
+		delete [] _blocks[i];
+	if(_out)
+		delete [] _out;
+}
+
+bool OASISReader::IsOASIS(FILE *iptr)
+{
+	char magic[OASIS_MAGIC_LEN];
+	size_t length;
+
+	if(!iptr)
+		return false;
+
+	fseek(iptr, 0, SEEK_SET);
+	length = fread(magic, 1, OASIS_MAGIC_LEN, iptr);
+	fseek(iptr, 0, SEEK_SET);
+
+	return length == OASIS_MAGIC_LEN && memcmp(magic, OASIS_MAGIC, OASIS_MAGIC_LEN) == 0;
+}
+
+bool OASISReader::Translate(FILE *iptr)
+{
+	GDSFileMap file;
+	const byte *data;
+	byte *buffer = NULL;
+	int64_t size;
+	double start = gds_time();
+
+	size = gds_file_size(iptr);
+	if(size < OASIS_MAGIC_LEN || (uint64_t)size > SIZE_MAX)
+		return false;
+
+	if(file.Open(iptr, size, true)){
+		data = file.GetData();
+	}else{
+		buffer = new byte[(size_t)size];
+		if(fread(buffer, 1, (size_t)size, iptr) != (size_t)size){
+			delete [] buffer;
+			return false;
+		}
+		fseek(iptr, 0, SEEK_SET);
+		data = buffer;
+	}
+
+	// First pass collects the name tables, the second one writes GDSII
+	for(int pass=0; pass<2 && !_error; pass++){
+		_emit = (pass == 1);
+		_pos = data + OASIS_MAGIC_LEN;
+		_end = data + size;
+		_done = false;
+		_incell = false;
+		_cellnameindex = _textstringindex = 0;
+		_blockindex = 0;
+		ResetModal();
+
+		if(!ParseRecords() || !_done){
+			if(!_error)
+				v_printf(1, "OASIS file ends without an END record.\n");
+			_error = true;
+		}
+	}
+
+	if(buffer)
+		delete [] buffer;
+
+	if(_error){
+		v_printf(1, "Unable to read OASIS file.\n");
+		return false;
+	}
+
+	v_printf(1, "Translated %.1f MB of OASIS to %.1f MB of GDSII in %.2f s\n", size/1048576.0, _outsize/1048576.0, gds_time() - start);
+	return true;
+}
+
+byte *OASISReader::Release(int64_t *size)
+{
+	byte *result = _out;
+
+	*size = _outsize;
+	_out = NULL;
+	_outsize = _outcapacity = 0;
+	return result;
+}
+
+void OASISReader::ResetModal()
+{
+	_modal.Relative = false;
+	_modal.HasRepetition = false;
+	_modal.Repetition.Lattice = true;
+	_modal.Repetition.Columns = _modal.Repetition.Rows = 1;
+	_modal.Repetition.ColX = _modal.Repetition.ColY = 0;
+	_modal.Repetition.RowX = _modal.Repetition.RowY = 0;
+	_modal.Repetition.Offsets.clear();
+
+	_modal.PlacementX = _modal.PlacementY = 0;
+	_modal.PlacementCell.clear();
+	_modal.Layer = _modal.Datatype = 0;
+	_modal.TextLayer = _modal.TextType = 0;
+	_modal.TextX = _modal.TextY = 0;
+	_modal.TextString.clear();
+	_modal.GeometryX = _modal.GeometryY = 0;
+	_modal.GeometryW = _modal.GeometryH = 0;
+	_modal.PolygonPoints.clear();
+	_modal.PathPoints.clear();
+	_modal.PathHalfWidth = 0;
+	_modal.PathStart.Scheme = _modal.PathEnd.Scheme = 1;
+	_modal.PathStart.Value = _modal.PathEnd.Value = 0;
+	_modal.CTrapezoidType = 0;
+	_modal.CircleRadius = 0;
+}
+
+/*
+** Primitive types
+*/
+
+// Info bytes are raw bytes, not unsigned integers
+byte OASISReader::ReadByte()
+{
+	if(_pos >= _end){
+		_error = true;
+		return 0;
+	}
+	return *_pos++;
+}
+
+uint64_t OASISReader::ReadUInt()
+{
+	uint64_t value = 0;
+	int shift = 0;
+	byte b;
+
+	do{
+		if(_pos >= _end){
+			_error = true;
+			return 0;
+		}
+		b = *_pos++;
+		if(shift < 64)
+			value |= (uint64_t)(b & 0x7f) << shift;
+		shift += 7;
+	}while(b & 0x80);
+
+	return value;
+}
+
+int64_t OASISReader::ReadSInt()
+{
+	uint64_t value = ReadUInt();
+
+	// Sign in the lowest bit
+	if(value & 1)
+		return -(int64_t)(value >> 1);
+	return (int64_t)(value >> 1);
+}
+
+double OASISReader::ReadRealType(uint64_t type)
+{
+	double value, denominator;
+	uint64_t bits = 0;
+
+	switch(type){
+		case 0:
+			return (double)ReadUInt();
+		case 1:
+			return -(double)ReadUInt();
+		case 2:
+			value = (double)ReadUInt();
+			return value ? 1.0/value : 0.0;
+		case 3:
+			value = (double)ReadUInt();
+			return value ? -1.0/value : 0.0;
+		case 4:
+		case 5:
+			value = (double)ReadUInt();
+			denominator = (double)ReadUInt();
+			if(!denominator)
+				return 0.0;
+			return (type == 4 ? 1.0 : -1.0) * value / denominator;
+		case 6:
+		case 7:{
+			// IEEE little endian
+			int length = (type == 6) ? 4 : 8;
+			if(_end - _pos < length){
+				_error = true;
+				return 0.0;
+			}
+			for(int i=length-1; i>=0; i--)
+				bits = (bits << 8) | _pos[i];
+			_pos += length;
+			if(type == 6){
+				uint32_t word = (uint32_t)bits;
+				float f;
+				memcpy(&f, &word, 4);
+				return f;
+			}
+			memcpy(&value, &bits, 8);
+			return value;
+		}
+		default:
+			_error = true;
+			return 0.0;
+	}
+}
+
+double OASISReader::ReadReal()
+{
+	return ReadRealType(ReadUInt());
+}
+
+void OASISReader::ReadString(string& str)
+{
+	uint64_t length = ReadUInt();
+
+	if(_error || length > (uint64_t)(_end - _pos)){
+		_error = true;
+		str.clear();
+		return;
+	}
+	str.assign((const char *)_pos, (size_t)length);
+	_pos += length;
+}
+
+void OASISReader::SkipString()
+{
+	uint64_t length = ReadUInt();
+
+	if(_error || length > (uint64_t)(_end - _pos)){
+		_error = true;
+		return;
+	}
+	_pos += length;
+}
+
+void OASISReader::SkipInterval()
+{
+	switch(ReadUInt()){
+		case 0:
+			break;
+		case 1:
+		case 2:
+		case 3:
+			ReadUInt();
+			break;
+		case 4:
+			ReadUInt();
+			ReadUInt();
+			break;
+		default:
+			_error = true;
+			break;
+	}
+}
+
+void OASISReader::SkipPropertyValue()
+{
+	uint64_t type = ReadUInt();
+
+	if(type < 8){
+		ReadRealType(type);
+	}else if(type == 8 || type == 9 || type >= 13){
+		ReadUInt();
+	}else{
+		SkipString();
+	}
+}
+
+void OASISReader::ReadGDelta(int64_t *dx, int64_t *dy)
+{
+	uint64_t value = ReadUInt();
+
+	if(value & 1){
+		// Form 2, separate x and y
+		*dx = (value & 2) ? -(int64_t)(value >> 2) : (int64_t)(value >> 2);
+		*dy = ReadSInt();
+	}else{
+		oasis_direction((unsigned int)(value >> 1), (int64_t)(value >> 4), dx, dy);
+	}
+}
+
+// Points are relative to the element position, the first point (0,0) is
+// implicit and included in the result
+void OASISReader::ReadPointList(vector<int64_t>& points, bool polygon)
+{
+	uint64_t type = ReadUInt();
+	uint64_t count = ReadUInt();
+	int64_t x = 0, y = 0, dx, dy, ddx = 0, ddy = 0;
+
+	points.clear();
+	if(_error || count > (uint64_t)(_end - _pos)){
+		_error = true;
+		return;
+	}
+	points.reserve(2*(count+2));
+	points.push_back(0);
+	points.push_back(0);
+
+	for(uint64_t i=0; i<count && !_error; i++){
+		switch(type){
+			case 0:
+			case 1:
+				// Manhattan, alternating horizontal and vertical
+				if((i & 1) == type)
+					x += ReadSInt();
+				else
+					y += ReadSInt();
+				break;
+			case 2:{
+				uint64_t value = ReadUInt();
+				oasis_direction((unsigned int)(value & 3), (int64_t)(value >> 2), &dx, &dy);
+				x += dx;
+				y += dy;
+				break;
+			}
+			case 3:{
+				uint64_t value = ReadUInt();
+				oasis_direction((unsigned int)(value & 7), (int64_t)(value >> 3), &dx, &dy);
+				x += dx;
+				y += dy;
+				break;
+			}
+			case 4:
+				ReadGDelta(&dx, &dy);
+				x += dx;
+				y += dy;
+				break;
+			case 5:
+				// Deltas between successive deltas
+				ReadGDelta(&dx, &dy);
+				ddx += dx;
+				ddy += dy;
+				x += ddx;
+				y += ddy;
+				break;
+			default:
+				_error = true;
+				return;
+		}
+		points.push_back(x);
+		points.push_back(y);
+	}
+
+	// Manhattan polygons leave out the vertex that closes them
+	if(polygon && type < 2){
+		if(type == 0){
+			points.push_back(0);
+			points.push_back(y);
+		}else{
+			points.push_back(x);
+			points.push_back(0);
+		}
+	}
+}
+
+bool OASISReader::ReadRepetition(bool present)
+{
+	OASISRepetition& rep = _modal.Repetition;
+	uint64_t type, count, grid;
+	int64_t x, y, dx, dy;
+
+	if(!present)
+		return false;
+
+	type = ReadUInt();
+	if(type == 0){
+		// Reuse the previous repetition
+		if(!_modal.HasRepetition)
+			_error = true;
+		return _modal.HasRepetition;
+	}
+
+	rep.Lattice = true;
+	rep.Columns = rep.Rows = 1;
+	rep.ColX = rep.ColY = rep.RowX = rep.RowY = 0;
+	rep.Offsets.clear();
+
+	switch(type){
+		case 1:
+			rep.Columns = ReadUInt() + 2;
+			rep.Rows = ReadUInt() + 2;
+			rep.ColX = (int64_t)ReadUInt();
+			rep.RowY = (int64_t)ReadUInt();
+			break;
+		case 2:
+			rep.Columns = ReadUInt() + 2;
+			rep.ColX = (int64_t)ReadUInt();
+			break;
+		case 3:
+			rep.Rows = ReadUInt() + 2;
+			rep.RowY = (int64_t)ReadUInt();
+			break;
+		case 4:
+		case 5:
+		case 6:
+		case 7:
+			// Irregular row or column
+			count = ReadUInt() + 2;
+			grid = (type == 5 || type == 7) ? ReadUInt() : 1;
+			if(_error || count > (uint64_t)(_end - _pos) + 1){
+				_error = true;
+				break;
+			}
+			rep.Lattice = false;
+			x = 0;
+			rep.Offsets.push_back(0);
+			rep.Offsets.push_back(0);
+			for(uint64_t i=1; i<count && !_error; i++){
+				x += (int64_t)(ReadUInt() * grid);
+				rep.Offsets.push_back(type < 6 ? x : 0);
+				rep.Offsets.push_back(type < 6 ? 0 : x);
+			}
+			break;
+		case 8:
+			rep.Columns = ReadUInt() + 2;
+			rep.Rows = ReadUInt() + 2;
+			ReadGDelta(&rep.ColX, &rep.ColY);
+			ReadGDelta(&rep.RowX, &rep.RowY);
+			break;
+		case 9:
+			rep.Columns = ReadUInt() + 2;
+			ReadGDelta(&rep.ColX, &rep.ColY);
+			break;
+		case 10:
+		case 11:
+			// Arbitrary positions
+			count = ReadUInt() + 2;
+			grid = (type == 11) ? ReadUInt() : 1;
+			if(_error || count > (uint64_t)(_end - _pos) + 1){
+				_error = true;
+				break;
+			}
+			rep.Lattice = false;
+			x = y = 0;
+			rep.Offsets.push_back(0);
+			rep.Offsets.push_back(0);
+			for(uint64_t i=1; i<count && !_error; i++){
+				ReadGDelta(&dx, &dy);
+				x += dx * (int64_t)grid;
+				y += dy * (int64_t)grid;
+				rep.Offsets.push_back(x);
+				rep.Offsets.push_back(y);
+			}
+			break;
+		default:
+			_error = true;
+			break;
+	}
+
+	_modal.HasRepetition = !_error;
+	return _modal.HasRepetition;
+}
+
+int64_t OASISReader::ReadCoordinate(bool present, int64_t& modal)
+{
+	if(present){
+		int64_t value = ReadSInt();
+		modal = _modal.Relative ? modal + value : value;
+	}
+	return modal;
+}
+
+// Elements of a lattice that is written out one by one. Like the count of
+// a point list it is bounded by the input left, a lattice just gets more
+// elements per byte. Sets _error if there are more, or if they overflow.
+uint64_t OASISReader::LatticeCount(const OASISRepetition& rep)
+{
+	uint64_t limit = ((uint64_t)(_end - _pos) + 1) * OASIS_LATTICE_PER_BYTE;
+
+	if(rep.Columns > limit || rep.Rows > limit || (rep.Rows && rep.Columns > limit / rep.Rows)){
+		_error = true;
+		return 0;
+	}
+	return rep.Columns*rep.Rows;
+}
+
+// Positions of all instances of the current element, relative to the first
+void OASISReader::RepetitionOffsets(bool repeated)
+{
+	const OASISRepetition& rep = _modal.Repetition;
+
+	_offsets.clear();
+	if(!repeated){
+		_offsets.push_back(0);
+		_offsets.push_back(0);
+	}else if(rep.Lattice){
+		uint64_t count = LatticeCount(rep);
+		if(_error)
+			return;
+		_offsets.reserve(2*count);
+		for(uint64_t r=0; r<rep.Rows; r++){
+			for(uint64_t c=0; c<rep.Columns; c++){
+				_offsets.push_back(c*rep.ColX + r*rep.RowX);
+				_offsets.push_back(c*rep.ColY + r*rep.RowY);
+			}
+		}
+	}else{
+		_offsets = rep.Offsets;
+	}
+}
+
+const string& OASISReader::CellName(uint64_t refnum)
+{
+	map<uint64_t, string>::iterator i = _cellnames.find(refnum);
+
+	if(i == _cellnames.end()){
+		char name[32];
+
+		// Keep going with a made up name, the reference stays unresolved
+		if(_emit)
+			v_printf(1, "OASIS cell name %llu is not defined.\n", (unsigned long long)refnum);
+		sprintf(name, "CELLNAME_%llu", (unsigned long long)refnum);
+		_cellnames[refnum] = name;
+		return _cellnames[refnum];
+	}
+	return i->second;
+}
+
+/*
+** Records
+*/
+
+bool OASISReader::ParseRecords()
+{
+	string str;
+	uint64_t refnum;
+
+	while(_pos < _end && !_error && !_done){
+		uint64_t type = ReadUInt();
+		byte info;
+
+		switch(type){
+			case orPad:
+				break;
+			case orStart:
+				SkipString(); // Version
+				_unit = ReadReal();
+				_offsetflag = ReadUInt();
+				if(_offsetflag == 0){
+					for(int i=0; i<12; i++)
+						ReadUInt();
+				}
+				if(_error || _unit <= 0.0){
+					v_printf(1, "Invalid OASIS START record.\n");
+					_error = true;
+					break;
+				}
+				if(_emit){
+					// Grid steps per micron become GDS units
+					byte dates[24];
+
+					memset(dates, 0, sizeof(dates));
+					PutShort(rnHeader, 600);
+					PutHeader(rnBgnLib, 2, 24);
+					Put(dates, 24);
+					PutString(rnLibName, "OASIS");
+					PutHeader(rnUnits, 5, 16);
+					PutReal8(1.0/_unit);
+					PutReal8(1e-6/_unit);
+				}
+				break;
+			case orEnd:
+				if(_offsetflag != 0){
+					for(int i=0; i<12; i++)
+						ReadUInt();
+				}
+				// Padding and validation are not checked
+				if(_emit){
+					if(_incell)
+						PutEmpty(rnEndStr);
+					PutEmpty(rnEndLib);
+				}
+				_incell = false;
+				_done = true;
+				break;
+			case orCellName:
+			case orCellNameRef:
+				ReadString(str);
+				refnum = (type == orCellName) ? _cellnameindex++ : ReadUInt();
+				if(!_emit && !_error)
+					_cellnames[refnum] = str;
+				break;
+			case orTextString:
+			case orTextStringRef:
+				ReadString(str);
+				refnum = (type == orTextString) ? _textstringindex++ : ReadUInt();
+				if(!_emit && !_error)
+					_textstrings[refnum] = str;
+				break;
+			case orPropName:
+			case orPropNameRef:
+				SkipString();
+				if(type == orPropNameRef)
+					ReadUInt();
+				break;
+			case orPropString:
+			case orPropStringRef:
+				SkipString();
+				if(type == orPropStringRef)
+					ReadUInt();
+				break;
+			case orLayerName:
+			case orLayerNameText:
+				SkipString();
+				SkipInterval();
+				SkipInterval();
+				break;
+			case orCellRef:
+			case orCell:
+				if(type == orCellRef){
+					refnum = ReadUInt();
+					if(_emit)
+						str = CellName(refnum);
+				}else{
+					ReadString(str);
+				}
+				if(_emit && !_error){
+					byte dates[24];
+
+					memset(dates, 0, sizeof(dates));
+					if(_incell)
+						PutEmpty(rnEndStr);
+					PutHeader(rnBgnStr, 2, 24);
+					Put(dates, 24);
+					PutString(rnStrName, str);
+				}
+				_incell = true;
+				ResetModal();
+				break;
+			case orXYAbsolute:
+				_modal.Relative = false;
+				break;
+			case orXYRelative:
+				_modal.Relative = true;
+				break;
+			case orPlacement:
+			case orPlacementMag:
+				info = ReadByte();
+				ParsePlacement(info, type == orPlacementMag);
+				break;
+			case orText:
+				info = ReadByte();
+				ParseText(info);
+				break;
+			case orRectangle:
+				info = ReadByte();
+				ParseRectangle(info);
+				break;
+			case orPolygon:
+				info = ReadByte();
+				ParsePolygon(info);
+				break;
+			case orPath:
+				info = ReadByte();
+				ParsePath(info);
+				break;
+			case orTrapezoid:
+			case orTrapezoidA:
+			case orTrapezoidB:
+				info = ReadByte();
+				ParseTrapezoid(info, (int)type);
+				break;
+			case orCTrapezoid:
+				info = ReadByte();
+				ParseCTrapezoid(info);
+				break;
+			case orCircle:
+				info = ReadByte();
+				ParseCircle(info);
+				break;
+			case orProperty:{
+				// Properties are not shown, only skipped
+				info = ReadByte();
+				if(info & 0x04){
+					if(info & 0x02)
+						ReadUInt();
+					else
+						SkipString();
+				}
+				if(!(info & 0x08)){
+					uint64_t count = info >> 4;
+					if(count == 15)
+						count = ReadUInt();
+					for(uint64_t i=0; i<count && !_error; i++)
+						SkipPropertyValue();
+				}
+				break;
+			}
+			case orPropertyRepeat:
+				break;
+			case orXName:
+			case orXNameRef:
+				ReadUInt();
+				SkipString();
+				if(type == orXNameRef)
+					ReadUInt();
+				break;
+			case orXElement:
+				ReadUInt();
+				SkipString();
+				break;
+			case orXGeometry:
+				info = ReadByte();
+				ReadUInt();
+				ParseLayerDatatype(info);
+				SkipString();
+				ReadCoordinate((info & 0x10) != 0, _modal.GeometryX);
+				ReadCoordinate((info & 0x08) != 0, _modal.GeometryY);
+				ReadRepetition((info & 0x04) != 0);
+				break;
+			case orCBlock:
+				ParseCBlock();
+				break;
+			default:
+				v_printf(1, "Unknown OASIS record type %llu.\n", (unsigned long long)type);
+				_error = true;
+				break;
+		}
+	}
+
+	return !_error;
+}
+
+bool OASISReader::ParseCBlock()
+{
+	uint64_t method = ReadUInt();
+	uint64_t size = ReadUInt();
+	uint64_t compressed = ReadUInt();
+	const byte *pos, *end;
+	byte *block;
+
+	if(_error || method != 0 || compressed > (uint64_t)(_end - _pos)){
+		v_printf(1, "Unsupported or corrupt OASIS CBLOCK.\n");
+		_error = true;
+		return false;
+	}
+
+	// Decompress during the first pass, the second one reuses the result
+	if(!_emit){
+		block = new byte[size ? size : 1];
+		if(!gds_inflate(_pos, (size_t)compressed, block, (size_t)size)){
+			v_printf(1, "Unable to decompress OASIS CBLOCK.\n");
+			delete [] block;
+			_error = true;
+			return false;
+		}
+		_blocks.push_back(block);
+		_blocksizes.push_back(size);
+	}else{
+		if(_blockindex >= _blocks.size()){
+			_error = true;
+			return false;
+		}
+		block = _blocks[_blockindex];
+		size = _blocksizes[_blockindex];
+		_blockindex++;
+	}
+	_pos += compressed;
+
+	// The block holds complete records
+	pos = _pos;
+	end = _end;
+	_pos = block;
+	_end = block + size;
+	ParseRecords();
+	_pos = pos;
+	_end = end;
+
+	return !_error;
+}
+
+void OASISReader::ParseLayerDatatype(byte info)
+{
+	if(info & 0x01)
+		_modal.Layer = ReadUInt();
+	if(info & 0x02)
+		_modal.Datatype = ReadUInt();
+}
+
+void OASISReader::ParsePlacement(byte info, bool magangle)
+{
+	OASISRepetition *rep = NULL;
+	double mag = 1.0, angle = 0.0;
+	bool flip = (info & 0x01) != 0;
+	int64_t x, y;
+
+	if(info & 0x80){
+		if(info & 0x40){
+			uint64_t refnum = ReadUInt();
+			if(_emit)
+				_modal.PlacementCell = CellName(refnum);
+		}else{
+			ReadString(_modal.PlacementCell);
+		}
+	}
+
+	if(magangle){
+		if(info & 0x04)
+			mag = ReadReal();
+		if(info & 0x02)
+			angle = ReadReal();
+	}else{
+		angle = 90.0 * ((info >> 1) & 3);
+	}
+
+	x = ReadCoordinate((info & 0x20) != 0, _modal.PlacementX);
+	y = ReadCoordinate((info & 0x10) != 0, _modal.PlacementY);
+	if(ReadRepetition((info & 0x08) != 0))
+		rep = &_modal.Repetition;
+
+	if(!_emit || _error || !_incell)
+		return;
+
+	// Regular repetitions become an AREF, GDSII can only count to 32767
+	bool aref = rep && rep->Lattice && rep->Columns <= 32767 && rep->Rows <= 32767;
+	uint64_t count = 1;
+	if(rep && !aref)
+		count = rep->Lattice ? LatticeCount(*rep) : rep->Offsets.size()/2;
+	if(_error)
+		return;
+
+	for(uint64_t i=0; i<(aref ? 1 : count); i++){
+		int64_t ox = 0, oy = 0;
+
+		if(rep && !aref){
+			if(rep->Lattice){
+				uint64_t c = i % rep->Columns, r = i / rep->Columns;
+				ox = c*rep->ColX + r*rep->RowX;
+				oy = c*rep->ColY + r*rep->RowY;
+			}else{
+				ox = rep->Offsets[2*i];
+				oy = rep->Offsets[2*i+1];
+			}
+		}
+
+		PutEmpty(aref ? rnARef : rnSRef);
+		PutString(rnSName, _modal.PlacementCell);
+		if(flip || mag != 1.0 || angle != 0.0){
+			PutShort(rnSTrans, flip ? (int16_t)0x8000 : 0);
+			if(mag != 1.0){
+				PutHeader(rnMag, 5, 8);
+				PutReal8(mag);
+			}
+			if(angle != 0.0){
+				PutHeader(rnAngle, 5, 8);
+				PutReal8(angle);
+			}
+		}
+		if(aref){
+			int64_t xy[6];
+
+			PutHeader(rnColRow, 2, 4);
+			PutInt16((int16_t)rep->Columns);
+			PutInt16((int16_t)rep->Rows);
+			xy[0] = x;
+			xy[1] = y;
+			xy[2] = x + (int64_t)rep->Columns*rep->ColX;
+			xy[3] = y + (int64_t)rep->Columns*rep->ColY;
+			xy[4] = x + (int64_t)rep->Rows*rep->RowX;
+			xy[5] = y + (int64_t)rep->Rows*rep->RowY;
+			PutXY(xy, 3, 0, 0, false);
+		}else{
+			int64_t xy[2] = {0, 0};
+			PutXY(xy, 1, x + ox, y + oy, false);
+		}
+		PutEmpty(rnEndEl);
+	}
+}
+
+void OASISReader::ParseText(byte info)
+{
+	int64_t x, y;
+	bool repeated;
+
+	if(info & 0x40){
+		if(info & 0x20){
+			uint64_t refnum = ReadUInt();
+			if(_emit){
+				map<uint64_t, string>::iterator i = _textstrings.find(refnum);
+				_modal.TextString = (i != _textstrings.end()) ? i->second : "";
+			}
+		}else{
+			ReadString(_modal.TextString);
+		}
+	}
+	if(info & 0x01)
+		_modal.TextLayer = ReadUInt();
+	if(info & 0x02)
+		_modal.TextType = ReadUInt();
+	x = ReadCoordinate((info & 0x10) != 0, _modal.TextX);
+	y = ReadCoordinate((info & 0x08) != 0, _modal.TextY);
+	repeated = ReadRepetition((info & 0x04) != 0);
+
+	if(!_emit || _error || !_incell)
+		return;
+
+	int64_t origin[2] = {0, 0};
+	RepetitionOffsets(repeated);
+	for(unsigned int i=0; i<_offsets.size(); i+=2){
+		PutEmpty(rnText);
+		PutShort(rnLayer, (int16_t)_modal.TextLayer);
+		PutShort(rnTextType, (int16_t)_modal.TextType);
+		PutXY(origin, 1, x + _offsets[i], y + _offsets[i+1], false);
+		PutString(rnString, _modal.TextString);
+		PutEmpty(rnEndEl);
+	}
+}
+
+void OASISReader::ParseRectangle(byte info)
+{
+	int64_t x, y, w, h;
+	int64_t points[8];
+
+	ParseLayerDatatype(info);
+	if(info & 0x40)
+		_modal.GeometryW = ReadUInt();
+	if(info & 0x20)
+		_modal.GeometryH = ReadUInt();
+	if(info & 0x80)
+		_modal.GeometryH = _modal.GeometryW; // Square
+	x = ReadCoordinate((info & 0x10) != 0, _modal.GeometryX);
+	y = ReadCoordinate((info & 0x08) != 0, _modal.GeometryY);
+	bool repeated = ReadRepetition((info & 0x04) != 0);
+
+	if(!_emit || _error || !_incell)
+		return;
+
+	w = (int64_t)_modal.GeometryW;
+	h = (int64_t)_modal.GeometryH;
+	points[0] = 0; points[1] = 0;
+	points[2] = w; points[3] = 0;
+	points[4] = w; points[5] = h;
+	points[6] = 0; points[7] = h;
+	RepetitionOffsets(repeated);
+	PutRepeated(points, 4, x, y);
+}
+
+void OASISReader::ParsePolygon(byte info)
+{
+	int64_t x, y;
+
+	ParseLayerDatatype(info);
+	if(info & 0x20)
+		ReadPointList(_modal.PolygonPoints, true);
+	x = ReadCoordinate((info & 0x10) != 0, _modal.GeometryX);
+	y = ReadCoordinate((info & 0x08) != 0, _modal.GeometryY);
+	bool repeated = ReadRepetition((info & 0x04) != 0);
+
+	// A polygon that never had a point list has nothing to draw
+	if(_modal.PolygonPoints.empty())
+		_error = true;
+	if(!_emit || _error || !_incell)
+		return;
+
+	RepetitionOffsets(repeated);
+	PutRepeated(&_modal.PolygonPoints[0], _modal.PolygonPoints.size()/2, x, y);
+}
+
+void OASISReader::ParsePath(byte info)
+{
+	int64_t x, y, bgnextn, endextn;
+	int16_t pathtype;
+
+	ParseLayerDatatype(info);
+	if(info & 0x40)
+		_modal.PathHalfWidth = ReadUInt();
+	if(info & 0x80){
+		uint64_t scheme = ReadUInt();
+		int start = (int)((scheme >> 2) & 3), end = (int)(scheme & 3);
+
+		if(start){
+			_modal.PathStart.Scheme = start;
+			if(start == 3)
+				_modal.PathStart.Value = ReadSInt();
+		}
+		if(end){
+			_modal.PathEnd.Scheme = end;
+			if(end == 3)
+				_modal.PathEnd.Value = ReadSInt();
+		}
+	}
+	if(info & 0x20)
+		ReadPointList(_modal.PathPoints, false);
+	x = ReadCoordinate((info & 0x10) != 0, _modal.GeometryX);
+	y = ReadCoordinate((info & 0x08) != 0, _modal.GeometryY);
+	bool repeated = ReadRepetition((info & 0x04) != 0);
+
+	if(!_emit || _error || !_incell)
+		return;
+
+	unsigned int count = _modal.PathPoints.size()/2;
+	if(count < 2)
+		return;
+	if(count > GDS_MAX_POINTS){
+		if(!_polygonwarning){
+			v_printf(1, "OASIS path with more than %d points skipped.\n", GDS_MAX_POINTS);
+			_polygonwarning = true;
+		}
+		return;
+	}
+
+	// Flush and half width ends have a GDSII path type, anything else is explicit
+	int64_t halfwidth = (int64_t)_modal.PathHalfWidth;
+	bgnextn = _modal.PathStart.Scheme == 2 ? halfwidth : (_modal.PathStart.Scheme == 3 ? _modal.PathStart.Value : 0);
+	endextn = _modal.PathEnd.Scheme == 2 ? halfwidth : (_modal.PathEnd.Scheme == 3 ? _modal.PathEnd.Value : 0);
+	if(_modal.PathStart.Scheme == 1 && _modal.PathEnd.Scheme == 1)
+		pathtype = 0;
+	else if(_modal.PathStart.Scheme == 2 && _modal.PathEnd.Scheme == 2)
+		pathtype = 2;
+	else
+		pathtype = 4;
+
+	RepetitionOffsets(repeated);
+	for(unsigned int i=0; i<_offsets.size(); i+=2){
+		PutEmpty(rnPath);
+		PutShort(rnLayer, (int16_t)_modal.Layer);
+		PutShort(rnDataType, (int16_t)_modal.Datatype);
+		PutShort(rnPathType, pathtype);
+		PutHeader(rnWidth, 3, 4);
+		PutInt32((int32_t)(2*halfwidth));
+		if(pathtype == 4){
+			PutHeader(rnBgnExtn, 3, 4);
+			PutInt32((int32_t)bgnextn);
+			PutHeader(rnEndExtn, 3, 4);
+			PutInt32((int32_t)endextn);
+		}
+		PutXY(&_modal.PathPoints[0], count, x + _offsets[i], y + _offsets[i+1], false);
+		PutEmpty(rnEndEl);
+	}
+}
+
+void OASISReader::ParseTrapezoid(byte info, int type)
+{
+	int64_t x, y, w, h, a = 0, b = 0;
+	int64_t points[8];
+
+	ParseLayerDatatype(info);
+	if(info & 0x40)
+		_modal.GeometryW = ReadUInt();
+	if(info & 0x20)
+		_modal.GeometryH = ReadUInt();
+	if(type != orTrapezoidB)
+		a = ReadSInt();
+	if(type != orTrapezoidA)
+		b = ReadSInt();
+	x = ReadCoordinate((info & 0x10) != 0, _modal.GeometryX);
+	y = ReadCoordinate((info & 0x08) != 0, _modal.GeometryY);
+	bool repeated = ReadRepetition((info & 0x04) != 0);
+
+	if(!_emit || _error || !_incell)
+		return;
+
+	w = (int64_t)_modal.GeometryW;
+	h = (int64_t)_modal.GeometryH;
+	if(info & 0x80){
+		// Vertical, the deltas move the left and right edge ends
+		points[0] = 0; points[1] = (a > 0) ? a : 0;
+		points[2] = 0; points[3] = h + ((b < 0) ? b : 0);
+		points[4] = w; points[5] = h - ((b > 0) ? b : 0);
+		points[6] = w; points[7] = -((a < 0) ? a : 0);
+	}else{
+		points[0] = -((a < 0) ? a : 0); points[1] = 0;
+		points[2] = (a > 0) ? a : 0; points[3] = h;
+		points[4] = w + ((b < 0) ? b : 0); points[5] = h;
+		points[6] = w - ((b > 0) ? b : 0); points[7] = 0;
+	}
+	RepetitionOffsets(repeated);
+	PutRepeated(points, 4, x, y);
+}
+
+void OASISReader::ParseCTrapezoid(byte info)
+{
+	int64_t x, y, w, h;
+	int64_t points[8];
+	unsigned int count = 0;
+
+	ParseLayerDatatype(info);
+	if(info & 0x80)
+		_modal.CTrapezoidType = (unsigned int)ReadUInt();
+	if(info & 0x40)
+		_modal.GeometryW = ReadUInt();
+	if(info & 0x20)
+		_modal.GeometryH = ReadUInt();
+	x = ReadCoordinate((info & 0x10) != 0, _modal.GeometryX);
+	y = ReadCoordinate((info & 0x08) != 0, _modal.GeometryY);
+	bool repeated = ReadRepetition((info & 0x04) != 0);
+
+	if(_modal.CTrapezoidType > 25){
+		_error = true;
+		return;
+	}
+	if(!_emit || _error || !_incell)
+		return;
+
+	// Some types take one dimension from the other
+	w = (int64_t)_modal.GeometryW;
+	h = (int64_t)_modal.GeometryH;
+	switch(_modal.CTrapezoidType){
+		case 16: case 17: case 18: case 19: case 25:
+			h = w;
+			break;
+		case 20: case 21:
+			w = 2*h;
+			break;
+		case 22: case 23:
+			h = 2*w;
+			break;
+	}
+
+	for(int i=0; i<4; i++){
+		const signed char *v = ctrapezoids[_modal.CTrapezoidType][i];
+		int64_t px = v[0]*w + v[1]*h, py = v[2]*w + v[3]*h;
+
+		// Triangles repeat their last vertex
+		if(count && points[2*count-2] == px && points[2*count-1] == py)
+			continue;
+		points[2*count] = px;
+		points[2*count+1] = py;
+		count++;
+	}
+	RepetitionOffsets(repeated);
+	PutRepeated(points, count, x, y);
+}
+
+void OASISReader::ParseCircle(byte info)
+{
+	int64_t x, y;
+	int64_t points[2*OASIS_CIRCLE_SEGMENTS];
+
+	ParseLayerDatatype(info);
+	if(info & 0x20)
+		_modal.CircleRadius = ReadUInt();
+	x = ReadCoordinate((info & 0x10) != 0, _modal.GeometryX);
+	y = ReadCoordinate((info & 0x08) != 0, _modal.GeometryY);
+	bool repeated = ReadRepetition((info & 0x04) != 0);
+
+	if(!_emit || _error || !_incell || !_modal.CircleRadius)
+		return;
+
+	for(int i=0; i<OASIS_CIRCLE_SEGMENTS; i++){
+		double a = 2.0*M_PI*i/OASIS_CIRCLE_SEGMENTS;
+		points[2*i] = (int64_t)floor(_modal.CircleRadius*cos(a) + 0.5);
+		points[2*i+1] = (int64_t)floor(_modal.CircleRadius*sin(a) + 0.5);
+	}
+	RepetitionOffsets(repeated);
+	PutRepeated(points, OASIS_CIRCLE_SEGMENTS, x, y);
+}
+
+/*
+** GDSII output
+*/
+
+void OASISReader::Put(const void *data, int64_t length)
+{
+	if(_outsize + length > _outcapacity){
+		int64_t capacity = _outcapacity ? 2*_outcapacity : (1<<20);
+		while(capacity < _outsize + length)
+			capacity *= 2;
+
+		byte *out = new byte[(size_t)capacity];
+		if(_out){
+			memcpy(out, _out, (size_t)_outsize);
+			delete [] _out;
+		}
+		_out = out;
+		_outcapacity = capacity;
+	}
+	memcpy(_out + _outsize, data, (size_t)length);
+	_outsize += length;
+}
+
+void OASISReader::PutHeader(byte type, byte datatype, int64_t length)
+{
+	byte header[4];
+
+	length += 4;
+	header[0] = (byte)(length >> 8);
+	header[1] = (byte)length;
+	header[2] = type;
+	header[3] = datatype;
+	Put(header, 4);
+}
+
+void OASISReader::PutInt16(int16_t value)
+{
+	byte data[2];
+
+	data[0] = (byte)((uint16_t)value >> 8);
+	data[1] = (byte)value;
+	Put(data, 2);
+}
+
+void OASISReader::PutInt32(int32_t value)
+{
+	byte data[4];
+
+	data[0] = (byte)((uint32_t)value >> 24);
+	data[1] = (byte)((uint32_t)value >> 16);
+	data[2] = (byte)((uint32_t)value >> 8);
+	data[3] = (byte)value;
+	Put(data, 4);
+}
+
+// Excess-64 base 16 real, the inverse of gds_real8()
+void OASISReader::PutReal8(double value)
+{
+	byte data[8];
+	byte sign = 0;
+	int exponent = 64;
+	uint64_t mantissa;
+
+	memset(data, 0, 8);
+	if(value != 0.0){
+		if(value < 0.0){
+			sign = 0x80;
+			value = -value;
+		}
+		while(value >= 1.0){
+			value /= 16.0;
+			exponent++;
+		}
+		while(value < 1.0/16.0){
+			value *= 16.0;
+			exponent--;
+		}
+		mantissa = (uint64_t)(value * 72057594037927936.0 + 0.5); // 2^56
+		if(mantissa >> 56)
+			mantissa = ((uint64_t)1 << 56) - 1;
+
+		data[0] = sign | (byte)exponent;
+		for(int i=7; i>0; i--){
+			data[i] = (byte)mantissa;
+			mantissa >>= 8;
+		}
+	}
+	Put(data, 8);
+}
+
+void OASISReader::PutEmpty(byte type)
+{
+	PutHeader(type, 0, 0);
+}
+
+void OASISReader::PutShort(byte type, int16_t value)
+{
+	PutHeader(type, 2, 2);
+	PutInt16(value);
+}
+
+void OASISReader::PutString(byte type, const string& str)
+{
+	long length = (long)str.size();
+
+	if(length > 65530)
+		length = 65530;
+	PutHeader(type, 6, (length + 1) & ~1);
+	Put(str.data(), length);
+	if(length & 1)
+		Put("", 1);
+}
+
+void OASISReader::PutXY(const int64_t *points, unsigned int count, int64_t x, int64_t y, bool close)
+{
+	PutHeader(rnXY, 3, 8*(count + (close ? 1 : 0)));
+	for(unsigned int i=0; i<count; i++){
+		PutInt32((int32_t)(x + points[2*i]));
+		PutInt32((int32_t)(y + points[2*i+1]));
+	}
+	if(close){
+		PutInt32((int32_t)(x + points[0]));
+		PutInt32((int32_t)(y + points[1]));
+	}
+}
+
+void OASISReader::PutBoundary(const int64_t *points, unsigned int count, int64_t x, int64_t y)
+{
+	if(count < 3)
+		return;
+	if(count > GDS_MAX_POINTS){
+		if(!_polygonwarning){
+			v_printf(1, "OASIS polygon with more than %d points skipped.\n", GDS_MAX_POINTS);
+			_polygonwarning = true;
+		}
+		return;
+	}
+
+	PutEmpty(rnBoundary);
+	PutShort(rnLayer, (int16_t)_modal.Layer);
+	PutShort(rnDataType, (int16_t)_modal.Datatype);
+	PutXY(points, count, x, y, true);
+	PutEmpty(rnEndEl);
+}
+
+// GDSII has no repeated geometry, so every instance becomes an element
+void OASISReader::PutRepeated(const int64_t *points, unsigned int count, int64_t x, int64_t y)
+{
+	for(unsigned int i=0; i<_offsets.size(); i+=2)
+		PutBoundary(points, count, x + _offsets[i], y + _offsets[i+1]);
+}
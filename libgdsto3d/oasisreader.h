@@ -0,0 +1,163 @@
+//  GDS3D, a program for viewing GDSII files in 3D.
+//  Created by Jasper Velner and Michiel Soer, http://icd.el.utwente.nl
+//  Copyright (C) 2013 IC-Design Group, University of Twente.
+//
+//  Based on gds2pov by Roger Light, http://atchoo.org/gds2pov/ / https://github.com/ralight/gds2pov
+//  Copyright (C) 2004-2008 by Roger Light
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef __OASISREADER_H__
+#define __OASISREADER_H__
+
+#include "gds_globals.h"
+#include <stdint.h>
+
+#define OASIS_MAGIC		"%SEMI-OASIS\r\n"
+#define OASIS_MAGIC_LEN	13
+
+// Placement or geometry repetition, either a lattice or a list of offsets
+typedef struct OASISRepetition{
+	bool		Lattice;
+	uint64_t	Columns, Rows;
+	int64_t		ColX, ColY;	// Step between columns
+	int64_t		RowX, RowY;	// Step between rows
+	vector<int64_t>	Offsets;	// X,Y pairs for irregular repetitions
+}OASISRepetition;
+
+// Path extension as given by the extension scheme
+typedef struct OASISExtension{
+	int		Scheme;		// 1 flush, 2 half width, 3 explicit
+	int64_t		Value;
+}OASISExtension;
+
+// Modal variables of the OASIS spec, reset by every CELL record
+typedef struct OASISModal{
+	bool		Relative;	// XYRELATIVE mode
+	bool		HasRepetition;
+	OASISRepetition	Repetition;
+
+	int64_t		PlacementX, PlacementY;
+	string		PlacementCell;
+
+	uint64_t	Layer, Datatype;
+	uint64_t	TextLayer, TextType;
+	int64_t		TextX, TextY;
+	string		TextString;
+
+	int64_t		GeometryX, GeometryY;
+	uint64_t	GeometryW, GeometryH;
+	vector<int64_t>	PolygonPoints;
+	vector<int64_t>	PathPoints;
+	uint64_t	PathHalfWidth;
+	OASISExtension	PathStart, PathEnd;
+	unsigned int	CTrapezoidType;
+	uint64_t	CircleRadius;
+}OASISModal;
+
+// Reads an OASIS file and writes the same library as a GDSII stream in
+// memory. GDSParse reads that stream like a GDS file, so OASIS input ends up
+// in the same objects and references, and also gets parallel parsing, lazy
+// loading, incremental reloads and the cache.
+class OASISReader
+{
+private:
+	// Input
+	const byte		*_pos;
+	const byte		*_end;
+	bool			_error;
+	bool			_done;		// END record seen
+
+	// The name tables may follow the cells that use them, so the file is
+	// read twice. The first pass only fills the tables.
+	bool			_emit;
+	map<uint64_t, string>	_cellnames;
+	map<uint64_t, string>	_textstrings;
+	uint64_t		_cellnameindex;
+	uint64_t		_textstringindex;
+	uint64_t		_offsetflag;
+
+	// Decompressed CBLOCKs, kept for the second pass
+	vector<byte*>		_blocks;
+	vector<uint64_t>	_blocksizes;
+	unsigned int		_blockindex;
+
+	OASISModal		_modal;
+	vector<int64_t>		_offsets;	// Instances of the current element
+	bool			_incell;
+	double			_unit;
+
+	// GDSII output
+	byte			*_out;
+	int64_t			_outsize;
+	int64_t			_outcapacity;
+	bool			_polygonwarning;
+
+	bool ParseRecords();
+	bool ParseCBlock();
+	void ResetModal();
+
+	byte ReadByte();
+	uint64_t ReadUInt();
+	int64_t ReadSInt();
+	double ReadReal();
+	double ReadRealType(uint64_t type);
+	void ReadString(string& str);
+	void SkipString();
+	void SkipInterval();
+	void SkipPropertyValue();
+	void ReadGDelta(int64_t *dx, int64_t *dy);
+	void ReadPointList(vector<int64_t>& points, bool polygon);
+	bool ReadRepetition(bool present);
+	int64_t ReadCoordinate(bool present, int64_t& modal);
+	uint64_t LatticeCount(const OASISRepetition& rep);
+	void RepetitionOffsets(bool repeated);
+	const string& CellName(uint64_t refnum);
+
+	void ParsePlacement(byte info, bool magangle);
+	void ParseText(byte info);
+	void ParseRectangle(byte info);
+	void ParsePolygon(byte info);
+	void ParsePath(byte info);
+	void ParseTrapezoid(byte info, int type);
+	void ParseCTrapezoid(byte info);
+	void ParseCircle(byte info);
+	void ParseLayerDatatype(byte info);
+
+	void Put(const void *data, int64_t length);
+	void PutHeader(byte type, byte datatype, int64_t length);
+	void PutInt16(int16_t value);
+	void PutInt32(int32_t value);
+	void PutReal8(double value);
+	void PutEmpty(byte type);
+	void PutShort(byte type, int16_t value);
+	void PutString(byte type, const string& str);
+	void PutXY(const int64_t *points, unsigned int count, int64_t x, int64_t y, bool close);
+	void PutBoundary(const int64_t *points, unsigned int count, int64_t x, int64_t y);
+	void PutRepeated(const int64_t *points, unsigned int count, int64_t x, int64_t y);
+
+public:
+	OASISReader();
+	~OASISReader();
+
+	// True if the file starts with the OASIS magic
+	static bool IsOASIS(FILE *iptr);
+
+	// Translate the whole file, the result is taken with Release()
+	bool Translate(FILE *iptr);
+	byte *Release(int64_t *size);
+};
+
+#endif // __OASISREADER_H__
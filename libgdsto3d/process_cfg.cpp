@@ -54,6 +54,14 @@ GDSProcess::GDSProcess()
 	_Valid = true;
 
 	_FirstLayer = NULL;
+
+	_LayerMap = new struct LayerMapEntry[LAYERMAP_SIZE];
+	for(int i=0; i<LAYERMAP_SIZE; i++){
+		_LayerMap[i].All = NULL;
+		_LayerMap[i].Warned = false;
+		_LayerMap[i].Datatypes = NULL;
+	}
+	_WarnedOther = false;
 }
 
 GDSProcess::~GDSProcess ()
@@ -81,6 +89,17 @@ GDSProcess::~GDSProcess ()
 			delete layer1;
 		}
 	}
+
+	for(int i=0; i<LAYERMAP_SIZE; i++){
+		struct LayerMapDirectory *dir = _LayerMap[i].Datatypes;
+		if(dir){
+			for(int j=0; j<LAYERMAP_SIZE/LAYERMAP_PAGE; j++){
+				delete dir->Page[j].load();
+			}
+			delete dir;
+		}
+	}
+	delete [] _LayerMap;
 }
 
 //bool GDSProcess::Parse(char *processfile)
@@ -463,21 +482,100 @@ void GDSProcess::Parse(char *processfile)
 
 struct ProcessLayer *GDSProcess::GetLayer(int Number, int Datatype)
 {
+	struct LayerMapEntry *entry;
+	struct LayerMapDirectory *dir;
+	struct LayerMapPage *page;
 	struct ProcessLayer *layer;
 
-	layer = _FirstLayer;
+	if(Number < 0 || Number >= LAYERMAP_SIZE) return NULL;
+	entry = &_LayerMap[Number];
+
+	if(Datatype >= 0 && Datatype < LAYERMAP_SIZE){
+		dir = entry->Datatypes.load(memory_order_acquire);
+		if(dir){
+			page = dir->Page[Datatype / LAYERMAP_PAGE].load(memory_order_acquire);
+			if(page){
+				layer = page->Layer[Datatype % LAYERMAP_PAGE].load(memory_order_acquire);
+				if(layer){
+					return layer;
+				}
+			}
+		}
+	}
+	return entry->All.load(memory_order_acquire);
+}
+
+// The page for Datatype, allocated on first use
+struct LayerMapPage *GDSProcess::MapPage(int Number, int Datatype)
+{
+	struct LayerMapEntry *entry = &_LayerMap[Number];
+	struct LayerMapDirectory *dir;
+	struct LayerMapPage *page;
+
+	dir = entry->Datatypes.load(memory_order_acquire);
+	if(dir){
+		page = dir->Page[Datatype / LAYERMAP_PAGE].load(memory_order_acquire);
+		if(page){
+			return page;
+		}
+	}
 
-	if(Number == -1) return NULL;
+	lock_guard<recursive_mutex> lock(_Mutex);
+	dir = entry->Datatypes.load(memory_order_acquire);
+	if(!dir){
+		dir = new struct LayerMapDirectory;
+		for(int i=0; i<LAYERMAP_SIZE/LAYERMAP_PAGE; i++){
+			dir->Page[i] = NULL;
+		}
+		entry->Datatypes.store(dir, memory_order_release);
+	}
 
-	while(layer){
-		if(layer->Layer == Number && layer->Datatype == -1){
-			return layer;
-		}else if(layer->Layer == Number && layer->Datatype == Datatype){
-			return layer;
+	page = dir->Page[Datatype / LAYERMAP_PAGE].load(memory_order_acquire);
+	if(!page){
+		page = new struct LayerMapPage;
+		for(int i=0; i<LAYERMAP_PAGE; i++){
+			page->Layer[i] = NULL;
+			page->Warned[i] = false;
 		}
-		layer = layer->Next;
+		dir->Page[Datatype / LAYERMAP_PAGE].store(page, memory_order_release);
 	}
-	return NULL;
+	return page;
+}
+
+// Layers are mapped in file order, so the first matching layer wins like
+// it did when the list was searched. A datatype -1 layer hides every
+// layer with the same number that comes after it.
+void GDSProcess::MapLayer(struct ProcessLayer *layer)
+{
+	struct LayerMapEntry *entry;
+	struct LayerMapPage *page;
+
+	if(layer->Layer < 0 || layer->Layer >= LAYERMAP_SIZE) return;
+	entry = &_LayerMap[layer->Layer];
+	if(entry->All.load(memory_order_acquire)) return;
+
+	if(layer->Datatype == -1){
+		entry->All.store(layer, memory_order_release);
+	}else if(layer->Datatype >= 0 && layer->Datatype < LAYERMAP_SIZE){
+		page = MapPage(layer->Layer, layer->Datatype);
+		if(!page->Layer[layer->Datatype % LAYERMAP_PAGE].load(memory_order_acquire)){
+			page->Layer[layer->Datatype % LAYERMAP_PAGE].store(layer, memory_order_release);
+		}
+	}
+}
+
+bool GDSProcess::WarnOnce(int Number, int Datatype)
+{
+	atomic<bool> *warned;
+
+	if(Number < 0 || Number >= LAYERMAP_SIZE){
+		warned = &_WarnedOther;
+	}else if(Datatype < 0 || Datatype >= LAYERMAP_SIZE){
+		warned = &_LayerMap[Number].Warned;
+	}else{
+		warned = &MapPage(Number, Datatype)->Warned[Datatype % LAYERMAP_PAGE];
+	}
+	return !*warned && !warned->exchange(true);
 }
 
 struct ProcessLayer *GDSProcess::GetLayer(int Index)
@@ -524,10 +622,19 @@ int GDSProcess::LayerCount()
 void GDSProcess::AddLayer(int Layer, int Datatype)
 {
 	struct ProcessLayer NewLayer;
+	struct ProcessLayer *layer;
 
 	if(Datatype<-1)
 		Datatype = -1; // Check for negative datatype (-1 is okay though)
 
+	// Several parser threads may report the same missing layer
+	lock_guard<recursive_mutex> lock(_Mutex);
+	for(layer = _FirstLayer; layer; layer = layer->Next){
+		if(layer->Layer == Layer && layer->Datatype == Datatype){
+			return;
+		}
+	}
+
 	NewLayer.Name = NULL;
 	NewLayer.Layer = Layer;
 	NewLayer.Datatype = Datatype;
@@ -563,22 +670,10 @@ void GDSProcess::ChangeLegendIndex(struct ProcessLayer *Layer, int LegendIndex)
 void GDSProcess::AddLayer(struct ProcessLayer *NewLayer)
 {
 	struct ProcessLayer *layer;
+	struct ProcessLayer *last;
 
-	layer = _FirstLayer;
-
-	if(_FirstLayer){
-		while(layer->Next){
-			layer = layer->Next;
-		}
-		layer->Next = new struct ProcessLayer;
-		layer = layer->Next;
-		layer->Next = NULL;
-	}else{
-		_FirstLayer = new struct ProcessLayer;
-		layer = _FirstLayer;
-		layer->Next = NULL;
-	}
-
+	layer = new struct ProcessLayer;
+	layer->Next = NULL;
 	layer->Name = NULL;
 	if(NewLayer->Name){
 		layer->Name = new char[strlen(NewLayer->Name)+1];
@@ -600,6 +695,20 @@ void GDSProcess::AddLayer(struct ProcessLayer *NewLayer)
 	layer->Shift = NewLayer->Shift;
 	layer->ShortKey = NewLayer->ShortKey;
 	layer->LegendIndex = NewLayer->LegendIndex;
+
+	// Link the layer in only when it is complete, GetLayer() does not lock
+	lock_guard<recursive_mutex> lock(_Mutex);
+	atomic_thread_fence(memory_order_release);
+	if(_FirstLayer){
+		last = _FirstLayer;
+		while(last->Next){
+			last = last->Next;
+		}
+		last->Next = layer;
+	}else{
+		_FirstLayer = layer;
+	}
+	MapLayer(layer);
 }
 
 bool GDSProcess::IsValid()
@@ -29,6 +29,8 @@
 #ifndef _PROCESS_CFG2_H
 #define _PROCESS_CFG2_H
 
+#include "gds_globals.h"
+
 struct ProcessLayer{
 	struct ProcessLayer *Next;
 	char *Name;
@@ -52,6 +54,27 @@ struct ProcessLayer{
 
 typedef struct ProcessLayer layers;
 
+// Process layers by GDS layer and datatype, both 0 to 65535. Datatype pages
+// are only allocated for layers that use them. Entries are published with
+// atomics, so parser threads look layers up without taking the lock.
+#define LAYERMAP_SIZE	65536
+#define LAYERMAP_PAGE	256
+
+struct LayerMapPage{
+	atomic<struct ProcessLayer*>	Layer[LAYERMAP_PAGE];
+	atomic<bool>			Warned[LAYERMAP_PAGE];	// Reported as missing
+};
+
+struct LayerMapDirectory{
+	atomic<struct LayerMapPage*>	Page[LAYERMAP_SIZE/LAYERMAP_PAGE];
+};
+
+struct LayerMapEntry{
+	atomic<struct ProcessLayer*>	All;	// Datatype -1, matches every datatype
+	atomic<bool>			Warned;
+	atomic<struct LayerMapDirectory*>	Datatypes;
+};
+
 class GDSProcess
 {
 private:
@@ -59,6 +82,14 @@ private:
 	int _Count;		/* Number of layers found */
 
 	bool _Valid;		/* Is the process file valid? */
+
+	recursive_mutex _Mutex;	/* Serializes AddLayer() for parser threads */
+
+	struct LayerMapEntry *_LayerMap;	/* Indexed by layer number */
+	atomic<bool> _WarnedOther;	/* Layers outside the map */
+
+	void MapLayer(struct ProcessLayer *layer);
+	struct LayerMapPage *MapPage(int Number, int Datatype);
 public:
 	GDSProcess ();
 	~GDSProcess ();
@@ -71,6 +102,7 @@ public:
 	void ChangeVisibility(struct ProcessLayer *Layer, bool Show);
 	void ChangeLegendIndex(struct ProcessLayer *Layer, int LegendIndex);
 	struct ProcessLayer *GetLayer(int Number, int Datatype);
+	bool WarnOnce(int Number, int Datatype); // True the first time a layer is reported missing
 	struct ProcessLayer *GetLayer(int Index);
 	struct ProcessLayer *GetLayer();
 	struct ProcessLayer *GetLayer(const char *Name);